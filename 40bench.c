@@ -0,0 +1,200 @@
+/* 40bench.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 4/26/2021
+ *
+ * Contains the main function for 40bench, a load generator for the 
+ *  40image --serve daemon. Each client thread holds one connection open and
+ *  sends the same in-memory image over and over; the latency of every 
+ *  request is recorded and the p50, p99, mean and throughput are reported.
+ *
+ * Usage: 40bench SOCKET -c|-d filename [-n requests] [-t clients]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "mem.h"
+#include "serve40.h"
+
+
+/* struct Bench_client
+ * Members:     sock_path:  the daemon's socket
+ *              compress:   whether requests compress or decompress
+ *              in, len:    the image sent with every request
+ *              latencies:  where this client records its requests' latencies
+ *              nrequests:  the number of requests this client sends
+ *              failures:   the number of requests that did not succeed
+ */
+struct Bench_client {
+    const char *sock_path;
+    bool compress;
+    const uint8_t *in;
+    size_t len;
+    double *latencies;
+    int nrequests;
+    int failures;
+};
+
+
+/* helper function declarations */
+void *bench_client_main(void *clientp);
+double bench_now(void);
+int bench_cmp_double(const void *a, const void *b);
+uint8_t *bench_slurp(const char *path, size_t *lenp);
+
+
+int main(int argc, char *argv[])
+{
+    int nrequests = 1000, nclients = 4;
+
+    if (argc < 4 || 
+        (strcmp(argv[2], "-c") != 0 && strcmp(argv[2], "-d") != 0)) {
+        fprintf(stderr, "Usage: %s SOCKET -c|-d filename "
+                "[-n requests] [-t clients]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    for (int i = 4; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-n") == 0) {
+            nrequests = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-t") == 0) {
+            nclients = atoi(argv[i + 1]);
+        }
+    }
+    if (nrequests < 1 || nclients < 1) {
+        fprintf(stderr, "%s: -n and -t must be positive\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    size_t len;
+    uint8_t *in = bench_slurp(argv[3], &len);
+    if (in == NULL) {
+        fprintf(stderr, "%s: cannot read %s\n", argv[0], argv[3]);
+        return EXIT_FAILURE;
+    }
+
+    double *latencies = CALLOC(nrequests, sizeof(double));
+    struct Bench_client *clients = CALLOC(nclients, sizeof(*clients));
+    pthread_t *threads = CALLOC(nclients, sizeof(pthread_t));
+
+    /* deal the requests out as evenly as possible */
+    double start = bench_now();
+    int offset = 0;
+    for (int i = 0; i < nclients; i++) {
+        clients[i].sock_path = argv[1];
+        clients[i].compress = strcmp(argv[2], "-c") == 0;
+        clients[i].in = in;
+        clients[i].len = len;
+        clients[i].latencies = latencies + offset;
+        clients[i].nrequests = nrequests / nclients + 
+                               (i < nrequests % nclients);
+        offset += clients[i].nrequests;
+        pthread_create(&threads[i], NULL, bench_client_main, &clients[i]);
+    }
+
+    int failures = 0;
+    for (int i = 0; i < nclients; i++) {
+        pthread_join(threads[i], NULL);
+        failures += clients[i].failures;
+    }
+    double elapsed = bench_now() - start;
+
+    double total = 0;
+    for (int i = 0; i < nrequests; i++) {
+        total += latencies[i];
+    }
+    qsort(latencies, nrequests, sizeof(double), bench_cmp_double);
+
+    printf("requests:   %d (%d failed) from %d clients\n", 
+           nrequests, failures, nclients);
+    printf("p50:        %.3f ms\n", 1e3 * latencies[(nrequests - 1) / 2]);
+    printf("p99:        %.3f ms\n", 
+           1e3 * latencies[(int) ((nrequests - 1) * 0.99)]);
+    printf("mean:       %.3f ms\n", 1e3 * total / nrequests);
+    printf("throughput: %.1f requests/s\n", nrequests / elapsed);
+
+    FREE(threads);
+    FREE(clients);
+    FREE(latencies);
+    FREE(in);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/* bench_client_main
+ * Purpose:     thread body of one client: connects once and sends its 
+ *                  requests back to back, timing each one
+ * Parameters:  void *clientp: the client's struct Bench_client
+ */
+void *bench_client_main(void *clientp)
+{
+    struct Bench_client *client = clientp;
+    uint8_t *out = NULL;
+    size_t cap = 0, outlen;
+
+    int sock = serve40_connect(client->sock_path);
+    for (int i = 0; i < client->nrequests; i++) {
+        double t0 = bench_now();
+        int status = sock < 0 ? SERVE40_IO_ERROR :
+                     serve40_request(sock, client->compress, client->in, 
+                                     client->len, -1, &out, &cap, &outlen);
+        client->latencies[i] = bench_now() - t0;
+        client->failures += status != COMPRESS40_OK;
+    }
+
+    if (sock >= 0) {
+        close(sock);
+    }
+    FREE(out);
+    return NULL;
+}
+
+
+/* bench_now
+ * Purpose:     returns the monotonic clock in seconds
+ */
+double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* bench_cmp_double
+ * Purpose:     qsort comparison of two doubles, ascending
+ */
+int bench_cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+
+/* bench_slurp
+ * Purpose:     reads the file at path into a newly allocated buffer
+ * Returns:     uint8_t *: the buffer, or NULL if the file cannot be read; 
+ *                  its length is stored in *lenp
+ */
+uint8_t *bench_slurp(const char *path, size_t *lenp)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long len = ftell(fp);
+    rewind(fp);
+
+    uint8_t *buf = ALLOC(len > 0 ? len : 1);
+    if (len <= 0 || fread(buf, 1, len, fp) != (size_t) len) {
+        FREE(buf);
+        buf = NULL;
+    }
+    fclose(fp);
+
+    *lenp = len;
+    return buf;
+}
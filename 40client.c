@@ -0,0 +1,92 @@
+/* 40client.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 4/26/2021
+ *
+ * Contains the main function for 40client, which sends one image to a 
+ *  running 40image --serve daemon and writes the result to stdout. A named
+ *  file is passed to the daemon as an open descriptor (so the daemon maps
+ *  it directly); stdin is read and sent over the socket.
+ *
+ * Usage: 40client SOCKET -c|-d [filename]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "mem.h"
+#include "serve40.h"
+
+
+/* helper function declarations */
+uint8_t *client_slurp(FILE *fp, size_t *lenp);
+
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3 || argc > 4 || 
+        (strcmp(argv[2], "-c") != 0 && strcmp(argv[2], "-d") != 0)) {
+        fprintf(stderr, "Usage: %s SOCKET -c|-d [filename]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    bool compress = strcmp(argv[2], "-c") == 0;
+
+    int sock = serve40_connect(argv[1]);
+    if (sock < 0) {
+        fprintf(stderr, "%s: cannot connect to %s\n", argv[0], argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    uint8_t *in = NULL, *out = NULL;
+    size_t len = 0, cap = 0, outlen = 0;
+    int fd = -1;
+    if (argc == 4) {
+        fd = open(argv[3], O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "%s: cannot open %s\n", argv[0], argv[3]);
+            return EXIT_FAILURE;
+        }
+    } else {
+        in = client_slurp(stdin, &len);
+    }
+
+    int status = serve40_request(sock, compress, in, len, fd, 
+                                 &out, &cap, &outlen);
+    if (status == COMPRESS40_OK) {
+        fwrite(out, 1, outlen, stdout);
+    } else {
+        fprintf(stderr, "%s: request failed (status %d)\n", argv[0], status);
+    }
+
+    close(sock);
+    if (fd >= 0) {
+        close(fd);
+    }
+    FREE(in);
+    FREE(out);
+    return status == COMPRESS40_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/* client_slurp
+ * Purpose:     reads all of fp into a newly allocated buffer
+ * Returns:     uint8_t *: the buffer, which the caller must FREE; its 
+ *                  length is stored in *lenp
+ */
+uint8_t *client_slurp(FILE *fp, size_t *lenp)
+{
+    size_t cap = 1 << 16, len = 0, n;
+    uint8_t *buf = ALLOC(cap);
+
+    while ((n = fread(buf + len, 1, cap - len, fp)) > 0) {
+        len += n;
+        if (len == cap) {
+            cap *= 2;
+            RESIZE(buf, cap);
+        }
+    }
+
+    *lenp = len;
+    return buf;
+}
@@ -8,35 +8,358 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "assert.h"
+#include "mem.h"
+#include "seq.h"
 #include "compress40.h"
+#include "big_buf.h"
+#include "fault_stats.h"
+#include "batch40.h"
+#include "serve40.h"
+#include "hash_index.h"
+#include "frame_seq.h"
 
 static void (*compress_or_decompress)(FILE *input) = compress40;
 
+/* what went wrong, by Compress40_status */
+static const char *status_messages[] = {
+        "ok", "not a ppm or compressed image", "output too large",
+        "region is outside the image or image is too small",
+        "checksum mismatch"
+};
+
+static void usage(const char *progname);
+static int run_batch(char **files, int nfiles, const char *outdir,
+                     int nthreads);
+static int run_crop(const char *path, Compress40_rect rect, bool decode);
+static int run_preview(const char *path, unsigned shrink);
+static int run_yuv420(const char *path, bool full_range);
+static int run_16bit(const char *path);
+static int run_yuv_input(const char *path, bool y4m, 
+                         Compress40_yuv_layout layout, unsigned width,
+                         unsigned height, bool full_range);
+static int run_transform(const char *path, const char *name);
+static int run_downscale(const char *path, unsigned levels);
+static int run_stats(const char *path, int nthreads);
+static int run_pack(const char *path, bool pack, int nthreads);
+static int run_convert(const char *path, unsigned format);
+static int run_verify(char **files, int nfiles);
+static int run_blend(const char *path, const char *overlay_path, 
+                     unsigned x, unsigned y, float alpha, int nthreads);
+static int run_patch(const char *path, const char *patch_path, unsigned x,
+                     unsigned y);
+static int run_mosaic(char **files, int nfiles, unsigned columns, 
+                      unsigned gap, float fill);
+static int run_hash(const char *path);
+static int run_hash_add(const char *index, char **files, int nfiles,
+                        int nthreads);
+static int run_near(const char *index, const char *path, unsigned distance,
+                    int nthreads);
+static int run_adjust(const char *path, Compress40_adjustment adj, 
+                      bool in_place);
+static int run_append(const char *seq_path, char **files, int nfiles,
+                      unsigned interval);
+static int run_frame(const char *seq_path, long k);
+static int run_extract(const char *seq_path, const char *dir, 
+                       int nthreads);
+static Seq_T read_file_names(char ***filesp, int *nfilesp);
+static void free_file_names(Seq_T *namesp, char **files);
+static uint8_t *load_input(const char *path, size_t *lenp, bool *mappedp);
+static uint8_t *try_load_input(const char *path, size_t *lenp, 
+                               bool *mappedp);
+static void unload_input(uint8_t *in, size_t len, bool mapped);
+static int finish_output(const char *path, Compress40_status status,
+                         uint8_t *out, size_t outlen);
+
 
 int main(int argc, char *argv[])
 {
         int i;
+        const char *outdir = NULL;      /* set by -o: batch mode */
+        const char *sock_path = NULL;   /* set by --serve: daemon mode */
+        size_t max_request = 0;         /* set by --max-request */
+        bool decode = false;            /* -d given explicitly */
+        bool crop = false;              /* set by --crop */
+        Compress40_rect rect = { 0, 0, 0, 0 };
+        unsigned shrink = 0;            /* set by --half and --quarter */
+        bool yuv420 = false;            /* set by --yuv420 */
+        bool full_range = false;        /* set by --full-range */
+        bool sixteen = false;           /* set by --16bit */
+        int yuv_layout = -1;            /* set by --i420 and --nv12 */
+        unsigned yuv_width = 0, yuv_height = 0;
+        bool y4m = false;               /* set by --y4m */
+        const char *transform = NULL;   /* set by --transform */
+        int levels = -1;                /* set by --downscale and --mip */
+        bool adjust = false;            /* set by --adjust */
+        bool in_place = false;          /* set by --in-place */
+        bool stats = false;             /* set by --stats */
+        int pack = -1;                  /* 1 for --pack, 0 for --unpack */
+        unsigned format = 0;            /* set by --convert */
+        bool verify = false;            /* set by --verify */
+        bool hash = false;              /* set by --hash */
+        const char *add_index = NULL;   /* set by --hash-add */
+        const char *near_index = NULL;  /* set by --near */
+        unsigned distance = 10;         /* set by --distance */
+        const char *overlay = NULL;     /* set by --blend */
+        const char *patch = NULL;       /* set by --patch */
+        float alpha = 0.5;              /* set by --alpha */
+        unsigned at_x = 0, at_y = 0;    /* set by --at */
+        unsigned columns = 0;           /* set by --mosaic */
+        unsigned gap = 0;               /* set by --gap */
+        float fill = 0;                 /* set by --fill */
+        const char *append = NULL;      /* set by --append */
+        unsigned interval = 1;          /* set by --keyframe */
+        long frame = -1;                /* set by --frame */
+        const char *extract = NULL;     /* set by --extract */
+        Compress40_adjustment adj = { 0, 1, 1 };
+        int nthreads = 0;               /* 0: one worker per CPU */
 
         for (i = 1; i < argc; i++) {
                 if (strcmp(argv[i], "-c") == 0) {
                         compress_or_decompress = compress40;
                 } else if (strcmp(argv[i], "-d") == 0) {
                         compress_or_decompress = decompress40;
+                        decode = true;
+                } else if (strcmp(argv[i], "--faults") == 0) {
+                        Fault_stats_report_to(stderr);
+                } else if (strcmp(argv[i], "--prefault") == 0) {
+                        Big_buf_set_prefault(true);
+                } else if (strcmp(argv[i], "--huge-threshold") == 0 &&
+                           i + 1 < argc) {
+                        Big_buf_set_threshold(strtoull(argv[++i], NULL, 0));
+                } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+                        outdir = argv[++i];
+                } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+                        nthreads = atoi(argv[++i]);
+                } else if (strcmp(argv[i], "--half") == 0) {
+                        shrink = 2;
+                } else if (strcmp(argv[i], "--quarter") == 0) {
+                        shrink = 4;
+                } else if (strcmp(argv[i], "--yuv420") == 0) {
+                        yuv420 = true;
+                } else if (strcmp(argv[i], "--full-range") == 0) {
+                        full_range = true;
+                } else if (strcmp(argv[i], "--16bit") == 0) {
+                        sixteen = true;
+                } else if ((strcmp(argv[i], "--i420") == 0 || 
+                            strcmp(argv[i], "--nv12") == 0) && 
+                           i + 1 < argc) {
+                        yuv_layout = strcmp(argv[i], "--i420") == 0 ? 
+                                     COMPRESS40_I420 : COMPRESS40_NV12;
+                        if (sscanf(argv[++i], "%ux%u", &yuv_width, 
+                                   &yuv_height) != 2) {
+                                usage(argv[0]);
+                                exit(1);
+                        }
+                } else if (strcmp(argv[i], "--y4m") == 0) {
+                        y4m = true;
+                } else if (strcmp(argv[i], "--adjust") == 0 && i + 1 < argc) {
+                        adjust = sscanf(argv[++i], "%f,%f,%f", 
+                                        &adj.brightness, &adj.contrast,
+                                        &adj.saturation) == 3 &&
+                                 isfinite(adj.brightness) && 
+                                 isfinite(adj.contrast) && 
+                                 isfinite(adj.saturation);
+                        if (!adjust) {
+                                usage(argv[0]);
+                                exit(1);
+                        }
+                } else if (strcmp(argv[i], "--pack") == 0) {
+                        pack = 1;
+                } else if (strcmp(argv[i], "--unpack") == 0) {
+                        pack = 0;
+                } else if (strcmp(argv[i], "--convert") == 0 && 
+                           i + 1 < argc) {
+                        format = strtoul(argv[++i], NULL, 0);
+                        if (format != 2 && format != 3) {
+                                usage(argv[0]);
+                                exit(1);
+                        }
+                } else if (strcmp(argv[i], "--crc") == 0) {
+                        compress40_set_checksums(true);
+                } else if (strcmp(argv[i], "--profile") == 0 && 
+                           i + 1 < argc) {
+                        if (!compress40_set_profile(argv[++i])) {
+                                fprintf(stderr, "40image: no profile "
+                                        "named %s\n", argv[i]);
+                                return EXIT_FAILURE;
+                        }
+                } else if (strcmp(argv[i], "--verify") == 0) {
+                        verify = true;
+                } else if (strcmp(argv[i], "--stats") == 0) {
+                        stats = true;
+                } else if (strcmp(argv[i], "--blend") == 0 && i + 1 < argc) {
+                        overlay = argv[++i];
+                } else if (strcmp(argv[i], "--patch") == 0 && i + 1 < argc) {
+                        patch = argv[++i];
+                } else if (strcmp(argv[i], "--alpha") == 0 && i + 1 < argc) {
+                        alpha = atof(argv[++i]);
+                        if (!(alpha >= 0 && alpha <= 1)) {
+                                usage(argv[0]);
+                                exit(1);
+                        }
+                } else if (strcmp(argv[i], "--at") == 0 && i + 1 < argc) {
+                        if (sscanf(argv[++i], "%u,%u", &at_x, &at_y) != 2) {
+                                usage(argv[0]);
+                                exit(1);
+                        }
+                } else if (strcmp(argv[i], "--mosaic") == 0 && 
+                           i + 1 < argc) {
+                        columns = strtoul(argv[++i], NULL, 0);
+                        if (columns == 0) {
+                                usage(argv[0]);
+                                exit(1);
+                        }
+                } else if (strcmp(argv[i], "--gap") == 0 && i + 1 < argc) {
+                        gap = strtoul(argv[++i], NULL, 0);
+                } else if (strcmp(argv[i], "--fill") == 0 && i + 1 < argc) {
+                        fill = atof(argv[++i]);
+                } else if (strcmp(argv[i], "--hash") == 0) {
+                        hash = true;
+                } else if (strcmp(argv[i], "--hash-add") == 0 && 
+                           i + 1 < argc) {
+                        add_index = argv[++i];
+                } else if (strcmp(argv[i], "--near") == 0 && i + 1 < argc) {
+                        near_index = argv[++i];
+                } else if (strcmp(argv[i], "--distance") == 0 && 
+                           i + 1 < argc) {
+                        distance = strtoul(argv[++i], NULL, 0);
+                } else if (strcmp(argv[i], "--in-place") == 0) {
+                        in_place = true;
+                } else if (strcmp(argv[i], "--downscale") == 0) {
+                        levels = 1;
+                } else if (strcmp(argv[i], "--mip") == 0) {
+                        levels = 0;
+                } else if (strcmp(argv[i], "--transform") == 0 && 
+                           i + 1 < argc) {
+                        transform = argv[++i];
+                } else if (strcmp(argv[i], "--crop") == 0 && i + 1 < argc) {
+                        crop = sscanf(argv[++i], "%u,%u,%u,%u", &rect.x, 
+                                      &rect.y, &rect.w, &rect.h) == 4;
+                        if (!crop) {
+                                usage(argv[0]);
+                                exit(1);
+                        }
+                } else if (strcmp(argv[i], "--append") == 0 && 
+                           i + 1 < argc) {
+                        append = argv[++i];
+                } else if (strcmp(argv[i], "--keyframe") == 0 && 
+                           i + 1 < argc) {
+                        interval = strtoul(argv[++i], NULL, 0);
+                } else if (strcmp(argv[i], "--frame") == 0 && i + 1 < argc) {
+                        frame = strtol(argv[++i], NULL, 0);
+                        if (frame < 0) {
+                                usage(argv[0]);
+                                exit(1);
+                        }
+                } else if (strcmp(argv[i], "--extract") == 0 && 
+                           i + 1 < argc) {
+                        extract = argv[++i];
+                } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+                        sock_path = argv[++i];
+                } else if (strcmp(argv[i], "--max-request") == 0 && 
+                           i + 1 < argc) {
+                        max_request = strtoull(argv[++i], NULL, 0);
                 } else if (*argv[i] == '-') {
                         fprintf(stderr, "%s: unknown option '%s'\n",
                                 argv[0], argv[i]);
                         exit(1);
-                } else if (argc - i > 2) {
-                        fprintf(stderr, "Usage: %s -d [filename]\n"
-                                "       %s -c [filename]\n",
-                                argv[0], argv[0]);
+                } else if (argc - i > 1 && outdir == NULL && 
+                           add_index == NULL && columns == 0 && !verify &&
+                           append == NULL) {
+                        usage(argv[0]);
                         exit(1);
                 } else {
                         break;
                 }
         }
+
+        if (sock_path != NULL) {
+                return serve40(sock_path, nthreads, max_request);
+        }
+        if (outdir != NULL) {
+                return run_batch(argv + i, argc - i, outdir, nthreads);
+        }
+        if (add_index != NULL) {
+                return run_hash_add(add_index, argv + i, argc - i, nthreads);
+        }
+        if (columns != 0) {
+                return run_mosaic(argv + i, argc - i, columns, gap, fill);
+        }
+        if (verify) {
+                return run_verify(argv + i, argc - i);
+        }
+        if (append != NULL) {
+                return run_append(append, argv + i, argc - i, interval);
+        }
+
         assert(argc - i <= 1);    /* at most one file on command line */
+        if (crop) {
+                return run_crop(i < argc ? argv[i] : NULL, rect, decode);
+        }
+        if (shrink != 0) {
+                return run_preview(i < argc ? argv[i] : NULL, shrink);
+        }
+        if (yuv420) {
+                return run_yuv420(i < argc ? argv[i] : NULL, full_range);
+        }
+        if (sixteen) {
+                return run_16bit(i < argc ? argv[i] : NULL);
+        }
+        if (yuv_layout >= 0 || y4m) {
+                return run_yuv_input(i < argc ? argv[i] : NULL, y4m, 
+                                     yuv_layout, yuv_width, yuv_height,
+                                     full_range);
+        }
+        if (transform != NULL) {
+                return run_transform(i < argc ? argv[i] : NULL, transform);
+        }
+        if (levels >= 0) {
+                return run_downscale(i < argc ? argv[i] : NULL, levels);
+        }
+        if (patch != NULL) {
+                return run_patch(i < argc ? argv[i] : NULL, patch, at_x, 
+                                 at_y);
+        }
+        if (overlay != NULL) {
+                return run_blend(i < argc ? argv[i] : NULL, overlay, at_x,
+                                 at_y, alpha, nthreads);
+        }
+        if (hash) {
+                return run_hash(i < argc ? argv[i] : NULL);
+        }
+        if (near_index != NULL) {
+                return run_near(near_index, i < argc ? argv[i] : NULL, 
+                                distance, nthreads);
+        }
+        if (pack >= 0) {
+                return run_pack(i < argc ? argv[i] : NULL, pack, nthreads);
+        }
+        if (format != 0) {
+                return run_convert(i < argc ? argv[i] : NULL, format);
+        }
+        if (stats) {
+                return run_stats(i < argc ? argv[i] : NULL, nthreads);
+        }
+        if (adjust) {
+                return run_adjust(i < argc ? argv[i] : NULL, adj, in_place);
+        }
+        if (frame >= 0 || extract != NULL) {
+                if (i == argc) {
+                        usage(argv[0]);
+                        exit(1);
+                }
+                return extract != NULL ? run_extract(argv[i], extract, 
+                                                     nthreads)
+                                       : run_frame(argv[i], frame);
+        }
         if (i < argc) {
                 FILE *fp = fopen(argv[i], "r");
                 assert(fp != NULL);
@@ -49,3 +372,831 @@ int main(int argc, char *argv[])
         return EXIT_SUCCESS; 
 }
 
+
+static void usage(const char *progname)
+{
+        fprintf(stderr, "Usage: %s -d [options] [filename]\n"
+                "       %s -c [options] [filename]\n"
+                "       %s -c|-d -o outdir [-j threads] [filename...]\n"
+                "       %s --serve socket [-j threads] [--max-request BYTES]\n"
+                "       %s [-d] --crop x,y,w,h [filename]\n"
+                "       %s -d --half|--quarter [filename]\n"
+                "       %s -d --yuv420 [--full-range] [filename]\n"
+                "       %s -d --16bit [filename]\n"
+                "       %s -c --i420|--nv12 WxH [--full-range] "
+                "[filename]\n"
+                "       %s -c --y4m [filename]\n"
+                "       %s --transform rot90|rot180|rot270|flip-h|flip-v|"
+                "transpose [filename]\n"
+                "       %s --downscale|--mip [filename]\n"
+                "       %s --adjust brightness,contrast,saturation "
+                "[--in-place] [filename]\n"
+                "       %s --stats [-j threads] [filename]\n"
+                "       %s --pack|--unpack [-j threads] [filename]\n"
+                "       %s --convert 2|3 [filename]\n"
+                "       %s --verify [filename...]\n"
+                "       %s --blend overlay [--alpha weight] [--at x,y] "
+                "[-j threads] [filename]\n"
+                "       %s --patch ppm [--at x,y] filename\n"
+                "       %s --mosaic columns [--gap pixels] [--fill gray] "
+                "[filename...]\n"
+                "       %s --hash [filename]\n"
+                "       %s --hash-add index [-j threads] [filename...]\n"
+                "       %s --near index [--distance bits] [-j threads] "
+                "[filename]\n"
+                "       %s --append sequence [--keyframe interval] "
+                "[filename...]\n"
+                "       %s --frame k sequence\n"
+                "       %s --extract dir [-j threads] sequence\n"
+                "options: --faults --prefault --huge-threshold BYTES\n"
+                "         --crc (end compressed output in a checksum)\n"
+                "         --profile tiny|small|standard|high|max "
+                "(16 to 64 bits a block)\n"
+                "With -o, files are read from stdin (one per line) "
+                "if none are named, as are files for --hash-add, "
+                "--mosaic, --verify and --append\n",
+                progname, progname, progname, progname, progname,
+                progname, progname, progname, progname, progname,
+                progname, progname, progname, progname, progname,
+                progname, progname, progname, progname, progname,
+                progname, progname, progname, progname, progname,
+                progname);
+}
+
+
+/* runs a batch over the named files, or over the file names listed one 
+   per line on stdin if there are none; exits nonzero if any file failed */
+static int run_batch(char **files, int nfiles, const char *outdir,
+                     int nthreads)
+{
+        bool compress = compress_or_decompress == compress40;
+        Seq_T names = NULL;
+
+        if (nfiles == 0) {
+                names = read_file_names(&files, &nfiles);
+        }
+
+        int failures = batch40(compress, files, nfiles, outdir, nthreads);
+
+        if (names != NULL) {
+                free_file_names(&names, files);
+        }
+
+        if (failures > 0) {
+                fprintf(stderr, "%s: %d of %d files failed\n", 
+                        "40image", failures, nfiles);
+                return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+}
+
+
+/* writes the w x h region at (x, y) of a compressed image to stdout, as a 
+   ppm with -d or as a block-aligned compressed sub-image without it */
+static int run_crop(const char *path, Compress40_rect rect, bool decode)
+{
+        size_t len, outlen = 0, cap = 0;
+        bool mapped;
+        uint8_t *in = load_input(path, &len, &mapped);
+        uint8_t *out = NULL;
+
+        Compress40_status status = decompress40_crop(in, len, rect, !decode,
+                                                     &out, &cap, &outlen);
+        unload_input(in, len, mapped);
+        return finish_output(path, status, out, outlen);
+}
+
+
+/* writes a 1/shrink scale preview of a compressed image to stdout */
+static int run_preview(const char *path, unsigned shrink)
+{
+        size_t len, outlen = 0, cap = 0;
+        bool mapped;
+        uint8_t *in = load_input(path, &len, &mapped);
+        uint8_t *out = NULL;
+
+        Compress40_status status = decompress40_preview(in, len, shrink, 
+                                                        &out, &cap, &outlen);
+        unload_input(in, len, mapped);
+        return finish_output(path, status, out, outlen);
+}
+
+
+/* decodes a compressed image to stdout as raw I420 (Y, Cb and Cr planes,
+   8 bits a sample) instead of a ppm */
+static int run_yuv420(const char *path, bool full_range)
+{
+        size_t len, outlen = 0, cap = 0;
+        bool mapped;
+        uint8_t *in = load_input(path, &len, &mapped);
+        uint8_t *out = NULL;
+
+        if (mapped) {
+                madvise(in, len, MADV_SEQUENTIAL);
+        }
+        Compress40_status status = decompress40_yuv420(in, len, full_range,
+                                                       &out, &cap, &outlen);
+        unload_input(in, len, mapped);
+        return finish_output(path, status, out, outlen);
+}
+
+
+/* decodes a compressed image to stdout as a ppm with maxval 65535 */
+static int run_16bit(const char *path)
+{
+        size_t len, outlen = 0, cap = 0;
+        bool mapped;
+        uint8_t *in = load_input(path, &len, &mapped);
+        uint8_t *out = NULL;
+
+        if (mapped) {
+                madvise(in, len, MADV_SEQUENTIAL);
+        }
+        Compress40_status status = decompress40_16bit(in, len, &out, &cap,
+                                                      &outlen);
+        unload_input(in, len, mapped);
+        return finish_output(path, status, out, outlen);
+}
+
+
+/* compresses a raw I420 or NV12 image of the provided size (or, with y4m,
+   the first frame of a Y4M stream) to stdout, straight from its planes */
+static int run_yuv_input(const char *path, bool y4m, 
+                         Compress40_yuv_layout layout, unsigned width,
+                         unsigned height, bool full_range)
+{
+        size_t len, outlen = 0, cap = 0;
+        bool mapped;
+        uint8_t *in = load_input(path, &len, &mapped);
+        uint8_t *out = NULL;
+
+        if (mapped) {
+                madvise(in, len, MADV_SEQUENTIAL);
+        }
+        Compress40_status status = 
+                y4m ? compress40_y4m(in, len, &out, &cap, &outlen)
+                    : compress40_yuv(in, len, layout, width, height, 
+                                     full_range, &out, &cap, &outlen);
+        unload_input(in, len, mapped);
+        if (status == COMPRESS40_BAD_FORMAT) {
+                fprintf(stderr, "40image: %s: %s\n", 
+                        path != NULL ? path : "stdin", 
+                        y4m ? "not a Y4M stream" 
+                            : "too short for a YUV image of that size");
+                compress40_free(out);
+                return EXIT_FAILURE;
+        }
+        return finish_output(path, status, out, outlen);
+}
+
+
+/* writes a compressed image rotated, flipped or transposed (as named) to 
+   stdout, still compressed */
+static int run_transform(const char *path, const char *name)
+{
+        static const char *names[] = {
+                "rot90", "rot180", "rot270", "flip-h", "flip-v", "transpose"
+        };
+        int t = 0;
+        while (t < 6 && strcmp(name, names[t]) != 0) {
+                t++;
+        }
+        if (t == 6) {
+                fprintf(stderr, "40image: unknown transform '%s'\n", name);
+                return EXIT_FAILURE;
+        }
+
+        size_t len, outlen = 0, cap = 0;
+        bool mapped;
+        uint8_t *in = load_input(path, &len, &mapped);
+        uint8_t *out = NULL;
+
+        Compress40_status status = compress40_transform(in, len, t, &out, 
+                                                        &cap, &outlen);
+        unload_input(in, len, mapped);
+        return finish_output(path, status, out, outlen);
+}
+
+
+/* writes a compressed image at half size (or, with levels 0, every level
+   of its mip pyramid, one after another) to stdout, still compressed */
+static int run_downscale(const char *path, unsigned levels)
+{
+        size_t len, outlen = 0, cap = 0;
+        bool mapped;
+        uint8_t *in = load_input(path, &len, &mapped);
+        uint8_t *out = NULL;
+
+        Compress40_status status = compress40_downscale(in, len, levels, 
+                                                        &out, &cap, &outlen);
+        unload_input(in, len, mapped);
+        return finish_output(path, status, out, outlen);
+}
+
+
+/* prints statistics about a compressed image as JSON to stdout */
+static int run_stats(const char *path, int nthreads)
+{
+        size_t len, outlen = 0, cap = 0;
+        bool mapped;
+        uint8_t *in = load_input(path, &len, &mapped);
+        uint8_t *out = NULL;
+
+        if (mapped) {
+                madvise(in, len, MADV_SEQUENTIAL);
+        }
+        Compress40_status status = compress40_stats(in, len, nthreads,
+                                                    &out, &cap, &outlen);
+        unload_input(in, len, mapped);
+        return finish_output(path, status, out, outlen);
+}
+
+
+/* blends a compressed overlay into a compressed image, the overlay's top 
+   left pixel at (x, y), and writes the result to stdout, still compressed*/
+static int run_blend(const char *path, const char *overlay_path, 
+                     unsigned x, unsigned y, float alpha, int nthreads)
+{
+        size_t len, overlay_len, outlen = 0, cap = 0;
+        bool mapped, overlay_mapped;
+        uint8_t *in = load_input(path, &len, &mapped);
+        uint8_t *overlay = load_input(overlay_path, &overlay_len, 
+                                      &overlay_mapped);
+        uint8_t *out = NULL;
+
+        Compress40_status status = compress40_blend(in, len, overlay, 
+                                                    overlay_len, x, y, alpha,
+                                                    nthreads, &out, &cap, 
+                                                    &outlen);
+        unload_input(overlay, overlay_len, overlay_mapped);
+        unload_input(in, len, mapped);
+        return finish_output(path, status, out, outlen);
+}
+
+
+/* re-encodes the blocks of the named compressed file under a ppm patch 
+   whose top left pixel goes at (x, y). The file is mapped privately, 
+   patched in memory, and only the rewritten words are written back to it
+   with pwrite, one block row at a time */
+static int run_patch(const char *path, const char *patch_path, unsigned x,
+                     unsigned y)
+{
+        struct stat st;
+        int fd = path != NULL ? open(path, O_RDWR) : -1;
+        if (fd < 0 || fstat(fd, &st) != 0 || st.st_size <= 0) {
+                fprintf(stderr, "40image: --patch needs a writable "
+                        "compressed file\n");
+                if (fd >= 0) {
+                        close(fd);
+                }
+                return EXIT_FAILURE;
+        }
+        size_t len = st.st_size;
+        uint8_t *in = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, 
+                           fd, 0);
+        if (in == MAP_FAILED) {
+                perror("40image: mmap");
+                close(fd);
+                return EXIT_FAILURE;
+        }
+        madvise(in, len, MADV_RANDOM);
+
+        size_t patch_len;
+        bool patch_mapped;
+        uint8_t *patch = load_input(patch_path, &patch_len, &patch_mapped);
+
+        Compress40_rect dirty;
+        Compress40_status status = compress40_patch(in, len, patch, 
+                                                    patch_len, x, y, &dirty);
+        unload_input(patch, patch_len, patch_mapped);
+
+        for (unsigned r = 0; status == COMPRESS40_OK && r < dirty.h; r += 2) {
+                size_t offset, row_len = (size_t) dirty.w / 2 * 4;
+                compress40_word_offset(in, len, dirty.x, dirty.y + r, 
+                                       &offset);
+                if (pwrite(fd, in + offset, row_len, offset) != 
+                    (ssize_t) row_len) {
+                        perror("40image: pwrite");
+                        munmap(in, len);
+                        close(fd);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        /* compress40_patch rewrote the checksum trailer, if there is one */
+        size_t trailer = 0;
+        if (status == COMPRESS40_OK && 
+            compress40_verify(in, len, &trailer) == COMPRESS40_OK &&
+            trailer > 0 && 
+            pwrite(fd, in + trailer, COMPRESS40_TRAILER_SIZE, trailer) != 
+            COMPRESS40_TRAILER_SIZE) {
+                perror("40image: pwrite");
+                munmap(in, len);
+                close(fd);
+                return EXIT_FAILURE;
+        }
+
+        munmap(in, len);
+        close(fd);
+        return finish_output(path, status, NULL, 0);
+}
+
+
+/* lays the named compressed images (or those listed one per line on stdin
+   if there are none) out in a grid with the given number of columns, each
+   at the top left of a cell as large as the largest image, with gap pixels
+   between cells, and writes the canvas to stdout, still compressed */
+static int run_mosaic(char **files, int nfiles, unsigned columns, 
+                      unsigned gap, float fill)
+{
+        Seq_T names = NULL;
+
+        if (nfiles == 0) {
+                names = read_file_names(&files, &nfiles);
+        }
+
+        Compress40_tile *tiles = ALLOC((nfiles > 0 ? nfiles : 1) * 
+                                       sizeof(*tiles));
+        bool *mapped = ALLOC((nfiles > 0 ? nfiles : 1) * sizeof(*mapped));
+        unsigned cell_w = 0, cell_h = 0;
+        int bad = -1;
+
+        for (int j = 0; j < nfiles; j++) {
+                unsigned w, h;
+                tiles[j].comp = load_input(files[j], &tiles[j].len, 
+                                           &mapped[j]);
+                if (compress40_size(tiles[j].comp, tiles[j].len, &w, 
+                                    &h) != COMPRESS40_OK) {
+                        bad = bad < 0 ? j : bad;
+                        continue;
+                }
+                cell_w = w > cell_w ? w : cell_w;
+                cell_h = h > cell_h ? h : cell_h;
+        }
+
+        gap += gap % 2;
+        unsigned used = (unsigned) nfiles < columns ? (unsigned) nfiles 
+                                                    : columns;
+        unsigned rows = (nfiles + columns - 1) / columns;
+        for (int j = 0; j < nfiles; j++) {
+                tiles[j].x = (j % columns) * (cell_w + gap);
+                tiles[j].y = (j / columns) * (cell_h + gap);
+        }
+
+        size_t outlen = 0, cap = 0;
+        uint8_t *out = NULL;
+        Compress40_status status = bad >= 0 ? COMPRESS40_BAD_FORMAT :
+                compress40_mosaic(tiles, nfiles, 
+                                  used * (cell_w + gap) - gap,
+                                  rows * (cell_h + gap) - gap, fill, 
+                                  &out, &cap, &outlen);
+
+        for (int j = 0; j < nfiles; j++) {
+                unload_input((uint8_t *) tiles[j].comp, tiles[j].len, 
+                             mapped[j]);
+        }
+        FREE(mapped);
+        FREE(tiles);
+
+        int result = finish_output(bad >= 0 ? files[bad] : "mosaic", 
+                                   status, out, outlen);
+        if (names != NULL) {
+                free_file_names(&names, files);
+        }
+        return result;
+}
+
+
+/* prints the perceptual hash of a compressed image to stdout in hex */
+static int run_hash(const char *path)
+{
+        size_t len;
+        bool mapped;
+        uint64_t hash;
+        uint8_t *in = load_input(path, &len, &mapped);
+
+        Compress40_status status = compress40_hash(in, len, &hash);
+        if (status == COMPRESS40_OK) {
+                printf("%016llx\n", (unsigned long long) hash);
+        }
+        unload_input(in, len, mapped);
+        return finish_output(path, status, NULL, 0);
+}
+
+
+/* adds the named compressed images, or those listed one per line on stdin
+   if there are none, to a hash index; exits nonzero if any file failed */
+static int run_hash_add(const char *index, char **files, int nfiles,
+                        int nthreads)
+{
+        Seq_T names = NULL;
+
+        if (nfiles == 0) {
+                names = read_file_names(&files, &nfiles);
+        }
+
+        int failures = Hash_index_add(index, files, nfiles, nthreads);
+
+        if (names != NULL) {
+                free_file_names(&names, files);
+        }
+        return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/* prints the images in a hash index whose hashes are at most distance bits
+   from a compressed image's, nearest first, one "distance name" per line */
+static int run_near(const char *index, const char *path, unsigned distance,
+                    int nthreads)
+{
+        Hash_index hashes = Hash_index_open(index);
+        if (hashes == NULL) {
+                fprintf(stderr, "40image: %s: not a hash index\n", index);
+                return EXIT_FAILURE;
+        }
+
+        size_t len;
+        bool mapped;
+        uint64_t hash;
+        uint8_t *in = load_input(path, &len, &mapped);
+        Compress40_status status = compress40_hash(in, len, &hash);
+        unload_input(in, len, mapped);
+
+        if (status == COMPRESS40_OK) {
+                Hash_match *matches;
+                size_t n = Hash_index_query(hashes, hash, distance, 
+                                            nthreads, &matches);
+                for (size_t j = 0; j < n; j++) {
+                        printf("%u %s\n", matches[j].distance, 
+                               Hash_index_name(hashes, matches[j].entry));
+                }
+                FREE(matches);
+        }
+
+        Hash_index_free(&hashes);
+        return finish_output(path, status, NULL, 0);
+}
+
+
+/* writes a compressed image entropy coded (--pack), or an entropy-coded 
+   image back in the plain format (--unpack), to stdout */
+static int run_pack(const char *path, bool pack, int nthreads)
+{
+        size_t len, outlen = 0, cap = 0;
+        bool mapped;
+        uint8_t *in = load_input(path, &len, &mapped);
+        uint8_t *out = NULL;
+
+        if (mapped) {
+                madvise(in, len, MADV_SEQUENTIAL);
+        }
+        Compress40_status status = 
+                pack ? compress40_pack(in, len, nthreads, &out, &cap, &outlen)
+                     : compress40_unpack(in, len, nthreads, &out, &cap, 
+                                         &outlen);
+        unload_input(in, len, mapped);
+        return finish_output(path, status, out, outlen);
+}
+
+
+/* writes a compressed image to stdout in format 2 (text header, big-endian
+   words) or format 3 (binary header, aligned little-endian words) */
+static int run_convert(const char *path, unsigned format)
+{
+        size_t len, outlen = 0, cap = 0;
+        bool mapped;
+        uint8_t *in = load_input(path, &len, &mapped);
+        uint8_t *out = NULL;
+
+        if (mapped) {
+                madvise(in, len, MADV_SEQUENTIAL);
+        }
+        Compress40_status status = compress40_convert(in, len, format, &out,
+                                                      &cap, &outlen);
+        unload_input(in, len, mapped);
+        return finish_output(path, status, out, outlen);
+}
+
+
+/* checks each named compressed file (or each listed one per line on stdin
+   if there are none) against its checksum trailer without decoding it, 
+   printing one line per file; fails if any file is corrupt, cannot be 
+   opened or is not a compressed image */
+static int run_verify(char **files, int nfiles)
+{
+        static const char *results[] = {
+                "ok", "not a compressed image", "", "", "checksum mismatch"
+        };
+        Seq_T names = NULL;
+        int failures = 0;
+
+        if (nfiles == 0) {
+                names = read_file_names(&files, &nfiles);
+        }
+
+        for (int j = 0; j < nfiles; j++) {
+                size_t len, trailer;
+                bool mapped;
+                uint8_t *in = try_load_input(files[j], &len, &mapped);
+                if (in == NULL) {
+                        printf("%s: cannot open\n", files[j]);
+                        failures++;
+                        continue;
+                }
+                if (mapped) {
+                        madvise(in, len, MADV_SEQUENTIAL);
+                }
+                Compress40_status status = compress40_verify(in, len, 
+                                                             &trailer);
+                unload_input(in, len, mapped);
+
+                printf("%s: %s\n", files[j], 
+                       status == COMPRESS40_OK && trailer == 0 ? 
+                       "no checksum" : results[status]);
+                failures += status != COMPRESS40_OK;
+        }
+
+        if (names != NULL) {
+                free_file_names(&names, files);
+        }
+        return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/* adjusts the brightness, contrast and saturation of a compressed image,
+   rewriting the named file in place with --in-place or writing the result
+   to stdout otherwise, and reports on stderr how many coefficients 
+   saturated */
+static int run_adjust(const char *path, Compress40_adjustment adj, 
+                      bool in_place)
+{
+        size_t len, saturated = 0;
+        bool mapped = false;
+        uint8_t *in;
+
+        if (in_place) {
+                struct stat st;
+                int fd = path != NULL ? open(path, O_RDWR) : -1;
+                if (fd < 0 || fstat(fd, &st) != 0 || st.st_size <= 0) {
+                        fprintf(stderr, "40image: --in-place needs a "
+                                "writable compressed file\n");
+                        if (fd >= 0) {
+                                close(fd);
+                        }
+                        return EXIT_FAILURE;
+                }
+                len = st.st_size;
+                in = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, 
+                          fd, 0);
+                close(fd);
+                if (in == MAP_FAILED) {
+                        perror("40image: mmap");
+                        return EXIT_FAILURE;
+                }
+                mapped = true;
+        } else {
+                in = load_input(path, &len, &mapped);
+        }
+
+        Compress40_status status = compress40_adjust(in, len, adj, 
+                                                     &saturated);
+        if (status == COMPRESS40_OK) {
+                fprintf(stderr, "40image: %zu coefficients saturated\n",
+                        saturated);
+                if (!in_place) {
+                        fwrite(in, 1, len, stdout);
+                }
+        }
+
+        unload_input(in, len, mapped);
+        return finish_output(path, status, NULL, 0);
+}
+
+
+/* compresses the named ppm files (or those listed one per line on stdin
+   if there are none) and appends them, in order, as frames of a sequence
+   file, creating it if need be, with a keyframe at least every interval 
+   frames and delta frames between; stops at the first frame that cannot
+   be written */
+static int run_append(const char *seq_path, char **files, int nfiles,
+                      unsigned interval)
+{
+        Seq_T names = NULL;
+        uint8_t *out = NULL;
+        size_t cap = 0;
+        int result = EXIT_SUCCESS;
+
+        if (nfiles == 0) {
+                names = read_file_names(&files, &nfiles);
+        }
+
+        for (int j = 0; j < nfiles && result == EXIT_SUCCESS; j++) {
+                size_t len, outlen;
+                bool mapped;
+                uint8_t *in = load_input(files[j], &len, &mapped);
+                Compress40_status status = compress40_buffered(true, in, 
+                                                               len, &out, 
+                                                               &cap, 
+                                                               &outlen);
+                unload_input(in, len, mapped);
+
+                if (status != COMPRESS40_OK) {
+                        fprintf(stderr, "40image: %s: %s\n", files[j],
+                                status_messages[status]);
+                        result = EXIT_FAILURE;
+                } else if (Frame_seq_append(seq_path, out, outlen, 
+                                            interval) != 0) {
+                        fprintf(stderr, "40image: %s: %s\n", seq_path,
+                                errno == EINVAL ? "not a frame sequence"
+                                                : strerror(errno));
+                        result = EXIT_FAILURE;
+                }
+        }
+
+        compress40_free(out);
+        if (names != NULL) {
+                free_file_names(&names, files);
+        }
+        return result;
+}
+
+
+/* decodes frame k of a sequence file to stdout */
+static int run_frame(const char *seq_path, long k)
+{
+        Frame_seq seq = Frame_seq_open(seq_path);
+        if (seq == NULL) {
+                fprintf(stderr, "40image: %s: not a frame sequence\n", 
+                        seq_path);
+                return EXIT_FAILURE;
+        }
+        if ((size_t) k >= Frame_seq_length(seq)) {
+                fprintf(stderr, "40image: %s: has only %zu frames\n", 
+                        seq_path, Frame_seq_length(seq));
+                Frame_seq_free(&seq);
+                return EXIT_FAILURE;
+        }
+
+        uint8_t *out = NULL;
+        size_t cap = 0, outlen = 0;
+        Compress40_status status = Frame_seq_decode(seq, k, &out, &cap, 
+                                                    &outlen);
+        Frame_seq_free(&seq);
+        return finish_output(seq_path, status, out, outlen);
+}
+
+
+/* decodes every frame of a sequence file into dir/frameNNNNNN.ppm, 
+   several frames at once; exits nonzero if any frame failed */
+static int run_extract(const char *seq_path, const char *dir, int nthreads)
+{
+        Frame_seq seq = Frame_seq_open(seq_path);
+        if (seq == NULL) {
+                fprintf(stderr, "40image: %s: not a frame sequence\n", 
+                        seq_path);
+                return EXIT_FAILURE;
+        }
+
+        int failures = Frame_seq_extract(seq, dir, nthreads);
+        Frame_seq_free(&seq);
+        return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/* reads file names from stdin, one per line, into *filesp (*nfilesp of 
+   them) and returns the sequence that owns them, to be released with 
+   free_file_names */
+static Seq_T read_file_names(char ***filesp, int *nfilesp)
+{
+        char *line = NULL;
+        size_t cap = 0;
+        ssize_t len;
+
+        Seq_T names = Seq_new(64);
+        while ((len = getline(&line, &cap, stdin)) > 0) {
+                if (line[len - 1] == '\n') {
+                        line[--len] = '\0';
+                }
+                if (len > 0) {
+                        char *name = ALLOC(len + 1);
+                        memcpy(name, line, len + 1);
+                        Seq_addhi(names, name);
+                }
+        }
+        free(line);
+
+        int nfiles = Seq_length(names);
+        char **files = ALLOC((nfiles > 0 ? nfiles : 1) * sizeof(char *));
+        for (int j = 0; j < nfiles; j++) {
+                files[j] = Seq_get(names, j);
+        }
+
+        *filesp = files;
+        *nfilesp = nfiles;
+        return names;
+}
+
+
+/* frees the names read by read_file_names and the array of them */
+static void free_file_names(Seq_T *namesp, char **files)
+{
+        int nfiles = Seq_length(*namesp);
+        for (int j = 0; j < nfiles; j++) {
+                FREE(files[j]);
+        }
+        FREE(files);
+        Seq_free(namesp);
+}
+
+
+/* returns the contents of the named file (mapped privately, so only the 
+   pages a caller touches are read and changes never reach the file) or, 
+   if path is NULL or names something that cannot be mapped, all of stdin 
+   or the file read into memory
+   Note: it is a CRE for the named file not to open */
+static uint8_t *load_input(const char *path, size_t *lenp, bool *mappedp)
+{
+        uint8_t *in = try_load_input(path, lenp, mappedp);
+        assert(in != NULL);
+        return in;
+}
+
+
+/* load_input, but returns NULL if the named file cannot be opened */
+static uint8_t *try_load_input(const char *path, size_t *lenp, 
+                               bool *mappedp)
+{
+        FILE *fp = stdin;
+        struct stat st;
+
+        if (path != NULL) {
+                int fd = open(path, O_RDONLY);
+                if (fd < 0) {
+                        return NULL;
+                }
+                if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && 
+                    st.st_size > 0) {
+                        void *in = mmap(NULL, st.st_size, 
+                                        PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                                        fd, 0);
+                        close(fd);
+                        if (in != MAP_FAILED) {
+                                madvise(in, st.st_size, MADV_RANDOM);
+                                *lenp = st.st_size;
+                                *mappedp = true;
+                                return in;
+                        }
+                } else {
+                        close(fd);
+                }
+                fp = fopen(path, "rb");
+                if (fp == NULL) {
+                        return NULL;
+                }
+        }
+
+        size_t len = 0, cap = 1 << 16, n;
+        uint8_t *in = ALLOC(cap);
+        while ((n = fread(in + len, 1, cap - len, fp)) > 0) {
+                len += n;
+                if (len == cap) {
+                        cap *= 2;
+                        RESIZE(in, cap);
+                }
+        }
+        if (fp != stdin) {
+                fclose(fp);
+        }
+
+        *lenp = len;
+        *mappedp = false;
+        return in;
+}
+
+
+/* releases an input returned by load_input */
+static void unload_input(uint8_t *in, size_t len, bool mapped)
+{
+        if (mapped) {
+                munmap(in, len);
+        } else {
+                FREE(in);
+        }
+}
+
+
+/* writes out[0..outlen) to stdout if status is COMPRESS40_OK, or reports 
+   the failure; frees out either way and returns the exit code */
+static int finish_output(const char *path, Compress40_status status,
+                         uint8_t *out, size_t outlen)
+{
+        if (status == COMPRESS40_OK && out != NULL) {
+                fwrite(out, 1, outlen, stdout);
+        } else if (status != COMPRESS40_OK) {
+                fprintf(stderr, "40image: %s: %s\n", 
+                        path != NULL ? path : "stdin", 
+                        status_messages[status]);
+        }
+        compress40_free(out);
+        return status == COMPRESS40_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -28,12 +28,12 @@ unsigned D_LSB = 8;
 unsigned A_LSB = 23;
 
 /*helper function declarations*/
-int64_t *scale_all_vals(float *abc_val);
+void scale_all_vals(float *abc_val, int64_t *scaled_val);
 void unscale_all_vals(float *abc_val, int64_t *scaled_val);
 int64_t scale_bcd(float n);
 float unscale_bcd(int64_t n);
 uint64_t pack_into_word(int64_t *scaled_val, uint64_t word);
-int64_t *unpack_word(uint64_t *word);
+void unpack_word(uint64_t *word, int64_t *unpacked_vals);
 int bcd_lsb(int i);
 
 
@@ -51,10 +51,10 @@ void abcd_to_word(float *abc_val, uint64_t *wordp)
 {
     assert(abc_val != NULL);
     assert(wordp != NULL);
-    int64_t *scaled_vals = scale_all_vals(abc_val);
+    int64_t scaled_vals[6];
+    scale_all_vals(abc_val, scaled_vals);
 
     *wordp = pack_into_word(scaled_vals, *wordp);
-    FREE(scaled_vals);
 }
 
 
@@ -70,25 +70,27 @@ void word_to_abcd(float *abc_val, uint64_t *wordp)
 {
     assert(abc_val != NULL);
     assert(wordp != NULL);
-    int64_t *scaled_val = unpack_word(wordp);
+    int64_t scaled_val[6];
+    unpack_word(wordp, scaled_val);
 
     unscale_all_vals(abc_val, scaled_val);
-    FREE(scaled_val);
 }
 
 
 /* scale_all_vals
  *  Purpose: Given an array of float values for a, b, c, d, Pb, and Pr, 
- *               allocates and returns a pointer to an array with their 
- *               quantized scaled int64_t forms
+ *               fills the provided int64_t array with their quantized 
+ *               scaled forms
  *  Parameters: float *abc_val: array containing [a, b, c, d, Pb, Pr]
- *  Returns:    int64_t *: heap-allocated array with 
+ *              int64_t *scaled_val: array of 6 to be filled with 
  *                  [a, b, c, d, Pb, Pr] as scaled ints
- *  Notes:      it is a CRE for abc_val to be null
+ *  Returns:    None
+ *  Notes:      it is a CRE for abc_val or scaled_val to be null
  */
-int64_t *scale_all_vals(float *abc_val)
+void scale_all_vals(float *abc_val, int64_t *scaled_val)
 {
-    int64_t *scaled_val = ALLOC(sizeof(int64_t)*6);
+    assert(abc_val != NULL);
+    assert(scaled_val != NULL);
 
     /* get packed a */
     scaled_val[0] = (int64_t) floor(abc_val[0] * 511);
@@ -101,8 +103,6 @@ int64_t *scale_all_vals(float *abc_val)
     /* get packed pb and pr */
     scaled_val[4] = Arith40_index_of_chroma(abc_val[4]);
     scaled_val[5] = Arith40_index_of_chroma(abc_val[5]);
-    
-    return scaled_val;
 }
 
 
@@ -194,23 +194,19 @@ uint64_t pack_into_word(int64_t *scaled_val, uint64_t word)
 
 
 /* unpack_word
- * Purpose:     given a 32-bit word in a 64-bit word, allocates and returns a 
- *                  pointer to an array with 
- *                  the quantized scaled int representations of 
+ * Purpose:     given a 32-bit word in a 64-bit word, fills the provided 
+ *                  array with the quantized scaled int representations of 
  *                   [a, b, c, d, Pb, Pr] 
  * Parameters:  uint64_t *word: pointer to the word to be unpacked
- *              bool front_of_word: true if the first 32 bits of the word 
- *                  should be unpacked, false if the last 32 bits should be 
- *                  unpacked 
- * Returns:     int64_t *: heap-allocated array containing the scaled int
- *                   representations of a, b, c, d, Pb, and Pr
- * Note:        it is a CRE for wordp to be NULL
+ *              int64_t *unpacked_vals: array of 6 to be filled with the 
+ *                   scaled int representations of a, b, c, d, Pb, and Pr
+ * Returns:     None
+ * Note:        it is a CRE for wordp or unpacked_vals to be NULL
  */
-int64_t *unpack_word(uint64_t *wordp)
+void unpack_word(uint64_t *wordp, int64_t *unpacked_vals)
 {
     assert(wordp != NULL);
-
-    int64_t *unpacked_vals = ALLOC(sizeof(int64_t)*6);
+    assert(unpacked_vals != NULL);
     
     /* unpack a */
     unpacked_vals[0] = Bitpack_getu(*wordp, A_WIDTH, A_LSB);
@@ -223,8 +219,6 @@ int64_t *unpack_word(uint64_t *wordp)
     /* unpack Pr/Pb */
     unpacked_vals[4] = Bitpack_getu(*wordp, PBPR_WIDTH, PR_LSB + PBPR_WIDTH);
     unpacked_vals[5] = Bitpack_getu(*wordp, PBPR_WIDTH, PR_LSB);
-    
-    return unpacked_vals;
 }
 
 
@@ -0,0 +1,321 @@
+/* batch40.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the implementation of batch compression. Every file becomes one
+ *  Thread_pool job that maps its input, runs the in-memory codec into a 
+ *  per-thread output buffer, and writes the result into the output 
+ *  directory. Per-thread buffers (the output buffer here and the pipeline 
+ *  arena in compress40.c) are reused from one image to the next.
+ *
+ *  Jobs are sorted largest first and dealt round-robin, so each worker 
+ *  starts on its biggest images while idle workers steal from the small 
+ *  end of other workers' deques. Small images therefore never wait behind
+ *  every large one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "assert.h"
+#include "mem.h"
+#include "compress40.h"
+#include "comp_gray.h"
+#include "thread_pool.h"
+#include "batch40.h"
+
+
+/* struct Batch_job
+ * Members:     path:       the input file
+ *              outdir:     the directory to write the output into
+ *              out:        the output file inside outdir
+ *              compress:   true to compress, false to decompress
+ *              gray:       true if the input is a grayscale compressed 
+ *                              image, which decompresses to a pgm
+ *              size:       the size of the input in bytes, used to schedule
+ *              error:      NULL on success, otherwise what went wrong
+ */
+struct Batch_job {
+    const char *path;
+    const char *outdir;
+    char *out;
+    bool compress;
+    bool gray;
+    size_t size;
+    const char *error;
+};
+
+
+/* helper function declarations */
+void run_batch_job(void *jobp);
+void batch_worker_exit(void);
+const char *code_buffer(struct Batch_job *job, const uint8_t *in, 
+                        size_t len, size_t *outlen);
+const char *write_output(struct Batch_job *job, size_t outlen);
+char *output_path(struct Batch_job *job);
+bool gray_input(const char *path);
+void fail_duplicate_outputs(struct Batch_job *jobs, int nfiles);
+int cmp_job_out(const void *a, const void *b);
+int cmp_job_size(const void *a, const void *b);
+
+
+/* the calling worker's output buffer, reused across images */
+static __thread uint8_t *out_buf = NULL;
+static __thread size_t out_cap = 0;
+
+
+/* batch40
+ * Purpose:     Compresses or decompresses a list of files on a thread pool
+ * Parameters:  bool compress: true to compress, false to decompress
+ *              char **files, int nfiles: the input files
+ *              const char *outdir: the directory outputs are written into
+ *              int nthreads: the number of workers, or < 1 for one per CPU
+ * Returns:     int: the number of files that failed
+ * Note:        It is a CRE for files or outdir to be NULL. Inputs that would
+ *                  write the same output file (d1/x.ppm and d2/x.ppm) fail
+ *                  before any job runs, except the first on the command line
+ */
+int batch40(bool compress, char **files, int nfiles, const char *outdir,
+            int nthreads)
+{
+    assert(files != NULL);
+    assert(outdir != NULL);
+
+    struct Batch_job *jobs = CALLOC(nfiles > 0 ? nfiles : 1, 
+                                    sizeof(struct Batch_job));
+    for (int i = 0; i < nfiles; i++) {
+        struct stat st;
+        jobs[i].path = files[i];
+        jobs[i].outdir = outdir;
+        jobs[i].compress = compress;
+        jobs[i].gray = !compress && gray_input(files[i]);
+        jobs[i].size = stat(files[i], &st) == 0 ? (size_t) st.st_size : 0;
+        jobs[i].error = NULL;
+        jobs[i].out = output_path(&jobs[i]);
+    }
+    fail_duplicate_outputs(jobs, nfiles);
+    qsort(jobs, nfiles, sizeof(struct Batch_job), cmp_job_size);
+
+    Thread_pool pool = Thread_pool_new(nthreads, batch_worker_exit);
+    for (int i = 0, next = 0; i < nfiles; i++) {
+        if (jobs[i].error == NULL) {
+            Thread_pool_submit(pool, next++ % Thread_pool_size(pool),
+                               run_batch_job, &jobs[i]);
+        }
+    }
+    Thread_pool_free(&pool);
+
+    int failures = 0;
+    for (int i = 0; i < nfiles; i++) {
+        if (jobs[i].error != NULL) {
+            failures++;
+        }
+        FREE(jobs[i].out);
+    }
+
+    FREE(jobs);
+    return failures;
+}
+
+
+/* run_batch_job
+ * Purpose:     Thread_pool job that maps one input file, codes it, writes
+ *                  the output, and reports any failure on stderr
+ * Parameters:  void *jobp: the struct Batch_job to run
+ */
+void run_batch_job(void *jobp)
+{
+    struct Batch_job *job = jobp;
+    size_t outlen = 0;
+
+    int fd = open(job->path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        job->error = strerror(errno);
+    } else if (st.st_size == 0) {
+        job->error = "empty file";
+    } else {
+        void *in = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (in == MAP_FAILED) {
+            job->error = strerror(errno);
+        } else {
+            job->error = code_buffer(job, in, st.st_size, &outlen);
+            munmap(in, st.st_size);
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    const char *failed = job->path;
+    if (job->error == NULL) {
+        job->error = write_output(job, outlen);
+        failed = job->out;
+    }
+    if (job->error != NULL) {
+        fprintf(stderr, "40image: %s: %s\n", failed, job->error);
+    }
+}
+
+
+/* code_buffer
+ * Purpose:     Runs the in-memory codec on one input, growing the worker's
+ *                  output buffer first if the result would not fit
+ * Returns:     const char *: NULL on success, otherwise an error message
+ */
+const char *code_buffer(struct Batch_job *job, const uint8_t *in, 
+                        size_t len, size_t *outlen)
+{
+    Compress40_status status = compress40_buffered(job->compress, in, len,
+                                                   &out_buf, &out_cap, 
+                                                   outlen);
+    switch (status) {
+        case COMPRESS40_OK:         return NULL;
+        case COMPRESS40_BAD_FORMAT: return job->compress ? 
+                                           "not a P6 ppm of at least 2x2" :
+                                           "not a compressed image";
+        case COMPRESS40_BAD_CHECKSUM: return "checksum mismatch";
+        default:                    return "output buffer too small";
+    }
+}
+
+
+/* write_output
+ * Purpose:     Writes the worker's output buffer to the job's output file
+ * Returns:     const char *: NULL on success, otherwise an error message
+ */
+const char *write_output(struct Batch_job *job, size_t outlen)
+{
+    const char *error = NULL;
+
+    int fd = open(job->out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        error = strerror(errno);
+    } else {
+        size_t written = 0;
+        while (written < outlen && error == NULL) {
+            ssize_t n = write(fd, out_buf + written, outlen - written);
+            if (n < 0 && errno != EINTR) {
+                error = strerror(errno);
+            } else if (n > 0) {
+                written += n;
+            }
+        }
+        close(fd);
+    }
+
+    return error;
+}
+
+
+/* output_path
+ * Purpose:     Builds "<outdir>/<input name without extension>.<ext>", where
+ *                  ext is c40 for compressed output, pgm for a decompressed
+ *                  grayscale image and ppm otherwise
+ * Returns:     char *: the heap-allocated path; the caller frees it
+ */
+char *output_path(struct Batch_job *job)
+{
+    const char *name = strrchr(job->path, '/');
+    name = name == NULL ? job->path : name + 1;
+
+    const char *dot = strrchr(name, '.');
+    int stem_len = dot == NULL || dot == name ? (int) strlen(name) 
+                                              : (int) (dot - name);
+
+    size_t size = strlen(job->outdir) + stem_len + 6;
+    char *path = ALLOC(size);
+    snprintf(path, size, "%s/%.*s.%s", job->outdir, stem_len, name,
+             job->compress ? "c40" : job->gray ? "pgm" : "ppm");
+    return path;
+}
+
+
+/* gray_input
+ * Purpose:     Returns true if the named file starts like a grayscale 
+ *                  compressed image; a file that cannot be read is left 
+ *                  for its job to report
+ */
+bool gray_input(const char *path)
+{
+    uint8_t head[64];
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    ssize_t n = read(fd, head, sizeof(head));
+    close(fd);
+    return n > 0 && Comp_gray_is(head, n);
+}
+
+
+/* fail_duplicate_outputs
+ * Purpose:     Fails every job whose output file is also the output of an
+ *                  earlier job on the command line, so that no two workers
+ *                  write the same file and no result is silently lost
+ * Parameters:  struct Batch_job *jobs, int nfiles: the jobs, still in
+ *                  command-line order
+ */
+void fail_duplicate_outputs(struct Batch_job *jobs, int nfiles)
+{
+    struct Batch_job **by_out = CALLOC(nfiles > 0 ? nfiles : 1,
+                                       sizeof(*by_out));
+    for (int i = 0; i < nfiles; i++) {
+        by_out[i] = &jobs[i];
+    }
+    qsort(by_out, nfiles, sizeof(*by_out), cmp_job_out);
+
+    struct Batch_job *first = NULL;
+    for (int i = 0; i < nfiles; i++) {
+        if (first == NULL || strcmp(first->out, by_out[i]->out) != 0) {
+            first = by_out[i];
+            continue;
+        }
+        by_out[i]->error = "duplicate output";
+        fprintf(stderr, "40image: %s: output %s is already written for %s\n",
+                by_out[i]->path, by_out[i]->out, first->path);
+    }
+
+    FREE(by_out);
+}
+
+
+/* cmp_job_out
+ * Purpose:     qsort comparison that orders job pointers by output path,
+ *                  then by command-line order
+ */
+int cmp_job_out(const void *a, const void *b)
+{
+    const struct Batch_job *job_a = *(struct Batch_job * const *) a;
+    const struct Batch_job *job_b = *(struct Batch_job * const *) b;
+    int cmp = strcmp(job_a->out, job_b->out);
+    return cmp != 0 ? cmp : (job_a > job_b) - (job_a < job_b);
+}
+
+
+/* batch_worker_exit
+ * Purpose:     Releases a worker's reusable buffers when the pool shuts down
+ */
+void batch_worker_exit(void)
+{
+    compress40_free(out_buf);
+    out_buf = NULL;
+    out_cap = 0;
+    compress40_release();
+}
+
+
+/* cmp_job_size
+ * Purpose:     qsort comparison that orders jobs from largest to smallest
+ */
+int cmp_job_size(const void *a, const void *b)
+{
+    size_t size_a = ((const struct Batch_job *) a)->size;
+    size_t size_b = ((const struct Batch_job *) b)->size;
+    return (size_a < size_b) - (size_a > size_b);
+}
@@ -0,0 +1,22 @@
+/* batch40.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 4/22/2021
+ *
+ * Contains the interface for compressing or decompressing many files in one
+ *  process on a work-stealing thread pool (40image -o DIR)
+ */
+
+#ifndef BATCH40_H
+#define BATCH40_H
+
+#include <stdbool.h>
+
+/* compresses (or, if compress is false, decompresses) each of the nfiles 
+    files into outdir using nthreads workers (one per CPU if < 1). A file 
+    that fails is reported on stderr and skipped; the rest of the batch 
+    still runs. Returns the number of files that failed
+    Note: it is a CRE for files or outdir to be NULL */
+int batch40(bool compress, char **files, int nfiles, const char *outdir,
+            int nthreads);
+
+#endif
@@ -0,0 +1,137 @@
+/* big_buf.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 4/14/2021
+ *
+ * Contains the implementation of the large pipeline buffer allocator
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "assert.h"
+#include "mem.h"
+#include "big_buf.h"
+
+
+/* size at or above which buffers are mapped from the OS */
+static size_t threshold = BIG_BUF_DEFAULT_THRESHOLD;
+
+/* whether mapped buffers are prefaulted */
+static bool prefault_maps = false;
+
+
+/* Big_buf_set_threshold
+ * Purpose:     sets the size at or above which buffers are mapped 
+ */
+void Big_buf_set_threshold(size_t nbytes)
+{
+    threshold = nbytes;
+}
+
+
+/* Big_buf_threshold
+ * Purpose:     returns the size at or above which buffers are mapped 
+ */
+size_t Big_buf_threshold(void)
+{
+    return threshold;
+}
+
+
+/* Big_buf_set_prefault
+ * Purpose:     sets whether mapped buffers are prefaulted with MAP_POPULATE
+ */
+void Big_buf_set_prefault(bool prefault)
+{
+    prefault_maps = prefault;
+}
+
+
+/* Big_buf_prefault
+ * Purpose:     returns whether mapped buffers are prefaulted
+ */
+bool Big_buf_prefault(void)
+{
+    return prefault_maps;
+}
+
+
+/* Big_buf_alloc
+ * Purpose:     Allocates a buffer, mapping it from the OS with huge pages 
+ *                  (and prefaulting it if configured) when it is big enough
+ * Parameters:  size_t nbytes: the size of the buffer
+ * Returns:     void *: the uninitialized buffer
+ * Note:        Raises Mem_Failed if the memory cannot be allocated
+ */
+void *Big_buf_alloc(size_t nbytes)
+{
+    if (nbytes < threshold) {
+        return ALLOC(nbytes);
+    }
+    return Big_buf_map(nbytes, true, prefault_maps);
+}
+
+
+/* Big_buf_free
+ * Purpose:     Frees a buffer allocated with Big_buf_alloc
+ * Parameters:  void *ptr: the buffer
+ *              size_t nbytes: the size the buffer was allocated with
+ * Note:        It is a CRE for ptr to be NULL
+ *              The threshold must not change between allocation and free
+ */
+void Big_buf_free(void *ptr, size_t nbytes)
+{
+    assert(ptr != NULL);
+
+    if (nbytes < threshold) {
+        FREE(ptr);
+    } else {
+        munmap(ptr, nbytes);
+    }
+}
+
+
+/* Big_buf_map
+ * Purpose:     Maps anonymous memory from the OS
+ * Parameters:  size_t nbytes: the size of the mapping
+ *              bool huge_pages: true to advise transparent huge pages
+ *              bool prefault: true to fault every page in up front
+ * Returns:     void *: the zeroed mapping
+ * Note:        Raises Mem_Failed if the mapping fails
+ *              Where the kernel headers allow it, the hugepage advice is 
+ *                  given before prefaulting so the prefault itself is 
+ *                  satisfied with huge pages; otherwise MAP_POPULATE is used
+ */
+void *Big_buf_map(size_t nbytes, bool huge_pages, bool prefault)
+{
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+#ifndef MADV_POPULATE_WRITE
+    if (prefault) {
+        flags |= MAP_POPULATE;
+    }
+#endif
+
+    void *mem = mmap(NULL, nbytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (mem == MAP_FAILED) {
+        RAISE(Mem_Failed);
+    }
+
+#ifdef MADV_HUGEPAGE
+    if (huge_pages) {
+        madvise(mem, nbytes, MADV_HUGEPAGE);
+    }
+#else
+    (void) huge_pages;
+#endif
+
+#ifdef MADV_POPULATE_WRITE
+    /* kernels older than 5.14 reject the advice; populate by touch */
+    if (prefault && madvise(mem, nbytes, MADV_POPULATE_WRITE) != 0) {
+        for (size_t i = 0; i < nbytes; i += 4096) {
+            ((volatile char *) mem)[i] = 0;
+        }
+    }
+#endif
+
+    return mem;
+}
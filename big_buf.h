@@ -0,0 +1,49 @@
+/* big_buf.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 4/14/2021
+ *
+ * Contains the interface for allocating the large buffers of the pipeline
+ *  (XYZ planes, compressed word arrays, RGB rasters). Buffers at or above a
+ *  size threshold are mapped straight from the OS, advised to use
+ *  transparent huge pages, and optionally prefaulted so the pipeline does
+ *  not take a page fault on first touch of every 4 KB page.
+ */
+
+#ifndef BIG_BUF_H
+#define BIG_BUF_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+
+/* buffers smaller than this many bytes come from Hanson's Mem by default */
+#define BIG_BUF_DEFAULT_THRESHOLD (2 * 1024 * 1024)
+
+/* sets the size at or above which Big_buf_alloc maps buffers from the OS */
+void Big_buf_set_threshold(size_t nbytes);
+
+/* returns the current size threshold */
+size_t Big_buf_threshold(void);
+
+/* sets whether mapped buffers are prefaulted with MAP_POPULATE */
+void Big_buf_set_prefault(bool prefault);
+
+/* returns whether mapped buffers are prefaulted */
+bool Big_buf_prefault(void);
+
+/* returns a buffer of nbytes, mapped from the OS if nbytes is at least the
+    threshold and allocated with ALLOC otherwise
+    Note: raises Mem_Failed if the memory cannot be allocated */
+void *Big_buf_alloc(size_t nbytes);
+
+/* frees a buffer from Big_buf_alloc; nbytes must match the allocation
+    Note: it is a CRE for ptr to be NULL */
+void Big_buf_free(void *ptr, size_t nbytes);
+
+/* maps nbytes of zeroed memory from the OS, advised to use huge pages if
+    huge_pages is true and prefaulted if prefault is true. Release it with
+    munmap.
+    Note: raises Mem_Failed if the mapping fails */
+void *Big_buf_map(size_t nbytes, bool huge_pages, bool prefault);
+
+#endif
@@ -0,0 +1,101 @@
+/* codeword.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the implementation of direct access to the fields of a 32-bit 
+ *  codeword. Fields are read and written with plain shifts and masks, 
+ *  rather than through Bitpack, since these functions run once per word
+ *  over whole word arrays.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <arith40.h>
+#include "assert.h"
+#include "codeword.h"
+
+
+/* helper function declarations */
+int codeword_signed_field(uint32_t word, unsigned shift);
+
+
+/* Codeword_unpack
+ * Purpose:     Splits a codeword into its quantized fields
+ * Parameters:  uint32_t word: the codeword
+ * Returns:     Codeword: the word's a, b, c, d, Pb and Pr fields
+ */
+Codeword Codeword_unpack(uint32_t word)
+{
+    Codeword cw;
+    cw.a = (word >> CODEWORD_A_SHIFT) & CODEWORD_A_MASK;
+    cw.b = codeword_signed_field(word, CODEWORD_B_SHIFT);
+    cw.c = codeword_signed_field(word, CODEWORD_C_SHIFT);
+    cw.d = codeword_signed_field(word, CODEWORD_D_SHIFT);
+    cw.pb = (word >> CODEWORD_PB_SHIFT) & CODEWORD_PBPR_MASK;
+    cw.pr = (word >> CODEWORD_PR_SHIFT) & CODEWORD_PBPR_MASK;
+    return cw;
+}
+
+
+/* Codeword_pack
+ * Purpose:     Packs quantized fields into a codeword
+ * Parameters:  Codeword cw: the fields to pack
+ * Returns:     uint32_t: the codeword
+ * Note:        It is a CRE for any field to be outside its limits
+ */
+uint32_t Codeword_pack(Codeword cw)
+{
+    assert(cw.a >= 0 && cw.a <= CODEWORD_A_MAX);
+    assert(abs(cw.b) <= CODEWORD_BCD_MAX && abs(cw.c) <= CODEWORD_BCD_MAX &&
+           abs(cw.d) <= CODEWORD_BCD_MAX);
+    assert(cw.pb >= 0 && cw.pb <= CODEWORD_PBPR_MAX && 
+           cw.pr >= 0 && cw.pr <= CODEWORD_PBPR_MAX);
+
+    return ((uint32_t) cw.a << CODEWORD_A_SHIFT) |
+           (((uint32_t) cw.b & CODEWORD_BCD_MASK) << CODEWORD_B_SHIFT) |
+           (((uint32_t) cw.c & CODEWORD_BCD_MASK) << CODEWORD_C_SHIFT) |
+           (((uint32_t) cw.d & CODEWORD_BCD_MASK) << CODEWORD_D_SHIFT) |
+           ((uint32_t) cw.pb << CODEWORD_PB_SHIFT) |
+           ((uint32_t) cw.pr << CODEWORD_PR_SHIFT);
+}
+
+
+/* Codeword_luma
+ * Purpose:     returns the luma a quantized a field stands for
+ */
+float Codeword_luma(int a)
+{
+    return a / 511.0;
+}
+
+
+/* Codeword_quantize_luma
+ * Purpose:     quantizes a luma value the way abcd_to_word.c quantizes a,
+ *                  clamping it into the field's range
+ */
+int Codeword_quantize_luma(float y)
+{
+    int a = (int) floor(y * 511);
+    return a < 0 ? 0 : a > CODEWORD_A_MAX ? CODEWORD_A_MAX : a;
+}
+
+
+/* Codeword_chroma
+ * Purpose:     returns the chroma value a chroma index stands for
+ */
+float Codeword_chroma(int index)
+{
+    return Arith40_chroma_of_index(index);
+}
+
+
+/* codeword_signed_field
+ * Purpose:     returns the sign-extended b, c or d field at shift in word
+ */
+int codeword_signed_field(uint32_t word, unsigned shift)
+{
+    int field = (word >> shift) & CODEWORD_BCD_MASK;
+    return (field ^ CODEWORD_BCD_SIGN) - CODEWORD_BCD_SIGN;
+}
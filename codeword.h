@@ -0,0 +1,94 @@
+/* codeword.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the interface for reading and writing the quantized fields of a
+ *  single 32-bit codeword directly, for operations that work on compressed
+ *  images without decoding them to pixels. The layout is the one 
+ *  abcd_to_word.c packs:
+ *
+ *  | a (9 bits) | b (5) | c (5) | d (5) | Pb (4) | Pr (4) |
+ */
+
+#ifndef CODEWORD_H
+#define CODEWORD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/* field positions and widths, as abcd_to_word.c packs them; b, c and d
+   are two's complement in their CODEWORD_BCD_MASK bits */
+#define CODEWORD_A_SHIFT  23
+#define CODEWORD_B_SHIFT  18
+#define CODEWORD_C_SHIFT  13
+#define CODEWORD_D_SHIFT  8
+#define CODEWORD_PB_SHIFT 4
+#define CODEWORD_PR_SHIFT 0
+
+#define CODEWORD_A_MASK    0x1ff
+#define CODEWORD_BCD_MASK  0x1f
+#define CODEWORD_PBPR_MASK 0xf
+
+/* the sign bit of b, c and d within CODEWORD_BCD_MASK */
+#define CODEWORD_BCD_SIGN  0x10
+
+/* limits of the quantized fields */
+#define CODEWORD_A_MAX   511    /* a is mean luma * 511, from 0 */
+#define CODEWORD_BCD_MAX 15     /* b, c, d are luma gradients * 50, +/- */
+#define CODEWORD_PBPR_MAX 15    /* Pb and Pr are Arith40 chroma indices */
+
+
+/* Codeword
+ * Members:     a:      the block's mean luma, 0 to CODEWORD_A_MAX
+ *              b, c, d: the block's vertical, horizontal and diagonal 
+ *                      luma gradients, -CODEWORD_BCD_MAX to 
+ *                      CODEWORD_BCD_MAX
+ *              pb, pr: the chroma indices of the block's mean Pb and Pr
+ */
+typedef struct Codeword {
+    int a;
+    int b, c, d;
+    int pb, pr;
+} Codeword;
+
+
+/* returns the fields of the provided codeword */
+Codeword Codeword_unpack(uint32_t word);
+
+/* returns the codeword holding the provided fields 
+    Note: it is a CRE for any field to be outside its limits */
+uint32_t Codeword_pack(Codeword cw);
+
+/* returns the luma (Y) a quantized a stands for */
+float Codeword_luma(int a);
+
+/* returns the quantized a nearest below the provided luma, clamped to 
+    0..CODEWORD_A_MAX */
+int Codeword_quantize_luma(float y);
+
+/* returns the chroma (Pb or Pr) a chroma index stands for */
+float Codeword_chroma(int index);
+
+
+/* returns the codeword stored at p, little-endian if little is true (as in
+    format 3) or big-endian otherwise (as in format 2) */
+static inline uint32_t Codeword_load(const uint8_t *p, bool little)
+{
+    if (little) {
+        return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | 
+               ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+    }
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | 
+           ((uint32_t) p[2] << 8) | p[3];
+}
+
+/* stores word at p in the byte order Codeword_load reads with little */
+static inline void Codeword_store(uint8_t *p, uint32_t word, bool little)
+{
+    for (int i = 0; i < 4; i++) {
+        p[i] = word >> (little ? 8 * i : 24 - 8 * i);
+    }
+}
+
+#endif
@@ -0,0 +1,148 @@
+/* comp_adjust.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the implementation of compressed-domain tonal adjustments. In 
+ *  Y/Pb/Pr each adjustment is linear:
+ *
+ *      Y'  = contrast * (Y - 1/2) + 1/2 + brightness
+ *      Pb' = saturation * Pb,  Pr' = saturation * Pr
+ *
+ *  so a block's a follows the Y formula, its gradients b, c and d are only 
+ *  scaled by contrast, and its chroma is scaled by saturation. Every field
+ *  has at most 512 possible values, so each adjustment is precomputed into
+ *  one table per field (along with whether each entry saturates), and the
+ *  pass over the words is nothing but table lookups.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <arith40.h>
+#include "assert.h"
+#include "codeword.h"
+#include "comp_adjust.h"
+
+
+/* struct Adjust_tables
+ * Members:     a:      the new a for each old a
+ *              bcd:    the new gradient for each old one, indexed by the 
+ *                          field's 5 raw bits
+ *              chroma: the new chroma index for each old one
+ *              *_sat:  1 where the new value had to be clamped, else 0
+ */
+struct Adjust_tables {
+    uint16_t a[CODEWORD_A_MAX + 1];
+    uint8_t a_sat[CODEWORD_A_MAX + 1];
+    int8_t bcd[32];
+    uint8_t bcd_sat[32];
+    uint8_t chroma[CODEWORD_PBPR_MAX + 1];
+    uint8_t chroma_sat[CODEWORD_PBPR_MAX + 1];
+};
+
+
+/* helper function declarations */
+void adjust_build_tables(struct Adjust_tables *t, Compress40_adjustment adj);
+long adjust_clamp(double n, long low, long hi, uint8_t *saturated);
+
+
+/* Comp_adjust_words
+ * Purpose:     Applies a brightness/contrast/saturation adjustment to 
+ *                  stored codewords in place
+ * Parameters:  uint8_t *words: the first byte of the first word
+ *              size_t nwords: the number of words
+ *              bool little: true if the words are little-endian (format 3),
+ *                  false if big-endian (format 2)
+ *              Compress40_adjustment adj: the adjustment
+ * Returns:     size_t: the number of coefficients clamped to the limits
+ *                  of their fields
+ * Note:        It is a CRE for words to be NULL while nwords > 0, or for any
+ *                  field of adj not to be finite
+ */
+size_t Comp_adjust_words(uint8_t *words, size_t nwords, bool little,
+                         Compress40_adjustment adj)
+{
+    assert(words != NULL || nwords == 0);
+    assert(isfinite(adj.brightness) && isfinite(adj.contrast) && 
+           isfinite(adj.saturation));
+
+    struct Adjust_tables t;
+    adjust_build_tables(&t, adj);
+    size_t saturated = 0;
+
+    for (size_t i = 0; i < nwords; i++, words += 4) {
+        uint32_t word = Codeword_load(words, little);
+
+        unsigned a = (word >> CODEWORD_A_SHIFT) & CODEWORD_A_MASK;
+        unsigned b = (word >> CODEWORD_B_SHIFT) & CODEWORD_BCD_MASK;
+        unsigned c = (word >> CODEWORD_C_SHIFT) & CODEWORD_BCD_MASK;
+        unsigned d = (word >> CODEWORD_D_SHIFT) & CODEWORD_BCD_MASK;
+        unsigned pb = (word >> CODEWORD_PB_SHIFT) & CODEWORD_PBPR_MASK;
+        unsigned pr = (word >> CODEWORD_PR_SHIFT) & CODEWORD_PBPR_MASK;
+
+        saturated += t.a_sat[a] + t.bcd_sat[b] + t.bcd_sat[c] + 
+                     t.bcd_sat[d] + t.chroma_sat[pb] + t.chroma_sat[pr];
+
+        word = ((uint32_t) t.a[a] << CODEWORD_A_SHIFT) | 
+               (((uint32_t) t.bcd[b] & CODEWORD_BCD_MASK) << 
+                CODEWORD_B_SHIFT) |
+               (((uint32_t) t.bcd[c] & CODEWORD_BCD_MASK) << 
+                CODEWORD_C_SHIFT) |
+               (((uint32_t) t.bcd[d] & CODEWORD_BCD_MASK) << 
+                CODEWORD_D_SHIFT) |
+               ((uint32_t) t.chroma[pb] << CODEWORD_PB_SHIFT) | 
+               ((uint32_t) t.chroma[pr] << CODEWORD_PR_SHIFT);
+
+        Codeword_store(words, word, little);
+    }
+
+    return saturated;
+}
+
+
+/* adjust_build_tables
+ * Purpose:     Precomputes the new value of every possible field value 
+ *                  under the adjustment
+ * Parameters:  struct Adjust_tables *t: the tables to fill
+ *              Compress40_adjustment adj: the adjustment
+ * Note:        Values are rounded to the nearest step, so the identity 
+ *                  adjustment (0, 1, 1) leaves every word unchanged
+ */
+void adjust_build_tables(struct Adjust_tables *t, Compress40_adjustment adj)
+{
+    /* a is mean luma * 511, so luma 1/2 is 255.5 */
+    for (int a = 0; a <= CODEWORD_A_MAX; a++) {
+        double y = adj.contrast * (a - 255.5) + 255.5 + 
+                   adj.brightness * CODEWORD_A_MAX;
+        t->a[a] = adjust_clamp(y, 0, CODEWORD_A_MAX, &t->a_sat[a]);
+    }
+
+    for (int bits = 0; bits < 32; bits++) {
+        int old = bits >= 16 ? bits - 32 : bits;
+        t->bcd[bits] = adjust_clamp((double) adj.contrast * old, 
+                                    -CODEWORD_BCD_MAX, CODEWORD_BCD_MAX,
+                                    &t->bcd_sat[bits]);
+    }
+
+    float low = Codeword_chroma(0), hi = Codeword_chroma(CODEWORD_PBPR_MAX);
+    for (int i = 0; i <= CODEWORD_PBPR_MAX; i++) {
+        float chroma = adj.saturation * Codeword_chroma(i);
+        t->chroma[i] = Arith40_index_of_chroma(chroma);
+        t->chroma_sat[i] = chroma < low || chroma > hi;
+    }
+}
+
+
+/* adjust_clamp
+ * Purpose:     returns n rounded to nearest and clamped to [low, hi], 
+ *                  setting *saturated to 1 if it had to be clamped and 0 
+ *                  otherwise
+ * Note:        n is clamped before it is rounded, so no value is too large
+ *                  for lround
+ */
+long adjust_clamp(double n, long low, long hi, uint8_t *saturated)
+{
+    long rounded = n < low - 1 ? low - 1 : n > hi + 1 ? hi + 1 : lround(n);
+    *saturated = rounded < low || rounded > hi;
+    return rounded < low ? low : rounded > hi ? hi : rounded;
+}
@@ -0,0 +1,26 @@
+/* comp_adjust.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the interface for tonal adjustments (brightness, contrast and
+ *  saturation) applied directly to the codewords of a compressed image
+ */
+
+#ifndef COMP_ADJUST_H
+#define COMP_ADJUST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "compress40.h"
+
+
+/* applies adj in place to the nwords codewords at words, exactly as they 
+    are stored in a compressed image file (little-endian if little is true,
+    as in format 3, or big-endian as in format 2), and returns how many 
+    coefficients (of the 6 in each word) had to be clamped to the 
+    quantizer's limits
+    Note: it is a CRE for words to be NULL while nwords > 0 */
+size_t Comp_adjust_words(uint8_t *words, size_t nwords, bool little,
+                         Compress40_adjustment adj);
+
+#endif
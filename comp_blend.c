@@ -0,0 +1,173 @@
+/* comp_blend.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the implementation of compressed-domain blending. a, b, c and d
+ *  are linear in the block's pixels, and Pb and Pr are plain averages, so 
+ *  blending two images pixel by pixel blends each field of their words the
+ *  same way. a, b, c and d are blended in fixed point with alpha in 256ths
+ *  and rounded to the nearest step; the chroma indices have only 16 values
+ *  each, so the blend of every pair of them is precomputed into a table.
+ *  Alpha 0 and 1 reproduce the base and overlay words exactly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <arith40.h>
+#include "assert.h"
+#include "mem.h"
+#include "codeword.h"
+#include "thread_pool.h"
+#include "comp_blend.h"
+
+
+/* rectangles with fewer words than this are blended on the calling thread*/
+#define BLEND_MIN_PARALLEL (1 << 18)
+
+/* alpha's fixed-point scale */
+#define BLEND_SHIFT 8
+#define BLEND_ONE (1 << BLEND_SHIFT)
+
+
+/* struct Blend_job
+ * Members:     base, overlay:  the first word of the job's first row
+ *              base_stride, overlay_stride: row pitches in words
+ *              base_little, overlay_little: whether each image's words are
+ *                              little-endian
+ *              rows, cols:     the size of the job's rectangle
+ *              weight:         alpha in 256ths
+ *              chroma:         the blended index for each pair of indices
+ */
+struct Blend_job {
+    uint8_t *base;
+    const uint8_t *overlay;
+    size_t base_stride, overlay_stride;
+    bool base_little, overlay_little;
+    size_t rows, cols;
+    int weight;
+    uint8_t (*chroma)[CODEWORD_PBPR_MAX + 1];
+};
+
+
+/* helper function declarations */
+void blend_rows(void *jobp);
+int blend_mix(int x, int y, int weight);
+
+
+/* Comp_blend_words
+ * Purpose:     Blends a rectangle of one image's words into another's
+ * Parameters:  uint8_t *base, size_t base_stride: the words blended into
+ *              bool base_little: true if base's words are little-endian 
+ *                  (format 3), false if big-endian (format 2)
+ *              const uint8_t *overlay, size_t overlay_stride: the words 
+ *                  blended in
+ *              bool overlay_little: overlay's byte order, as base_little
+ *              size_t rows, cols: the size of the rectangle in blocks
+ *              float alpha: the overlay's weight
+ *              int nthreads: the number of threads, or < 1 for one per CPU
+ * Note:        It is a CRE for base or overlay to be NULL or alpha to be 
+ *                  outside [0, 1]
+ */
+void Comp_blend_words(uint8_t *base, size_t base_stride, bool base_little,
+                      const uint8_t *overlay, size_t overlay_stride,
+                      bool overlay_little, size_t rows, size_t cols, 
+                      float alpha, int nthreads)
+{
+    assert(base != NULL && overlay != NULL);
+    assert(alpha >= 0 && alpha <= 1);
+
+    uint8_t chroma[CODEWORD_PBPR_MAX + 1][CODEWORD_PBPR_MAX + 1];
+    for (int x = 0; x <= CODEWORD_PBPR_MAX; x++) {
+        for (int y = 0; y <= CODEWORD_PBPR_MAX; y++) {
+            float mixed = (1 - alpha) * Codeword_chroma(x) + 
+                          alpha * Codeword_chroma(y);
+            chroma[x][y] = alpha == 0 ? x : alpha == 1 ? y : 
+                           (int) Arith40_index_of_chroma(mixed);
+        }
+    }
+
+    struct Blend_job whole = { base, overlay, base_stride, overlay_stride,
+                               base_little, overlay_little, rows, cols, 
+                               lroundf(alpha * BLEND_ONE), chroma };
+
+    if (nthreads == 1 || rows * cols < BLEND_MIN_PARALLEL) {
+        blend_rows(&whole);
+        return;
+    }
+
+    Thread_pool pool = Thread_pool_new(nthreads, NULL);
+    int njobs = Thread_pool_size(pool);
+    struct Blend_job *jobs = CALLOC(njobs, sizeof(*jobs));
+
+    size_t per_job = (rows + njobs - 1) / njobs;
+    for (int i = 0; i < njobs; i++) {
+        size_t first = per_job * i < rows ? per_job * i : rows;
+        jobs[i] = whole;
+        jobs[i].base += first * base_stride * 4;
+        jobs[i].overlay += first * overlay_stride * 4;
+        jobs[i].rows = rows - first < per_job ? rows - first : per_job;
+        Thread_pool_submit(pool, i, blend_rows, &jobs[i]);
+    }
+    Thread_pool_free(&pool);
+    FREE(jobs);
+}
+
+
+/* blend_rows
+ * Purpose:     Thread_pool job (also run directly) that blends the rows of
+ *                  one struct Blend_job
+ * Parameters:  void *jobp: the struct Blend_job to run
+ * Note:        The raw gradients are sign extended by flipping and then 
+ *                  subtracting CODEWORD_BCD_SIGN
+ */
+void blend_rows(void *jobp)
+{
+    struct Blend_job *job = jobp;
+
+    for (size_t row = 0; row < job->rows; row++) {
+        uint8_t *w = job->base + row * job->base_stride * 4;
+        const uint8_t *o = job->overlay + row * job->overlay_stride * 4;
+
+        for (size_t col = 0; col < job->cols; col++, w += 4, o += 4) {
+            uint32_t x = Codeword_load(w, job->base_little);
+            uint32_t y = Codeword_load(o, job->overlay_little);
+
+            uint32_t word = (uint32_t) blend_mix(x >> CODEWORD_A_SHIFT, 
+                                                 y >> CODEWORD_A_SHIFT, 
+                                                 job->weight) 
+                            << CODEWORD_A_SHIFT;
+            for (int shift = CODEWORD_B_SHIFT; shift >= CODEWORD_D_SHIFT; 
+                 shift -= CODEWORD_B_SHIFT - CODEWORD_C_SHIFT) {
+                int bx = (int) (((x >> shift) & CODEWORD_BCD_MASK) ^ 
+                                CODEWORD_BCD_SIGN) - CODEWORD_BCD_SIGN;
+                int by = (int) (((y >> shift) & CODEWORD_BCD_MASK) ^ 
+                                CODEWORD_BCD_SIGN) - CODEWORD_BCD_SIGN;
+                word |= (uint32_t) (blend_mix(bx, by, job->weight) & 
+                                    CODEWORD_BCD_MASK) << shift;
+            }
+            unsigned pb_x = (x >> CODEWORD_PB_SHIFT) & CODEWORD_PBPR_MASK;
+            unsigned pb_y = (y >> CODEWORD_PB_SHIFT) & CODEWORD_PBPR_MASK;
+            unsigned pr_x = (x >> CODEWORD_PR_SHIFT) & CODEWORD_PBPR_MASK;
+            unsigned pr_y = (y >> CODEWORD_PR_SHIFT) & CODEWORD_PBPR_MASK;
+            word |= (uint32_t) job->chroma[pb_x][pb_y] << CODEWORD_PB_SHIFT;
+            word |= (uint32_t) job->chroma[pr_x][pr_y] << CODEWORD_PR_SHIFT;
+
+            Codeword_store(w, word, job->base_little);
+        }
+    }
+}
+
+
+/* blend_mix
+ * Purpose:     returns (BLEND_ONE - weight) * x + weight * y, in units of
+ *                  BLEND_ONE and rounded to nearest (halves rounded up)
+ * Note:        The result always lies between x and y, so it needs no 
+ *                  clamping. Negative sums rely on >> being an arithmetic
+ *                  shift, as it is with gcc
+ */
+int blend_mix(int x, int y, int weight)
+{
+    return ((BLEND_ONE - weight) * x + weight * y + BLEND_ONE / 2) 
+           >> BLEND_SHIFT;
+}
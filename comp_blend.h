@@ -0,0 +1,31 @@
+/* comp_blend.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the interface for constant-alpha blending of one compressed 
+ *  image's codewords into another's
+ */
+
+#ifndef COMP_BLEND_H
+#define COMP_BLEND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/* blends a rows x cols rectangle of words at overlay into the one at base,
+    in place: every field of a base word becomes 
+    (1 - alpha) * base + alpha * overlay, requantized. Consecutive rows are
+    base_stride and overlay_stride words apart, and each image's words are 
+    little-endian (format 3) if its _little flag is true or big-endian 
+    (format 2) otherwise. Large rectangles are split across nthreads 
+    threads (one per CPU if < 1)
+    Note: it is a CRE for base or overlay to be NULL, or for alpha to be 
+          outside [0, 1] */
+void Comp_blend_words(uint8_t *base, size_t base_stride, bool base_little,
+                      const uint8_t *overlay, size_t overlay_stride,
+                      bool overlay_little, size_t rows, size_t cols, 
+                      float alpha, int nthreads);
+
+#endif
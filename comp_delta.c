@@ -0,0 +1,245 @@
+/* comp_delta.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/4/2021
+ *
+ * Contains the implementation of delta frames. A delta frame is
+ *
+ *      "COMP40 Delta frame format 1\n<width> <height>\n"
+ *      uint32_t changed            the number of changed words
+ *      uint8_t skip[(nwords + 7) / 8]  bit i % 8 of byte i / 8 is set if
+ *                                      word i differs from the reference's
+ *      uint32_t words[changed]     the changed words, in block order
+ *
+ *  with all integers big-endian, as the words are in format 2. Still
+ *  scenes leave most of the bitmap zero, so both the encoder and the
+ *  decoder work GROUP_WORDS words at a time: the encoder ORs the XOR of a
+ *  whole group with a branch-free loop the compiler vectorizes before it
+ *  looks at single words, and the decoder passes over a group whose 8
+ *  bitmap bytes are all zero with one test.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assert.h"
+#include "comp_delta.h"
+
+
+#define DELTA_MAGIC "COMP40 Delta frame format 1\n"
+
+/* enough room for DELTA_MAGIC and two 10-digit dimensions */
+#define DELTA_HEADER_MAX 64
+
+/* words per group: one 8-byte stretch of the skip bitmap */
+#define GROUP_WORDS 64
+
+
+/* helper function declarations */
+bool delta_parse(const uint8_t *buf, size_t len, unsigned *width,
+                 unsigned *height, size_t *changed, const uint8_t **skip,
+                 const uint8_t **data);
+static inline uint32_t load_be32(const uint8_t *p);
+static inline void store_be32(uint8_t *p, uint32_t v);
+
+
+/* Comp_delta_parse_header
+ * Purpose:     Reads the size of a delta frame
+ * Parameters:  const uint8_t *buf, size_t len: the delta frame
+ *              unsigned *width, *height: set to its size in pixels
+ * Returns:     bool: false unless buf holds a complete delta frame
+ * Note:        It is a CRE for width or height to be NULL
+ */
+bool Comp_delta_parse_header(const uint8_t *buf, size_t len, unsigned *width,
+                             unsigned *height)
+{
+    assert(width != NULL && height != NULL);
+
+    size_t changed;
+    const uint8_t *skip, *data;
+    return delta_parse(buf, len, width, height, &changed, &skip, &data);
+}
+
+
+/* Comp_delta_bound
+ * Purpose:     returns the most bytes a width x height delta frame can take
+ */
+size_t Comp_delta_bound(unsigned width, unsigned height)
+{
+    size_t nwords = (size_t) (width / 2) * (height / 2);
+    return DELTA_HEADER_MAX + 4 + (nwords + 7) / 8 + nwords * 4;
+}
+
+
+/* Comp_delta_encode
+ * Purpose:     Codes an image as the words that differ from a reference's
+ * Parameters:  const uint32_t *ref: the reference image's words
+ *              const uint32_t *words: the image's words
+ *              unsigned width, height: the size of both images in pixels
+ *              uint8_t *out: where to write the delta frame; must hold
+ *                  Comp_delta_bound bytes
+ *              size_t *changed: set to the number of changed words
+ * Returns:     size_t: the number of bytes written
+ * Note:        It is a CRE for ref, words, out or changed to be NULL
+ */
+size_t Comp_delta_encode(const uint32_t *ref, const uint32_t *words,
+                         unsigned width, unsigned height, uint8_t *out,
+                         size_t *changed)
+{
+    assert(ref != NULL && words != NULL && out != NULL && changed != NULL);
+
+    size_t nwords = (size_t) (width / 2) * (height / 2);
+    uint8_t *count = out + snprintf((char *) out, DELTA_HEADER_MAX,
+                                    DELTA_MAGIC "%u %u\n", width, height);
+    uint8_t *skip = count + 4;
+    uint8_t *p = skip + (nwords + 7) / 8;
+    memset(skip, 0, (nwords + 7) / 8);
+
+    for (size_t group = 0; group < nwords; group += GROUP_WORDS) {
+        size_t end = nwords - group < GROUP_WORDS ? nwords
+                                                  : group + GROUP_WORDS;
+        uint32_t diff = 0;
+        for (size_t i = group; i < end; i++) {
+            diff |= ref[i] ^ words[i];
+        }
+        if (diff == 0) {
+            continue;
+        }
+
+        for (size_t i = group; i < end; i++) {
+            if (ref[i] != words[i]) {
+                skip[i / 8] |= 1u << (i % 8);
+                store_be32(p, words[i]);
+                p += 4;
+            }
+        }
+    }
+
+    *changed = (p - skip - (nwords + 7) / 8) / 4;
+    store_be32(count, *changed);
+    return p - out;
+}
+
+
+/* Comp_delta_apply
+ * Purpose:     Turns a delta frame's reference into the frame, in place
+ * Parameters:  const uint8_t *buf, size_t len: the delta frame
+ *              uint8_t *words: the reference image's big-endian words,
+ *                  rewritten
+ *              unsigned width, height: the reference's size in pixels
+ * Returns:     bool: false (and words untouched) unless buf is a complete
+ *                  delta frame of the reference's size
+ * Note:        It is a CRE for words to be NULL
+ */
+bool Comp_delta_apply(const uint8_t *buf, size_t len, uint8_t *words,
+                      unsigned width, unsigned height)
+{
+    assert(words != NULL);
+
+    unsigned delta_width, delta_height;
+    size_t changed;
+    const uint8_t *skip, *p;
+    if (!delta_parse(buf, len, &delta_width, &delta_height, &changed, &skip,
+                     &p) ||
+        delta_width != width || delta_height != height) {
+        return false;
+    }
+
+    size_t nbytes = ((size_t) (width / 2) * (height / 2) + 7) / 8;
+    for (size_t byte = 0; byte < nbytes; byte++) {
+        uint64_t group;
+        if (byte % 8 == 0 && nbytes - byte >= 8) {
+            memcpy(&group, skip + byte, sizeof(group));
+            if (group == 0) {
+                byte += 7;
+                continue;
+            }
+        }
+
+        for (unsigned bits = skip[byte]; bits != 0; bits &= bits - 1) {
+            memcpy(words + (byte * 8 + __builtin_ctz(bits)) * 4, p, 4);
+            p += 4;
+        }
+    }
+
+    return true;
+}
+
+
+/* delta_parse
+ * Purpose:     Parses and checks a delta frame
+ * Parameters:  const uint8_t *buf, size_t len: the delta frame
+ *              unsigned *width, *height: set to its size in pixels
+ *              size_t *changed: set to the number of changed words
+ *              const uint8_t **skip: set to the skip bitmap
+ *              const uint8_t **data: set to the first changed word
+ * Returns:     bool: false unless the header is well formed, buf holds the
+ *                  whole bitmap and all the changed words, and the bitmap
+ *                  marks exactly changed words, none past the last block
+ */
+bool delta_parse(const uint8_t *buf, size_t len, unsigned *width,
+                 unsigned *height, size_t *changed, const uint8_t **skip,
+                 const uint8_t **data)
+{
+    size_t magic_len = strlen(DELTA_MAGIC);
+    if (buf == NULL || len < magic_len ||
+        memcmp(buf, DELTA_MAGIC, magic_len) != 0) {
+        return false;
+    }
+
+    /* parse "<width> <height>\n" from a bounded copy of the header line */
+    char line[DELTA_HEADER_MAX];
+    size_t line_len = len - magic_len < sizeof(line) - 1 ?
+                      len - magic_len : sizeof(line) - 1;
+    memcpy(line, buf + magic_len, line_len);
+    line[line_len] = '\0';
+
+    int consumed = 0;
+    if (sscanf(line, "%u %u%n", width, height, &consumed) != 2 ||
+        (size_t) consumed >= line_len || line[consumed] != '\n' ||
+        *width < 2 || *height < 2 || *width % 2 != 0 || *height % 2 != 0) {
+        return false;
+    }
+
+    const uint8_t *p = buf + magic_len + consumed + 1;
+    size_t left = len - (p - buf);
+    size_t nwords = (size_t) (*width / 2) * (*height / 2);
+    size_t nbytes = (nwords + 7) / 8;
+    if (left < 4 || left - 4 < nbytes) {
+        return false;
+    }
+    *changed = load_be32(p);
+    *skip = p + 4;
+    *data = *skip + nbytes;
+    if (*changed > nwords || (left - 4 - nbytes) / 4 < *changed) {
+        return false;
+    }
+
+    size_t marked = 0;
+    for (size_t byte = 0; byte < nbytes; byte++) {
+        marked += __builtin_popcount((*skip)[byte]);
+    }
+    return marked == *changed &&
+           (nwords % 8 == 0 || ((*skip)[nbytes - 1] >> (nwords % 8)) == 0);
+}
+
+
+/* load_be32
+ * Purpose:     returns the big-endian 32-bit integer at p
+ */
+static inline uint32_t load_be32(const uint8_t *p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) |
+           ((uint32_t) p[2] << 8) | p[3];
+}
+
+
+/* store_be32
+ * Purpose:     writes v at p as a big-endian 32-bit integer
+ */
+static inline void store_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
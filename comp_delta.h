@@ -0,0 +1,48 @@
+/* comp_delta.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/4/2021
+ *
+ * Contains the interface for delta frames: a compressed image coded as
+ *  just the words that differ from the co-located words of a reference
+ *  image of the same size
+ */
+
+#ifndef COMP_DELTA_H
+#define COMP_DELTA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+/* parses the header of the delta frame in buf[0..len) into *width and
+    *height. Returns false unless buf holds a well-formed header and all of
+    the frame's skip bitmap and words
+    Note: it is a CRE for width or height to be NULL */
+bool Comp_delta_parse_header(const uint8_t *buf, size_t len, unsigned *width,
+                             unsigned *height);
+
+/* returns the most bytes Comp_delta_encode can write for a width x height
+    image (every word changed) */
+size_t Comp_delta_bound(unsigned width, unsigned height);
+
+/* codes the width x height image whose words (one per block, in the host's
+    byte order) are words as a delta frame against the image whose words
+    are ref, into out, which must hold Comp_delta_bound bytes. Returns the
+    number of bytes written and sets *changed to the number of words that
+    differ
+    Note: it is a CRE for ref, words, out or changed to be NULL */
+size_t Comp_delta_encode(const uint32_t *ref, const uint32_t *words,
+                         unsigned width, unsigned height, uint8_t *out,
+                         size_t *changed);
+
+/* rewrites the big-endian words (as in format 2) of a width x height
+    image in place with the changed words of the delta frame in
+    buf[0..len), turning the frame's reference into the frame. Returns
+    false, leaving words alone, unless buf is a well-formed delta frame of
+    the same size
+    Note: it is a CRE for words to be NULL */
+bool Comp_delta_apply(const uint8_t *buf, size_t len, uint8_t *words,
+                      unsigned width, unsigned height);
+
+#endif
@@ -0,0 +1,930 @@
+/* comp_entropy.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the implementation of the entropy-coded image format. Each word
+ *  is split into six symbols, one per field:
+ *
+ *      A   a's residual from a median edge detector (LOCO-I) prediction of
+ *              its left, upper and upper left neighbours, zigzagged;
+ *              residuals past ESCAPE - 1 send ESCAPE and then 10 raw bits
+ *      B, C, D   the raw 5-bit gradient fields
+ *      PB, PR    the chroma indices, each coded with one of 16 models
+ *                    chosen by the previous block's index, since chroma
+ *                    changes slowly
+ *
+ *  and each symbol is coded with rANS against a static frequency table 
+ *  (12-bit precision) per model, built from the whole image. RANS_STATES
+ *  rANS states take turns field by field (see FIELD_STATE) and share one
+ *  stream of 16-bit words, so each symbol refills its state at most once
+ *  and the states' decode chains overlap. The image is cut into stripes 
+ *  of STRIPE_ROWS block rows;
+ *  prediction never looks across a stripe's top edge, so every stripe can
+ *  be decoded on its own, and the stripes are encoded and decoded in
+ *  parallel. The file is
+ *
+ *      "COMP40 Entropy-coded image format 2\n<width> <height>\n"
+ *      uint32_t stripe_rows, nstripes
+ *      freqs[ENTROPY_SYMBOLS]      every model's table in turn (all zero
+ *                                      for unused models), each frequency
+ *                                      in one byte if below 0x80, else in
+ *                                      two with the top bit set
+ *      uint32_t ends[nstripes]     end of each stripe in the data
+ *      the stripes' rANS streams   each the states' final values, 
+ *                                      then the 16-bit words the states
+ *                                      shifted out
+ *
+ *  with all integers big-endian, as the words are in format 2. Like format 
+ *  2, the file may end in a trailer right after its last stripe: "C32C", 
+ *  then the CRC-32C of everything before the trailer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assert.h"
+#include "mem.h"
+#include "thread_pool.h"
+#include "crc32c.h"
+#include "codeword.h"
+#include "comp_entropy.h"
+
+
+#define ENTROPY_MAGIC "COMP40 Entropy-coded image format 2\n"
+
+/* enough room for ENTROPY_MAGIC and two 10-digit dimensions */
+#define ENTROPY_HEADER_MAX 64
+
+/* block rows per independently decodable stripe */
+#define STRIPE_ROWS 16
+
+/* rANS parameters: frequencies sum to SCALE, and each state is kept in
+   [RANS_LOW, RANS_LOW << 16), moving 16 bits at a time to or from the 
+   stream */
+#define SCALE_BITS 12
+#define SCALE (1u << SCALE_BITS)
+#define RANS_LOW (1u << 16)
+
+/* the interleaved rANS states, the one each field is coded with, and the
+   one a's escape bits, which come between a and b, are coded with */
+#define RANS_STATES 4
+#define FIELD_STATE(f) ((f) % RANS_STATES)
+#define ESCAPE_STATE 2
+
+/* the A symbol that announces a raw residual of ESCAPE_BITS bits */
+#define ESCAPE 63
+#define ESCAPE_BITS 10
+
+/* the optional checksum trailer */
+#define ENTROPY_TRAILER_TAG "C32C"
+#define ENTROPY_TRAILER_SIZE 8
+
+/* images with fewer words than this are coded on the calling thread */
+#define ENTROPY_MIN_PARALLEL (1 << 18)
+
+/* the most bytes one word's symbols can code to, 6 * 12 + 10 bits */
+#define WORD_BOUND 11
+
+/* the bytes a stripe's stream adds on top of its words: the states and 
+   one partly filled 16-bit word */
+#define STRIPE_SLACK (4 * RANS_STATES + 2)
+
+/* the most stream bytes one word can take: a 16-bit refill per symbol */
+#define WORD_READ_MAX 14
+
+/* the fields of a word, in the order they are decoded */
+enum { FIELD_A, FIELD_B, FIELD_C, FIELD_D, FIELD_PB, FIELD_PR, NFIELDS };
+
+/* the models: one each for A, B, C and D, then 16 for PB and 16 for PR */
+enum { MODEL_A, MODEL_B, MODEL_C, MODEL_D, MODEL_PB,
+       MODEL_PR = MODEL_PB + 16, NMODELS = MODEL_PR + 16 };
+#define MODEL_MAX 64
+#define ENTROPY_SYMBOLS (MODEL_MAX + 3 * 32 + 2 * 16 * 16)
+
+/* returns the number of symbols model m codes */
+#define MODEL_SIZE(m) ((m) == MODEL_A ? MODEL_MAX : (m) < MODEL_PB ? 32 : 16)
+
+
+/* struct Entropy_tables
+ * Members:     freq, start:    each model's symbol frequencies and their
+ *                                  running sums
+ *              slot:           each model's decoding entry for every 
+ *                                  state slot: the symbol, the slot's 
+ *                                  offset into the symbol's range, and 
+ *                                  the symbol's frequency, packed so one
+ *                                  load decodes a symbol; filled only for
+ *                                  decoding
+ *              empty:          true for each model whose frequencies are
+ *                                  all zero, set only for decoding
+ */
+struct Entropy_tables {
+    uint16_t freq[NMODELS][MODEL_MAX];
+    uint16_t start[NMODELS][MODEL_MAX];
+    uint32_t slot[NMODELS][SCALE];
+    bool empty[NMODELS];
+};
+
+/* where the parts of a slot entry go: the symbol in the low SLOT_SYM_BITS
+   bits, the offset in the next SCALE_BITS, and the frequency above */
+#define SLOT_SYM_BITS 6
+#define SLOT_FREQ_SHIFT (SLOT_SYM_BITS + SCALE_BITS)
+
+/* struct Entropy_job
+ * Members:     tables:         the shared frequency tables
+ *              words:          the image's stored words (encoding)
+ *              little:         whether words is little-endian (encoding)
+ *              out:            the image's words (decoding)
+ *              width:          the image's width in blocks
+ *              height:         the image's height in blocks
+ *              first, last:    the stripes [first, last) this job codes
+ *              scratch:        per-stripe output areas (encoding)
+ *              sizes:          each stripe's coded size (encoding)
+ *              data, ends:     the stripes' streams and ends (decoding)
+ *              ok:             false if a stripe failed to decode
+ */
+struct Entropy_job {
+    const struct Entropy_tables *tables;
+    const uint8_t *words;
+    bool little;
+    uint32_t *out;
+    size_t width;
+    unsigned height;
+    unsigned first, last;
+    uint8_t *scratch;
+    size_t *sizes;
+    const uint8_t *data, *ends;
+    bool ok;
+};
+
+
+/* helper function declarations */
+bool entropy_parse(const uint8_t *buf, size_t len, unsigned *width,
+                   unsigned *height, struct Entropy_tables *t,
+                   unsigned *nstripes, const uint8_t **ends,
+                   const uint8_t **data, size_t *data_len);
+bool entropy_check_trailer(const uint8_t *buf, size_t len, size_t end,
+                           size_t *trailer);
+void entropy_symbols(const uint8_t *words, bool little, size_t width, 
+                     unsigned row, size_t col, unsigned model[NFIELDS],
+                     unsigned sym[NFIELDS], unsigned *raw);
+static inline int entropy_predict(int w, int n, int nw, bool has_w, 
+                                  bool has_n);
+void entropy_normalize(const uint64_t *counts, unsigned n, uint16_t *freq);
+void entropy_run(struct Entropy_job *whole, unsigned nstripes, int nthreads,
+                 void run(void *));
+void entropy_encode_stripes(void *jobp);
+void entropy_decode_stripes(void *jobp);
+size_t entropy_encode_stripe(const struct Entropy_tables *t,
+                             const uint8_t *words, bool little, 
+                             size_t width, unsigned rows, uint8_t *end);
+bool entropy_decode_stripe(const struct Entropy_tables *t,
+                           const uint8_t *in, const uint8_t *end,
+                           uint32_t *out, size_t width, unsigned rows);
+static inline uint32_t load_be32(const uint8_t *p);
+static inline void store_be32(uint8_t *p, uint32_t v);
+
+
+/* Comp_entropy_is
+ * Purpose:     returns true if buf starts with the entropy-coded magic
+ */
+bool Comp_entropy_is(const uint8_t *buf, size_t len)
+{
+    size_t magic_len = strlen(ENTROPY_MAGIC);
+    return buf != NULL && len >= magic_len &&
+           memcmp(buf, ENTROPY_MAGIC, magic_len) == 0;
+}
+
+
+/* Comp_entropy_bound
+ * Purpose:     returns the most bytes a width x height image can code to
+ */
+size_t Comp_entropy_bound(unsigned width, unsigned height)
+{
+    size_t nstripes = (height / 2 + STRIPE_ROWS - 1) / STRIPE_ROWS;
+    return ENTROPY_HEADER_MAX + 8 + 2 * ENTROPY_SYMBOLS +
+           nstripes * (4 + STRIPE_SLACK) +
+           (size_t) (width / 2) * (height / 2) * WORD_BOUND;
+}
+
+
+/* Comp_entropy_encode
+ * Purpose:     Entropy codes an image's stored words
+ * Parameters:  const uint8_t *words: the image's first stored word
+ *              bool little: true if the words are little-endian (format 3),
+ *                  false if big-endian (format 2)
+ *              unsigned width, height: the image's size in pixels
+ *              int nthreads: the number of threads, or < 1 for one per CPU
+ *              uint8_t *out: where to write the entropy-coded image
+ * Returns:     size_t: the number of bytes written
+ * Note:        It is a CRE for words or out to be NULL
+ *              Statistics are gathered over the whole image first, so the
+ *                  tables are written once and every stripe shares them
+ */
+size_t Comp_entropy_encode(const uint8_t *words, bool little, 
+                           unsigned width, unsigned height, int nthreads, 
+                           uint8_t *out)
+{
+    assert(words != NULL && out != NULL);
+
+    size_t bw = width / 2;
+    unsigned bh = height / 2;
+    unsigned nstripes = (bh + STRIPE_ROWS - 1) / STRIPE_ROWS;
+
+    /* count every model's symbols */
+    uint64_t (*counts)[MODEL_MAX] = CALLOC(NMODELS, sizeof(*counts));
+    for (unsigned row = 0; row < bh; row++) {
+        for (size_t col = 0; col < bw; col++) {
+            unsigned model[NFIELDS], sym[NFIELDS], raw;
+            entropy_symbols(words + (row - row % STRIPE_ROWS) * bw * 4, 
+                            little, bw, row % STRIPE_ROWS, col, model, sym,
+                            &raw);
+            for (int f = 0; f < NFIELDS; f++) {
+                counts[model[f]][sym[f]]++;
+            }
+        }
+    }
+
+    struct Entropy_tables *t = ALLOC(sizeof(*t));
+    for (int m = 0; m < NMODELS; m++) {
+        entropy_normalize(counts[m], MODEL_SIZE(m), t->freq[m]);
+        for (unsigned s = 0, start = 0; s < MODEL_SIZE(m); s++) {
+            t->start[m][s] = start;
+            start += t->freq[m][s];
+        }
+    }
+    FREE(counts);
+
+    /* code each stripe backwards from the end of its own scratch area */
+    size_t stripe_bound = (size_t) STRIPE_ROWS * bw * WORD_BOUND + 
+                          STRIPE_SLACK;
+    struct Entropy_job whole = { t, words, little, NULL, bw, bh, 0, 
+                                 nstripes,
+                                 ALLOC(nstripes * stripe_bound + 1),
+                                 ALLOC((nstripes + 1) * sizeof(size_t)),
+                                 NULL, NULL, true };
+    entropy_run(&whole, nstripes, bw * bh < ENTROPY_MIN_PARALLEL ? 1
+                                                               : nthreads,
+                entropy_encode_stripes);
+
+    uint8_t *p = out + snprintf((char *) out, ENTROPY_HEADER_MAX,
+                                ENTROPY_MAGIC "%u %u\n", width, height);
+    store_be32(p, STRIPE_ROWS);
+    store_be32(p + 4, nstripes);
+    p += 8;
+    for (int m = 0; m < NMODELS; m++) {
+        for (unsigned s = 0; s < MODEL_SIZE(m); s++) {
+            if (t->freq[m][s] >= 0x80) {
+                *p++ = 0x80 | (t->freq[m][s] >> 8);
+            }
+            *p++ = t->freq[m][s];
+        }
+    }
+
+    uint32_t end = 0;
+    for (unsigned i = 0; i < nstripes; i++, p += 4) {
+        end += whole.sizes[i];
+        store_be32(p, end);
+    }
+    for (unsigned i = 0; i < nstripes; i++) {
+        memcpy(p, whole.scratch + (i + 1) * stripe_bound - whole.sizes[i],
+               whole.sizes[i]);
+        p += whole.sizes[i];
+    }
+
+    FREE(whole.scratch);
+    FREE(whole.sizes);
+    FREE(t);
+    return p - out;
+}
+
+
+/* Comp_entropy_parse_header
+ * Purpose:     Parses the header of an entropy-coded image held in memory
+ * Parameters:  const uint8_t *buf, size_t len: the entropy-coded image
+ *              unsigned *width, *height: set to the image's size in pixels
+ * Returns:     bool: false unless the header is well formed and every 
+ *                  stripe lies in buf
+ * Note:        It is a CRE for width or height to be NULL
+ */
+bool Comp_entropy_parse_header(const uint8_t *buf, size_t len, 
+                               unsigned *width, unsigned *height)
+{
+    assert(width != NULL && height != NULL);
+
+    unsigned nstripes;
+    const uint8_t *ends, *data;
+    size_t data_len;
+    return entropy_parse(buf, len, width, height, NULL, &nstripes, &ends,
+                         &data, &data_len);
+}
+
+
+/* Comp_entropy_seal
+ * Purpose:     Ends an entropy-coded image with its checksum trailer
+ * Parameters:  uint8_t *buf: the image, with room for the trailer after it
+ *              size_t len: the length of the image, as Comp_entropy_encode
+ *                  returned it
+ * Returns:     size_t: the length of the image with its trailer
+ * Note:        It is a CRE for buf to be NULL
+ */
+size_t Comp_entropy_seal(uint8_t *buf, size_t len)
+{
+    assert(buf != NULL);
+
+    memcpy(buf + len, ENTROPY_TRAILER_TAG, 4);
+    store_be32(buf + len + 4, Crc32c_update(0, buf, len));
+    return len + ENTROPY_TRAILER_SIZE;
+}
+
+
+/* Comp_entropy_verify
+ * Purpose:     Checks an entropy-coded image against its checksum trailer 
+ *                  without decoding it
+ * Parameters:  const uint8_t *buf, size_t len: the entropy-coded image
+ *              size_t *trailer: set to the offset of the trailer, or to 0
+ *                  if the image has none
+ * Returns:     bool: false if buf is not a well-formed entropy-coded image
+ *                  or its trailer does not match
+ * Note:        It is a CRE for trailer to be NULL
+ */
+bool Comp_entropy_verify(const uint8_t *buf, size_t len, size_t *trailer)
+{
+    assert(trailer != NULL);
+
+    unsigned width, height, nstripes;
+    const uint8_t *ends, *data;
+    size_t data_len;
+    *trailer = 0;
+    if (!entropy_parse(buf, len, &width, &height, NULL, &nstripes, &ends,
+                       &data, &data_len)) {
+        return false;
+    }
+    size_t end = data - buf + load_be32(ends + 4 * (nstripes - 1));
+    return entropy_check_trailer(buf, len, end, trailer);
+}
+
+
+/* Comp_entropy_decode_in
+ * Purpose:     Decodes an entropy-coded image into a Comp_img
+ * Parameters:  Img_arena arena: the arena to own the image, or NULL to
+ *                  allocate it on the heap
+ *              const uint8_t *buf, size_t len: the entropy-coded image
+ *              int nthreads: the number of threads, or < 1 for one per CPU
+ * Returns:     Comp_img: the new image, or NULL if buf is malformed or 
+ *                  its trailer does not match
+ */
+Comp_img Comp_entropy_decode_in(Img_arena arena, const uint8_t *buf,
+                                size_t len, int nthreads)
+{
+    unsigned width, height, nstripes;
+    const uint8_t *ends, *data;
+    size_t data_len;
+    struct Entropy_tables *t = CALLOC(1, sizeof(*t));
+
+    size_t trailer;
+    if (!entropy_parse(buf, len, &width, &height, t, &nstripes, &ends,
+                       &data, &data_len) ||
+        !entropy_check_trailer(buf, len, data - buf + 
+                               load_be32(ends + 4 * (nstripes - 1)), 
+                               &trailer)) {
+        FREE(t);
+        return NULL;
+    }
+    for (int m = 0; m < NMODELS; m++) {
+        for (unsigned s = 0; s < MODEL_SIZE(m); s++) {
+            uint32_t *slot = t->slot[m] + t->start[m][s];
+            for (uint32_t k = 0; k < t->freq[m][s]; k++) {
+                slot[k] = ((uint32_t) t->freq[m][s] << SLOT_FREQ_SHIFT) |
+                          (k << SLOT_SYM_BITS) | s;
+            }
+        }
+    }
+
+    Comp_img img = Comp_img_new_in(arena, width, height);
+    size_t bw = width / 2;
+    struct Entropy_job whole = { t, NULL, false, Comp_img_words(img), bw,
+                                 height / 2, 0, nstripes, NULL, NULL,
+                                 data, ends, true };
+    entropy_run(&whole, nstripes, bw * (height / 2) < ENTROPY_MIN_PARALLEL ?
+                                  1 : nthreads,
+                entropy_decode_stripes);
+    FREE(t);
+
+    if (!whole.ok) {
+        Comp_img_free(&img);
+        return NULL;
+    }
+    Comp_img_set_full(img);
+    return img;
+}
+
+
+/* entropy_parse
+ * Purpose:     Parses and checks the header of an entropy-coded image
+ * Parameters:  const uint8_t *buf, size_t len: the entropy-coded image
+ *              unsigned *width, *height: set to the image's size in pixels
+ *              struct Entropy_tables *t: its freq, start and empty 
+ *                  tables are set, unless t is NULL
+ *              unsigned *nstripes: set to the number of stripes
+ *              const uint8_t **ends: set to the table of stripe ends
+ *              const uint8_t **data: set to the first stripe's stream
+ *              size_t *data_len: set to the length of all the streams
+ * Returns:     bool: false unless the header is well formed, every model's
+ *                  frequencies sum to SCALE (or, for models never used,
+ *                  0), and every stripe lies in buf
+ */
+bool entropy_parse(const uint8_t *buf, size_t len, unsigned *width,
+                   unsigned *height, struct Entropy_tables *t,
+                   unsigned *nstripes, const uint8_t **ends,
+                   const uint8_t **data, size_t *data_len)
+{
+    if (!Comp_entropy_is(buf, len)) {
+        return false;
+    }
+
+    /* parse "<width> <height>\n" from a bounded copy of the header line */
+    size_t magic_len = strlen(ENTROPY_MAGIC);
+    char line[ENTROPY_HEADER_MAX];
+    size_t line_len = len - magic_len < sizeof(line) - 1 ?
+                      len - magic_len : sizeof(line) - 1;
+    memcpy(line, buf + magic_len, line_len);
+    line[line_len] = '\0';
+
+    int consumed = 0;
+    if (sscanf(line, "%u %u%n", width, height, &consumed) != 2 ||
+        (size_t) consumed >= line_len || line[consumed] != '\n' ||
+        *width < 2 || *height < 2 || *width % 2 != 0 || *height % 2 != 0) {
+        return false;
+    }
+
+    const uint8_t *p = buf + magic_len + consumed + 1;
+    size_t left = len - (p - buf);
+    if (left < 8 || load_be32(p) != STRIPE_ROWS) {
+        return false;
+    }
+    *nstripes = load_be32(p + 4);
+    if (*nstripes != (*height / 2 + STRIPE_ROWS - 1) / STRIPE_ROWS) {
+        return false;
+    }
+    p += 8;
+    left -= 8;
+
+    for (int m = 0; m < NMODELS; m++) {
+        unsigned start = 0;
+        for (unsigned s = 0; s < MODEL_SIZE(m); s++) {
+            size_t size = left > 0 && (*p & 0x80) ? 2 : 1;
+            if (left < size) {
+                return false;
+            }
+            unsigned freq = size == 2 ? ((p[0] & 0x7f) << 8) | p[1] : p[0];
+            p += size;
+            left -= size;
+            if (t != NULL) {
+                t->freq[m][s] = freq;
+                t->start[m][s] = start;
+            }
+            start += freq;
+        }
+        if (start != SCALE && start != 0) {
+            return false;
+        }
+        if (t != NULL) {
+            t->empty[m] = start == 0;
+        }
+    }
+
+    if (left < (size_t) *nstripes * 4) {
+        return false;
+    }
+    *ends = p;
+    *data = p + (size_t) *nstripes * 4;
+    *data_len = left - (size_t) *nstripes * 4;
+
+    uint32_t prev = 0;
+    for (unsigned i = 0; i < *nstripes; i++) {
+        uint32_t end = load_be32(*ends + 4 * i);
+        if (end < prev || end > *data_len) {
+            return false;
+        }
+        prev = end;
+    }
+    return true;
+}
+
+
+/* entropy_check_trailer
+ * Purpose:     Checks the trailer, if there is one, of the entropy-coded 
+ *                  image whose last stripe ends at buf + end
+ * Parameters:  const uint8_t *buf, size_t len: the entropy-coded image
+ *              size_t end: the offset just past its last stripe
+ *              size_t *trailer: set to the offset of the trailer, or to 0
+ *                  if the image has none
+ * Returns:     bool: false if the trailer does not match
+ */
+bool entropy_check_trailer(const uint8_t *buf, size_t len, size_t end,
+                           size_t *trailer)
+{
+    *trailer = 0;
+    if (len - end < ENTROPY_TRAILER_SIZE ||
+        memcmp(buf + end, ENTROPY_TRAILER_TAG, 4) != 0) {
+        return true;
+    }
+    *trailer = end;
+    return load_be32(buf + end + 4) == Crc32c_update(0, buf, end);
+}
+
+
+/* entropy_symbols
+ * Purpose:     Finds the symbols a word is coded as
+ * Parameters:  const uint8_t *words: the first stored word of the 
+ *                  word's stripe
+ *              bool little: whether the words are little-endian
+ *              size_t width: the image's width in blocks
+ *              unsigned row: the word's row within its stripe
+ *              size_t col: the word's column
+ *              unsigned model[NFIELDS]: set to the model of each field
+ *              unsigned sym[NFIELDS]: set to the word's symbols
+ *              unsigned *raw: set to the zigzagged residual of a, which is
+ *                  sent raw when sym[FIELD_A] is ESCAPE
+ * Note:        The first block of a row takes its chroma context from the
+ *                  block above it
+ */
+void entropy_symbols(const uint8_t *words, bool little, size_t width, 
+                     unsigned row, size_t col, unsigned model[NFIELDS],
+                     unsigned sym[NFIELDS], unsigned *raw)
+{
+    const uint8_t *w = words + (row * width + col) * 4;
+    uint32_t word = Codeword_load(w, little);
+    uint32_t left = col > 0 ? Codeword_load(w - 4, little) : 0;
+    uint32_t up = row > 0 ? Codeword_load(w - width * 4, little) : 0;
+    uint32_t up_left = col > 0 && row > 0 ? 
+                       Codeword_load(w - width * 4 - 4, little) : 0;
+
+    int residual = (int) (word >> CODEWORD_A_SHIFT) -
+                   entropy_predict(left >> CODEWORD_A_SHIFT, 
+                                   up >> CODEWORD_A_SHIFT,
+                                   up_left >> CODEWORD_A_SHIFT,
+                                   col > 0, row > 0);
+    *raw = residual >= 0 ? 2 * residual : -2 * residual - 1;
+    sym[FIELD_A] = *raw < ESCAPE ? *raw : ESCAPE;
+    sym[FIELD_B] = (word >> CODEWORD_B_SHIFT) & CODEWORD_BCD_MASK;
+    sym[FIELD_C] = (word >> CODEWORD_C_SHIFT) & CODEWORD_BCD_MASK;
+    sym[FIELD_D] = (word >> CODEWORD_D_SHIFT) & CODEWORD_BCD_MASK;
+    sym[FIELD_PB] = (word >> CODEWORD_PB_SHIFT) & CODEWORD_PBPR_MASK;
+    sym[FIELD_PR] = (word >> CODEWORD_PR_SHIFT) & CODEWORD_PBPR_MASK;
+
+    uint32_t prev = col > 0 ? left : up;
+    model[FIELD_A] = MODEL_A;
+    model[FIELD_B] = MODEL_B;
+    model[FIELD_C] = MODEL_C;
+    model[FIELD_D] = MODEL_D;
+    model[FIELD_PB] = MODEL_PB + ((prev >> CODEWORD_PB_SHIFT) & 
+                                  CODEWORD_PBPR_MASK);
+    model[FIELD_PR] = MODEL_PR + ((prev >> CODEWORD_PR_SHIFT) & 
+                                  CODEWORD_PBPR_MASK);
+}
+
+
+/* entropy_predict
+ * Purpose:     returns the median edge detector's prediction of a from its
+ *                  left (w), upper (n) and upper left (nw) neighbours,
+ *                  falling back to whichever neighbour there is, or 0
+ */
+static inline int entropy_predict(int w, int n, int nw, bool has_w, 
+                                  bool has_n)
+{
+    if (!has_n) {
+        return has_w ? w : 0;
+    }
+    if (!has_w) {
+        return n;
+    }
+
+    /* w + n - nw clamped to [lo, hi], which compiles without branches */
+    int lo = w < n ? w : n, hi = w < n ? n : w;
+    int grad = w + n - nw;
+    grad = grad < lo ? lo : grad;
+    return grad > hi ? hi : grad;
+}
+
+
+/* entropy_normalize
+ * Purpose:     Scales symbol counts to frequencies summing to SCALE,
+ *                  keeping every symbol that occurs at least 1
+ * Parameters:  const uint64_t *counts: the counts of the n symbols
+ *              unsigned n: the number of symbols
+ *              uint16_t *freq: set to the frequencies
+ * Note:        The rounding error is taken from (or given to) the most
+ *                  frequent symbol. A model with no counts at all gets all
+ *                  zero frequencies
+ */
+void entropy_normalize(const uint64_t *counts, unsigned n, uint16_t *freq)
+{
+    uint64_t total = 0;
+    for (unsigned s = 0; s < n; s++) {
+        total += counts[s];
+    }
+    if (total == 0) {
+        memset(freq, 0, n * sizeof(*freq));
+        return;
+    }
+
+    int sum = 0;
+    unsigned biggest = 0;
+    for (unsigned s = 0; s < n; s++) {
+        uint64_t scaled = counts[s] * SCALE / total;
+        freq[s] = counts[s] == 0 ? 0 : scaled > 0 ? scaled : 1;
+        sum += freq[s];
+        biggest = freq[s] > freq[biggest] ? s : biggest;
+    }
+
+    assert(freq[biggest] + (int) SCALE - sum > 0);
+    freq[biggest] += (int) SCALE - sum;
+}
+
+
+/* entropy_run
+ * Purpose:     Runs a job over every stripe, splitting the stripes across
+ *                  a Thread_pool unless nthreads is 1
+ * Parameters:  struct Entropy_job *whole: the job covering every stripe;
+ *                  its ok is cleared if any part fails
+ *              unsigned nstripes: the number of stripes
+ *              int nthreads: the number of threads, or < 1 for one per CPU
+ *              void run(void *): entropy_encode_stripes or
+ *                  entropy_decode_stripes
+ */
+void entropy_run(struct Entropy_job *whole, unsigned nstripes, int nthreads,
+                 void run(void *))
+{
+    if (nthreads == 1 || nstripes < 2) {
+        run(whole);
+        return;
+    }
+
+    Thread_pool pool = Thread_pool_new(nthreads, NULL);
+    unsigned njobs = Thread_pool_size(pool);
+    njobs = njobs < nstripes ? njobs : nstripes;
+    struct Entropy_job *jobs = CALLOC(njobs, sizeof(*jobs));
+
+    for (unsigned i = 0; i < njobs; i++) {
+        jobs[i] = *whole;
+        jobs[i].first = (uint64_t) nstripes * i / njobs;
+        jobs[i].last = (uint64_t) nstripes * (i + 1) / njobs;
+        Thread_pool_submit(pool, i, run, &jobs[i]);
+    }
+    Thread_pool_free(&pool);
+
+    for (unsigned i = 0; i < njobs; i++) {
+        whole->ok = whole->ok && jobs[i].ok;
+    }
+    FREE(jobs);
+}
+
+
+/* entropy_encode_stripes
+ * Purpose:     Thread_pool job (also run directly) that codes stripes
+ *                  [first, last) into their scratch areas
+ * Parameters:  void *jobp: the struct Entropy_job to run
+ */
+void entropy_encode_stripes(void *jobp)
+{
+    struct Entropy_job *job = jobp;
+    size_t stripe_bound = (size_t) STRIPE_ROWS * job->width * WORD_BOUND + 
+                          STRIPE_SLACK;
+
+    for (unsigned i = job->first; i < job->last; i++) {
+        unsigned row = i * STRIPE_ROWS;
+        unsigned rows = job->height - row < STRIPE_ROWS ? job->height - row
+                                                        : STRIPE_ROWS;
+        job->sizes[i] = entropy_encode_stripe(job->tables,
+                                              job->words +
+                                              row * job->width * 4,
+                                              job->little, job->width, rows,
+                                              job->scratch +
+                                              (i + 1) * stripe_bound);
+    }
+}
+
+
+/* entropy_decode_stripes
+ * Purpose:     Thread_pool job (also run directly) that decodes stripes
+ *                  [first, last) into the image's words
+ * Parameters:  void *jobp: the struct Entropy_job to run
+ */
+void entropy_decode_stripes(void *jobp)
+{
+    struct Entropy_job *job = jobp;
+
+    for (unsigned i = job->first; i < job->last && job->ok; i++) {
+        unsigned row = i * STRIPE_ROWS;
+        unsigned rows = job->height - row < STRIPE_ROWS ? job->height - row
+                                                        : STRIPE_ROWS;
+        uint32_t start = i > 0 ? load_be32(job->ends + 4 * (i - 1)) : 0;
+        uint32_t end = load_be32(job->ends + 4 * i);
+        job->ok = entropy_decode_stripe(job->tables, job->data + start,
+                                        job->data + end,
+                                        job->out + row * job->width,
+                                        job->width, rows);
+    }
+}
+
+
+/* entropy_encode_stripe
+ * Purpose:     rANS codes one stripe, backwards, so it decodes forwards
+ * Parameters:  const struct Entropy_tables *t: the frequency tables
+ *              const uint8_t *words: the stripe's first stored word
+ *              bool little: whether the words are little-endian
+ *              size_t width: the image's width in blocks
+ *              unsigned rows: the stripe's height in blocks
+ *              uint8_t *end: the end of the stripe's scratch area; the
+ *                  stream is written just before it
+ * Returns:     size_t: the length of the stream
+ */
+size_t entropy_encode_stripe(const struct Entropy_tables *t,
+                             const uint8_t *words, bool little, 
+                             size_t width, unsigned rows, uint8_t *end)
+{
+    uint32_t x[RANS_STATES];
+    uint8_t *p = end;
+    for (int i = 0; i < RANS_STATES; i++) {
+        x[i] = RANS_LOW;
+    }
+
+/* codes start and freq into state x, first shifting out the 16 bits that
+   would push it past RANS_LOW << 16 */
+#define RANS_PUT(x, start, freq) do {                                       \
+        uint32_t f_ = (freq);                                               \
+        if ((uint64_t) (x) >= ((uint64_t) RANS_LOW << 16 >> SCALE_BITS) *  \
+                              f_) {                                         \
+            p -= 2;                                                         \
+            p[0] = (x) >> 8;                                                \
+            p[1] = (x);                                                     \
+            (x) >>= 16;                                                     \
+        }                                                                   \
+        (x) = (((x) / f_) << SCALE_BITS) + ((x) % f_) + (start);            \
+    } while (0)
+
+    for (size_t i = (size_t) rows * width; i-- > 0; ) {
+        unsigned model[NFIELDS], sym[NFIELDS], raw;
+        entropy_symbols(words, little, width, i / width, i % width, model, 
+                        sym, &raw);
+
+        for (int f = NFIELDS - 1; f > FIELD_A; f--) {
+            RANS_PUT(x[FIELD_STATE(f)], t->start[model[f]][sym[f]], 
+                     t->freq[model[f]][sym[f]]);
+        }
+        if (sym[FIELD_A] == ESCAPE) {
+            RANS_PUT(x[ESCAPE_STATE], raw << (SCALE_BITS - ESCAPE_BITS),
+                     1u << (SCALE_BITS - ESCAPE_BITS));
+        }
+        RANS_PUT(x[FIELD_STATE(FIELD_A)], t->start[MODEL_A][sym[FIELD_A]],
+                 t->freq[MODEL_A][sym[FIELD_A]]);
+    }
+#undef RANS_PUT
+
+    for (int i = RANS_STATES; i-- > 0; ) {
+        p -= 4;
+        store_be32(p, x[i]);
+    }
+    return end - p;
+}
+
+
+/* entropy_decode_stripe
+ * Purpose:     Decodes one stripe's rANS stream into host-order words
+ * Parameters:  const struct Entropy_tables *t: the frequency and slot
+ *                  tables
+ *              const uint8_t *in, *end: the stripe's stream
+ *              uint32_t *out: the stripe's first word
+ *              size_t width: the image's width in blocks
+ *              unsigned rows: the stripe's height in blocks
+ * Returns:     bool: false if the stream runs out early or decodes to an a
+ *                  outside its field
+ * Note:        Each state lives in its own variable so that the states' 
+ *                  chains of table lookups run side by side. The stream's
+ *                  last few bytes are copied into a zero-padded buffer, so
+ *                  the refills never check for the end of the stream
+ */
+bool entropy_decode_stripe(const struct Entropy_tables *t,
+                           const uint8_t *in, const uint8_t *end,
+                           uint32_t *out, size_t width, unsigned rows)
+{
+    if (end - in < 4 * RANS_STATES || t->empty[MODEL_A] || 
+        t->empty[MODEL_B] || t->empty[MODEL_C] || t->empty[MODEL_D]) {
+        return false;
+    }
+    uint32_t x0 = load_be32(in), x1 = load_be32(in + 4);
+    uint32_t x2 = load_be32(in + 8), x3 = load_be32(in + 12);
+    in += 4 * RANS_STATES;
+    uint8_t tail[3 * WORD_READ_MAX];
+    bool in_tail = false;
+    bool ok = true;
+
+/* shifts the next 16-bit word into state x if it has dropped below 
+   RANS_LOW, with masks rather than a branch on the data. A decode leaves
+   x at least RANS_LOW >> SCALE_BITS, so one word always brings it back
+   into range */
+#define RANS_REFILL(x) do {                                                 \
+        uint32_t need_ = (x) < RANS_LOW;                                    \
+        uint32_t next_ = ((uint32_t) in[0] << 8) | in[1];                   \
+        (x) = ((x) << (need_ << 4)) | (next_ & -need_);                     \
+        in += need_ << 1;                                                   \
+    } while (0)
+
+/* decodes the next symbol of model m from state x into s, then refills x */
+#define RANS_GET(x, m, s) do {                                              \
+        uint32_t entry_ = t->slot[m][(x) & (SCALE - 1)];                    \
+        s = entry_ & ((1u << SLOT_SYM_BITS) - 1);                           \
+        (x) = (entry_ >> SLOT_FREQ_SHIFT) * ((x) >> SCALE_BITS) +           \
+              ((entry_ >> SLOT_SYM_BITS) & (SCALE - 1));                    \
+        RANS_REFILL(x);                                                     \
+    } while (0)
+
+    for (unsigned row = 0; row < rows; row++) {
+        for (size_t col = 0; col < width; col++, out++) {
+            /* near the end, carry on in the padded copy; a stream that 
+               reads past its end fails there, inside the padding */
+            if (end - in < WORD_READ_MAX) {
+                if (in_tail && in > end) {
+                    return false;
+                }
+                if (!in_tail) {
+                    memset(tail, 0, sizeof(tail));
+                    memcpy(tail, in, end - in);
+                    end = tail + (end - in);
+                    in = tail;
+                    in_tail = true;
+                }
+            }
+
+            uint32_t left = col > 0 ? out[-1] : 0;
+            uint32_t up = row > 0 ? out[-width] : 0;
+            uint32_t up_left = col > 0 && row > 0 ? out[-width - 1] : 0;
+            uint32_t prev = col > 0 ? left : up;
+            unsigned pb_model = MODEL_PB + ((prev >> CODEWORD_PB_SHIFT) & 
+                                            CODEWORD_PBPR_MASK);
+            unsigned pr_model = MODEL_PR + ((prev >> CODEWORD_PR_SHIFT) & 
+                                            CODEWORD_PBPR_MASK);
+            unsigned a, b, c, d, pb, pr;
+
+            /* a model the encoder never used has no symbols, so a stream
+               that asks for one fails the stripe at once */
+            if (t->empty[pb_model] || t->empty[pr_model]) {
+                return false;
+            }
+
+            RANS_GET(x0, MODEL_A, a);
+            if (a == ESCAPE) {
+                a = (x2 & (SCALE - 1)) >> (SCALE_BITS - ESCAPE_BITS);
+                x2 = (1u << (SCALE_BITS - ESCAPE_BITS)) * 
+                     (x2 >> SCALE_BITS) +
+                     (x2 & ((1u << (SCALE_BITS - ESCAPE_BITS)) - 1));
+                RANS_REFILL(x2);
+            }
+            int value = entropy_predict(left >> CODEWORD_A_SHIFT, 
+                                        up >> CODEWORD_A_SHIFT,
+                                        up_left >> CODEWORD_A_SHIFT,
+                                        col > 0, row > 0) +
+                        ((int) (a >> 1) ^ -(int) (a & 1));
+            ok &= (unsigned) value <= CODEWORD_A_MAX;
+
+            RANS_GET(x1, MODEL_B, b);
+            RANS_GET(x2, MODEL_C, c);
+            RANS_GET(x3, MODEL_D, d);
+            RANS_GET(x0, pb_model, pb);
+            RANS_GET(x1, pr_model, pr);
+
+            *out = ((uint32_t) (value & CODEWORD_A_MASK) << CODEWORD_A_SHIFT) |
+                   (b << CODEWORD_B_SHIFT) | (c << CODEWORD_C_SHIFT) | 
+                   (d << CODEWORD_D_SHIFT) | (pb << CODEWORD_PB_SHIFT) | 
+                   (pr << CODEWORD_PR_SHIFT);
+        }
+    }
+#undef RANS_GET
+#undef RANS_REFILL
+
+    return ok && x0 == RANS_LOW && x1 == RANS_LOW && x2 == RANS_LOW && 
+           x3 == RANS_LOW && in == end;
+}
+
+
+/* load_be32
+ * Purpose:     returns the big-endian 32-bit integer at p
+ */
+static inline uint32_t load_be32(const uint8_t *p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) |
+           ((uint32_t) p[2] << 8) | p[3];
+}
+
+
+/* store_be32
+ * Purpose:     writes v at p as a big-endian 32-bit integer
+ */
+static inline void store_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
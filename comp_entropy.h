@@ -0,0 +1,64 @@
+/* comp_entropy.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the interface for the entropy-coded variant of the compressed
+ *  image format: the same codewords, predicted and rANS coded in
+ *  independently decodable stripes of block rows
+ */
+
+#ifndef COMP_ENTROPY_H
+#define COMP_ENTROPY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "comp_img.h"
+#include "img_arena.h"
+
+
+/* returns true if buf[0..len) starts like an entropy-coded image */
+bool Comp_entropy_is(const uint8_t *buf, size_t len);
+
+/* returns the most bytes Comp_entropy_encode can write for a width x
+    height image */
+size_t Comp_entropy_bound(unsigned width, unsigned height);
+
+/* entropy codes the width x height image whose words start at words, 
+    little-endian if little is true (format 3) or big-endian otherwise 
+    (format 2), into out, which must hold Comp_entropy_bound bytes, with 
+    nthreads threads (one per CPU if < 1), and returns the number of bytes
+    written
+    Note: it is a CRE for words or out to be NULL */
+size_t Comp_entropy_encode(const uint8_t *words, bool little, 
+                           unsigned width, unsigned height, int nthreads, 
+                           uint8_t *out);
+
+/* parses the header of the entropy-coded image in buf[0..len) into *width
+    and *height. Returns false unless buf holds a well-formed header and 
+    all of the image's stripes, which may still fail to decode
+    Note: it is a CRE for width or height to be NULL */
+bool Comp_entropy_parse_header(const uint8_t *buf, size_t len, 
+                               unsigned *width, unsigned *height);
+
+/* appends a checksum trailer to the entropy-coded image in buf[0..len), 
+    which must have room for 8 more bytes, and returns the new length
+    Note: it is a CRE for buf to be NULL */
+size_t Comp_entropy_seal(uint8_t *buf, size_t len);
+
+/* checks the entropy-coded image in buf[0..len) against its trailer and 
+    sets *trailer to the trailer's offset (0 if it has none). Returns false
+    if buf is not a well-formed entropy-coded image or its trailer does not
+    match
+    Note: it is a CRE for trailer to be NULL */
+bool Comp_entropy_verify(const uint8_t *buf, size_t len, size_t *trailer);
+
+/* decodes the entropy-coded image in buf[0..len) into a new Comp_img owned
+    by the provided arena (or the heap if arena is NULL), decoding stripes
+    on nthreads threads (one per CPU if < 1). Returns NULL if buf does not
+    hold a well-formed, complete entropy-coded image, or if its trailer 
+    does not match */
+Comp_img Comp_entropy_decode_in(Img_arena arena, const uint8_t *buf,
+                                size_t len, int nthreads);
+
+#endif
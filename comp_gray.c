@@ -0,0 +1,340 @@
+/* comp_gray.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the implementation of the grayscale image format. A gray
+ *  image has no chroma, so its Pb and Pr fields would always hold the same
+ *  index; dropping them leaves 3 bytes a block instead of 4. Encoding goes
+ *  straight from the pgm's raster: each sample's luma comes from a table
+ *  (or one multiply by 1 / maxval for 16-bit samples), and the block's a,
+ *  b, c and d are quantized as abcd_to_word.c quantizes them, with no
+ *  XYZ_img, no RGB and no chroma lookups in between. Decoding runs the
+ *  inverse Haar transform from the fields to the four samples.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "assert.h"
+#include "comp_gray.h"
+#include "codeword.h"
+#include "crc32c.h"
+
+
+#define GRAY_MAGIC "COMP40 Grayscale image format 1\n"
+
+/* enough room for GRAY_MAGIC and two 10-digit dimensions */
+#define GRAY_HEADER_MAX 64
+
+/* b, c and d are luma gradients * 50, as abcd_to_word.c quantizes them */
+#define BCD_SCALE 50.0
+
+/* bytes per block */
+#define GRAY_BLOCK_BYTES 3
+
+/* the optional checksum trailer */
+#define GRAY_TRAILER_TAG "C32C"
+#define GRAY_TRAILER_SIZE 8
+
+
+/* helper function declarations */
+bool gray_parse(const uint8_t *buf, size_t len, unsigned *width,
+                unsigned *height, const uint8_t **blocks);
+void gray_encode_block(float y1, float y2, float y3, float y4, uint8_t *out);
+static inline int gray_quantize_bcd(float n);
+static inline uint8_t gray_sample(float y);
+
+
+/* Comp_gray_is
+ * Purpose:     returns true if buf begins with the grayscale format's magic
+ */
+bool Comp_gray_is(const uint8_t *buf, size_t len)
+{
+    size_t magic_len = strlen(GRAY_MAGIC);
+    return buf != NULL && len >= magic_len &&
+           memcmp(buf, GRAY_MAGIC, magic_len) == 0;
+}
+
+
+/* Comp_gray_size
+ * Purpose:     returns the size of an evened width x height grayscale image
+ */
+size_t Comp_gray_size(unsigned width, unsigned height)
+{
+    return snprintf(NULL, 0, GRAY_MAGIC "%u %u\n", width, height) +
+           (size_t) (width / 2) * (height / 2) * GRAY_BLOCK_BYTES;
+}
+
+
+/* Comp_gray_encode
+ * Purpose:     Codes the raster of a P5 pgm as a grayscale image
+ * Parameters:  const uint8_t *raster: the pgm's samples
+ *              unsigned width, height: the pgm's size in pixels
+ *              unsigned maxval: the pgm's maxval
+ *              uint8_t *out: where to write the image; must hold
+ *                  Comp_gray_size bytes for the evened down size
+ * Returns:     size_t: the number of bytes written
+ * Note:        It is a CRE for raster or out to be NULL, for width or
+ *                  height to be < 2, or for maxval to be 0 or > 65535
+ *              Samples above maxval are read as maxval
+ */
+size_t Comp_gray_encode(const uint8_t *raster, unsigned width,
+                        unsigned height, unsigned maxval, uint8_t *out)
+{
+    assert(raster != NULL && out != NULL);
+    assert(width >= 2 && height >= 2);
+    assert(maxval > 0 && maxval <= 65535);
+
+    unsigned blocks_per_row = width / 2;
+    unsigned block_rows = height / 2;
+    uint8_t *p = out + snprintf((char *) out, GRAY_HEADER_MAX,
+                                GRAY_MAGIC "%u %u\n", blocks_per_row * 2,
+                                block_rows * 2);
+
+    if (maxval > 255) {
+        /* 16-bit samples: fold 1 / maxval into one multiply */
+        float scale = 1.0 / maxval;
+        size_t stride = (size_t) width * 2;
+        for (unsigned row = 0; row < block_rows; row++) {
+            const uint8_t *top = raster + (size_t) row * 2 * stride;
+            const uint8_t *bottom = top + stride;
+            for (unsigned col = 0; col < blocks_per_row; col++) {
+                unsigned v[4] = {
+                    (unsigned) top[4 * col] << 8 | top[4 * col + 1],
+                    (unsigned) top[4 * col + 2] << 8 | top[4 * col + 3],
+                    (unsigned) bottom[4 * col] << 8 | bottom[4 * col + 1],
+                    (unsigned) bottom[4 * col + 2] << 8 | bottom[4 * col + 3]
+                };
+                for (int i = 0; i < 4; i++) {
+                    v[i] = v[i] < maxval ? v[i] : maxval;
+                }
+                gray_encode_block(v[0] * scale, v[1] * scale, v[2] * scale,
+                                  v[3] * scale, p);
+                p += GRAY_BLOCK_BYTES;
+            }
+        }
+        return p - out;
+    }
+
+    /* the luma of every 8-bit sample */
+    float luma[256];
+    for (unsigned v = 0; v < 256; v++) {
+        luma[v] = (float) (v < maxval ? v : maxval) / maxval;
+    }
+
+    for (unsigned row = 0; row < block_rows; row++) {
+        const uint8_t *top = raster + (size_t) row * 2 * width;
+        const uint8_t *bottom = top + width;
+        for (unsigned col = 0; col < blocks_per_row; col++) {
+            gray_encode_block(luma[top[2 * col]], luma[top[2 * col + 1]],
+                              luma[bottom[2 * col]],
+                              luma[bottom[2 * col + 1]], p);
+            p += GRAY_BLOCK_BYTES;
+        }
+    }
+    return p - out;
+}
+
+
+/* Comp_gray_parse_header
+ * Purpose:     Reads the size of a grayscale image
+ * Parameters:  const uint8_t *buf, size_t len: the grayscale image
+ *              unsigned *width, *height: set to its size in pixels
+ * Returns:     bool: false unless buf holds a complete grayscale image
+ * Note:        It is a CRE for width or height to be NULL
+ */
+bool Comp_gray_parse_header(const uint8_t *buf, size_t len, unsigned *width,
+                            unsigned *height)
+{
+    assert(width != NULL && height != NULL);
+
+    const uint8_t *blocks;
+    return gray_parse(buf, len, width, height, &blocks);
+}
+
+
+/* Comp_gray_seal
+ * Purpose:     Ends a grayscale image with its checksum trailer
+ * Parameters:  uint8_t *buf: the image, with room for the trailer after it
+ *              size_t len: the length of the image, as Comp_gray_encode 
+ *                  returned it
+ * Returns:     size_t: the length of the image with its trailer
+ * Note:        It is a CRE for buf to be NULL
+ */
+size_t Comp_gray_seal(uint8_t *buf, size_t len)
+{
+    assert(buf != NULL);
+
+    uint32_t crc = Crc32c_update(0, buf, len);
+    memcpy(buf + len, GRAY_TRAILER_TAG, 4);
+    buf[len + 4] = crc >> 24;
+    buf[len + 5] = crc >> 16;
+    buf[len + 6] = crc >> 8;
+    buf[len + 7] = crc;
+    return len + GRAY_TRAILER_SIZE;
+}
+
+
+/* Comp_gray_verify
+ * Purpose:     Checks a grayscale image against its checksum trailer
+ * Parameters:  const uint8_t *buf, size_t len: the grayscale image
+ *              size_t *trailer: set to the offset of the trailer, or to 0
+ *                  if the image has none
+ * Returns:     bool: false if buf is not a complete grayscale image or its
+ *                  trailer does not match
+ * Note:        It is a CRE for trailer to be NULL
+ */
+bool Comp_gray_verify(const uint8_t *buf, size_t len, size_t *trailer)
+{
+    assert(trailer != NULL);
+
+    unsigned width, height;
+    const uint8_t *blocks;
+    *trailer = 0;
+    if (!gray_parse(buf, len, &width, &height, &blocks)) {
+        return false;
+    }
+
+    size_t end = blocks - buf + 
+                 (size_t) (width / 2) * (height / 2) * GRAY_BLOCK_BYTES;
+    if (len - end < GRAY_TRAILER_SIZE ||
+        memcmp(buf + end, GRAY_TRAILER_TAG, 4) != 0) {
+        return true;
+    }
+    *trailer = end;
+
+    const uint8_t *p = buf + end + 4;
+    uint32_t stored = (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 |
+                      (uint32_t) p[2] << 8 | p[3];
+    return stored == Crc32c_update(0, buf, end);
+}
+
+
+/* Comp_gray_decode
+ * Purpose:     Decodes a grayscale image into the raster of a P5 pgm with
+ *                  maxval 255
+ * Parameters:  const uint8_t *buf, size_t len: the grayscale image
+ *              uint8_t *raster: where to write width * height samples
+ * Note:        It is a CRE for raster to be NULL or for buf not to hold a
+ *                  complete grayscale image
+ */
+void Comp_gray_decode(const uint8_t *buf, size_t len, uint8_t *raster)
+{
+    assert(raster != NULL);
+
+    unsigned width, height;
+    const uint8_t *p;
+    bool parsed = gray_parse(buf, len, &width, &height, &p);
+    assert(parsed);
+
+    /* the luma each a stands for */
+    float luma[CODEWORD_A_MAX + 1];
+    for (int a = 0; a <= CODEWORD_A_MAX; a++) {
+        luma[a] = Codeword_luma(a);
+    }
+
+    for (unsigned row = 0; row < height / 2; row++) {
+        uint8_t *top = raster + (size_t) row * 2 * width;
+        uint8_t *bottom = top + width;
+
+        for (unsigned col = 0; col < width / 2; col++) {
+            uint32_t word = (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 |
+                            (uint32_t) p[2] << 8;
+            p += GRAY_BLOCK_BYTES;
+
+            Codeword cw = Codeword_unpack(word);
+            float y = luma[cw.a];
+            float b = cw.b / BCD_SCALE;
+            float c = cw.c / BCD_SCALE;
+            float d = cw.d / BCD_SCALE;
+
+            /* the inverse of the transform in do_compression_math */
+            top[2 * col] = gray_sample(y - b - c + d);
+            top[2 * col + 1] = gray_sample(y - b + c - d);
+            bottom[2 * col] = gray_sample(y + b - c - d);
+            bottom[2 * col + 1] = gray_sample(y + b + c + d);
+        }
+    }
+}
+
+
+/* gray_parse
+ * Purpose:     Parses and checks a grayscale image
+ * Parameters:  const uint8_t *buf, size_t len: the grayscale image
+ *              unsigned *width, *height: set to its size in pixels
+ *              const uint8_t **blocks: set to its first block
+ * Returns:     bool: false unless the header is well formed and buf holds
+ *                  all of the blocks
+ */
+bool gray_parse(const uint8_t *buf, size_t len, unsigned *width,
+                unsigned *height, const uint8_t **blocks)
+{
+    if (!Comp_gray_is(buf, len)) {
+        return false;
+    }
+
+    /* parse "<width> <height>\n" from a bounded copy of the header line */
+    size_t magic_len = strlen(GRAY_MAGIC);
+    char line[GRAY_HEADER_MAX];
+    size_t line_len = len - magic_len < sizeof(line) - 1 ?
+                      len - magic_len : sizeof(line) - 1;
+    memcpy(line, buf + magic_len, line_len);
+    line[line_len] = '\0';
+
+    int consumed = 0;
+    if (sscanf(line, "%u %u%n", width, height, &consumed) != 2 ||
+        (size_t) consumed >= line_len || line[consumed] != '\n' ||
+        *width < 2 || *height < 2 || *width % 2 != 0 || *height % 2 != 0) {
+        return false;
+    }
+
+    *blocks = buf + magic_len + consumed + 1;
+    size_t left = len - (*blocks - buf);
+    return left / GRAY_BLOCK_BYTES >= (size_t) (*width / 2) * (*height / 2);
+}
+
+
+/* gray_encode_block
+ * Purpose:     Quantizes a block's four lumas (top left, top right, bottom
+ *                  left, bottom right) and writes its 3 bytes to out
+ */
+void gray_encode_block(float y1, float y2, float y3, float y4, uint8_t *out)
+{
+    /* as do_compression_math computes them */
+    Codeword cw = {
+        Codeword_quantize_luma((y4 + y3 + y2 + y1) / 4.0),
+        gray_quantize_bcd((y4 + y3 - y2 - y1) / 4.0),
+        gray_quantize_bcd((y4 - y3 + y2 - y1) / 4.0),
+        gray_quantize_bcd((y4 - y3 - y2 + y1) / 4.0),
+        0, 0
+    };
+    uint32_t word = Codeword_pack(cw);
+
+    out[0] = word >> 24;
+    out[1] = word >> 16;
+    out[2] = word >> 8;
+}
+
+
+/* gray_quantize_bcd
+ * Purpose:     quantizes b, c or d the way abcd_to_word.c's scale_bcd does
+ */
+static inline int gray_quantize_bcd(float n)
+{
+    n *= BCD_SCALE;
+    n = n < -CODEWORD_BCD_MAX ? -CODEWORD_BCD_MAX :
+        n > CODEWORD_BCD_MAX ? CODEWORD_BCD_MAX : n;
+    return (int) floorf(n);
+}
+
+
+/* gray_sample
+ * Purpose:     returns a luma clamped to [0, 1] as an 8-bit sample, as
+ *                  xyz_to_raster scales each channel
+ */
+static inline uint8_t gray_sample(float y)
+{
+    y = y < 0 ? 0 : y > 1 ? 1 : y;
+    return (uint8_t) floorf(y * 255);
+}
@@ -0,0 +1,68 @@
+/* comp_gray.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the interface for the grayscale image format, which codes a P5
+ *  pgm as only the luma fields of each block's codeword:
+ *
+ *      "COMP40 Grayscale image format 1\n<width> <height>\n"
+ *      uint8_t blocks[width / 2 * height / 2][3]
+ *
+ *  where each block is the top 24 bits of a format 2 word, big-endian:
+ *
+ *  | a (9 bits) | b (5) | c (5) | d (5) |
+ *
+ *  Like format 2, the image may end in a trailer right after its last 
+ *  block: "C32C", then the CRC-32C of everything before the trailer, 
+ *  big-endian.
+ */
+
+#ifndef COMP_GRAY_H
+#define COMP_GRAY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+/* returns true if buf[0..len) begins with the grayscale format's magic */
+bool Comp_gray_is(const uint8_t *buf, size_t len);
+
+/* returns the number of bytes of a grayscale image of the provided size,
+    both already evened down */
+size_t Comp_gray_size(unsigned width, unsigned height);
+
+/* codes the width x height raster of a P5 pgm with the provided maxval
+    (one byte per sample, or two big-endian bytes above 255) into out, which
+    must hold Comp_gray_size bytes for the evened down size. Returns the
+    number of bytes written
+    Note: it is a CRE for raster or out to be NULL, for width or height to
+          be < 2, or for maxval to be 0 or above 65535 */
+size_t Comp_gray_encode(const uint8_t *raster, unsigned width,
+                        unsigned height, unsigned maxval, uint8_t *out);
+
+/* appends a checksum trailer to the grayscale image in buf[0..len), which
+    must have room for 8 more bytes, and returns the new length
+    Note: it is a CRE for buf to be NULL */
+size_t Comp_gray_seal(uint8_t *buf, size_t len);
+
+/* checks the grayscale image in buf[0..len) against its trailer and sets 
+    *trailer to the trailer's offset (0 if it has none). Returns false if 
+    buf is not a complete grayscale image or its trailer does not match
+    Note: it is a CRE for trailer to be NULL */
+bool Comp_gray_verify(const uint8_t *buf, size_t len, size_t *trailer);
+
+/* parses the header of the grayscale image in buf[0..len) into *width and
+    *height. Returns false unless buf holds a well-formed header and all of
+    the image's blocks
+    Note: it is a CRE for width or height to be NULL */
+bool Comp_gray_parse_header(const uint8_t *buf, size_t len, unsigned *width,
+                            unsigned *height);
+
+/* decodes the grayscale image in buf[0..len) into raster, one byte per
+    pixel with maxval 255, as the raster of a P5 pgm
+    Note: it is a CRE for raster to be NULL or for buf not to hold a
+          complete grayscale image */
+void Comp_gray_decode(const uint8_t *buf, size_t len, uint8_t *raster);
+
+#endif
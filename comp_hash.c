@@ -0,0 +1,166 @@
+/* comp_hash.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the implementation of the perceptual hash. The a fields of the
+ *  words already form an image of mean lumas at half resolution, so that 
+ *  plane is averaged down to a HASH_GRID x HASH_GRID grid without any 
+ *  decoding. The lowest 8x8 frequencies of the grid's DCT are then 
+ *  compared to their median, one bit per frequency, so the hash tracks the
+ *  image's coarse structure and ignores requantization, rescaling and 
+ *  small tonal changes.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "assert.h"
+#include "comp_hash.h"
+#include "codeword.h"
+
+
+/* the side of the grid of averaged lumas the DCT is taken over */
+#define HASH_GRID 32
+
+/* the side of the block of low frequencies kept, 64 coefficients in all */
+#define HASH_FREQS 8
+
+
+/* helper function declarations */
+void hash_grid(const uint8_t *words, bool little, unsigned bw, unsigned bh,
+               double grid[HASH_GRID][HASH_GRID]);
+void hash_dct(double grid[HASH_GRID][HASH_GRID], 
+              double freqs[HASH_FREQS * HASH_FREQS]);
+int hash_cmp_double(const void *a, const void *b);
+
+
+/* Comp_hash
+ * Purpose:     Computes the perceptual hash of a compressed image
+ * Parameters:  const uint8_t *words: the image's first stored word
+ *              bool little: true if the words are little-endian (format 3),
+ *                  false if big-endian (format 2)
+ *              unsigned width, height: the image's size in pixels
+ * Returns:     uint64_t: the hash; bit i is set if the ith lowest 
+ *                  frequency (row by row) is above the median
+ * Note:        It is a CRE for words to be NULL
+ */
+uint64_t Comp_hash(const uint8_t *words, bool little, unsigned width, 
+                   unsigned height)
+{
+    assert(words != NULL);
+
+    double grid[HASH_GRID][HASH_GRID];
+    double freqs[HASH_FREQS * HASH_FREQS];
+    double sorted[HASH_FREQS * HASH_FREQS];
+
+    hash_grid(words, little, width / 2, height / 2, grid);
+    hash_dct(grid, freqs);
+
+    memcpy(sorted, freqs, sizeof(freqs));
+    qsort(sorted, HASH_FREQS * HASH_FREQS, sizeof(double), hash_cmp_double);
+    double median = (sorted[HASH_FREQS * HASH_FREQS / 2 - 1] + 
+                     sorted[HASH_FREQS * HASH_FREQS / 2]) / 2;
+
+    uint64_t hash = 0;
+    for (int i = 0; i < HASH_FREQS * HASH_FREQS; i++) {
+        if (freqs[i] > median) {
+            hash |= (uint64_t) 1 << i;
+        }
+    }
+    return hash;
+}
+
+
+/* hash_grid
+ * Purpose:     Averages the a fields of a bw x bh array of blocks down to a
+ *                  HASH_GRID x HASH_GRID grid
+ * Parameters:  const uint8_t *words: the first word
+ *              bool little: whether the words are little-endian
+ *              unsigned bw, bh: the image's size in blocks
+ *              double grid[][]: the grid to fill
+ * Note:        Each cell covers at least one block, so images smaller than
+ *                  the grid repeat blocks across neighbouring cells. An 
+ *                  image with no blocks gives an all-zero grid
+ */
+void hash_grid(const uint8_t *words, bool little, unsigned bw, unsigned bh,
+               double grid[HASH_GRID][HASH_GRID])
+{
+    memset(grid, 0, sizeof(double) * HASH_GRID * HASH_GRID);
+    if (bw == 0 || bh == 0) {
+        return;
+    }
+
+    for (unsigned gy = 0; gy < HASH_GRID; gy++) {
+        size_t row0 = (size_t) gy * bh / HASH_GRID;
+        size_t row1 = (size_t) (gy + 1) * bh / HASH_GRID;
+        row1 = row1 > row0 ? row1 : row0 + 1;
+
+        for (unsigned gx = 0; gx < HASH_GRID; gx++) {
+            size_t col0 = (size_t) gx * bw / HASH_GRID;
+            size_t col1 = (size_t) (gx + 1) * bw / HASH_GRID;
+            col1 = col1 > col0 ? col1 : col0 + 1;
+
+            uint64_t sum = 0;
+            for (size_t row = row0; row < row1; row++) {
+                const uint8_t *w = words + (row * bw + col0) * 4;
+                for (size_t col = col0; col < col1; col++, w += 4) {
+                    uint32_t word = Codeword_load(w, little);
+                    sum += (word >> CODEWORD_A_SHIFT) & CODEWORD_A_MASK;
+                }
+            }
+            grid[gy][gx] = (double) sum / ((row1 - row0) * (col1 - col0));
+        }
+    }
+}
+
+
+/* hash_dct
+ * Purpose:     Computes the lowest HASH_FREQS x HASH_FREQS coefficients of
+ *                  the (unnormalized) 2D DCT-II of the grid
+ * Parameters:  double grid[][]: the grid
+ *              double freqs[]: the coefficients, row by row
+ * Note:        The transform is separable: rows first, then columns, each 
+ *                  keeping only the HASH_FREQS lowest frequencies
+ */
+void hash_dct(double grid[HASH_GRID][HASH_GRID], 
+              double freqs[HASH_FREQS * HASH_FREQS])
+{
+    double basis[HASH_FREQS][HASH_GRID];
+    double rows[HASH_GRID][HASH_FREQS];
+
+    for (int u = 0; u < HASH_FREQS; u++) {
+        for (int x = 0; x < HASH_GRID; x++) {
+            basis[u][x] = cos((2 * x + 1) * u * M_PI / (2 * HASH_GRID));
+        }
+    }
+
+    for (int y = 0; y < HASH_GRID; y++) {
+        for (int u = 0; u < HASH_FREQS; u++) {
+            double sum = 0;
+            for (int x = 0; x < HASH_GRID; x++) {
+                sum += grid[y][x] * basis[u][x];
+            }
+            rows[y][u] = sum;
+        }
+    }
+
+    for (int v = 0; v < HASH_FREQS; v++) {
+        for (int u = 0; u < HASH_FREQS; u++) {
+            double sum = 0;
+            for (int y = 0; y < HASH_GRID; y++) {
+                sum += basis[v][y] * rows[y][u];
+            }
+            freqs[v * HASH_FREQS + u] = sum;
+        }
+    }
+}
+
+
+/* hash_cmp_double
+ * Purpose:     qsort comparison of two doubles, ascending
+ */
+int hash_cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
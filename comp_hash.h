@@ -0,0 +1,30 @@
+/* comp_hash.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the interface for computing a 64-bit perceptual hash of a 
+ *  compressed image from the a (mean luma) field of its words
+ */
+
+#ifndef COMP_HASH_H
+#define COMP_HASH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/* returns the perceptual hash of the width x height image whose words 
+    start at words, little-endian if little is true (format 3) or big-endian
+    otherwise (format 2). Images that look alike have hashes a small 
+    Hamming distance apart
+    Note: it is a CRE for words to be NULL */
+uint64_t Comp_hash(const uint8_t *words, bool little, unsigned width, 
+                   unsigned height);
+
+/* returns the number of bits in which hashes x and y differ */
+static inline unsigned Comp_hash_distance(uint64_t x, uint64_t y)
+{
+    return __builtin_popcountll(x ^ y);
+}
+
+#endif
@@ -1,6 +1,6 @@
 /* comp_img.c
  * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
- * last edited: 3/21/2021
+ * last edited: 5/9/2021
  * 
  * Contains the implementation of functions for interacting with with comp_img 
  * (compressed image) structs including creation, deletion, and printing.
@@ -10,33 +10,91 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "assert.h"
-#include "seq.h"
 #include "mem.h"
 #include "comp_img.h"
 #include "bitpack.h"
-
-void print_block(uint32_t *word);
+#include "big_buf.h"
+#include "crc32c.h"
+
+int comp_header(char *buf, size_t size, unsigned width, unsigned height);
+size_t comp_end(const uint8_t *buf, size_t len, bool *binary);
+void comp_store_trailer(uint8_t *p, uint32_t crc, bool binary);
+static inline uint32_t load_le32(const uint8_t *p);
+static inline void store_le32(uint8_t *p, uint32_t v);
+
+/* the first line of every compressed image */
+#define COMP_MAGIC "COMP40 Compressed image format 2\n"
+
+/* enough room for COMP_MAGIC and two 10-digit dimensions */
+#define COMP_HEADER_MAX 64
+
+/* Format 3 is binary: a fixed header of COMP_BINARY_HEADER bytes,
+ *
+ *      offset  0   char magic[8]           COMP_BINARY_MAGIC
+ *              8   uint32_t version        3
+ *             12   uint32_t width, height  in pixels
+ *             20   uint32_t flags          COMP_FLAG_CRC32C or 0
+ *             24   uint64_t words_offset   a multiple of COMP_ALIGN
+ *             32   zeros
+ *
+ *  then the words, little-endian and block by block, from words_offset. 
+ *  Every integer is little-endian, so on a little-endian host the words of
+ *  a mapped file are used where they lie. */
+#define COMP_BINARY_MAGIC "COMP40B\0"
+#define COMP_BINARY_VERSION 3
+#define COMP_BINARY_HEADER 64
+#define COMP_ALIGN 64
+#define COMP_FLAG_CRC32C 1u
+#define HOST_LITTLE_ENDIAN (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+
+/* Either format may end in a trailer right after its last word: 
+ *  COMP_TRAILER_TAG, then the CRC-32C of everything before the trailer, 
+ *  big-endian in format 2 and little-endian in format 3 (whose header also
+ *  sets COMP_FLAG_CRC32C). */
+#define COMP_TRAILER_TAG "C32C"
+#define COMP_TRAILER_SIZE 8
+
+/* set by Comp_img_set_checksums: true to end every image written with a 
+   trailer */
+static bool checksums = false;
+
+/* the most bytes Comp_img_write buffers before writing them out */
+#define WRITE_CHUNK 4096
 
 /* struct Comp_img AKA Comp_img
  *  Purpose: stores the data of a compressed ppm image 
  *  Members: int width: the width in pixels of the original image
  *           int height: the height in pixels of the original image
- *           Seq_T comp_words: a Hanson sequence containing the bitpacked data
+ *           uint32_t *comp_words: an array containing the bitpacked data
  *                  for each 2x2 block of pixels in the original image. Words
  *                  are stored in row major order with the first block in the 
- *                  image being the "lowest" block in the sequence
+ *                  image at index 0
+ *           int num_words: the capacity of comp_words (one per block)
+ *           int length: the number of words added to comp_words so far
+ *           int next_word: index of the next word Comp_img_get_next_word 
+ *                  will return
+ *           Img_arena arena: the arena owning the image, or NULL if the 
+ *                  image is heap-allocated
+ *           bool borrowed: true if comp_words lies in a caller's buffer 
+ *                  (see Comp_img_view_in) and must not be freed
  */
 struct Comp_img {
     int width;
     int height;
-    Seq_T comp_words;
+    uint32_t *comp_words;
+    int num_words;
+    int length;
+    int next_word;
+    Img_arena arena;
+    bool borrowed;
 };
 
 
 /* Comp_img_new
  * Purpose: Allocates a new comp_img struct with the provided height and width
- *              and allocates a new comp_words sequence for it 
+ *              and allocates a new comp_words array for it 
  * Parameters:  unsigned width: the width of the original img 
  *              unsigned height: the height of the original img
  * Returns:     Comp_img: the newly initialized comp_img struct
@@ -50,8 +108,45 @@ Comp_img Comp_img_new(unsigned width, unsigned height)
     NEW(new_img);
     new_img->width = width;
     new_img->height = height;
-    int num_words = width * height / 4;
-    new_img->comp_words = Seq_new(num_words);
+    new_img->num_words = width * height / 4;
+    new_img->comp_words = Big_buf_alloc(new_img->num_words * 
+                                        sizeof(uint32_t));
+    new_img->length = 0;
+    new_img->next_word = 0;
+    new_img->arena = NULL;
+    new_img->borrowed = false;
+
+    return new_img;
+}
+
+
+/* Comp_img_new_in
+ * Purpose: Allocates a new comp_img struct and its comp_words array out of 
+ *              the provided arena 
+ * Parameters:  Img_arena arena: the arena to own the image, or NULL to 
+ *                  allocate it on the heap with Comp_img_new
+ *              unsigned width: the width of the original img 
+ *              unsigned height: the height of the original img
+ * Returns:     Comp_img: the newly initialized comp_img struct
+ * Note:        It is a CRE for width or height to be < 2    
+ */
+Comp_img Comp_img_new_in(Img_arena arena, unsigned width, unsigned height)
+{
+    if (arena == NULL) {
+        return Comp_img_new(width, height);
+    }
+    assert(width > 1 && height > 1);
+
+    Comp_img new_img = Img_arena_alloc(arena, sizeof(*new_img));
+    new_img->width = width;
+    new_img->height = height;
+    new_img->num_words = width * height / 4;
+    new_img->comp_words = Img_arena_alloc(arena, new_img->num_words * 
+                                                 sizeof(uint32_t));
+    new_img->length = 0;
+    new_img->next_word = 0;
+    new_img->arena = arena;
+    new_img->borrowed = false;
 
     return new_img;
 }
@@ -68,14 +163,17 @@ void Comp_img_free(Comp_img *imgp)
     assert(imgp != NULL);
     assert(*imgp != NULL);
 
-    /* free any remaining words */
-    while (Seq_length((*imgp)->comp_words) > 0) {
-        uint32_t *temp = Seq_remlo((*imgp)->comp_words);
-        FREE(temp);
+    /* arena-owned images are released by resetting their arena */
+    if ((*imgp)->arena != NULL) {
+        *imgp = NULL;
+        return;
     }
 
-    /* free comp_word sequence */
-    Seq_free(&(*imgp)->comp_words);
+    /* free comp_word array, unless it belongs to the caller */
+    if (!(*imgp)->borrowed) {
+        Big_buf_free((*imgp)->comp_words, 
+                     (*imgp)->num_words * sizeof(uint32_t));
+    }
 
     /* free struct data */
     FREE(*imgp);
@@ -87,41 +185,627 @@ void Comp_img_free(Comp_img *imgp)
  *                  image format 2 format. 
  * Parameters:  Comp_img img: The compressed image to be printed
  * Returns:     None
- * Notes:       Removes and frees each word in the compressed image
- *              It is a CRE for img to be NULL
+ * Notes:       It is a CRE for img to be NULL
  */
 void Comp_img_print(Comp_img img)
+{
+    Comp_img_write(img, stdout);
+}
+
+
+/* Comp_img_write
+ * Purpose:     Prints the data of a provided image in the Comp40 compressed
+ *                  image format 2 format to the provided stream
+ * Parameters:  Comp_img img: The compressed image to be printed
+ *              FILE *fp: The stream to print it to
+ * Returns:     None
+ * Notes:       It is a CRE for img or fp to be NULL
+ */
+void Comp_img_write(Comp_img img, FILE *fp)
 {
     assert(img != NULL);
+    assert(fp != NULL);
 
-    printf("COMP40 Compressed image format 2\n%u %u\n", 
-                                                    img->width, img->height);
+    char header[COMP_HEADER_MAX];
+    int header_len = comp_header(header, sizeof(header), 
+                                 img->width, img->height);
+    fwrite(header, 1, header_len, fp);
+    uint32_t crc = checksums ? Crc32c_update(0, header, header_len) : 0;
+
+    /* words go out a chunk at a time, checksummed as they go */
+    uint8_t chunk[WRITE_CHUNK];
+    for (int i = 0; i < img->length; ) {
+        int n = 0;
+        for (; i < img->length && n < WRITE_CHUNK; i++, n += 4) {
+            uint32_t word = img->comp_words[i];
+            chunk[n] = word >> 24;
+            chunk[n + 1] = word >> 16;
+            chunk[n + 2] = word >> 8;
+            chunk[n + 3] = word;
+        }
+        fwrite(chunk, 1, n, fp);
+        if (checksums) {
+            crc = Crc32c_update(crc, chunk, n);
+        }
+    }
 
-    for (int i = 0, length = Seq_length(img->comp_words); i < length; i ++) {
+    if (checksums) {
+        comp_store_trailer(chunk, crc, false);
+        fwrite(chunk, 1, COMP_TRAILER_SIZE, fp);
+    }
+}
 
-        uint32_t *curr_word = Seq_remlo(img->comp_words);
-        
-        print_block(curr_word);
 
-        FREE(curr_word);
+/* Comp_img_serialized_size
+ * Purpose:     Returns the size in bytes of a compressed image of the 
+ *                  provided dimensions, header included
+ */
+size_t Comp_img_serialized_size(unsigned width, unsigned height)
+{
+    char header[COMP_HEADER_MAX];
+    return comp_header(header, sizeof(header), width, height) + 
+           (size_t) (width / 2) * (height / 2) * sizeof(uint32_t) +
+           Comp_img_trailer_size();
+}
+
+
+/* Comp_img_serialize
+ * Purpose:     Writes the provided image into a buffer in the same format 
+ *                  Comp_img_print uses
+ * Parameters:  Comp_img img: The compressed image to be written
+ *              uint8_t *buf: The buffer to write to, which must hold at 
+ *                  least Comp_img_serialized_size bytes
+ * Returns:     size_t: the number of bytes written
+ * Notes:       It is a CRE for img or buf to be NULL
+ */
+size_t Comp_img_serialize(Comp_img img, uint8_t *buf)
+{
+    assert(img != NULL);
+    assert(buf != NULL);
+
+    char header[COMP_HEADER_MAX];
+    int header_len = comp_header(header, sizeof(header), 
+                                 img->width, img->height);
+    memcpy(buf, header, header_len);
+
+    uint8_t *out = buf + header_len;
+    for (int i = 0; i < img->length; i++) {
+        uint32_t word = img->comp_words[i];
+        out[0] = word >> 24;
+        out[1] = word >> 16;
+        out[2] = word >> 8;
+        out[3] = word;
+        out += 4;
     }
+
+    return Comp_img_seal(buf, out - buf);
 }
 
 
-/* print_block
- * Purpose:     Prints the block data from a 32-bit word in big endian order
- * Parameters:  uint32_t *word: pointer to the 32-bit word to be printed
- * Returns:     None
+/* Comp_img_serialize_header
+ * Purpose:     Writes the header of a compressed image, for callers that 
+ *                  write its words themselves
+ * Parameters:  unsigned width, height: the image's size in pixels
+ *              uint8_t *buf: The buffer to write to, which must hold at 
+ *                  least Comp_img_serialized_size bytes
+ * Returns:     size_t: the number of bytes written
+ * Notes:       It is a CRE for buf to be NULL
+ */
+size_t Comp_img_serialize_header(unsigned width, unsigned height, 
+                                 uint8_t *buf)
+{
+    assert(buf != NULL);
+
+    char header[COMP_HEADER_MAX];
+    int header_len = comp_header(header, sizeof(header), width, height);
+    memcpy(buf, header, header_len);
+    return header_len;
+}
+
+
+/* Comp_img_binary_size
+ * Purpose:     Returns the size in bytes of a format 3 compressed image of 
+ *                  the provided dimensions, header included
+ */
+size_t Comp_img_binary_size(unsigned width, unsigned height)
+{
+    return COMP_BINARY_HEADER + 
+           (size_t) (width / 2) * (height / 2) * sizeof(uint32_t) +
+           Comp_img_trailer_size();
+}
+
+
+/* Comp_img_serialize_binary
+ * Purpose:     Writes the provided image into a buffer in format 3
+ * Parameters:  Comp_img img: The compressed image to be written
+ *              uint8_t *buf: The buffer to write to, which must hold at 
+ *                  least Comp_img_binary_size bytes
+ * Returns:     size_t: the number of bytes written
+ * Notes:       It is a CRE for img or buf to be NULL
+ */
+size_t Comp_img_serialize_binary(Comp_img img, uint8_t *buf)
+{
+    assert(img != NULL);
+    assert(buf != NULL);
+
+    uint8_t *out = buf + Comp_img_serialize_binary_header(img->width, 
+                                                          img->height, buf);
+    if (HOST_LITTLE_ENDIAN) {
+        memcpy(out, img->comp_words, img->length * sizeof(uint32_t));
+        out += img->length * sizeof(uint32_t);
+    } else {
+        for (int i = 0; i < img->length; i++, out += 4) {
+            store_le32(out, img->comp_words[i]);
+        }
+    }
+    return Comp_img_seal(buf, out - buf);
+}
+
+
+/* Comp_img_serialize_binary_header
+ * Purpose:     Writes the header of a format 3 compressed image, for 
+ *                  callers that write its words themselves
+ * Parameters:  unsigned width, height: the image's size in pixels
+ *              uint8_t *buf: The buffer to write to, which must hold at 
+ *                  least Comp_img_binary_size bytes
+ * Returns:     size_t: the number of bytes written, which is the offset of
+ *                  the first word
+ * Notes:       It is a CRE for buf to be NULL
+ */
+size_t Comp_img_serialize_binary_header(unsigned width, unsigned height,
+                                        uint8_t *buf)
+{
+    assert(buf != NULL);
+
+    memset(buf, 0, COMP_BINARY_HEADER);
+    memcpy(buf, COMP_BINARY_MAGIC, 8);
+    store_le32(buf + 8, COMP_BINARY_VERSION);
+    store_le32(buf + 12, width);
+    store_le32(buf + 16, height);
+    store_le32(buf + 20, checksums ? COMP_FLAG_CRC32C : 0);
+    store_le32(buf + 24, COMP_BINARY_HEADER);
+    return COMP_BINARY_HEADER;
+}
+
+
+/* Comp_img_set_checksums
+ * Purpose:     Turns checksum trailers on or off for every image written 
+ *                  from now on, by any thread
+ */
+void Comp_img_set_checksums(bool on)
+{
+    checksums = on;
+}
+
+
+/* Comp_img_seal
+ * Purpose:     Ends a compressed image written into a buffer with its 
+ *                  checksum trailer, if checksums are on
+ * Parameters:  uint8_t *buf: the image, header and words, with room for 
+ *                  the trailer after them (as the *_size functions count)
+ *              size_t len: the length of the header and words
+ * Returns:     size_t: the length of the image with its trailer
+ * Note:        It is a CRE for buf not to hold a complete image
+ */
+size_t Comp_img_seal(uint8_t *buf, size_t len)
+{
+    if (!checksums) {
+        return len;
+    }
+
+    bool binary;
+    size_t end = comp_end(buf, len, &binary);
+    assert(end == len);
+    comp_store_trailer(buf + end, Crc32c_update(0, buf, end), binary);
+    return end + COMP_TRAILER_SIZE;
+}
+
+
+/* Comp_img_seal_if
+ * Purpose:     Ends a compressed image written into a buffer with its 
+ *                  checksum trailer if seal is true or checksums are on, 
+ *                  unless it already ends in one
+ * Parameters:  uint8_t *buf: the image, with room for the trailer after it
+ *              size_t len: the length of the image
+ *              bool seal: true to seal the image even with checksums off
+ * Returns:     size_t: the length of the image with its trailer
+ * Note:        It is a CRE for buf not to hold a complete image
  */
-void print_block(uint32_t *word)
+size_t Comp_img_seal_if(uint8_t *buf, size_t len, bool seal)
 {
-    /* prints 32-bit block in big-endian order*/
-    for (int i = 3; i >= 0; i--) {
-        putchar(Bitpack_getu(*word, 8, i * 8));
+    bool binary;
+    size_t end = comp_end(buf, len, &binary);
+    assert(end != 0);
+    if (!(seal || checksums) || len - end >= COMP_TRAILER_SIZE) {
+        return len;
     }
+    assert(end == len);
+
+    if (binary) {
+        store_le32(buf + 20, load_le32(buf + 20) | COMP_FLAG_CRC32C);
+    }
+    comp_store_trailer(buf + end, Crc32c_update(0, buf, end), binary);
+    return end + COMP_TRAILER_SIZE;
+}
+
+
+/* Comp_img_verify
+ * Purpose:     Checks a compressed image held in memory against its 
+ *                  checksum trailer, reading every byte once
+ * Parameters:  const uint8_t *buf, size_t len: the compressed image
+ *              size_t *trailer: set to the offset of the trailer, or to 0
+ *                  if the image has none
+ * Returns:     bool: false if buf is not a complete compressed image, if 
+ *                  the trailer does not match, or if a format 3 header 
+ *                  promises a trailer that is missing; true otherwise, 
+ *                  including for images with no trailer
+ * Note:        It is a CRE for trailer to be NULL
+ */
+bool Comp_img_verify(const uint8_t *buf, size_t len, size_t *trailer)
+{
+    assert(trailer != NULL);
+
+    bool binary;
+    size_t end = comp_end(buf, len, &binary);
+    *trailer = 0;
+    if (end == 0) {
+        return false;
+    }
+
+    bool sealed = len - end >= COMP_TRAILER_SIZE &&
+                  memcmp(buf + end, COMP_TRAILER_TAG, 4) == 0;
+    if (binary && (load_le32(buf + 20) & COMP_FLAG_CRC32C) != 0 && 
+        !sealed) {
+        return false;
+    }
+    if (!sealed) {
+        return true;
+    }
+
+    uint8_t expected[COMP_TRAILER_SIZE];
+    comp_store_trailer(expected, Crc32c_update(0, buf, end), binary);
+    *trailer = end;
+    return memcmp(buf + end, expected, COMP_TRAILER_SIZE) == 0;
 }
 
 
+/* Comp_img_reseal
+ * Purpose:     Rewrites the checksum trailer of a compressed image whose 
+ *                  words were changed in place, if it has one
+ * Parameters:  uint8_t *buf, size_t len: the compressed image
+ * Returns:     size_t: the offset of the trailer, or 0 if there is none
+ */
+size_t Comp_img_reseal(uint8_t *buf, size_t len)
+{
+    bool binary;
+    size_t end = comp_end(buf, len, &binary);
+    if (end == 0 || len - end < COMP_TRAILER_SIZE ||
+        memcmp(buf + end, COMP_TRAILER_TAG, 4) != 0) {
+        return 0;
+    }
+
+    comp_store_trailer(buf + end, Crc32c_update(0, buf, end), binary);
+    return end;
+}
+
+
+/* Comp_img_trailer_offset
+ * Purpose:     Finds the checksum trailer of a compressed image held in 
+ *                  memory without checking it
+ * Parameters:  const uint8_t *buf, size_t len: the compressed image
+ * Returns:     size_t: the offset of the trailer, or 0 if there is none
+ */
+size_t Comp_img_trailer_offset(const uint8_t *buf, size_t len)
+{
+    bool binary;
+    size_t end = comp_end(buf, len, &binary);
+    if (end == 0 || len - end < COMP_TRAILER_SIZE ||
+        memcmp(buf + end, COMP_TRAILER_TAG, 4) != 0) {
+        return 0;
+    }
+    return end;
+}
+
+
+/* Comp_img_parse_header
+ * Purpose:     Parses the header of a compressed image held in memory
+ * Parameters:  const uint8_t *buf: the bytes of the compressed image
+ *              size_t len: the number of bytes in buf
+ *              unsigned *width, *height: set to the image's dimensions
+ *              size_t *words_offset: set to the offset of the first word
+ * Returns:     bool: false if buf does not start with a well-formed header
+ *                  or is too short to hold all of the image's words
+ * Note:        It is a CRE for width, height or words_offset to be NULL
+ */
+bool Comp_img_parse_header(const uint8_t *buf, size_t len, unsigned *width,
+                           unsigned *height, size_t *words_offset)
+{
+    assert(width != NULL && height != NULL && words_offset != NULL);
+
+    size_t magic_len = strlen(COMP_MAGIC);
+    if (buf == NULL || len < magic_len || 
+        memcmp(buf, COMP_MAGIC, magic_len) != 0) {
+        return false;
+    }
+
+    /* parse "<width> <height>\n" from a bounded copy of the header line */
+    char line[COMP_HEADER_MAX];
+    size_t line_len = len - magic_len < sizeof(line) - 1 ? 
+                      len - magic_len : sizeof(line) - 1;
+    memcpy(line, buf + magic_len, line_len);
+    line[line_len] = '\0';
+
+    int consumed = 0;
+    if (sscanf(line, "%u %u%n", width, height, &consumed) != 2 ||
+        (size_t) consumed >= line_len || line[consumed] != '\n' ||
+        *width < 2 || *height < 2 || *width % 2 != 0 || *height % 2 != 0) {
+        return false;
+    }
+
+    *words_offset = magic_len + consumed + 1;
+    size_t num_words = (size_t) (*width / 2) * (*height / 2);
+    return len - *words_offset >= num_words * sizeof(uint32_t);
+}
+
+
+/* Comp_img_parse_binary_header
+ * Purpose:     Parses the header of a format 3 compressed image held in 
+ *                  memory
+ * Parameters:  const uint8_t *buf: the bytes of the compressed image
+ *              size_t len: the number of bytes in buf
+ *              unsigned *width, *height: set to the image's dimensions
+ *              size_t *words_offset: set to the offset of the first word
+ * Returns:     bool: false if buf does not start with a well-formed format
+ *                  3 header this version understands, or is too short to 
+ *                  hold all of the image's words
+ * Note:        It is a CRE for width, height or words_offset to be NULL
+ */
+bool Comp_img_parse_binary_header(const uint8_t *buf, size_t len, 
+                                  unsigned *width, unsigned *height, 
+                                  size_t *words_offset)
+{
+    assert(width != NULL && height != NULL && words_offset != NULL);
+
+    if (buf == NULL || len < COMP_BINARY_HEADER || 
+        memcmp(buf, COMP_BINARY_MAGIC, 8) != 0 ||
+        load_le32(buf + 8) != COMP_BINARY_VERSION || 
+        (load_le32(buf + 20) & ~COMP_FLAG_CRC32C) != 0 || 
+        load_le32(buf + 28) != 0) {
+        return false;
+    }
+
+    *width = load_le32(buf + 12);
+    *height = load_le32(buf + 16);
+    *words_offset = load_le32(buf + 24);
+    if (*width < 2 || *height < 2 || *width % 2 != 0 || *height % 2 != 0 ||
+        *words_offset < COMP_BINARY_HEADER || 
+        *words_offset % COMP_ALIGN != 0 || *words_offset > len) {
+        return false;
+    }
+
+    size_t num_words = (size_t) (*width / 2) * (*height / 2);
+    return len - *words_offset >= num_words * sizeof(uint32_t);
+}
+
+
+/* Comp_img_parse_in
+ * Purpose:     Creates a new Comp_img from a compressed image held in memory
+ * Parameters:  Img_arena arena: the arena to own the image, or NULL to 
+ *                  allocate it on the heap
+ *              const uint8_t *buf: the bytes of the compressed image
+ *              size_t len: the number of bytes in buf
+ * Returns:     Comp_img: the new image, or NULL if buf does not hold a 
+ *                  well-formed, complete compressed image, or its checksum
+ *                  trailer does not match
+ */
+Comp_img Comp_img_parse_in(Img_arena arena, const uint8_t *buf, size_t len)
+{
+    unsigned width, height;
+    size_t offset, trailer;
+    bool binary;
+    if (!Comp_img_locate(buf, len, &width, &height, &offset, &binary) ||
+        !Comp_img_verify(buf, len, &trailer)) {
+        return NULL;
+    }
+
+    return Comp_img_parse_region_in(arena, buf, len, 0, 0, width, height);
+}
+
+
+/* Comp_img_view_in
+ * Purpose:     Creates a new Comp_img for a compressed image held in 
+ *                  memory without copying its words, if it can: a format 3
+ *                  image on a little-endian host whose words are 4-byte 
+ *                  aligned (as they are in a mapped file) is used where it 
+ *                  lies. Any other image is parsed as by Comp_img_parse_in
+ * Parameters:  Img_arena arena: the arena to own the image, or NULL to 
+ *                  allocate it on the heap
+ *              const uint8_t *buf, size_t len: the compressed image
+ * Returns:     Comp_img: the new image, or NULL if buf does not hold a 
+ *                  well-formed, complete compressed image, or its checksum
+ *                  trailer does not match
+ * Note:        A view's words must not be written, and buf must outlive it
+ */
+Comp_img Comp_img_view_in(Img_arena arena, const uint8_t *buf, size_t len)
+{
+    unsigned width, height;
+    size_t offset, trailer;
+    if (!HOST_LITTLE_ENDIAN || 
+        !Comp_img_parse_binary_header(buf, len, &width, &height, &offset) ||
+        (uintptr_t) (buf + offset) % sizeof(uint32_t) != 0) {
+        return Comp_img_parse_in(arena, buf, len);
+    }
+    if (!Comp_img_verify(buf, len, &trailer)) {
+        return NULL;
+    }
+
+    Comp_img view;
+    if (arena == NULL) {
+        NEW(view);
+    } else {
+        view = Img_arena_alloc(arena, sizeof(*view));
+    }
+    view->width = width;
+    view->height = height;
+    view->num_words = (width / 2) * (height / 2);
+    view->comp_words = (uint32_t *) (buf + offset);
+    view->length = view->num_words;
+    view->next_word = 0;
+    view->arena = arena;
+    view->borrowed = true;
+
+    return view;
+}
+
+
+/* Comp_img_parse_region_in
+ * Purpose:     Creates a new Comp_img holding only the blocks of a 
+ *                  compressed image (held in memory, in format 2 or 3) that
+ *                  make up the provided rectangle. Only those words are 
+ *                  read, so when buf is a mapped file only the pages 
+ *                  holding them are faulted in.
+ * Parameters:  Img_arena arena: the arena to own the image, or NULL to 
+ *                  allocate it on the heap
+ *              const uint8_t *buf, size_t len: the compressed image
+ *              unsigned col, row: the top left pixel of the rectangle
+ *              unsigned width, height: the size of the rectangle in pixels
+ * Returns:     Comp_img: the width x height sub-image, or NULL if buf does 
+ *                  not hold a complete compressed image or the rectangle 
+ *                  is not block-aligned and inside the image
+ */
+Comp_img Comp_img_parse_region_in(Img_arena arena, const uint8_t *buf, 
+                                  size_t len, unsigned col, unsigned row, 
+                                  unsigned width, unsigned height)
+{
+    unsigned full_width, full_height;
+    size_t offset;
+    bool binary;
+    if (!Comp_img_locate(buf, len, &full_width, &full_height, &offset, 
+                         &binary) ||
+        col % 2 != 0 || row % 2 != 0 || width < 2 || height < 2 ||
+        width % 2 != 0 || height % 2 != 0 || 
+        width > full_width || col > full_width - width ||
+        height > full_height || row > full_height - height) {
+        return NULL;
+    }
+
+    Comp_img compressed = Comp_img_new_in(arena, width, height);
+    size_t blocks_per_row = full_width / 2;
+    uint32_t *word = compressed->comp_words;
+
+    for (unsigned blk_row = row / 2; blk_row < (row + height) / 2; 
+         blk_row++) {
+        const uint8_t *in = buf + offset + 
+                            (blk_row * blocks_per_row + col / 2) * 4;
+        if (binary && HOST_LITTLE_ENDIAN) {
+            memcpy(word, in, (width / 2) * sizeof(uint32_t));
+            word += width / 2;
+            continue;
+        }
+        for (unsigned i = 0; i < width / 2; i++) {
+            *word++ = binary ? load_le32(in) 
+                             : ((uint32_t) in[0] << 24) | 
+                               ((uint32_t) in[1] << 16) |
+                               ((uint32_t) in[2] << 8) | in[3];
+            in += 4;
+        }
+    }
+    compressed->length = compressed->num_words;
+
+    return compressed;
+}
+
+
+/* comp_header
+ * Purpose:     Formats the header of a compressed image into buf
+ * Returns:     int: the length of the header
+ */
+int comp_header(char *buf, size_t size, unsigned width, unsigned height)
+{
+    return snprintf(buf, size, COMP_MAGIC "%u %u\n", width, height);
+}
+
+
+/* comp_end
+ * Purpose:     Returns the offset just past the last word of the compressed
+ *                  image in buf[0..len), or 0 if buf does not hold one, and
+ *                  sets *binary to true for format 3
+ */
+size_t comp_end(const uint8_t *buf, size_t len, bool *binary)
+{
+    unsigned width, height;
+    size_t offset;
+    if (!Comp_img_locate(buf, len, &width, &height, &offset, binary)) {
+        return 0;
+    }
+    return offset + (size_t) (width / 2) * (height / 2) * sizeof(uint32_t);
+}
+
+
+/* Comp_img_trailer_size
+ * Purpose:     Returns the size of the trailer of images written now: 0, 
+ *                  unless checksums are on
+ */
+size_t Comp_img_trailer_size(void)
+{
+    return checksums ? COMP_TRAILER_SIZE : 0;
+}
+
+
+/* comp_store_trailer
+ * Purpose:     Writes a trailer holding crc at p, in the byte order of 
+ *                  format 3 if binary is true and of format 2 if not
+ */
+void comp_store_trailer(uint8_t *p, uint32_t crc, bool binary)
+{
+    memcpy(p, COMP_TRAILER_TAG, 4);
+    if (binary) {
+        store_le32(p + 4, crc);
+    } else {
+        p[4] = crc >> 24;
+        p[5] = crc >> 16;
+        p[6] = crc >> 8;
+        p[7] = crc;
+    }
+}
+
+
+/* Comp_img_locate
+ * Purpose:     Parses the header of a compressed image in either format
+ * Returns:     bool: as Comp_img_parse_header; *binary is set to true for 
+ *                  format 3
+ */
+bool Comp_img_locate(const uint8_t *buf, size_t len, unsigned *width, 
+                     unsigned *height, size_t *words_offset, bool *binary)
+{
+    *binary = Comp_img_parse_binary_header(buf, len, width, height, 
+                                           words_offset);
+    return *binary || 
+           Comp_img_parse_header(buf, len, width, height, words_offset);
+}
+
+
+/* load_le32
+ * Purpose:     returns the little-endian 32-bit integer at p
+ */
+static inline uint32_t load_le32(const uint8_t *p)
+{
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | 
+           ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+
+/* store_le32
+ * Purpose:     stores v at p, little-endian
+ */
+static inline void store_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
 
 /* Comp_img_read
  * Purpose:         Creates and returns a new Comp_img using input from the 
@@ -132,27 +816,61 @@ void print_block(uint32_t *word)
  * Note:            it is a CRE for fp to be NULL
  */
 Comp_img Comp_img_read(FILE *fp)
+{
+    return Comp_img_read_in(NULL, fp);
+}
+
+
+/* Comp_img_read_in
+ * Purpose:         Creates and returns a new Comp_img owned by the provided
+ *                      arena using input from the provided stream.
+ * Parameters:      Img_arena arena: the arena to own the image, or NULL to 
+ *                      allocate it on the heap
+ *                  FILE *fp: an input stream containing a Comp_img as 
+ *                      printed by Comp_img_print
+ * Returns:         Comp_img: a new Comp_img struct 
+ * Note:            it is a CRE for fp to be NULL, or, with checksums on, 
+ *                      for the image not to end in a matching trailer
+ */
+Comp_img Comp_img_read_in(Img_arena arena, FILE *fp)
 {
     assert(fp != NULL);
     
     unsigned height, width;
-    int read = fscanf(fp, "COMP40 Compressed image format 2\n%u %u\n", 
+    int read = fscanf(fp, COMP_MAGIC "%u %u\n", 
                                                             &width, &height); 
     assert(read == 2);
     
-    Comp_img compressed = Comp_img_new(width, height);
+    Comp_img compressed = Comp_img_new_in(arena, width, height);
 
-    uint32_t *word;
-    uint8_t c;
+    char header[COMP_HEADER_MAX];
+    uint32_t crc = Crc32c_update(0, header, comp_header(header, 
+                                                        sizeof(header),
+                                                        width, height));
+    uint32_t word = 0;
+    uint8_t c[4];
 
-    for (int i = 0; i < (int) (width * height / 4); i++) {
+    for (int i = 0; i < compressed->num_words; i++) {
         
-        word = ALLOC(sizeof(uint32_t));
         for (int j = 3; j >= 0; j--){
-            c = getc(fp);
-            *word = (uint32_t) Bitpack_newu(*word, 8, 8 * j, (uint64_t) c);  
+            c[3 - j] = getc(fp);
+            word = (uint32_t) Bitpack_newu(word, 8, 8 * j, 
+                                           (uint64_t) c[3 - j]);  
+        }
+        compressed->comp_words[i] = word;
+        if (checksums) {
+            crc = Crc32c_update(crc, c, 4);
         }
-        Seq_addhi(compressed->comp_words, word);
+    }
+    compressed->length = compressed->num_words;
+
+    /* with checksums on, the stream must end the image with its trailer */
+    if (checksums) {
+        uint8_t trailer[COMP_TRAILER_SIZE], expected[COMP_TRAILER_SIZE];
+        comp_store_trailer(expected, crc, false);
+        read = fread(trailer, 1, COMP_TRAILER_SIZE, fp);
+        assert(read == COMP_TRAILER_SIZE && 
+               memcmp(trailer, expected, COMP_TRAILER_SIZE) == 0);
     }
 
     return compressed;
@@ -183,26 +901,51 @@ unsigned Comp_img_height(Comp_img img)
 }
 
 
+/* Comp_img_words
+ * Purpose:     Returns the provided image's word array, so whole-image 
+ *                  operations can work on it directly
+ * Notes:       it is a CRE for img to be NULL
+ */
+uint32_t *Comp_img_words(Comp_img img)
+{
+    assert(img != NULL);
+    return img->comp_words;
+}
+
+
+/* Comp_img_set_full
+ * Purpose:     Marks all of the provided image's words as added, after they
+ *                  have been written straight into its word array
+ * Notes:       it is a CRE for img to be NULL
+ */
+void Comp_img_set_full(Comp_img img)
+{
+    assert(img != NULL);
+    img->length = img->num_words;
+}
+
+
 /* Comp_img_get_next_word
- * Purpose:     Returns a pointer to the next words in the provided image's
- *                  comp_word sequence, removing that word from the sequence
- * Notes:       It is the client's responsibility to free the word  
- *              it is a CRE for img to be NULL
+ * Purpose:     Returns the next unread word in the provided image's
+ *                  comp_words array and advances past it
+ * Notes:       it is a CRE for img to be NULL or to read past the last word
  */
-uint32_t *Comp_img_get_next_word(Comp_img img)
+uint32_t Comp_img_get_next_word(Comp_img img)
 {
     assert(img != NULL);
-    return Seq_remlo(img->comp_words); 
+    assert(img->next_word < img->length);
+    return img->comp_words[img->next_word++]; 
 }
 
 
 /* Comp_img_add_word
- * Purpose:     adds the provided pointer to a word to the top of the provided
- *                  img's comp_words sequence 
- * Note:        it is a CRE for img to be NULL
+ * Purpose:     adds the provided word to the top of the provided img's 
+ *                  comp_words array 
+ * Note:        it is a CRE for img to be NULL or for the array to be full
  */
-void Comp_img_add_word(Comp_img img, uint32_t *wordp)
+void Comp_img_add_word(Comp_img img, uint32_t word)
 {
     assert(img != NULL);
-    Seq_addhi(img->comp_words, wordp);
+    assert(img->length < img->num_words);
+    img->comp_words[img->length++] = word;
 }
\ No newline at end of file
@@ -1,6 +1,6 @@
 /* comp_img.h
  * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
- * last edited: 3/21/2021
+ * last edited: 5/9/2021
  * 
  * Contains the interface for working with comp_img (compressed image) structs
  *  including creation, deletion, and printing
@@ -12,7 +12,8 @@
 
 #include <stdio.h>
 #include <stdint.h>
-#include "seq.h"
+#include <stdbool.h>
+#include "img_arena.h"
 
 
 typedef struct Comp_img *Comp_img;
@@ -20,15 +21,146 @@ typedef struct Comp_img *Comp_img;
 /* allocates space for a new Comp_img with the provided width and height */
 Comp_img Comp_img_new(unsigned width, unsigned height);
 
+/* allocates a new Comp_img whose word array is owned by the provided arena,
+   or on the heap like Comp_img_new if arena is NULL */
+Comp_img Comp_img_new_in(Img_arena arena, unsigned width, unsigned height);
+
 /* prints the provided Comp_img to stdout 
    Note: it is a CRE for img to be NULL */
 void Comp_img_print(Comp_img img);
 
+/* prints the provided Comp_img to the provided stream
+   Note: it is a CRE for img or fp to be NULL */
+void Comp_img_write(Comp_img img, FILE *fp);
+
+/* returns the number of bytes Comp_img_serialize writes for an image of the
+   provided size */
+size_t Comp_img_serialized_size(unsigned width, unsigned height);
+
+/* writes the provided Comp_img, exactly as Comp_img_print would print it, 
+   into buf and returns the number of bytes written. buf must hold at least
+   Comp_img_serialized_size bytes
+   Note: it is a CRE for img or buf to be NULL */
+size_t Comp_img_serialize(Comp_img img, uint8_t *buf);
+
+/* writes just the header of a width x height compressed image into buf, 
+   which must hold Comp_img_serialized_size bytes (header and words), and 
+   returns its length; the words follow it, big-endian and block by block
+   Note: it is a CRE for buf to be NULL */
+size_t Comp_img_serialize_header(unsigned width, unsigned height, 
+                                 uint8_t *buf);
+
+/* returns the number of bytes Comp_img_serialize_binary writes for an image
+   of the provided size */
+size_t Comp_img_binary_size(unsigned width, unsigned height);
+
+/* writes the provided Comp_img into buf in binary format 3 (a fixed header,
+   then the words little-endian from a 64-byte aligned offset) and returns 
+   the number of bytes written. buf must hold Comp_img_binary_size bytes
+   Note: it is a CRE for img or buf to be NULL */
+size_t Comp_img_serialize_binary(Comp_img img, uint8_t *buf);
+
+/* writes just the header of a width x height format 3 image into buf, 
+   which must hold Comp_img_binary_size bytes, and returns its length, 
+   which is the offset of the first word
+   Note: it is a CRE for buf to be NULL */
+size_t Comp_img_serialize_binary_header(unsigned width, unsigned height,
+                                        uint8_t *buf);
+
+/* turns checksum trailers on or off for all images written from now on: 
+   with them on, every image Comp_img_print, Comp_img_write or the 
+   serialize functions write ends in a trailer holding the CRC-32C of the
+   bytes before it, the *_size functions count it, and Comp_img_read 
+   requires it. Readers of images in memory check a trailer whenever one is
+   present */
+void Comp_img_set_checksums(bool on);
+
+/* returns the size of the trailer images written now end in (0 with 
+   checksums off) */
+size_t Comp_img_trailer_size(void);
+
+/* appends the trailer, if checksums are on, to the complete image (header
+   and words) in buf[0..len), which has room for it, and returns the new
+   length; for callers that write the words themselves
+   Note: it is a CRE for buf not to hold a complete image */
+size_t Comp_img_seal(uint8_t *buf, size_t len);
+
+/* like Comp_img_seal, but also appends the trailer when seal is true (so 
+   an image made from a sealed one stays sealed), setting the checksum flag
+   of a format 3 header; an image that already ends in its trailer is left
+   as it is. buf must have room for 8 more bytes
+   Note: it is a CRE for buf not to hold a complete image */
+size_t Comp_img_seal_if(uint8_t *buf, size_t len, bool seal);
+
+/* checks the image in buf[0..len) against its trailer and sets *trailer to
+   the trailer's offset (0 if it has none). Returns false if buf is not a 
+   complete image or its trailer is missing (where the header promises one)
+   or does not match
+   Note: it is a CRE for trailer to be NULL */
+bool Comp_img_verify(const uint8_t *buf, size_t len, size_t *trailer);
+
+/* recomputes the trailer of the image in buf[0..len), if it has one, after
+   its words were changed in place, and returns the trailer's offset (0 if
+   it has none) */
+size_t Comp_img_reseal(uint8_t *buf, size_t len);
+
+/* returns the offset of the trailer of the image in buf[0..len), without
+   checking it, or 0 if the image has none */
+size_t Comp_img_trailer_offset(const uint8_t *buf, size_t len);
+
+/* parses the header of the compressed image in buf[0..len) into *width and
+   *height, and the offset of its first word into *words_offset. Returns 
+   false unless buf holds a well-formed header and all of the image's words
+   Note: it is a CRE for width, height or words_offset to be NULL */
+bool Comp_img_parse_header(const uint8_t *buf, size_t len, unsigned *width,
+                           unsigned *height, size_t *words_offset);
+
+/* like Comp_img_parse_header, for a format 3 image; its words are 
+   little-endian */
+bool Comp_img_parse_binary_header(const uint8_t *buf, size_t len, 
+                                  unsigned *width, unsigned *height, 
+                                  size_t *words_offset);
+
+/* like Comp_img_parse_header, for an image in format 2 or 3; *binary is set
+   to true for format 3, whose words are little-endian, and false for 
+   format 2, whose words are big-endian
+   Note: it is a CRE for any of the out parameters to be NULL */
+bool Comp_img_locate(const uint8_t *buf, size_t len, unsigned *width, 
+                     unsigned *height, size_t *words_offset, bool *binary);
+
+/* creates a new Comp_img, owned by the provided arena (or the heap if arena
+   is NULL), from the len bytes at buf, in format 2 or 3. Returns NULL if 
+   buf does not hold a complete compressed image or its trailer does not
+   match */
+Comp_img Comp_img_parse_in(Img_arena arena, const uint8_t *buf, size_t len);
+
+/* like Comp_img_parse_in, but a format 3 image whose words can be used in 
+   place (a little-endian host, 4-byte aligned words) is not copied: the 
+   new Comp_img's words are buf's. Such an image must not be written, and 
+   buf must outlive it */
+Comp_img Comp_img_view_in(Img_arena arena, const uint8_t *buf, size_t len);
+
+/* creates a new width x height Comp_img (owned like Comp_img_parse_in) 
+   from just the blocks of the image in buf[0..len) that cover the 
+   rectangle whose top left pixel is (col, row). Returns NULL if buf is not 
+   a complete compressed image (format 2 or 3) or the rectangle is not 
+   block-aligned (all even) and inside it */
+Comp_img Comp_img_parse_region_in(Img_arena arena, const uint8_t *buf, 
+                                  size_t len, unsigned col, unsigned row, 
+                                  unsigned width, unsigned height);
+
 /* creates a new Comp_img using data read in from the provided file 
    Note: it is a CRE for fp to be NULL */
 Comp_img Comp_img_read(FILE *fp);
 
-/* frees all heap-allocated memory associated with the provided Comp_img 
+/* like Comp_img_read, but the new Comp_img is owned by the provided arena
+   (or the heap if arena is NULL) 
+   Note: it is a CRE for fp to be NULL */
+Comp_img Comp_img_read_in(Img_arena arena, FILE *fp);
+
+/* frees all heap-allocated memory associated with the provided Comp_img.
+   Arena-owned images are only forgotten; their memory goes back with the 
+   arena 
    Note: it is a CRE for imgp to be NULL */
 void Comp_img_free(Comp_img *imgp);
 
@@ -40,13 +172,23 @@ unsigned Comp_img_width(Comp_img img);
    Note: it is a CRE for img to be NULL */
 unsigned Comp_img_height(Comp_img img);
 
-/* returns a pointer to the first word in an image's comp_words sequence, 
-        removing it from comp_words 
+/* returns the image's word array: one word per 2x2 block, in row-major 
+   block order. The array may be read and rewritten in place, unless the
+   image came from Comp_img_view_in
    Note: it is a CRE for img to be NULL */
-uint32_t *Comp_img_get_next_word(Comp_img img);
+uint32_t *Comp_img_words(Comp_img img);
+
+/* marks every word of img as added, for callers that fill the array from
+   Comp_img_words directly instead of with Comp_img_add_word
+   Note: it is a CRE for img to be NULL */
+void Comp_img_set_full(Comp_img img);
+
+/* returns the next unread word in an image's comp_words array 
+   Note: it is a CRE for img to be NULL or to read past the last word */
+uint32_t Comp_img_get_next_word(Comp_img img);
 
-/* adds a pointer to a word to the end of an image's comp_words sequence 
-   Note: it is a CRE for img or wordp to be NULL */
-void Comp_img_add_word(Comp_img img, uint32_t *wordp);
+/* appends a word to the end of an image's comp_words array 
+   Note: it is a CRE for img to be NULL or for the array to be full */
+void Comp_img_add_word(Comp_img img, uint32_t word);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,74 @@
+/* comp_mosaic.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the implementation of compressed-domain mosaics. Every word 
+ *  codes its own block, so a tile placed on the 2x2 block grid is just its
+ *  rows of words copied into the canvas's rows. The canvas is built one 
+ *  block row at a time: the row is filled with the fill word and then each
+ *  tile's span on it is copied over it with memcpy while the row is still
+ *  in cache, so the work is proportional to the size of the canvas. Tiles
+ *  in format 3 have their words byte swapped as they are copied.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assert.h"
+#include "comp_mosaic.h"
+#include "codeword.h"
+
+
+/* Comp_mosaic
+ * Purpose:     Builds a canvas of words from tiles and a fill word
+ * Parameters:  uint8_t *words: the canvas's first word
+ *              unsigned width, height: the canvas's size in pixels
+ *              const Comp_tile *tiles, unsigned ntiles: the tiles, in the 
+ *                  order they are laid down
+ *              uint32_t fill: the word for blocks no tile covers
+ * Note:        It is a CRE for words to be NULL, for tiles to be NULL 
+ *                  while ntiles > 0, or for a tile's x or y to be odd
+ */
+void Comp_mosaic(uint8_t *words, unsigned width, unsigned height,
+                 const Comp_tile *tiles, unsigned ntiles, uint32_t fill)
+{
+    assert(words != NULL && (tiles != NULL || ntiles == 0));
+
+    size_t bw = width / 2, bh = height / 2;
+    uint8_t fill_bytes[4] = { fill >> 24, fill >> 16, fill >> 8, fill };
+
+    for (unsigned t = 0; t < ntiles; t++) {
+        assert(tiles[t].x % 2 == 0 && tiles[t].y % 2 == 0);
+    }
+
+    for (size_t row = 0; row < bh; row++) {
+        uint8_t *out = words + row * bw * 4;
+
+        /* fill the row by doubling the filled prefix */
+        memcpy(out, fill_bytes, bw > 0 ? 4 : 0);
+        for (size_t done = 1; done < bw; done *= 2) {
+            memcpy(out + done * 4, out, 
+                   (done < bw - done ? done : bw - done) * 4);
+        }
+
+        for (unsigned t = 0; t < ntiles; t++) {
+            const Comp_tile *tile = &tiles[t];
+            size_t tx = tile->x / 2, ty = tile->y / 2;
+            size_t tw = tile->width / 2, th = tile->height / 2;
+            if (row < ty || row - ty >= th || tx >= bw) {
+                continue;
+            }
+
+            size_t cols = tw < bw - tx ? tw : bw - tx;
+            const uint8_t *in = tile->words + (row - ty) * tw * 4;
+            if (!tile->little) {
+                memcpy(out + tx * 4, in, cols * 4);
+                continue;
+            }
+            for (size_t col = 0; col < cols; col++) {
+                Codeword_store(out + (tx + col) * 4, 
+                               Codeword_load(in + col * 4, true), false);
+            }
+        }
+    }
+}
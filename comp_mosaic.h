@@ -0,0 +1,42 @@
+/* comp_mosaic.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the interface for laying out several compressed images on one
+ *  compressed canvas by copying rows of their codewords
+ */
+
+#ifndef COMP_MOSAIC_H
+#define COMP_MOSAIC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/* Comp_tile
+ * Members:     words:          the tile's first word
+ *              little:         true if its words are little-endian 
+ *                                  (format 3), false if big-endian 
+ *                                  (format 2)
+ *              width, height:  the tile's size in pixels
+ *              x, y:           where its top left pixel goes on the canvas
+ *                                  (both even)
+ */
+typedef struct Comp_tile {
+    const uint8_t *words;
+    bool little;
+    unsigned width, height;
+    unsigned x, y;
+} Comp_tile;
+
+
+/* fills the width x height canvas of big-endian words at words with the 
+    ntiles tiles, later tiles covering earlier ones, and every block no 
+    tile covers with fill. Parts of tiles off the canvas are dropped
+    Note: it is a CRE for words to be NULL, for tiles to be NULL while 
+          ntiles > 0, or for a tile's x or y to be odd */
+void Comp_mosaic(uint8_t *words, unsigned width, unsigned height,
+                 const Comp_tile *tiles, unsigned ntiles, uint32_t fill);
+
+#endif
@@ -0,0 +1,124 @@
+/* comp_preview.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 4/27/2021
+ *
+ * Contains the implementation of preview decoding. At 1/2 scale each output
+ *  pixel is one block's a, Pb and Pr; at 1/4 scale (and smaller) it is the
+ *  mean of a square group of blocks. The b, c and d gradients average out 
+ *  to zero over a block, so they never need to be read.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "assert.h"
+#include "comp_preview.h"
+#include "codeword.h"
+#include "rgb_to_xyz.h"
+
+
+/* helper function declarations */
+void preview_pixel(const uint32_t *words, unsigned blocks_per_row, 
+                   unsigned cols, unsigned rows, const float *chroma, 
+                   uint8_t *out);
+
+
+/* Comp_preview_size
+ * Purpose:     Computes the size of an image's preview
+ * Parameters:  Comp_img img: the compressed image
+ *              unsigned shrink: the scale divisor (2 for half size)
+ *              unsigned *width, *height: set to the preview's size
+ * Note:        It is a CRE for img to be NULL, or for shrink to be odd or
+ *                  < 2
+ */
+void Comp_preview_size(Comp_img img, unsigned shrink, unsigned *width,
+                       unsigned *height)
+{
+    assert(img != NULL);
+    assert(shrink >= 2 && shrink % 2 == 0);
+    assert(width != NULL && height != NULL);
+
+    *width = (Comp_img_width(img) + shrink - 1) / shrink;
+    *height = (Comp_img_height(img) + shrink - 1) / shrink;
+}
+
+
+/* Comp_preview
+ * Purpose:     Writes an image's preview as a raw P6 raster, straight from
+ *                  its codewords
+ * Parameters:  Comp_img img: the compressed image
+ *              unsigned shrink: the scale divisor (2 for half size)
+ *              uint8_t *raster: where to write the preview's pixels
+ * Note:        It is a CRE for img or raster to be NULL, or for shrink to 
+ *                  be odd or < 2
+ *              Groups along the right and bottom edges may be cut short
+ *                  by the image's edge; they average the blocks they have
+ */
+void Comp_preview(Comp_img img, unsigned shrink, uint8_t *raster)
+{
+    assert(raster != NULL);
+
+    unsigned width, height;
+    Comp_preview_size(img, shrink, &width, &height);
+
+    /* decode the 16 chroma indices once instead of once per word */
+    float chroma[CODEWORD_PBPR_MAX + 1];
+    for (int i = 0; i <= CODEWORD_PBPR_MAX; i++) {
+        chroma[i] = Codeword_chroma(i);
+    }
+
+    unsigned group = shrink / 2;
+    unsigned blocks_per_row = Comp_img_width(img) / 2;
+    unsigned block_rows = Comp_img_height(img) / 2;
+    const uint32_t *words = Comp_img_words(img);
+
+    for (unsigned row = 0; row < height; row++) {
+        unsigned blk_row = row * group;
+        unsigned rows = block_rows - blk_row < group ? 
+                        block_rows - blk_row : group;
+
+        for (unsigned col = 0; col < width; col++) {
+            unsigned blk_col = col * group;
+            unsigned cols = blocks_per_row - blk_col < group ? 
+                            blocks_per_row - blk_col : group;
+
+            preview_pixel(words + (size_t) blk_row * blocks_per_row + 
+                          blk_col, blocks_per_row, cols, rows, chroma, 
+                          raster);
+            raster += 3;
+        }
+    }
+}
+
+
+/* preview_pixel
+ * Purpose:     Averages the a, Pb and Pr of a cols x rows group of words 
+ *                  and writes the resulting RGB pixel
+ * Parameters:  const uint32_t *words: the group's top left word
+ *              unsigned blocks_per_row: the stride between rows of words
+ *              unsigned cols, rows: the size of the group in blocks
+ *              const float *chroma: the chroma value of each index
+ *              uint8_t *out: where to write the pixel's 3 samples
+ */
+void preview_pixel(const uint32_t *words, unsigned blocks_per_row, 
+                   unsigned cols, unsigned rows, const float *chroma, 
+                   uint8_t *out)
+{
+    int a_sum = 0;
+    float pb_sum = 0, pr_sum = 0;
+
+    for (unsigned j = 0; j < rows; j++) {
+        for (unsigned i = 0; i < cols; i++) {
+            Codeword cw = Codeword_unpack(words[j * blocks_per_row + i]);
+            a_sum += cw.a;
+            pb_sum += chroma[cw.pb];
+            pr_sum += chroma[cw.pr];
+        }
+    }
+
+    unsigned n = cols * rows;
+    XYZ_pix pix = { Codeword_luma(a_sum) / n, pb_sum / n, pr_sum / n };
+    struct Pnm_rgb rgb = xyz_to_rgb(pix, 255);
+    out[0] = rgb.red;
+    out[1] = rgb.green;
+    out[2] = rgb.blue;
+}
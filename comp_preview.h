@@ -0,0 +1,30 @@
+/* comp_preview.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 4/27/2021
+ *
+ * Contains the interface for reduced-resolution preview decoding, which 
+ *  rebuilds one pixel per block (or per group of blocks) from the mean luma
+ *  and chroma every codeword carries, with no inverse Haar transform
+ */
+
+#ifndef COMP_PREVIEW_H
+#define COMP_PREVIEW_H
+
+#include <stdint.h>
+#include "comp_img.h"
+
+
+/* sets *width and *height to the size of img's preview at 1/shrink scale:
+    the image's size divided by shrink, rounded up
+    Note: it is a CRE for img to be NULL, or for shrink to be odd or < 2 */
+void Comp_preview_size(Comp_img img, unsigned shrink, unsigned *width,
+                       unsigned *height);
+
+/* writes img's preview at 1/shrink scale into raster as a raw P6 raster
+    with maxval 255. raster must hold 3 * width * height bytes for the size
+    Comp_preview_size gives
+    Note: it is a CRE for img or raster to be NULL, or for shrink to be odd
+          or < 2 */
+void Comp_preview(Comp_img img, unsigned shrink, uint8_t *raster);
+
+#endif
@@ -0,0 +1,452 @@
+/* comp_profile.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the implementation of quantization profiles. Every profile's
+ *  quantizer is the same inline function, profile_pack (and its inverse
+ *  profile_unpack), but each profile gets its own copy of the per-block
+ *  coder from PROFILE_KERNELS with its field widths and scales as
+ *  constants, so the compiler folds them into shifts, masks and multiplies
+ *  and choosing a profile costs nothing per block. The standard profile
+ *  quantizes exactly as abcd_to_word.c does (rounding down, Arith40 chroma
+ *  indices), so its blocks are the words of format 2; the others round to
+ *  nearest, and those with 4-bit chroma also use the Arith40 indices.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <arith40.h>
+#include "assert.h"
+#include "comp_profile.h"
+#include "xyz_to_abcd.h"
+#include "crc32c.h"
+
+
+#define PROFILE_MAGIC "COMP40 Profile image format 1\n"
+
+/* enough room for PROFILE_MAGIC, a profile name and two 10-digit
+   dimensions */
+#define PROFILE_HEADER_MAX 80
+
+/* the optional checksum trailer */
+#define PROFILE_TRAILER_TAG "C32C"
+#define PROFILE_TRAILER_SIZE 8
+
+
+/* struct Comp_profile
+ * Members:     name:   what the profile is called in headers and on the
+ *                          command line
+ *              bits:   the bits spent on each block, a multiple of 8
+ *              encode: xyz_map_blocks function that packs one block and
+ *                          stores it at the uint8_t * its closure points
+ *                          to, moving it past the block
+ *              decode: xyz_from_blocks_in function that loads and unpacks
+ *                          one block the same way
+ */
+struct Comp_profile {
+    const char *name;
+    unsigned bits;
+    void (*encode)(float *abc_val, void *cl);
+    void (*decode)(float *abc_val, void *cl);
+};
+
+
+/* helper function declarations */
+static inline uint64_t profile_pack(const float *abc_val, unsigned a_bits,
+                                    unsigned bcd_bits, float bcd_scale,
+                                    unsigned pbpr_bits, float round);
+static inline void profile_unpack(uint64_t word, float *abc_val,
+                                  unsigned a_bits, unsigned bcd_bits,
+                                  float bcd_scale, unsigned pbpr_bits);
+static inline int64_t profile_quantize(float n, float low, float hi);
+static inline void profile_store(uint8_t *p, uint64_t word, unsigned bytes);
+static inline uint64_t profile_load(const uint8_t *p, unsigned bytes);
+bool profile_parse(const uint8_t *buf, size_t len,
+                   const Comp_profile **profile, unsigned *width,
+                   unsigned *height, const uint8_t **blocks);
+bool profile_check_trailer(const uint8_t *buf, size_t len, size_t end,
+                           size_t *trailer);
+
+
+/* PROFILE_KERNELS
+ * Purpose:     Defines encode_<name> and decode_<name>, the block coders of
+ *                  one profile, with its layout compiled in
+ * Parameters:  name: the profile's name
+ *              a_bits: the width of a, which is scaled by 2^a_bits - 1
+ *              bcd_bits: the width of each of b, c and d (signed)
+ *              bcd_scale: what b, c and d are multiplied by
+ *              pbpr_bits: the width of each of Pb and Pr
+ *              round: 0 to round down (as abcd_to_word.c does) or 0.5 to
+ *                  round to nearest
+ */
+#define PROFILE_KERNELS(name, a_bits, bcd_bits, bcd_scale, pbpr_bits,       \
+                        round)                                              \
+static void encode_##name(float *abc_val, void *cl)                         \
+{                                                                           \
+    uint8_t **p = cl;                                                       \
+    profile_store(*p, profile_pack(abc_val, a_bits, bcd_bits, bcd_scale,    \
+                                   pbpr_bits, round),                       \
+                  (a_bits + 3 * bcd_bits + 2 * pbpr_bits) / 8);             \
+    *p += (a_bits + 3 * bcd_bits + 2 * pbpr_bits) / 8;                      \
+}                                                                           \
+                                                                            \
+static void decode_##name(float *abc_val, void *cl)                         \
+{                                                                           \
+    const uint8_t **p = cl;                                                 \
+    profile_unpack(profile_load(*p, (a_bits + 3 * bcd_bits +                \
+                                     2 * pbpr_bits) / 8),                   \
+                   abc_val, a_bits, bcd_bits, bcd_scale, pbpr_bits);        \
+    *p += (a_bits + 3 * bcd_bits + 2 * pbpr_bits) / 8;                      \
+}
+
+PROFILE_KERNELS(tiny,      6,  2,    3.0, 2, 0.5)
+PROFILE_KERNELS(small,     7,  3,   10.0, 4, 0.5)
+PROFILE_KERNELS(standard,  9,  5,   50.0, 4, 0.0)
+PROFILE_KERNELS(high,     12,  8,  254.0, 6, 0.5)
+PROFILE_KERNELS(max,      16, 10, 1022.0, 9, 0.5)
+
+static const Comp_profile profiles[] = {
+    { "tiny",     16, encode_tiny,     decode_tiny },
+    { "small",    24, encode_small,    decode_small },
+    { "standard", 32, encode_standard, decode_standard },
+    { "high",     48, encode_high,     decode_high },
+    { "max",      64, encode_max,      decode_max }
+};
+
+
+/* Comp_profile_named
+ * Purpose:     returns the profile called name, or NULL if there is none
+ */
+const Comp_profile *Comp_profile_named(const char *name)
+{
+    for (size_t i = 0; name != NULL &&
+                       i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+        if (strcmp(profiles[i].name, name) == 0) {
+            return &profiles[i];
+        }
+    }
+    return NULL;
+}
+
+
+/* Comp_profile_name
+ * Purpose:     returns the name of a profile
+ */
+const char *Comp_profile_name(const Comp_profile *profile)
+{
+    assert(profile != NULL);
+    return profile->name;
+}
+
+
+/* Comp_profile_bits
+ * Purpose:     returns the bits a profile spends on each block
+ */
+unsigned Comp_profile_bits(const Comp_profile *profile)
+{
+    assert(profile != NULL);
+    return profile->bits;
+}
+
+
+/* Comp_profile_is
+ * Purpose:     returns true if buf begins with the profile format's magic
+ */
+bool Comp_profile_is(const uint8_t *buf, size_t len)
+{
+    size_t magic_len = strlen(PROFILE_MAGIC);
+    return buf != NULL && len >= magic_len &&
+           memcmp(buf, PROFILE_MAGIC, magic_len) == 0;
+}
+
+
+/* Comp_profile_size
+ * Purpose:     returns the size of a width x height image coded with a
+ *                  profile
+ */
+size_t Comp_profile_size(const Comp_profile *profile, unsigned width,
+                         unsigned height)
+{
+    assert(profile != NULL);
+    return snprintf(NULL, 0, PROFILE_MAGIC "%s %u %u\n", profile->name,
+                    width, height) +
+           (size_t) (width / 2) * (height / 2) * (profile->bits / 8);
+}
+
+
+/* Comp_profile_encode
+ * Purpose:     Codes an XYZ_img with a profile
+ * Parameters:  const Comp_profile *profile: the profile
+ *              XYZ_img img: the image
+ *              uint8_t *out: where to write the coded image; must hold
+ *                  Comp_profile_size bytes
+ * Returns:     size_t: the number of bytes written
+ * Note:        It is a CRE for profile, img or out to be NULL
+ */
+size_t Comp_profile_encode(const Comp_profile *profile, XYZ_img img,
+                           uint8_t *out)
+{
+    assert(profile != NULL && img != NULL && out != NULL);
+
+    uint8_t *p = out + snprintf((char *) out, PROFILE_HEADER_MAX,
+                                PROFILE_MAGIC "%s %u %u\n", profile->name,
+                                XYZ_img_width(img), XYZ_img_height(img));
+    xyz_map_blocks(img, profile->encode, &p);
+    return p - out;
+}
+
+
+/* Comp_profile_parse_header
+ * Purpose:     Reads the profile and size of a profile image
+ * Parameters:  const uint8_t *buf, size_t len: the profile image
+ *              const Comp_profile **profile: set to its profile
+ *              unsigned *width, *height: set to its size in pixels
+ * Returns:     bool: false unless buf holds a complete profile image
+ * Note:        It is a CRE for profile, width or height to be NULL
+ */
+bool Comp_profile_parse_header(const uint8_t *buf, size_t len,
+                               const Comp_profile **profile, unsigned *width,
+                               unsigned *height)
+{
+    assert(profile != NULL && width != NULL && height != NULL);
+
+    const uint8_t *blocks;
+    return profile_parse(buf, len, profile, width, height, &blocks);
+}
+
+
+/* Comp_profile_seal
+ * Purpose:     Ends a profile image with its checksum trailer
+ * Parameters:  uint8_t *buf: the image, with room for the trailer after it
+ *              size_t len: the length of the image, as Comp_profile_encode
+ *                  returned it
+ * Returns:     size_t: the length of the image with its trailer
+ * Note:        It is a CRE for buf to be NULL
+ */
+size_t Comp_profile_seal(uint8_t *buf, size_t len)
+{
+    assert(buf != NULL);
+
+    memcpy(buf + len, PROFILE_TRAILER_TAG, 4);
+    profile_store(buf + len + 4, Crc32c_update(0, buf, len), 4);
+    return len + PROFILE_TRAILER_SIZE;
+}
+
+
+/* Comp_profile_verify
+ * Purpose:     Checks a profile image against its checksum trailer without
+ *                  decoding it
+ * Parameters:  const uint8_t *buf, size_t len: the profile image
+ *              size_t *trailer: set to the offset of the trailer, or to 0
+ *                  if the image has none
+ * Returns:     bool: false if buf is not a complete profile image or its 
+ *                  trailer does not match
+ * Note:        It is a CRE for trailer to be NULL
+ */
+bool Comp_profile_verify(const uint8_t *buf, size_t len, size_t *trailer)
+{
+    assert(trailer != NULL);
+
+    const Comp_profile *profile;
+    unsigned width, height;
+    const uint8_t *blocks;
+    *trailer = 0;
+    if (!profile_parse(buf, len, &profile, &width, &height, &blocks)) {
+        return false;
+    }
+    size_t end = blocks - buf + (size_t) (width / 2) * (height / 2) * 
+                                (profile->bits / 8);
+    return profile_check_trailer(buf, len, end, trailer);
+}
+
+
+/* Comp_profile_decode_in
+ * Purpose:     Decodes a profile image into an XYZ_img
+ * Parameters:  Img_arena arena: the arena to own the image, or NULL
+ *              const uint8_t *buf, size_t len: the profile image
+ * Returns:     XYZ_img: the decoded image, or NULL if buf does not hold a
+ *                  complete profile image or its trailer does not match
+ */
+XYZ_img Comp_profile_decode_in(Img_arena arena, const uint8_t *buf,
+                               size_t len)
+{
+    const Comp_profile *profile;
+    unsigned width, height;
+    const uint8_t *p;
+    size_t trailer;
+    if (!profile_parse(buf, len, &profile, &width, &height, &p) ||
+        !profile_check_trailer(buf, len, p - buf + (size_t) (width / 2) * 
+                               (height / 2) * (profile->bits / 8), 
+                               &trailer)) {
+        return NULL;
+    }
+
+    return xyz_from_blocks_in(arena, width, height, profile->decode, &p);
+}
+
+
+/* profile_parse
+ * Purpose:     Parses and checks a profile image
+ * Parameters:  const uint8_t *buf, size_t len: the profile image
+ *              const Comp_profile **profile: set to its profile
+ *              unsigned *width, *height: set to its size in pixels
+ *              const uint8_t **blocks: set to its first block
+ * Returns:     bool: false unless the header is well formed, names a known
+ *                  profile, and buf holds all of the blocks
+ */
+bool profile_parse(const uint8_t *buf, size_t len,
+                   const Comp_profile **profile, unsigned *width,
+                   unsigned *height, const uint8_t **blocks)
+{
+    if (!Comp_profile_is(buf, len)) {
+        return false;
+    }
+
+    /* parse "<profile> <width> <height>\n" from a bounded copy of the
+       header line */
+    size_t magic_len = strlen(PROFILE_MAGIC);
+    char line[PROFILE_HEADER_MAX];
+    size_t line_len = len - magic_len < sizeof(line) - 1 ?
+                      len - magic_len : sizeof(line) - 1;
+    memcpy(line, buf + magic_len, line_len);
+    line[line_len] = '\0';
+
+    char name[16];
+    int consumed = 0;
+    if (sscanf(line, "%15s %u %u%n", name, width, height, &consumed) != 3 ||
+        (size_t) consumed >= line_len || line[consumed] != '\n' ||
+        *width < 2 || *height < 2 || *width % 2 != 0 || *height % 2 != 0) {
+        return false;
+    }
+    *profile = Comp_profile_named(name);
+    if (*profile == NULL) {
+        return false;
+    }
+
+    *blocks = buf + magic_len + consumed + 1;
+    size_t left = len - (*blocks - buf);
+    return left / ((*profile)->bits / 8) >=
+           (size_t) (*width / 2) * (*height / 2);
+}
+
+
+/* profile_check_trailer
+ * Purpose:     Checks the trailer, if there is one, of the profile image 
+ *                  whose last block ends at buf + end
+ * Parameters:  const uint8_t *buf, size_t len: the profile image
+ *              size_t end: the offset just past its last block
+ *              size_t *trailer: set to the offset of the trailer, or to 0
+ *                  if the image has none
+ * Returns:     bool: false if the trailer does not match
+ */
+bool profile_check_trailer(const uint8_t *buf, size_t len, size_t end,
+                           size_t *trailer)
+{
+    *trailer = 0;
+    if (len - end < PROFILE_TRAILER_SIZE ||
+        memcmp(buf + end, PROFILE_TRAILER_TAG, 4) != 0) {
+        return true;
+    }
+    *trailer = end;
+    return profile_load(buf + end + 4, 4) == Crc32c_update(0, buf, end);
+}
+
+
+/* profile_pack
+ * Purpose:     Quantizes a block's [a, b, c, d, Pb_avg, Pr_avg] and packs
+ *                  them, a first, into the low bits of a word
+ * Parameters:  const float *abc_val: the block's values
+ *              the rest: the profile's layout, as in PROFILE_KERNELS
+ * Returns:     uint64_t: the packed block
+ */
+static inline uint64_t profile_pack(const float *abc_val, unsigned a_bits,
+                                    unsigned bcd_bits, float bcd_scale,
+                                    unsigned pbpr_bits, float round)
+{
+    float a_max = (1u << a_bits) - 1;
+    float bcd_max = (1u << (bcd_bits - 1)) - 1;
+    float pbpr_max = (1u << pbpr_bits) - 1;
+
+    uint64_t word = profile_quantize(abc_val[0] * a_max + round, 0, a_max);
+    for (int i = 1; i < 4; i++) {
+        int64_t n = profile_quantize(abc_val[i] * bcd_scale + round,
+                                     -bcd_max, bcd_max);
+        word = word << bcd_bits | ((uint64_t) n & ((1u << bcd_bits) - 1));
+    }
+    for (int i = 4; i < 6; i++) {
+        uint64_t index = pbpr_bits == 4 ?
+                         Arith40_index_of_chroma(abc_val[i]) :
+                         (uint64_t) profile_quantize((abc_val[i] + 0.5) *
+                                                     pbpr_max + round,
+                                                     0, pbpr_max);
+        word = word << pbpr_bits | index;
+    }
+    return word;
+}
+
+
+/* profile_unpack
+ * Purpose:     Unpacks and unscales a block packed by profile_pack
+ * Parameters:  uint64_t word: the packed block
+ *              float *abc_val: filled with [a, b, c, d, Pb_avg, Pr_avg]
+ *              the rest: the profile's layout, as in PROFILE_KERNELS
+ */
+static inline void profile_unpack(uint64_t word, float *abc_val,
+                                  unsigned a_bits, unsigned bcd_bits,
+                                  float bcd_scale, unsigned pbpr_bits)
+{
+    unsigned pbpr_max = (1u << pbpr_bits) - 1;
+    for (int i = 5; i >= 4; i--) {
+        unsigned index = word & pbpr_max;
+        word >>= pbpr_bits;
+        abc_val[i] = pbpr_bits == 4 ? Arith40_chroma_of_index(index) :
+                     (float) index / pbpr_max - 0.5;
+    }
+
+    /* shift each signed field to the top of an int64_t to extend its sign */
+    for (int i = 3; i >= 1; i--) {
+        int64_t n = (int64_t) (word << (64 - bcd_bits)) >> (64 - bcd_bits);
+        word >>= bcd_bits;
+        abc_val[i] = n / bcd_scale;
+    }
+
+    abc_val[0] = (word & ((1u << a_bits) - 1)) /
+                 (double) ((1u << a_bits) - 1);
+}
+
+
+/* profile_quantize
+ * Purpose:     returns n clamped to [low, hi] and rounded down
+ */
+static inline int64_t profile_quantize(float n, float low, float hi)
+{
+    n = n < low ? low : n > hi ? hi : n;
+    return (int64_t) floorf(n);
+}
+
+
+/* profile_store
+ * Purpose:     writes the low bytes * 8 bits of word at p, big-endian
+ */
+static inline void profile_store(uint8_t *p, uint64_t word, unsigned bytes)
+{
+    for (unsigned i = bytes; i > 0; i--) {
+        p[i - 1] = word;
+        word >>= 8;
+    }
+}
+
+
+/* profile_load
+ * Purpose:     returns the big-endian integer of the provided size at p
+ */
+static inline uint64_t profile_load(const uint8_t *p, unsigned bytes)
+{
+    uint64_t word = 0;
+    for (unsigned i = 0; i < bytes; i++) {
+        word = word << 8 | p[i];
+    }
+    return word;
+}
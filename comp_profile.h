@@ -0,0 +1,92 @@
+/* comp_profile.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the interface for quantization profiles, which trade quality
+ *  for bytes by spending more or fewer bits on each block's fields:
+ *
+ *      name        bits    a   b, c, d  Pb, Pr
+ *      tiny        16      6   2        2
+ *      small       24      7   3        4
+ *      standard    32      9   5        4       (the fields of format 2)
+ *      high        48      12  8        6
+ *      max         64      16  10       9
+ *
+ *  An image coded with a profile is stored as
+ *
+ *      "COMP40 Profile image format 1\n<profile> <width> <height>\n"
+ *      uint8_t blocks[width / 2 * height / 2][bits / 8]
+ *
+ *  with each block's fields packed like a codeword's (a in the top bits,
+ *  Pr in the bottom ones), big-endian. Like format 2, the image may end in 
+ *  a trailer right after its last block: "C32C", then the CRC-32C of 
+ *  everything before the trailer, big-endian
+ */
+
+#ifndef COMP_PROFILE_H
+#define COMP_PROFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "xyz_img.h"
+#include "img_arena.h"
+
+
+typedef struct Comp_profile Comp_profile;
+
+
+/* returns the profile with the provided name, or NULL if there is none */
+const Comp_profile *Comp_profile_named(const char *name);
+
+/* returns the name of the provided profile
+    Note: it is a CRE for profile to be NULL */
+const char *Comp_profile_name(const Comp_profile *profile);
+
+/* returns the number of bits the provided profile spends on each block
+    Note: it is a CRE for profile to be NULL */
+unsigned Comp_profile_bits(const Comp_profile *profile);
+
+/* returns true if buf[0..len) begins with the profile format's magic */
+bool Comp_profile_is(const uint8_t *buf, size_t len);
+
+/* returns the number of bytes of an image of the provided (even) size coded
+    with the provided profile
+    Note: it is a CRE for profile to be NULL */
+size_t Comp_profile_size(const Comp_profile *profile, unsigned width,
+                         unsigned height);
+
+/* codes img with the provided profile into out, which must hold
+    Comp_profile_size bytes for img's size. Returns the number of bytes
+    written
+    Note: it is a CRE for profile, img or out to be NULL */
+size_t Comp_profile_encode(const Comp_profile *profile, XYZ_img img,
+                           uint8_t *out);
+
+/* appends a checksum trailer to the profile image in buf[0..len), which 
+    must have room for 8 more bytes, and returns the new length
+    Note: it is a CRE for buf to be NULL */
+size_t Comp_profile_seal(uint8_t *buf, size_t len);
+
+/* checks the profile image in buf[0..len) against its trailer and sets 
+    *trailer to the trailer's offset (0 if it has none). Returns false if 
+    buf is not a complete profile image or its trailer does not match
+    Note: it is a CRE for trailer to be NULL */
+bool Comp_profile_verify(const uint8_t *buf, size_t len, size_t *trailer);
+
+/* parses the header of the profile image in buf[0..len) into *profile,
+    *width and *height. Returns false unless buf holds a well-formed header
+    naming a known profile and all of the image's blocks
+    Note: it is a CRE for profile, width or height to be NULL */
+bool Comp_profile_parse_header(const uint8_t *buf, size_t len,
+                               const Comp_profile **profile, unsigned *width,
+                               unsigned *height);
+
+/* decodes the profile image in buf[0..len) into a new XYZ_img owned by the
+    provided arena (or the heap if arena is NULL). Returns NULL unless
+    Comp_profile_parse_header accepts buf and its trailer, if it has one,
+    matches */
+XYZ_img Comp_profile_decode_in(Img_arena arena, const uint8_t *buf,
+                               size_t len);
+
+#endif
@@ -0,0 +1,117 @@
+/* comp_scale.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 4/28/2021
+ *
+ * Contains the implementation of compressed-domain downscaling. A pixel of
+ *  the half-size image is the mean of one old block, which is that block's
+ *  a. A 2x2 group of old blocks therefore becomes one new block whose four
+ *  pixels are the four old a values. The new a, b, c and d come from those 
+ *  four values exactly as do_compression_math computes them from pixels, 
+ *  and the new chroma is the mean of the four old chroma values.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <arith40.h>
+#include "assert.h"
+#include "codeword.h"
+#include "comp_scale.h"
+#include "math_funs.h"
+
+
+/* helper function declarations */
+uint32_t merge_words(const uint32_t *top, const uint32_t *bottom, 
+                     const float *chroma);
+int scale_gradient(float gradient);
+
+
+/* Comp_img_downscale_in
+ * Purpose:     Halves a compressed image's width and height, working only 
+ *                  on its codewords
+ * Parameters:  Img_arena arena: the arena to own the new image, or NULL to
+ *                  allocate it on the heap
+ *              Comp_img img: the image to downscale
+ * Returns:     Comp_img: the half-size image, or NULL if img is smaller 
+ *                  than 4x4 pixels
+ * Note:        It is a CRE for img to be NULL
+ */
+Comp_img Comp_img_downscale_in(Img_arena arena, Comp_img img)
+{
+    assert(img != NULL);
+
+    unsigned cols = Comp_img_width(img) / 2, rows = Comp_img_height(img) / 2;
+    unsigned new_cols = cols / 2, new_rows = rows / 2;
+    if (new_cols == 0 || new_rows == 0) {
+        return NULL;
+    }
+    Comp_img result = Comp_img_new_in(arena, new_cols * 2, new_rows * 2);
+
+    /* decode the 16 chroma indices once instead of once per word */
+    float chroma[CODEWORD_PBPR_MAX + 1];
+    for (int i = 0; i <= CODEWORD_PBPR_MAX; i++) {
+        chroma[i] = Codeword_chroma(i);
+    }
+
+    const uint32_t *src = Comp_img_words(img);
+    uint32_t *dst = Comp_img_words(result);
+
+    for (unsigned row = 0; row < new_rows; row++) {
+        const uint32_t *top = src + (size_t) 2 * row * cols;
+        const uint32_t *bottom = top + cols;
+        for (unsigned col = 0; col < new_cols; col++) {
+            *dst++ = merge_words(top + 2 * col, bottom + 2 * col, chroma);
+        }
+    }
+    Comp_img_set_full(result);
+
+    return result;
+}
+
+
+/* merge_words
+ * Purpose:     Builds the word for one new block out of a 2x2 group of 
+ *                  old words
+ * Parameters:  const uint32_t *top: the group's top left and right words
+ *              const uint32_t *bottom: its bottom left and right words
+ *              const float *chroma: the chroma value of each index
+ * Returns:     uint32_t: the new block's word
+ */
+uint32_t merge_words(const uint32_t *top, const uint32_t *bottom, 
+                     const float *chroma)
+{
+    Codeword blk[4] = { 
+        Codeword_unpack(top[0]), Codeword_unpack(top[1]),
+        Codeword_unpack(bottom[0]), Codeword_unpack(bottom[1])
+    };
+
+    /* the new block's pixels, numbered as in do_compression_math */
+    float y1 = Codeword_luma(blk[0].a), y2 = Codeword_luma(blk[1].a);
+    float y3 = Codeword_luma(blk[2].a), y4 = Codeword_luma(blk[3].a);
+
+    float pb = 0, pr = 0;
+    for (int i = 0; i < 4; i++) {
+        pb += chroma[blk[i].pb];
+        pr += chroma[blk[i].pr];
+    }
+
+    Codeword cw;
+    cw.a = (blk[0].a + blk[1].a + blk[2].a + blk[3].a) / 4;
+    cw.b = scale_gradient((y4 + y3 - y2 - y1) / 4.0);
+    cw.c = scale_gradient((y4 - y3 + y2 - y1) / 4.0);
+    cw.d = scale_gradient((y4 - y3 - y2 + y1) / 4.0);
+    cw.pb = Arith40_index_of_chroma(pb / 4.0);
+    cw.pr = Arith40_index_of_chroma(pr / 4.0);
+
+    return Codeword_pack(cw);
+}
+
+
+/* scale_gradient
+ * Purpose:     quantizes a b, c or d value the way abcd_to_word.c does
+ */
+int scale_gradient(float gradient)
+{
+    return (int) floor(constrain(gradient * 50, -CODEWORD_BCD_MAX, 
+                                 CODEWORD_BCD_MAX));
+}
@@ -0,0 +1,22 @@
+/* comp_scale.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 4/28/2021
+ *
+ * Contains the interface for downscaling compressed images by 2 without 
+ *  decoding them
+ */
+
+#ifndef COMP_SCALE_H
+#define COMP_SCALE_H
+
+#include "comp_img.h"
+
+
+/* returns img at half its width and height as a new Comp_img owned by the
+    provided arena (or the heap if arena is NULL). Each 2x2 group of words
+    becomes one word; a block column or row left over at an odd edge is 
+    dropped. Returns NULL if img is smaller than 4x4 pixels
+    Note: it is a CRE for img to be NULL */
+Comp_img Comp_img_downscale_in(Img_arena arena, Comp_img img);
+
+#endif
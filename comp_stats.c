@@ -0,0 +1,210 @@
+/* comp_stats.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the implementation of compressed-domain statistics. A block's a 
+ *  is its mean luma and its Pb/Pr indices are its mean chroma, so the image
+ *  is summarized by three histograms over the words. The scan loads each
+ *  stored word whole, in its format's byte order, and masks those three 
+ *  fields out of it. Large images are split across a Thread_pool, each job
+ *  filling its own histograms, which are summed afterwards.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "assert.h"
+#include "mem.h"
+#include "comp_stats.h"
+#include "thread_pool.h"
+#include "rgb_to_xyz.h"
+
+
+/* images with fewer words than this are scanned on the calling thread */
+#define STATS_MIN_PARALLEL (1 << 18)
+
+/* a block is dark if its luma is below this */
+#define DARK_LUMA 0.15
+
+/* an image is mostly dark if at least this fraction of its blocks is */
+#define MOSTLY_DARK 0.9
+
+/* an image is blank if both its luma deviation and mean chroma magnitude 
+   are below this */
+#define BLANK_SPREAD 0.02
+
+
+/* struct Stats_job
+ * Members:     words, nwords: the words this job scans
+ *              little:        whether the words are little-endian
+ *              stats:         the job's own histograms
+ */
+struct Stats_job {
+    const uint8_t *words;
+    size_t nwords;
+    bool little;
+    Comp_stats stats;
+};
+
+
+/* helper function declarations */
+void stats_scan_range(void *jobp);
+
+
+/* Comp_stats_scan
+ * Purpose:     Builds the a, Pb and Pr histograms of a compressed image
+ * Parameters:  const uint8_t *words: the image's first stored word
+ *              bool little: true if the words are little-endian (format 3),
+ *                  false if big-endian (format 2)
+ *              unsigned width, height: the image's size in pixels
+ *              int nthreads: the number of threads, or < 1 for one per CPU
+ *              Comp_stats *stats: the statistics to fill
+ * Note:        It is a CRE for words or stats to be NULL
+ */
+void Comp_stats_scan(const uint8_t *words, bool little, unsigned width, 
+                     unsigned height, int nthreads, Comp_stats *stats)
+{
+    assert(words != NULL && stats != NULL);
+
+    size_t nwords = (size_t) (width / 2) * (height / 2);
+    struct Stats_job whole = { words, nwords, little, { 0 } };
+
+    if (nthreads == 1 || nwords < STATS_MIN_PARALLEL) {
+        stats_scan_range(&whole);
+    } else {
+        Thread_pool pool = Thread_pool_new(nthreads, NULL);
+        int njobs = Thread_pool_size(pool);
+        struct Stats_job *jobs = CALLOC(njobs, sizeof(*jobs));
+
+        size_t per_job = (nwords + njobs - 1) / njobs;
+        for (int i = 0; i < njobs; i++) {
+            size_t start = per_job * i < nwords ? per_job * i : nwords;
+            jobs[i].words = words + start * 4;
+            jobs[i].nwords = nwords - start < per_job ? nwords - start 
+                                                      : per_job;
+            jobs[i].little = little;
+            Thread_pool_submit(pool, i, stats_scan_range, &jobs[i]);
+        }
+        Thread_pool_free(&pool);
+
+        for (int i = 0; i < njobs; i++) {
+            for (int a = 0; a <= CODEWORD_A_MAX; a++) {
+                whole.stats.a_hist[a] += jobs[i].stats.a_hist[a];
+            }
+            for (int c = 0; c <= CODEWORD_PBPR_MAX; c++) {
+                whole.stats.pb_hist[c] += jobs[i].stats.pb_hist[c];
+                whole.stats.pr_hist[c] += jobs[i].stats.pr_hist[c];
+            }
+        }
+        FREE(jobs);
+    }
+
+    *stats = whole.stats;
+    stats->width = width;
+    stats->height = height;
+}
+
+
+/* Comp_stats_json
+ * Purpose:     Formats the statistics derived from an image's histograms 
+ *                  as a JSON object
+ * Parameters:  const Comp_stats *stats: the histograms
+ *              char *buf, size_t size: where to write, as with snprintf
+ * Returns:     size_t: the length of the whole JSON object
+ * Note:        It is a CRE for stats to be NULL
+ *              The luma histogram has 256 bins, each covering two values 
+ *                  of a
+ */
+size_t Comp_stats_json(const Comp_stats *stats, char *buf, size_t size)
+{
+    assert(stats != NULL);
+
+    uint64_t blocks = 0, dark = 0;
+    double a_sum = 0, a_sq_sum = 0;
+    int a_min = -1, a_max = 0;
+    for (int a = 0; a <= CODEWORD_A_MAX; a++) {
+        uint64_t n = stats->a_hist[a];
+        blocks += n;
+        a_sum += (double) n * a;
+        a_sq_sum += (double) n * a * a;
+        if (Codeword_luma(a) < DARK_LUMA) {
+            dark += n;
+        }
+        if (n > 0) {
+            a_min = a_min < 0 ? a : a_min;
+            a_max = a;
+        }
+    }
+
+    double pb = 0, pr = 0, chroma_mag = 0;
+    for (int c = 0; c <= CODEWORD_PBPR_MAX; c++) {
+        float value = Codeword_chroma(c);
+        pb += stats->pb_hist[c] * value;
+        pr += stats->pr_hist[c] * value;
+        chroma_mag += (stats->pb_hist[c] + stats->pr_hist[c]) * fabs(value);
+    }
+
+    double n = blocks > 0 ? blocks : 1;
+    double mean_a = a_sum / n;
+    double dev_a = sqrt(fmax(a_sq_sum / n - mean_a * mean_a, 0));
+    double mean_luma = mean_a / CODEWORD_A_MAX;
+    double dev_luma = dev_a / CODEWORD_A_MAX;
+    pb /= n;
+    pr /= n;
+    chroma_mag /= 2 * n;
+    double dark_fraction = dark / n;
+
+    XYZ_pix mean = { mean_luma, pb, pr };
+    struct Pnm_rgb rgb = xyz_to_rgb(mean, 255);
+
+    size_t len = snprintf(buf, size,
+        "{\"width\": %u, \"height\": %u, \"blocks\": %llu, "
+        "\"mean_luma\": %.4f, \"luma_stddev\": %.4f, "
+        "\"min_luma\": %.4f, \"max_luma\": %.4f, "
+        "\"mean_pb\": %.4f, \"mean_pr\": %.4f, \"chroma_magnitude\": %.4f, "
+        "\"mean_rgb\": [%u, %u, %u], \"dark_fraction\": %.4f, "
+        "\"mostly_dark\": %s, \"blank\": %s, \"luma_histogram\": [",
+        stats->width, stats->height, (unsigned long long) blocks, 
+        mean_luma, dev_luma, Codeword_luma(a_min < 0 ? 0 : a_min), 
+        Codeword_luma(a_max), pb, pr, chroma_mag, 
+        rgb.red, rgb.green, rgb.blue, dark_fraction, 
+        dark_fraction >= MOSTLY_DARK ? "true" : "false",
+        dev_luma < BLANK_SPREAD && chroma_mag < BLANK_SPREAD ? 
+            "true" : "false");
+
+    for (int bin = 0; bin < 256; bin++) {
+        len += snprintf(len < size ? buf + len : NULL, 
+                        len < size ? size - len : 0, "%s%llu", 
+                        bin > 0 ? ", " : "", 
+                        (unsigned long long) (stats->a_hist[2 * bin] + 
+                                              stats->a_hist[2 * bin + 1]));
+    }
+    len += snprintf(len < size ? buf + len : NULL, 
+                    len < size ? size - len : 0, "]}\n");
+
+    return len;
+}
+
+
+/* stats_scan_range
+ * Purpose:     Thread_pool job (also run directly) that histograms the a, 
+ *                  Pb and Pr fields of a range of stored words
+ * Parameters:  void *jobp: the struct Stats_job to scan and fill
+ * Note:        Each word is loaded with Codeword_load and its fields are 
+ *                  found with the codeword.h shifts and masks
+ */
+void stats_scan_range(void *jobp)
+{
+    struct Stats_job *job = jobp;
+    const uint8_t *w = job->words;
+    Comp_stats *stats = &job->stats;
+    bool little = job->little;
+
+    for (size_t i = 0; i < job->nwords; i++, w += 4) {
+        uint32_t word = Codeword_load(w, little);
+        stats->a_hist[(word >> CODEWORD_A_SHIFT) & CODEWORD_A_MASK]++;
+        stats->pb_hist[(word >> CODEWORD_PB_SHIFT) & CODEWORD_PBPR_MASK]++;
+        stats->pr_hist[(word >> CODEWORD_PR_SHIFT) & CODEWORD_PBPR_MASK]++;
+    }
+}
@@ -0,0 +1,48 @@
+/* comp_stats.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the interface for computing image statistics (luma histogram, 
+ *  mean luma and color, dark/blank flags) from the a, Pb and Pr fields of 
+ *  a compressed image's words, without decoding it
+ */
+
+#ifndef COMP_STATS_H
+#define COMP_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "codeword.h"
+
+
+/* Comp_stats
+ * Members:     width, height:  the size of the image in pixels
+ *              a_hist:         the number of blocks with each value of a
+ *              pb_hist, pr_hist: the number of blocks with each chroma index
+ * Note:        every statistic Comp_stats_json reports is derived from 
+ *                  these histograms
+ */
+typedef struct Comp_stats {
+    unsigned width, height;
+    uint64_t a_hist[CODEWORD_A_MAX + 1];
+    uint64_t pb_hist[CODEWORD_PBPR_MAX + 1];
+    uint64_t pr_hist[CODEWORD_PBPR_MAX + 1];
+} Comp_stats;
+
+
+/* fills stats for the width x height image whose words start at words, 
+    little-endian if little is true (format 3) or big-endian otherwise 
+    (format 2), scanning them with nthreads threads (one per CPU if < 1)
+    Note: it is a CRE for words or stats to be NULL */
+void Comp_stats_scan(const uint8_t *words, bool little, unsigned width, 
+                     unsigned height, int nthreads, Comp_stats *stats);
+
+/* writes stats as a JSON object into buf[0..size) like snprintf, and 
+    returns the length of the whole object. No more than COMP_STATS_JSON_MAX
+    bytes are ever needed
+    Note: it is a CRE for stats to be NULL */
+size_t Comp_stats_json(const Comp_stats *stats, char *buf, size_t size);
+
+#define COMP_STATS_JSON_MAX 8192
+
+#endif
@@ -0,0 +1,190 @@
+/* comp_transform.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the implementation of compressed-domain transforms. Each 
+ *  transform moves every block to its new position and rewrites the block's
+ *  gradients for the block's new orientation. With the pixels of a block 
+ *  numbered  1 | 2  the gradients are  b = (Y3 + Y4 - Y1 - Y2) / 4 (top to 
+ *            3 | 4  bottom),           c = (Y2 + Y4 - Y1 - Y3) / 4 (left to
+ *  right) and d = (Y1 + Y4 - Y2 - Y3) / 4 (diagonal), so a mirror negates 
+ *  the gradients across it, a transpose swaps b and c, and the rotations 
+ *  combine the two. a, Pb and Pr do not depend on orientation.
+ *
+ *  The 15 bits holding b, c and d are rewritten through a table built once 
+ *  per call, and blocks are moved one square tile at a time so that both
+ *  the words read and the words written stay in cache.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "assert.h"
+#include "mem.h"
+#include "codeword.h"
+#include "comp_transform.h"
+
+
+/* b, c and d sit together, from d's lowest bit up to a */
+#define BCD_SHIFT CODEWORD_D_SHIFT
+#define BCD_BITS  (CODEWORD_A_SHIFT - CODEWORD_D_SHIFT)
+
+/* tiles are TILE x TILE blocks: 16KB of source words */
+#define TILE 64
+
+
+/* helper function declarations */
+Codeword transform_gradients(Codeword cw, Compress40_transform transform);
+int transform_clamp(int n);
+void transform_position(Compress40_transform transform, unsigned col, 
+                        unsigned row, unsigned cols, unsigned rows, 
+                        unsigned *new_col, unsigned *new_row);
+bool transform_swaps_axes(Compress40_transform transform);
+
+
+/* Comp_img_transform_in
+ * Purpose:     Rotates, flips or transposes a compressed image losslessly
+ * Parameters:  Img_arena arena: the arena to own the new image, or NULL to
+ *                  allocate it on the heap
+ *              Comp_img img: the image to transform
+ *              Compress40_transform transform: the transform to apply
+ * Returns:     Comp_img: the transformed image
+ * Note:        It is a CRE for img to be NULL
+ */
+Comp_img Comp_img_transform_in(Img_arena arena, Comp_img img, 
+                               Compress40_transform transform)
+{
+    assert(img != NULL);
+
+    unsigned width = Comp_img_width(img), height = Comp_img_height(img);
+    unsigned cols = width / 2, rows = height / 2;
+    bool swap = transform_swaps_axes(transform);
+    Comp_img result = Comp_img_new_in(arena, swap ? height : width, 
+                                      swap ? width : height);
+    unsigned new_cols = swap ? rows : cols;
+
+    /* the new gradient bits for every possible combination of old ones */
+    uint16_t *bcd_table = CALLOC(1 << BCD_BITS, sizeof(uint16_t));
+    for (uint32_t bcd = 0; bcd < (1 << BCD_BITS); bcd++) {
+        Codeword cw = Codeword_unpack(bcd << BCD_SHIFT);
+        cw = transform_gradients(cw, transform);
+        bcd_table[bcd] = Codeword_pack(cw) >> BCD_SHIFT;
+    }
+
+    const uint32_t *src = Comp_img_words(img);
+    uint32_t *dst = Comp_img_words(result);
+    uint32_t bcd_mask = ((1u << BCD_BITS) - 1) << BCD_SHIFT;
+
+    for (unsigned tile_row = 0; tile_row < rows; tile_row += TILE) {
+        for (unsigned tile_col = 0; tile_col < cols; tile_col += TILE) {
+            unsigned row_end = rows - tile_row < TILE ? rows : tile_row + TILE;
+            unsigned col_end = cols - tile_col < TILE ? cols : tile_col + TILE;
+
+            for (unsigned row = tile_row; row < row_end; row++) {
+                for (unsigned col = tile_col; col < col_end; col++) {
+                    uint32_t word = src[(size_t) row * cols + col];
+                    unsigned new_col, new_row;
+                    transform_position(transform, col, row, cols, rows,
+                                       &new_col, &new_row);
+                    dst[(size_t) new_row * new_cols + new_col] = 
+                        (word & ~bcd_mask) | 
+                        ((uint32_t) bcd_table[(word & bcd_mask) >> 
+                                              BCD_SHIFT] << BCD_SHIFT);
+                }
+            }
+        }
+    }
+
+    Comp_img_set_full(result);
+
+    FREE(bcd_table);
+    return result;
+}
+
+
+/* transform_gradients
+ * Purpose:     returns cw with its b, c and d rewritten for the block's 
+ *                  orientation after the transform
+ */
+Codeword transform_gradients(Codeword cw, Compress40_transform transform)
+{
+    int b = cw.b, c = cw.c, d = cw.d;
+
+    switch (transform) {
+    case COMPRESS40_ROT90:      /* clockwise */
+        cw.b = c;   cw.c = -b;  cw.d = -d;
+        break;
+    case COMPRESS40_ROT180:
+        cw.b = -b;  cw.c = -c;  cw.d = d;
+        break;
+    case COMPRESS40_ROT270:
+        cw.b = -c;  cw.c = b;   cw.d = -d;
+        break;
+    case COMPRESS40_FLIP_H:     /* mirror left to right */
+        cw.b = b;   cw.c = -c;  cw.d = -d;
+        break;
+    case COMPRESS40_FLIP_V:     /* mirror top to bottom */
+        cw.b = -b;  cw.c = c;   cw.d = -d;
+        break;
+    case COMPRESS40_TRANSPOSE:
+        cw.b = c;   cw.c = b;   cw.d = d;
+        break;
+    }
+
+    /* a stray -16 in the input has no positive counterpart */
+    cw.b = transform_clamp(cw.b);
+    cw.c = transform_clamp(cw.c);
+    cw.d = transform_clamp(cw.d);
+    return cw;
+}
+
+
+/* transform_clamp
+ * Purpose:     clamps a gradient into the range Codeword_pack accepts
+ */
+int transform_clamp(int n)
+{
+    return n > CODEWORD_BCD_MAX ? CODEWORD_BCD_MAX : 
+           n < -CODEWORD_BCD_MAX ? -CODEWORD_BCD_MAX : n;
+}
+
+
+/* transform_position
+ * Purpose:     computes where the block at (col, row) of a cols x rows grid
+ *                  of blocks lands after the transform
+ */
+void transform_position(Compress40_transform transform, unsigned col, 
+                        unsigned row, unsigned cols, unsigned rows, 
+                        unsigned *new_col, unsigned *new_row)
+{
+    switch (transform) {
+    case COMPRESS40_ROT90:
+        *new_col = rows - 1 - row;  *new_row = col;
+        break;
+    case COMPRESS40_ROT180:
+        *new_col = cols - 1 - col;  *new_row = rows - 1 - row;
+        break;
+    case COMPRESS40_ROT270:
+        *new_col = row;             *new_row = cols - 1 - col;
+        break;
+    case COMPRESS40_FLIP_H:
+        *new_col = cols - 1 - col;  *new_row = row;
+        break;
+    case COMPRESS40_FLIP_V:
+        *new_col = col;             *new_row = rows - 1 - row;
+        break;
+    case COMPRESS40_TRANSPOSE:
+    default:
+        *new_col = row;             *new_row = col;
+        break;
+    }
+}
+
+
+/* transform_swaps_axes
+ * Purpose:     returns true if the transform swaps the width and height
+ */
+bool transform_swaps_axes(Compress40_transform transform)
+{
+    return transform == COMPRESS40_ROT90 || transform == COMPRESS40_ROT270 ||
+           transform == COMPRESS40_TRANSPOSE;
+}
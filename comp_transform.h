@@ -0,0 +1,23 @@
+/* comp_transform.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 4/28/2021
+ *
+ * Contains the interface for rotating, flipping and transposing compressed
+ *  images without decoding them
+ */
+
+#ifndef COMP_TRANSFORM_H
+#define COMP_TRANSFORM_H
+
+#include "comp_img.h"
+#include "compress40.h"
+
+
+/* returns img rotated, flipped or transposed as a new Comp_img owned by 
+    the provided arena (or the heap if arena is NULL). Decoding the result
+    gives exactly the transformed decoding of img
+    Note: it is a CRE for img to be NULL */
+Comp_img Comp_img_transform_in(Img_arena arena, Comp_img img, 
+                               Compress40_transform transform);
+
+#endif
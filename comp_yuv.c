@@ -0,0 +1,318 @@
+/* comp_yuv.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/6/2021
+ *
+ * Contains the implementation of YUV coding. Decoding to I420, each word's
+ *  a, b, c and d go through the inverse Haar transform straight to its
+ *  block's four Y samples, and its Pb and Pr indices are looked up in a
+ *  table of ready Cb and Cr samples, so no pixel is ever converted to RGB.
+ *  Encoding runs the other way: every 8-bit sample is mapped to its luma
+ *  or chroma through a 256-entry table, and each block's values are
+ *  packed exactly as xyz_to_abcd.c packs an RGB image's. The scales of
+ *  the chosen range are folded into the tables both ways.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assert.h"
+#include "comp_yuv.h"
+#include "codeword.h"
+#include "abcd_to_word.h"
+
+
+#define Y4M_MAGIC "YUV4MPEG2 "
+#define Y4M_FRAME "FRAME"
+
+
+/* b, c and d are luma gradients * 50, as abcd_to_word.c quantizes them */
+#define BCD_SCALE 50.0
+
+
+/* helper function declarations */
+static inline uint8_t yuv_sample(float v, float lo, float hi);
+float yuv_block_chroma(const Comp_yuv_planes *planes, const uint8_t *plane,
+                       unsigned col, unsigned row, const float *chroma);
+bool y4m_colorspace(const char *name, size_t len, Comp_yuv_planes *planes,
+                    bool *mono);
+
+
+/* Comp_yuv_size
+ * Purpose:     returns the size of a width x height I420 image
+ */
+size_t Comp_yuv_size(unsigned width, unsigned height)
+{
+    return (size_t) width * height + 2 * ((size_t) (width / 2) *
+                                          (height / 2));
+}
+
+
+/* Comp_yuv_i420
+ * Purpose:     Decodes a compressed image to 8-bit I420, straight from its
+ *                  codewords
+ * Parameters:  Comp_img img: the compressed image
+ *              bool full_range: true for full range samples, false for
+ *                  BT.601 limited range
+ *              uint8_t *out: where to write the Y, Cb and Cr planes
+ * Note:        It is a CRE for img or out to be NULL
+ */
+void Comp_yuv_i420(Comp_img img, bool full_range, uint8_t *out)
+{
+    assert(img != NULL && out != NULL);
+
+    float luma_lo = full_range ? 0 : 16;
+    float luma_hi = full_range ? 255 : 235;
+    float luma_scale = luma_hi - luma_lo;
+    float chroma_scale = full_range ? 255 : 224;
+
+    /* the Y sample each a stands for, and the Cb or Cr each index does */
+    float luma[CODEWORD_A_MAX + 1];
+    uint8_t chroma[CODEWORD_PBPR_MAX + 1];
+    for (int a = 0; a <= CODEWORD_A_MAX; a++) {
+        luma[a] = luma_lo + luma_scale * Codeword_luma(a);
+    }
+    for (int i = 0; i <= CODEWORD_PBPR_MAX; i++) {
+        chroma[i] = yuv_sample(128 + chroma_scale * Codeword_chroma(i),
+                               0, 255);
+    }
+    float gradient = luma_scale / BCD_SCALE;
+
+    unsigned width = Comp_img_width(img);
+    unsigned blocks_per_row = width / 2;
+    unsigned block_rows = Comp_img_height(img) / 2;
+    const uint32_t *words = Comp_img_words(img);
+    uint8_t *cb = out + (size_t) width * block_rows * 2;
+    uint8_t *cr = cb + (size_t) blocks_per_row * block_rows;
+
+    for (unsigned row = 0; row < block_rows; row++) {
+        uint8_t *top = out + (size_t) row * 2 * width;
+        uint8_t *bottom = top + width;
+
+        for (unsigned col = 0; col < blocks_per_row; col++) {
+            Codeword cw = Codeword_unpack(*words++);
+            float y = luma[cw.a];
+            float b = cw.b * gradient;
+            float c = cw.c * gradient;
+            float d = cw.d * gradient;
+
+            top[2 * col] = yuv_sample(y - b - c + d, luma_lo, luma_hi);
+            top[2 * col + 1] = yuv_sample(y - b + c - d, luma_lo, luma_hi);
+            bottom[2 * col] = yuv_sample(y + b - c - d, luma_lo, luma_hi);
+            bottom[2 * col + 1] = yuv_sample(y + b + c + d, luma_lo,
+                                             luma_hi);
+            *cb++ = chroma[cw.pb];
+            *cr++ = chroma[cw.pr];
+        }
+    }
+}
+
+
+/* Comp_yuv_compress_in
+ * Purpose:     Compresses a YUV image straight from its planes
+ * Parameters:  Img_arena arena: the arena to own the image, or NULL
+ *              const Comp_yuv_planes *planes: the image's samples
+ *              unsigned width, height: its size in pixels
+ * Returns:     Comp_img: the compressed image, evened down to whole blocks
+ * Note:        It is a CRE for planes to be NULL or for width or height to
+ *                  be < 2
+ */
+Comp_img Comp_yuv_compress_in(Img_arena arena, const Comp_yuv_planes *planes,
+                              unsigned width, unsigned height)
+{
+    assert(planes != NULL && planes->y != NULL);
+    assert(width >= 2 && height >= 2);
+
+    /* the luma (0 to 1) and chroma (-0.5 to 0.5) of every sample */
+    float luma_lo = planes->full_range ? 0 : 16;
+    float luma_scale = planes->full_range ? 255 : 219;
+    float chroma_scale = planes->full_range ? 255 : 224;
+    float luma[256], chroma[256];
+    for (int v = 0; v < 256; v++) {
+        float y = (v - luma_lo) / luma_scale;
+        float p = (v - 128) / chroma_scale;
+        luma[v] = y < 0 ? 0 : y > 1 ? 1 : y;
+        chroma[v] = p < -0.5 ? -0.5 : p > 0.5 ? 0.5 : p;
+    }
+
+    unsigned blocks_per_row = width / 2;
+    unsigned block_rows = height / 2;
+    Comp_img img = Comp_img_new_in(arena, blocks_per_row * 2,
+                                   block_rows * 2);
+
+    for (unsigned row = 0; row < block_rows; row++) {
+        const uint8_t *top = planes->y + (size_t) row * 2 * planes->y_stride;
+        const uint8_t *bottom = top + planes->y_stride;
+
+        for (unsigned col = 0; col < blocks_per_row; col++) {
+            float y1 = luma[top[2 * col]], y2 = luma[top[2 * col + 1]];
+            float y3 = luma[bottom[2 * col]];
+            float y4 = luma[bottom[2 * col + 1]];
+
+            /* as do_compression_math computes them */
+            float abc_val[6] = {
+                (y4 + y3 + y2 + y1) / 4.0, (y4 + y3 - y2 - y1) / 4.0,
+                (y4 - y3 + y2 - y1) / 4.0, (y4 - y3 - y2 + y1) / 4.0,
+                yuv_block_chroma(planes, planes->cb, col, row, chroma),
+                yuv_block_chroma(planes, planes->cr, col, row, chroma)
+            };
+            uint64_t word = 0;
+            abcd_to_word(abc_val, &word);
+            Comp_img_add_word(img, (uint32_t) word);
+        }
+    }
+
+    return img;
+}
+
+
+/* Comp_yuv_parse_y4m
+ * Purpose:     Finds the first frame of a Y4M stream
+ * Parameters:  const uint8_t *buf, size_t len: the Y4M stream
+ *              Comp_yuv_planes *planes: set to the first frame's planes
+ *              unsigned *width, *height: set to the frame's size
+ * Returns:     bool: false unless buf holds a Y4M header this module can
+ *                  read and all of the first frame
+ * Note:        It is a CRE for planes, width or height to be NULL
+ *              Interlacing, frame rate and aspect tags are ignored; the
+ *                  XCOLORRANGE=FULL tag selects full range
+ */
+bool Comp_yuv_parse_y4m(const uint8_t *buf, size_t len,
+                        Comp_yuv_planes *planes, unsigned *width,
+                        unsigned *height)
+{
+    assert(planes != NULL && width != NULL && height != NULL);
+
+    size_t magic_len = strlen(Y4M_MAGIC);
+    const uint8_t *end = buf != NULL ? memchr(buf, '\n', len) : NULL;
+    if (end == NULL || (size_t) (end - buf) < magic_len ||
+        memcmp(buf, Y4M_MAGIC, magic_len) != 0) {
+        return false;
+    }
+
+    /* the header's tags, each a letter and a value, space separated */
+    *planes = (Comp_yuv_planes) { NULL, NULL, NULL, 0, 0, 1, 1, 1, false };
+    *width = *height = 0;
+    const char *tag = (const char *) buf + magic_len;
+    bool colorspace = true, mono = false;
+    while (tag < (const char *) end) {
+        const char *tag_end = memchr(tag, ' ', (const char *) end - tag);
+        if (tag_end == NULL) {
+            tag_end = (const char *) end;
+        }
+        if (*tag == 'W') {
+            *width = strtoul(tag + 1, NULL, 10);
+        } else if (*tag == 'H') {
+            *height = strtoul(tag + 1, NULL, 10);
+        } else if (*tag == 'C') {
+            colorspace = y4m_colorspace(tag + 1, tag_end - tag - 1, planes,
+                                        &mono);
+        } else if (tag_end - tag == 16 &&
+                   memcmp(tag, "XCOLORRANGE=FULL", 16) == 0) {
+            planes->full_range = true;
+        }
+        tag = tag_end + 1;
+    }
+    /* the planes total at most three luma planes, which must fit a size_t */
+    if (!colorspace || *width < 2 || *height < 2 ||
+        *width > SIZE_MAX / 3 / *height) {
+        return false;
+    }
+
+    /* the first frame: "FRAME", its own tags, then the planes */
+    const uint8_t *frame = end + 1;
+    size_t left = len - (frame - buf);
+    const uint8_t *data = memchr(frame, '\n', left);
+    if (left < strlen(Y4M_FRAME) ||
+        memcmp(frame, Y4M_FRAME, strlen(Y4M_FRAME)) != 0 || data == NULL) {
+        return false;
+    }
+    data++;
+    left -= data - frame;
+
+    size_t luma_size = (size_t) *width * *height;
+    size_t c_width = ((size_t) *width + (1u << planes->c_shift_x) - 1) >>
+                     planes->c_shift_x;
+    size_t c_height = ((size_t) *height + (1u << planes->c_shift_y) - 1) >>
+                      planes->c_shift_y;
+    size_t chroma_size = mono ? 0 : c_width * c_height;
+    if (left < luma_size + 2 * chroma_size) {
+        return false;
+    }
+
+    planes->y = data;
+    planes->y_stride = *width;
+    if (!mono) {
+        planes->cb = data + luma_size;
+        planes->cr = planes->cb + chroma_size;
+        planes->c_stride = c_width;
+    }
+    return true;
+}
+
+
+/* yuv_block_chroma
+ * Purpose:     Returns the mean chroma of one plane's samples over a block,
+ *                  one sample per pixel, or 0 for a luma-only image
+ * Parameters:  const Comp_yuv_planes *planes: the image's layout
+ *              const uint8_t *plane: the Cb or Cr plane, or NULL
+ *              unsigned col, row: the block
+ *              const float *chroma: the chroma of each sample value
+ */
+float yuv_block_chroma(const Comp_yuv_planes *planes, const uint8_t *plane,
+                       unsigned col, unsigned row, const float *chroma)
+{
+    if (plane == NULL) {
+        return 0;
+    }
+
+    float sum = 0;
+    for (unsigned y = row * 2; y < row * 2 + 2; y++) {
+        const uint8_t *line = plane +
+                              (size_t) (y >> planes->c_shift_y) *
+                              planes->c_stride;
+        for (unsigned x = col * 2; x < col * 2 + 2; x++) {
+            sum += chroma[line[(size_t) (x >> planes->c_shift_x) *
+                               planes->c_step]];
+        }
+    }
+    return sum / 4.0;
+}
+
+
+/* y4m_colorspace
+ * Purpose:     Sets the chroma subsampling of planes from a Y4M colorspace
+ *                  tag's value, name[0..len), and *mono if it has no
+ *                  chroma planes
+ * Returns:     bool: false for colorspaces other than 8-bit 4:2:0, 4:2:2,
+ *                  4:4:4 and mono
+ */
+bool y4m_colorspace(const char *name, size_t len, Comp_yuv_planes *planes,
+                    bool *mono)
+{
+    static const char *names[] = {
+        "420jpeg", "420paldv", "420mpeg2", "420", "422", "444", "mono"
+    };
+    static const unsigned shifts[][2] = {
+        { 1, 1 }, { 1, 1 }, { 1, 1 }, { 1, 1 }, { 1, 0 }, { 0, 0 }, { 0, 0 }
+    };
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strlen(names[i]) == len && memcmp(name, names[i], len) == 0) {
+            planes->c_shift_x = shifts[i][0];
+            planes->c_shift_y = shifts[i][1];
+            *mono = strcmp(names[i], "mono") == 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/* yuv_sample
+ * Purpose:     returns v clamped to [lo, hi] and rounded to a sample
+ */
+static inline uint8_t yuv_sample(float v, float lo, float hi)
+{
+    v = v < lo ? lo : v > hi ? hi : v;
+    return (uint8_t) (v + 0.5f);
+}
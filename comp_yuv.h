@@ -0,0 +1,73 @@
+/* comp_yuv.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/6/2021
+ *
+ * Contains the interface for coding compressed images straight to and from
+ *  YUV (planar I420, semi-planar NV12 and Y4M input), whose 4:2:0 layout
+ *  is the one the codewords already hold: four lumas and one chroma pair
+ *  per 2x2 block
+ */
+
+#ifndef COMP_YUV_H
+#define COMP_YUV_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "comp_img.h"
+#include "img_arena.h"
+
+
+/* Comp_yuv_planes
+ * Members:     y, cb, cr:      the first sample of each plane; cb and cr
+ *                                  are NULL for a luma-only image
+ *              y_stride:       the bytes from one luma row to the next
+ *              c_stride:       the bytes from one chroma row to the next
+ *              c_step:         the bytes from one chroma sample to the
+ *                                  next in a row (1 planar, 2 for NV12's
+ *                                  interleaved CbCr)
+ *              c_shift_x, c_shift_y: log2 of the chroma subsampling
+ *                                  (1 and 1 for 4:2:0, 1 and 0 for 4:2:2,
+ *                                  0 and 0 for 4:4:4)
+ *              full_range:     true for full range samples, false for
+ *                                  BT.601 limited range
+ */
+typedef struct Comp_yuv_planes {
+    const uint8_t *y, *cb, *cr;
+    size_t y_stride, c_stride;
+    unsigned c_step;
+    unsigned c_shift_x, c_shift_y;
+    bool full_range;
+} Comp_yuv_planes;
+
+
+/* returns the number of bytes of a width x height I420 image: a full size
+    Y plane, then quarter size Cb and Cr planes */
+size_t Comp_yuv_size(unsigned width, unsigned height);
+
+/* writes img as 8-bit I420 into out, which must hold Comp_yuv_size bytes
+    for img's size: full range (Y 0 to 255, Cb and Cr 128 +/- 127.5) if
+    full_range, else the limited range of BT.601 (Y 16 to 235, Cb and Cr
+    16 to 240)
+    Note: it is a CRE for img or out to be NULL */
+void Comp_yuv_i420(Comp_img img, bool full_range, uint8_t *out);
+
+/* compresses the width x height (both evened down) YUV image in planes into
+    a new Comp_img owned by the provided arena (or the heap if arena is
+    NULL): each block's four Y samples go straight into the Haar transform
+    and its Pb and Pr are the means of the chroma samples over it
+    Note: it is a CRE for planes to be NULL or for width or height to be
+          < 2 */
+Comp_img Comp_yuv_compress_in(Img_arena arena, const Comp_yuv_planes *planes,
+                              unsigned width, unsigned height);
+
+/* parses the header of the Y4M stream in buf[0..len) and points planes at
+    its first frame, setting *width and *height to its size. Returns false
+    unless buf holds a Y4M header with a 4:2:0, 4:2:2, 4:4:4 or mono
+    colorspace and all of the first frame
+    Note: it is a CRE for planes, width or height to be NULL */
+bool Comp_yuv_parse_y4m(const uint8_t *buf, size_t len,
+                        Comp_yuv_planes *planes, unsigned *width,
+                        unsigned *height);
+
+#endif
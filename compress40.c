@@ -3,16 +3,20 @@
  * 
  *  Contains the implementation and definitions for compress40.h, which
  *      controls the compression and decompression of ppm images into and from
- *      the Comp 40 Compressed Image Format 2
+ *      the Comp 40 Compressed Image Format 2 (and reads format 3 and the 
+ *      entropy-coded format), and of P5 pgms into and from the grayscale
+ *      format
  * 
- * Last updated 3/22/2021
+ * Last updated 4/18/2021
  * 
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <arith40.h>
 #include "compress40.h"
 #include "pnm.h"
 #include "a2methods.h"
@@ -21,9 +25,53 @@
 #include "xyz_to_abcd.h"
 #include "xyz_img.h"
 #include "comp_img.h"
+#include "img_arena.h"
+#include "fault_stats.h"
+#include "ppm_mem.h"
+#include "mem.h"
+#include "math_funs.h"
+#include "comp_preview.h"
+#include "comp_transform.h"
+#include "comp_scale.h"
+#include "comp_adjust.h"
+#include "comp_stats.h"
+#include "comp_hash.h"
+#include "comp_blend.h"
+#include "comp_mosaic.h"
+#include "codeword.h"
+#include "comp_entropy.h"
+#include "comp_delta.h"
+#include "comp_yuv.h"
+#include "comp_gray.h"
+#include "comp_profile.h"
 
-/* Helper Function */
-void free_all_img(Pnm_ppm rgb_img, XYZ_img xyz_img, Comp_img compressed_img);
+/* size of each chunk the pipeline arena maps from the OS at a time */
+#define PIPELINE_CHUNK_SIZE (64 * 1024 * 1024)
+
+/* Helper Functions */
+Img_arena pipeline_arena(void);
+size_t decompressed_size(unsigned width, unsigned height);
+void grow_buffer(uint8_t **buf, size_t *cap, size_t len);
+Comp_img parse_compressed(const uint8_t *comp, size_t len);
+uint8_t *read_stream(FILE *input, size_t *lenp);
+Compress40_status parse_failure(const uint8_t *comp, size_t len);
+void write_mem(Compress40_status (*code)(const uint8_t *, size_t, 
+                                         uint8_t **, size_t *), 
+               const uint8_t *in, size_t len);
+void swap_words(const uint8_t *in, size_t n, uint8_t *out);
+bool input_sealed(const uint8_t *comp, size_t len);
+void seal_output(uint8_t **buf, size_t *cap, size_t start, size_t *outlen,
+                 bool sealed);
+void merge_patch(uint8_t *raster, size_t stride, const uint8_t *patch, 
+                 const Ppm_header *hdr, unsigned width, unsigned height);
+
+/* owns all per-image pipeline state of the calling thread; reset after 
+   every image */
+static __thread Img_arena arena = NULL;
+
+/* set by compress40_set_profile: the profile images are compressed with, 
+   or NULL for format 2 */
+static const Comp_profile *profile = NULL;
 
 
 /* compress40
@@ -31,6 +79,8 @@ void free_all_img(Pnm_ppm rgb_img, XYZ_img xyz_img, Comp_img compressed_img);
  * Parameters:  The filestream of the ppm
  * Returns:     N/A
  * Note:        It is a CRE for input to be NULL
+ *              Bad input exits with EXIT_FAILURE rather than reaching the
+ *                  asserts in Pnm_ppmread
  */
 extern void compress40  (FILE *input)
 {
@@ -40,13 +90,68 @@ extern void compress40  (FILE *input)
     A2Methods_T input_methods = uarray2_methods_plain; 
     assert(input_methods);
 
+    /* a raw ppm or pgm is converted straight from its raster in memory,
+       as compress40_mem does; only a plain (P3) ppm is still read by 
+       Pnm_ppmread, from the buffered copy */
+    Fault_stats_begin("read");
+    size_t len;
+    uint8_t *in = read_stream(input, &len);
+    Ppm_header hdr;
+    if ((Ppm_parse_header(in, len, &hdr) || 
+         Pgm_parse_header(in, len, &hdr)) && 
+        hdr.width >= 2 && hdr.height >= 2) {
+        Fault_stats_end();
+        write_mem(compress40_mem, in, len);
+        FREE(in);
+        return;
+    }
+    if (len < 2 || memcmp(in, "P3", 2) != 0) {
+        fprintf(stderr, "compress40: input is not a complete ppm or pgm "
+                "of at least 2x2 pixels\n");
+        exit(EXIT_FAILURE);
+    }
+    FILE *ppm = fmemopen(in, len, "rb");
+    assert(ppm != NULL);
+
     /* read rgb img, convert to XYZ img, compress into Comp_img, and print */
-    Pnm_ppm rgb_img = Pnm_ppmread(input, input_methods);
-    A2Methods_UArray2 xyz_img = rgb_img_to_xyz(rgb_img);
-    Comp_img compressed_img = xyz_compress(xyz_img);
-    Comp_img_print(compressed_img);
+    Pnm_ppm rgb_img = Pnm_ppmread(ppm, input_methods);
+    fclose(ppm);
+    Fault_stats_end();
+
+    Fault_stats_begin("rgb_to_xyz");
+    XYZ_img xyz_img = rgb_img_to_xyz_in(pipeline_arena(), rgb_img);
+    Fault_stats_end();
 
-    free_all_img(rgb_img, xyz_img, compressed_img);
+    if (profile != NULL) {
+        Fault_stats_begin("compress");
+        size_t outlen = Comp_profile_size(profile, XYZ_img_width(xyz_img),
+                                          XYZ_img_height(xyz_img));
+        uint8_t *out = ALLOC(outlen + Comp_img_trailer_size());
+        Comp_profile_encode(profile, xyz_img, out);
+        if (Comp_img_trailer_size() > 0) {
+            outlen = Comp_profile_seal(out, outlen);
+        }
+        Fault_stats_end();
+
+        Fault_stats_begin("print");
+        fwrite(out, 1, outlen, stdout);
+        Fault_stats_end();
+        FREE(out);
+    } else {
+        Fault_stats_begin("compress");
+        Comp_img compressed_img = xyz_compress_in(pipeline_arena(), 
+                                                  xyz_img);
+        Fault_stats_end();
+
+        Fault_stats_begin("print");
+        Comp_img_print(compressed_img);
+        Fault_stats_end();
+    }
+
+    /* the ppm belongs to Pnm_ppmread; everything else goes with the arena */
+    Pnm_ppmfree(&rgb_img);
+    FREE(in);
+    Img_arena_reset(pipeline_arena());
 }
 
 
@@ -61,22 +166,1506 @@ extern void decompress40(FILE *input)
     assert(input != NULL);
 
     /* Read Comp_img, decompress into XYZ img, convert to RGB img, and print */
-    Comp_img compressed_img = Comp_img_read(input);
-    A2Methods_UArray2 xyz_img = xyz_decompress(compressed_img);
-    Pnm_ppm rgb_img = xyz_img_to_rgb(xyz_img);
+    Fault_stats_begin("read");
+    size_t len;
+    uint8_t *comp = read_stream(input, &len);
+    if (Comp_gray_is(comp, len) || Comp_profile_is(comp, len)) {
+        Fault_stats_end();
+        write_mem(decompress40_mem, comp, len);
+        FREE(comp);
+        return;
+    }
+    Comp_img compressed_img = parse_compressed(comp, len);
+    assert(compressed_img != NULL);
+    Fault_stats_end();
+
+    /* a format 3 image's words may still be comp's */
+    Fault_stats_begin("decompress");
+    XYZ_img xyz_img = xyz_decompress_in(pipeline_arena(), compressed_img);
+    FREE(comp);
+    Fault_stats_end();
+
+    Fault_stats_begin("xyz_to_rgb");
+    Pnm_ppm rgb_img = xyz_img_to_rgb_in(pipeline_arena(), xyz_img);
+    Fault_stats_end();
+
+    Fault_stats_begin("write");
     Pnm_ppmwrite(stdout, rgb_img);
+    Fault_stats_end();
 
-    free_all_img(rgb_img, xyz_img, compressed_img);
+    /* every image in the pipeline is owned by the arena */
+    Img_arena_reset(pipeline_arena());
 }
 
 
-/* free_all_img
- * Purpose:     Given a Pnm_ppm, XYZ_img, and Comp_img, frees them
- * Note:        It is a CRE for any img to be NULL
+/* compress40_mem
+ * Purpose:     Compresses a ppm held in memory into a newly allocated buffer
+ * Parameters:  const uint8_t *ppm, size_t len: the P6 ppm
+ *              uint8_t **out: set to the compressed image
+ *              size_t *outlen: set to the size of the compressed image
+ * Returns:     COMPRESS40_OK, or COMPRESS40_BAD_FORMAT if ppm is not a 
+ *                  complete P6 ppm of at least 2x2 pixels
+ * Note:        It is a CRE for out or outlen to be NULL
  */
-void free_all_img(Pnm_ppm rgb_img, XYZ_img xyz_img, Comp_img compressed_img)
+extern Compress40_status compress40_mem(const uint8_t *ppm, size_t len,
+                                        uint8_t **out, size_t *outlen)
 {
-    Comp_img_free(&compressed_img);
-    XYZ_img_free(&xyz_img);
-    Pnm_ppmfree(&rgb_img);
+    assert(out != NULL && outlen != NULL);
+
+    Compress40_status status = compress40_into(ppm, len, NULL, 0, outlen);
+    if (status != COMPRESS40_TOO_SMALL) {
+        return status;
+    }
+
+    *out = ALLOC(*outlen);
+    return compress40_into(ppm, len, *out, *outlen, outlen);
+}
+
+
+/* decompress40_mem
+ * Purpose:     Decompresses a compressed image held in memory into a newly
+ *                  allocated ppm buffer
+ * Parameters:  const uint8_t *comp, size_t len: the compressed image
+ *              uint8_t **out: set to the P6 ppm
+ *              size_t *outlen: set to the size of the ppm
+ * Returns:     COMPRESS40_OK, or COMPRESS40_BAD_FORMAT if comp is not a 
+ *                  complete compressed image
+ * Note:        It is a CRE for out or outlen to be NULL
+ */
+extern Compress40_status decompress40_mem(const uint8_t *comp, size_t len,
+                                          uint8_t **out, size_t *outlen)
+{
+    assert(out != NULL && outlen != NULL);
+
+    Compress40_status status = decompress40_into(comp, len, NULL, 0, outlen);
+    if (status != COMPRESS40_TOO_SMALL) {
+        return status;
+    }
+
+    /* the size comes from the header, so a corrupt image fails here */
+    *out = ALLOC(*outlen);
+    status = decompress40_into(comp, len, *out, *outlen, outlen);
+    if (status != COMPRESS40_OK) {
+        FREE(*out);
+    }
+    return status;
+}
+
+
+/* compress40_into
+ * Purpose:     Compresses a ppm held in memory into a caller-provided buffer,
+ *                  converting its raster straight to XYZ with no Pnm_ppm 
+ * Parameters:  const uint8_t *ppm, size_t len: the P6 ppm
+ *              uint8_t *out, size_t cap: the output buffer, or NULL and 0 
+ *                  to only query the output size
+ *              size_t *outlen: set to the size of the compressed image
+ * Returns:     COMPRESS40_OK, COMPRESS40_BAD_FORMAT, or 
+ *                  COMPRESS40_TOO_SMALL if out cannot hold *outlen bytes
+ * Note:        It is a CRE for outlen to be NULL
+ */
+extern Compress40_status compress40_into(const uint8_t *ppm, size_t len,
+                                         uint8_t *out, size_t cap,
+                                         size_t *outlen)
+{
+    assert(outlen != NULL);
+
+    Ppm_header hdr;
+    bool gray = Pgm_parse_header(ppm, len, &hdr);
+    if ((!gray && !Ppm_parse_header(ppm, len, &hdr)) || 
+        hdr.width < 2 || hdr.height < 2) {
+        return COMPRESS40_BAD_FORMAT;
+    }
+
+    unsigned width = evenify(hdr.width), height = evenify(hdr.height);
+    if (gray) {
+        *outlen = Comp_gray_size(width, height) + Comp_img_trailer_size();
+    } else if (profile != NULL) {
+        *outlen = Comp_profile_size(profile, width, height) + 
+                  Comp_img_trailer_size();
+    } else {
+        *outlen = Comp_img_serialized_size(width, height);
+    }
+    if (out == NULL || cap < *outlen) {
+        return COMPRESS40_TOO_SMALL;
+    }
+    if (gray) {
+        size_t coded = Comp_gray_encode(ppm + hdr.raster_offset, hdr.width,
+                                        hdr.height, hdr.maxval, out);
+        if (Comp_img_trailer_size() > 0) {
+            Comp_gray_seal(out, coded);
+        }
+        return COMPRESS40_OK;
+    }
+
+    XYZ_img xyz_img = raster_to_xyz_in(pipeline_arena(), 
+                                       ppm + hdr.raster_offset,
+                                       hdr.width, hdr.height, hdr.maxval);
+    if (profile != NULL) {
+        size_t coded = Comp_profile_encode(profile, xyz_img, out);
+        if (Comp_img_trailer_size() > 0) {
+            Comp_profile_seal(out, coded);
+        }
+    } else {
+        Comp_img compressed_img = xyz_compress_in(pipeline_arena(), 
+                                                  xyz_img);
+        Comp_img_serialize(compressed_img, out);
+    }
+
+    Img_arena_reset(pipeline_arena());
+    return COMPRESS40_OK;
+}
+
+
+/* decompress40_into
+ * Purpose:     Decompresses a compressed image held in memory into a 
+ *                  caller-provided buffer, writing the raster straight from
+ *                  XYZ with no Pnm_ppm
+ * Parameters:  const uint8_t *comp, size_t len: the compressed image
+ *              uint8_t *out, size_t cap: the output buffer, or NULL and 0 
+ *                  to only query the output size
+ *              size_t *outlen: set to the size of the P6 ppm
+ * Returns:     COMPRESS40_OK, COMPRESS40_BAD_FORMAT, or 
+ *                  COMPRESS40_TOO_SMALL if out cannot hold *outlen bytes
+ * Note:        It is a CRE for outlen to be NULL
+ */
+extern Compress40_status decompress40_into(const uint8_t *comp, size_t len,
+                                           uint8_t *out, size_t cap,
+                                           size_t *outlen)
+{
+    assert(outlen != NULL);
+
+    unsigned width, height;
+    size_t trailer;
+    if (Comp_gray_parse_header(comp, len, &width, &height)) {
+        size_t header_len = Pgm_write_header(NULL, width, height, 255);
+        *outlen = header_len + (size_t) width * height;
+        if (out == NULL || cap < *outlen) {
+            return COMPRESS40_TOO_SMALL;
+        }
+        if (!Comp_gray_verify(comp, len, &trailer)) {
+            return COMPRESS40_BAD_CHECKSUM;
+        }
+        Pgm_write_header(out, width, height, 255);
+        Comp_gray_decode(comp, len, out + header_len);
+        return COMPRESS40_OK;
+    }
+
+    const Comp_profile *coded;
+    if (Comp_profile_parse_header(comp, len, &coded, &width, &height)) {
+        *outlen = decompressed_size(width, height);
+        if (out == NULL || cap < *outlen) {
+            return COMPRESS40_TOO_SMALL;
+        }
+        XYZ_img xyz_img = Comp_profile_decode_in(pipeline_arena(), comp, 
+                                                 len);
+        if (xyz_img == NULL) {
+            Img_arena_reset(pipeline_arena());
+            return COMPRESS40_BAD_CHECKSUM;
+        }
+        size_t header_len = Ppm_write_header(out, width, height, 255);
+        xyz_to_raster(xyz_img, out + header_len);
+
+        Img_arena_reset(pipeline_arena());
+        return COMPRESS40_OK;
+    }
+
+    /* a header is only accepted if every word (or stripe) it promises is
+       there, so a size query never has to decode the image */
+    if (compress40_size(comp, len, &width, &height) != COMPRESS40_OK &&
+        !Comp_entropy_parse_header(comp, len, &width, &height)) {
+        return COMPRESS40_BAD_FORMAT;
+    }
+    *outlen = decompressed_size(width, height);
+    if (out == NULL || cap < *outlen) {
+        return COMPRESS40_TOO_SMALL;
+    }
+
+    Comp_img compressed_img = parse_compressed(comp, len);
+    if (compressed_img == NULL) {
+        Img_arena_reset(pipeline_arena());
+        return parse_failure(comp, len);
+    }
+
+    XYZ_img xyz_img = xyz_decompress_in(pipeline_arena(), compressed_img);
+    size_t header_len = Ppm_write_header(out, width, height, 255);
+    xyz_to_raster(xyz_img, out + header_len);
+
+    Img_arena_reset(pipeline_arena());
+    return COMPRESS40_OK;
+}
+
+
+/* compress40_buffered
+ * Purpose:     Codes an in-memory image into a reusable, growable buffer
+ * Parameters:  bool compress: true to compress, false to decompress
+ *              const uint8_t *in, size_t len: the input image
+ *              uint8_t **buf, size_t *cap: the output buffer and its size,
+ *                  grown with RESIZE when the output would not fit
+ *              size_t *outlen: set to the size of the output
+ * Returns:     COMPRESS40_OK or COMPRESS40_BAD_FORMAT
+ * Note:        It is a CRE for buf, cap or outlen to be NULL
+ */
+extern Compress40_status compress40_buffered(bool compress, 
+                                             const uint8_t *in, size_t len,
+                                             uint8_t **buf, size_t *cap,
+                                             size_t *outlen)
+{
+    assert(buf != NULL && cap != NULL && outlen != NULL);
+    Compress40_status status = COMPRESS40_TOO_SMALL;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (compress) {
+            status = compress40_into(in, len, *buf, *cap, outlen);
+        } else {
+            status = decompress40_into(in, len, *buf, *cap, outlen);
+        }
+        if (status != COMPRESS40_TOO_SMALL) {
+            break;
+        }
+
+        grow_buffer(buf, cap, *outlen);
+    }
+
+    return status;
+}
+
+
+/* compress40_size
+ * Purpose:     Reads the size of a compressed image held in memory
+ * Parameters:  const uint8_t *comp, size_t len: the compressed image
+ *              unsigned *width, *height: set to its size in pixels
+ * Returns:     COMPRESS40_OK or COMPRESS40_BAD_FORMAT
+ * Note:        It is a CRE for width or height to be NULL
+ */
+extern Compress40_status compress40_size(const uint8_t *comp, size_t len,
+                                         unsigned *width, unsigned *height)
+{
+    assert(width != NULL && height != NULL);
+
+    size_t offset;
+    bool binary;
+    return Comp_img_locate(comp, len, width, height, &offset, &binary) ?
+           COMPRESS40_OK : COMPRESS40_BAD_FORMAT;
+}
+
+
+/* compress40_word_offset
+ * Purpose:     Finds where the word for a pixel's block is stored in a 
+ *                  compressed image
+ * Parameters:  const uint8_t *comp, size_t len: the compressed image
+ *              unsigned col, row: the pixel
+ *              size_t *offset: set to the offset of the block's word
+ * Returns:     COMPRESS40_OK, COMPRESS40_BAD_FORMAT, or 
+ *                  COMPRESS40_BAD_REGION if the pixel is outside the image
+ * Note:        It is a CRE for offset to be NULL
+ */
+extern Compress40_status compress40_word_offset(const uint8_t *comp, 
+                                                size_t len, unsigned col,
+                                                unsigned row, size_t *offset)
+{
+    assert(offset != NULL);
+
+    unsigned width, height;
+    size_t words_offset;
+    bool binary;
+    if (!Comp_img_locate(comp, len, &width, &height, &words_offset, 
+                         &binary)) {
+        return COMPRESS40_BAD_FORMAT;
+    }
+    if (col >= width || row >= height) {
+        return COMPRESS40_BAD_REGION;
+    }
+
+    *offset = words_offset + 
+              ((size_t) (row / 2) * (width / 2) + col / 2) * 4;
+    return COMPRESS40_OK;
+}
+
+
+/* decompress40_crop
+ * Purpose:     Decodes (or copies, still compressed) one rectangle of a 
+ *                  compressed image held in memory, touching only the 
+ *                  words of the blocks that cover it
+ * Parameters:  const uint8_t *comp, size_t len: the compressed image, 
+ *                  which may be a mapped file
+ *              Compress40_rect rect: the pixels wanted; clipped to the image
+ *              bool keep_compressed: true to output the covering blocks as
+ *                  a compressed image instead of decoding them
+ *              uint8_t **buf, size_t *cap: the output buffer and its size,
+ *                  grown with RESIZE when the output would not fit
+ *              size_t *outlen: set to the size of the output
+ * Returns:     COMPRESS40_OK, COMPRESS40_BAD_FORMAT, or 
+ *                  COMPRESS40_BAD_REGION if rect misses the image entirely
+ * Note:        It is a CRE for buf, cap or outlen to be NULL
+ */
+extern Compress40_status decompress40_crop(const uint8_t *comp, size_t len,
+                                           Compress40_rect rect, 
+                                           bool keep_compressed,
+                                           uint8_t **buf, size_t *cap,
+                                           size_t *outlen)
+{
+    assert(buf != NULL && cap != NULL && outlen != NULL);
+
+    unsigned width, height;
+    if (compress40_size(comp, len, &width, &height) != COMPRESS40_OK) {
+        return COMPRESS40_BAD_FORMAT;
+    }
+    if (rect.x >= width || rect.y >= height || rect.w == 0 || rect.h == 0) {
+        return COMPRESS40_BAD_REGION;
+    }
+    rect.w = rect.w < width - rect.x ? rect.w : width - rect.x;
+    rect.h = rect.h < height - rect.y ? rect.h : height - rect.y;
+
+    /* grow the rectangle out to whole blocks */
+    unsigned col = rect.x & ~1u, row = rect.y & ~1u;
+    unsigned blk_width = evenify(rect.x + rect.w + 1) - col;
+    unsigned blk_height = evenify(rect.y + rect.h + 1) - row;
+
+    Comp_img region = Comp_img_parse_region_in(pipeline_arena(), comp, len,
+                                               col, row, 
+                                               blk_width, blk_height);
+    assert(region != NULL);
+
+    if (keep_compressed) {
+        *outlen = Comp_img_serialized_size(blk_width, blk_height);
+        grow_buffer(buf, cap, *outlen);
+        Comp_img_serialize(region, *buf);
+    } else {
+        *outlen = decompressed_size(rect.w, rect.h);
+        grow_buffer(buf, cap, *outlen);
+
+        XYZ_img xyz_img = xyz_decompress_in(pipeline_arena(), region);
+        size_t header_len = Ppm_write_header(*buf, rect.w, rect.h, 255);
+        xyz_to_raster_crop(xyz_img, *buf + header_len, rect.x - col, 
+                           rect.y - row, rect.w, rect.h);
+    }
+
+    Img_arena_reset(pipeline_arena());
+    return COMPRESS40_OK;
+}
+
+
+/* decompress40_preview
+ * Purpose:     Decodes a reduced-resolution preview of a compressed image
+ *                  held in memory, without the inverse Haar transform
+ * Parameters:  const uint8_t *comp, size_t len: the compressed image
+ *              unsigned shrink: the scale divisor (2 for half size)
+ *              uint8_t **buf, size_t *cap: the output buffer and its size,
+ *                  grown with RESIZE when the output would not fit
+ *              size_t *outlen: set to the size of the P6 ppm
+ * Returns:     COMPRESS40_OK or COMPRESS40_BAD_FORMAT
+ * Note:        It is a CRE for buf, cap or outlen to be NULL, or for 
+ *                  shrink to be odd or < 2
+ */
+extern Compress40_status decompress40_preview(const uint8_t *comp, 
+                                              size_t len, unsigned shrink,
+                                              uint8_t **buf, size_t *cap,
+                                              size_t *outlen)
+{
+    assert(buf != NULL && cap != NULL && outlen != NULL);
+
+    Comp_img compressed_img = parse_compressed(comp, len);
+    if (compressed_img == NULL) {
+        Img_arena_reset(pipeline_arena());
+        return parse_failure(comp, len);
+    }
+
+    unsigned width, height;
+    Comp_preview_size(compressed_img, shrink, &width, &height);
+    *outlen = decompressed_size(width, height);
+    grow_buffer(buf, cap, *outlen);
+
+    size_t header_len = Ppm_write_header(*buf, width, height, 255);
+    Comp_preview(compressed_img, shrink, *buf + header_len);
+
+    Img_arena_reset(pipeline_arena());
+    return COMPRESS40_OK;
+}
+
+
+/* compress40_yuv
+ * Purpose:     Compresses a raw YUV 4:2:0 image held in memory straight
+ *                  from its planes
+ * Parameters:  const uint8_t *yuv, size_t len: the Y plane, then the 
+ *                  chroma as layout says
+ *              Compress40_yuv_layout layout: COMPRESS40_I420 or 
+ *                  COMPRESS40_NV12
+ *              unsigned width, height: the image's size in pixels
+ *              bool full_range: true for full range samples, false for
+ *                  BT.601 limited range
+ *              uint8_t **buf, size_t *cap: the output buffer and its size,
+ *                  grown with RESIZE when the output would not fit
+ *              size_t *outlen: set to the size of the compressed image
+ * Returns:     COMPRESS40_OK or COMPRESS40_BAD_FORMAT
+ * Note:        It is a CRE for buf, cap or outlen to be NULL
+ */
+extern Compress40_status compress40_yuv(const uint8_t *yuv, size_t len,
+                                        Compress40_yuv_layout layout,
+                                        unsigned width, unsigned height,
+                                        bool full_range, uint8_t **buf,
+                                        size_t *cap, size_t *outlen)
+{
+    assert(buf != NULL && cap != NULL && outlen != NULL);
+
+    size_t luma_size = (size_t) width * height;
+    size_t c_width = ((size_t) width + 1) / 2;
+    size_t c_height = ((size_t) height + 1) / 2;
+    if (yuv == NULL || width < 2 || height < 2 ||
+        width > SIZE_MAX / 2 / height ||
+        len < luma_size + 2 * c_width * c_height) {
+        return COMPRESS40_BAD_FORMAT;
+    }
+
+    Comp_yuv_planes planes = { yuv, yuv + luma_size, NULL, width, c_width,
+                               1, 1, 1, full_range };
+    if (layout == COMPRESS40_I420) {
+        planes.cr = planes.cb + c_width * c_height;
+    } else {
+        planes.cr = planes.cb + 1;
+        planes.c_stride = 2 * c_width;
+        planes.c_step = 2;
+    }
+
+    Comp_img img = Comp_yuv_compress_in(pipeline_arena(), &planes, width,
+                                        height);
+    *outlen = Comp_img_serialized_size(Comp_img_width(img),
+                                       Comp_img_height(img));
+    grow_buffer(buf, cap, *outlen);
+    Comp_img_serialize(img, *buf);
+
+    Img_arena_reset(pipeline_arena());
+    return COMPRESS40_OK;
+}
+
+
+/* compress40_y4m
+ * Purpose:     Compresses the first frame of a Y4M stream held in memory
+ *                  straight from its planes
+ * Parameters:  const uint8_t *y4m, size_t len: the Y4M stream
+ *              uint8_t **buf, size_t *cap: the output buffer and its size,
+ *                  grown with RESIZE when the output would not fit
+ *              size_t *outlen: set to the size of the compressed image
+ * Returns:     COMPRESS40_OK or COMPRESS40_BAD_FORMAT
+ * Note:        It is a CRE for buf, cap or outlen to be NULL
+ */
+extern Compress40_status compress40_y4m(const uint8_t *y4m, size_t len,
+                                        uint8_t **buf, size_t *cap,
+                                        size_t *outlen)
+{
+    assert(buf != NULL && cap != NULL && outlen != NULL);
+
+    Comp_yuv_planes planes;
+    unsigned width, height;
+    if (!Comp_yuv_parse_y4m(y4m, len, &planes, &width, &height)) {
+        return COMPRESS40_BAD_FORMAT;
+    }
+
+    Comp_img img = Comp_yuv_compress_in(pipeline_arena(), &planes, width,
+                                        height);
+    *outlen = Comp_img_serialized_size(Comp_img_width(img),
+                                       Comp_img_height(img));
+    grow_buffer(buf, cap, *outlen);
+    Comp_img_serialize(img, *buf);
+
+    Img_arena_reset(pipeline_arena());
+    return COMPRESS40_OK;
+}
+
+
+/* decompress40_yuv420
+ * Purpose:     Decodes a compressed image held in memory to planar YUV 
+ *                  4:2:0 (I420) without converting it to RGB
+ * Parameters:  const uint8_t *comp, size_t len: the compressed image
+ *              bool full_range: true for full range samples, false for
+ *                  BT.601 limited range
+ *              uint8_t **buf, size_t *cap: the output buffer and its size,
+ *                  grown with RESIZE when the output would not fit
+ *              size_t *outlen: set to the size of the Y, Cb and Cr planes
+ * Returns:     COMPRESS40_OK, COMPRESS40_BAD_FORMAT or 
+ *                  COMPRESS40_BAD_CHECKSUM
+ * Note:        It is a CRE for buf, cap or outlen to be NULL
+ */
+extern Compress40_status decompress40_yuv420(const uint8_t *comp, 
+                                             size_t len, bool full_range,
+                                             uint8_t **buf, size_t *cap,
+                                             size_t *outlen)
+{
+    assert(buf != NULL && cap != NULL && outlen != NULL);
+
+    Comp_img compressed_img = parse_compressed(comp, len);
+    if (compressed_img == NULL) {
+        Img_arena_reset(pipeline_arena());
+        return parse_failure(comp, len);
+    }
+
+    *outlen = Comp_yuv_size(Comp_img_width(compressed_img),
+                            Comp_img_height(compressed_img));
+    grow_buffer(buf, cap, *outlen);
+    Comp_yuv_i420(compressed_img, full_range, *buf);
+
+    Img_arena_reset(pipeline_arena());
+    return COMPRESS40_OK;
+}
+
+
+/* decompress40_16bit
+ * Purpose:     Decompresses a compressed image held in memory into a P6 ppm
+ *                  with maxval 65535
+ * Parameters:  const uint8_t *comp, size_t len: the compressed image
+ *              uint8_t **buf, size_t *cap: the output buffer and its size,
+ *                  grown with RESIZE when the output would not fit
+ *              size_t *outlen: set to the size of the ppm
+ * Returns:     COMPRESS40_OK, COMPRESS40_BAD_FORMAT or 
+ *                  COMPRESS40_BAD_CHECKSUM
+ * Note:        It is a CRE for buf, cap or outlen to be NULL
+ */
+extern Compress40_status decompress40_16bit(const uint8_t *comp, size_t len,
+                                            uint8_t **buf, size_t *cap,
+                                            size_t *outlen)
+{
+    assert(buf != NULL && cap != NULL && outlen != NULL);
+
+    /* a profile image is decoded at its profile's precision */
+    XYZ_img xyz_img = Comp_profile_decode_in(pipeline_arena(), comp, len);
+    if (xyz_img == NULL) {
+        Comp_img compressed_img = parse_compressed(comp, len);
+        if (compressed_img == NULL) {
+            Img_arena_reset(pipeline_arena());
+            return parse_failure(comp, len);
+        }
+        xyz_img = xyz_decompress_in(pipeline_arena(), compressed_img);
+    }
+
+    unsigned width = XYZ_img_width(xyz_img);
+    unsigned height = XYZ_img_height(xyz_img);
+    size_t header_len = Ppm_write_header(NULL, width, height, 65535);
+    *outlen = header_len + (size_t) width * height * 6;
+    grow_buffer(buf, cap, *outlen);
+
+    Ppm_write_header(*buf, width, height, 65535);
+    xyz_to_raster16(xyz_img, *buf + header_len);
+
+    Img_arena_reset(pipeline_arena());
+    return COMPRESS40_OK;
+}
+
+
+/* compress40_transform
+ * Purpose:     Rotates, flips or transposes a compressed image held in 
+ *                  memory without decoding it
+ * Parameters:  const uint8_t *comp, size_t len: the compressed image
+ *              Compress40_transform transform: the transform to apply
+ *              uint8_t **buf, size_t *cap: the output buffer and its size,
+ *                  grown with RESIZE when the output would not fit
+ *              size_t *outlen: set to the size of the new compressed image
+ * Returns:     COMPRESS40_OK or COMPRESS40_BAD_FORMAT
+ * Note:        It is a CRE for buf, cap or outlen to be NULL
+ */
+extern Compress40_status compress40_transform(const uint8_t *comp, 
+                                              size_t len,
+                                              Compress40_transform transform,
+                                              uint8_t **buf, size_t *cap,
+                                              size_t *outlen)
+{
+    assert(buf != NULL && cap != NULL && outlen != NULL);
+
+    Comp_img compressed_img = parse_compressed(comp, len);
+    if (compressed_img == NULL) {
+        Img_arena_reset(pipeline_arena());
+        return parse_failure(comp, len);
+    }
+
+    Comp_img transformed = Comp_img_transform_in(pipeline_arena(), 
+                                                 compressed_img, transform);
+    *outlen = Comp_img_serialized_size(Comp_img_width(transformed),
+                                       Comp_img_height(transformed));
+    grow_buffer(buf, cap, *outlen);
+    *outlen = Comp_img_serialize(transformed, *buf);
+    seal_output(buf, cap, 0, outlen, input_sealed(comp, len));
+
+    Img_arena_reset(pipeline_arena());
+    return COMPRESS40_OK;
+}
+
+
+/* compress40_downscale
+ * Purpose:     Builds half-size (and, optionally, smaller) renditions of a 
+ *                  compressed image held in memory straight from its words
+ * Parameters:  const uint8_t *comp, size_t len: the compressed image
+ *              unsigned levels: how many times to halve the image, or 0 to
+ *                  build the whole mip pyramid
+ *              uint8_t **buf, size_t *cap: the output buffer and its size,
+ *                  grown with RESIZE when the output would not fit
+ *              size_t *outlen: set to the total size of the renditions
+ * Returns:     COMPRESS40_OK, COMPRESS40_BAD_FORMAT, or 
+ *                  COMPRESS40_BAD_REGION if the image is under 4x4 pixels
+ * Note:        It is a CRE for buf, cap or outlen to be NULL
+ *              Each level is built from the level above it, which is a 
+ *                  quarter of its size, so the whole pyramid costs about a
+ *                  third more than the first level alone
+ */
+extern Compress40_status compress40_downscale(const uint8_t *comp, 
+                                              size_t len, unsigned levels,
+                                              uint8_t **buf, size_t *cap,
+                                              size_t *outlen)
+{
+    assert(buf != NULL && cap != NULL && outlen != NULL);
+
+    Comp_img level = parse_compressed(comp, len);
+    if (level == NULL) {
+        Img_arena_reset(pipeline_arena());
+        return parse_failure(comp, len);
+    }
+
+    bool sealed = input_sealed(comp, len);
+    *outlen = 0;
+    for (unsigned i = 0; levels == 0 || i < levels; i++) {
+        level = Comp_img_downscale_in(pipeline_arena(), level);
+        if (level == NULL) {
+            break;
+        }
+
+        size_t start = *outlen;
+        size_t size = Comp_img_serialized_size(Comp_img_width(level),
+                                               Comp_img_height(level));
+        grow_buffer(buf, cap, start + size);
+        *outlen += Comp_img_serialize(level, *buf + start);
+        seal_output(buf, cap, start, outlen, sealed);
+    }
+
+    Img_arena_reset(pipeline_arena());
+    return *outlen > 0 ? COMPRESS40_OK : COMPRESS40_BAD_REGION;
+}
+
+
+/* compress40_adjust
+ * Purpose:     Adjusts the brightness, contrast and saturation of a 
+ *                  compressed image in place, working on its codewords only
+ * Parameters:  uint8_t *comp, size_t len: the compressed image
+ *              Compress40_adjustment adj: the adjustment
+ *              size_t *saturated: set to the number of clamped coefficients
+ * Returns:     COMPRESS40_OK or COMPRESS40_BAD_FORMAT
+ * Note:        It is a CRE for saturated to be NULL
+ */
+extern Compress40_status compress40_adjust(uint8_t *comp, size_t len,
+                                           Compress40_adjustment adj,
+                                           size_t *saturated)
+{
+    assert(saturated != NULL);
+
+    unsigned width, height;
+    size_t offset, trailer;
+    bool binary;
+    if (!Comp_img_locate(comp, len, &width, &height, &offset, &binary)) {
+        return COMPRESS40_BAD_FORMAT;
+    }
+    if (!Comp_img_verify(comp, len, &trailer)) {
+        return COMPRESS40_BAD_CHECKSUM;
+    }
+
+    *saturated = Comp_adjust_words(comp + offset, 
+                                   (size_t) (width / 2) * (height / 2), 
+                                   binary, adj);
+    Comp_img_reseal(comp, len);
+    return COMPRESS40_OK;
+}
+
+
+/* compress40_stats
+ * Purpose:     Summarizes a compressed image held in memory as JSON without
+ *                  decoding it
+ * Parameters:  const uint8_t *comp, size_t len: the compressed image
+ *              int nthreads: the number of threads to scan with, or < 1 for
+ *                  one per CPU
+ *              uint8_t **buf, size_t *cap: the output buffer and its size,
+ *                  grown with RESIZE when the output would not fit
+ *              size_t *outlen: set to the length of the JSON
+ * Returns:     COMPRESS40_OK or COMPRESS40_BAD_FORMAT
+ * Note:        It is a CRE for buf, cap or outlen to be NULL
+ */
+extern Compress40_status compress40_stats(const uint8_t *comp, size_t len,
+                                          int nthreads, uint8_t **buf, 
+                                          size_t *cap, size_t *outlen)
+{
+    assert(buf != NULL && cap != NULL && outlen != NULL);
+
+    unsigned width, height;
+    size_t offset;
+    bool binary;
+    if (!Comp_img_locate(comp, len, &width, &height, &offset, &binary)) {
+        return COMPRESS40_BAD_FORMAT;
+    }
+
+    Comp_stats stats;
+    Comp_stats_scan(comp + offset, binary, width, height, nthreads, &stats);
+
+    grow_buffer(buf, cap, COMP_STATS_JSON_MAX);
+    *outlen = Comp_stats_json(&stats, (char *) *buf, *cap);
+    return COMPRESS40_OK;
+}
+
+
+/* compress40_hash
+ * Purpose:     Computes the perceptual hash of a compressed image held in 
+ *                  memory without decoding it
+ * Parameters:  const uint8_t *comp, size_t len: the compressed image
+ *              uint64_t *hash: set to the hash
+ * Returns:     COMPRESS40_OK or COMPRESS40_BAD_FORMAT
+ * Note:        It is a CRE for hash to be NULL
+ */
+extern Compress40_status compress40_hash(const uint8_t *comp, size_t len,
+                                         uint64_t *hash)
+{
+    assert(hash != NULL);
+
+    unsigned width, height;
+    size_t offset;
+    bool binary;
+    if (!Comp_img_locate(comp, len, &width, &height, &offset, &binary)) {
+        return COMPRESS40_BAD_FORMAT;
+    }
+
+    *hash = Comp_hash(comp + offset, binary, width, height);
+    return COMPRESS40_OK;
+}
+
+
+/* compress40_blend
+ * Purpose:     Blends one compressed image into another at a block-aligned
+ *                  offset, working on their codewords only
+ * Parameters:  const uint8_t *base, size_t base_len: the image blended 
+ *                  into
+ *              const uint8_t *overlay, size_t overlay_len: the image 
+ *                  blended in
+ *              unsigned x, y: where the overlay's top left pixel goes
+ *              float alpha: the overlay's weight
+ *              int nthreads: the number of threads, or < 1 for one per CPU
+ *              uint8_t **buf, size_t *cap: the output buffer and its size,
+ *                  grown with RESIZE when the output would not fit
+ *              size_t *outlen: set to the size of the blended image
+ * Returns:     COMPRESS40_OK, COMPRESS40_BAD_FORMAT, 
+ *                  COMPRESS40_BAD_CHECKSUM if either image fails its 
+ *                  trailer, or COMPRESS40_BAD_REGION if (x, y) is not 
+ *                  block-aligned or the overlay does not overlap base
+ * Note:        It is a CRE for buf, cap or outlen to be NULL or for alpha
+ *                  to be outside [0, 1]
+ *              The output is base's bytes with the overlapped words 
+ *                  rewritten, so it has base's header and size, and it is
+ *                  sealed if either input was
+ */
+extern Compress40_status compress40_blend(const uint8_t *base, 
+                                          size_t base_len,
+                                          const uint8_t *overlay, 
+                                          size_t overlay_len,
+                                          unsigned x, unsigned y, 
+                                          float alpha, int nthreads,
+                                          uint8_t **buf, size_t *cap,
+                                          size_t *outlen)
+{
+    assert(buf != NULL && cap != NULL && outlen != NULL);
+
+    unsigned bw, bh, ow, oh;
+    size_t base_offset, overlay_offset, trailer;
+    bool base_binary, overlay_binary;
+    if (!Comp_img_locate(base, base_len, &bw, &bh, &base_offset, 
+                         &base_binary) ||
+        !Comp_img_locate(overlay, overlay_len, &ow, &oh, &overlay_offset, 
+                         &overlay_binary)) {
+        return COMPRESS40_BAD_FORMAT;
+    }
+    if (!Comp_img_verify(base, base_len, &trailer) ||
+        !Comp_img_verify(overlay, overlay_len, &trailer)) {
+        return COMPRESS40_BAD_CHECKSUM;
+    }
+    if (x % 2 != 0 || y % 2 != 0 || x >= bw || y >= bh) {
+        return COMPRESS40_BAD_REGION;
+    }
+
+    size_t cols = (x + ow < bw ? ow : bw - x) / 2;
+    size_t rows = (y + oh < bh ? oh : bh - y) / 2;
+    if (cols == 0 || rows == 0) {
+        return COMPRESS40_BAD_REGION;
+    }
+
+    *outlen = base_offset + (size_t) (bw / 2) * (bh / 2) * 4;
+    grow_buffer(buf, cap, *outlen + Comp_img_trailer_size());
+    memcpy(*buf, base, *outlen);
+
+    uint8_t *words = *buf + base_offset + 
+                     ((size_t) (y / 2) * (bw / 2) + x / 2) * 4;
+    Comp_blend_words(words, bw / 2, base_binary, overlay + overlay_offset,
+                     ow / 2, overlay_binary, rows, cols, alpha, nthreads);
+    *outlen = Comp_img_seal(*buf, *outlen);
+    seal_output(buf, cap, 0, outlen, input_sealed(base, base_len) || 
+                                     input_sealed(overlay, overlay_len));
+    return COMPRESS40_OK;
+}
+
+
+/* compress40_mosaic
+ * Purpose:     Lays several compressed images out on one compressed canvas
+ *                  without decoding them
+ * Parameters:  const Compress40_tile *tiles, unsigned ntiles: the images 
+ *                  and where they go
+ *              unsigned width, height: the canvas's size in pixels
+ *              float fill: the gray level of blocks no image covers
+ *              uint8_t **buf, size_t *cap: the output buffer and its size,
+ *                  grown with RESIZE when the output would not fit
+ *              size_t *outlen: set to the size of the canvas
+ * Returns:     COMPRESS40_OK, COMPRESS40_BAD_FORMAT if a tile is not a 
+ *                  compressed image, COMPRESS40_BAD_CHECKSUM if a tile 
+ *                  fails its trailer, or COMPRESS40_BAD_REGION if a tile 
+ *                  is not block-aligned or the canvas is empty
+ * Note:        It is a CRE for buf, cap or outlen to be NULL, or for tiles
+ *                  to be NULL while ntiles > 0
+ *              The canvas is sealed if any tile was
+ */
+extern Compress40_status compress40_mosaic(const Compress40_tile *tiles,
+                                           unsigned ntiles, unsigned width,
+                                           unsigned height, float fill,
+                                           uint8_t **buf, size_t *cap,
+                                           size_t *outlen)
+{
+    assert(buf != NULL && cap != NULL && outlen != NULL);
+    assert(tiles != NULL || ntiles == 0);
+
+    width -= width % 2;
+    height -= height % 2;
+    if (width == 0 || height == 0) {
+        return COMPRESS40_BAD_REGION;
+    }
+
+    Comp_tile *placed = ALLOC((ntiles > 0 ? ntiles : 1) * sizeof(*placed));
+    Compress40_status status = COMPRESS40_OK;
+    bool sealed = false;
+    for (unsigned i = 0; i < ntiles && status == COMPRESS40_OK; i++) {
+        size_t offset, trailer;
+        placed[i].x = tiles[i].x;
+        placed[i].y = tiles[i].y;
+        if (!Comp_img_locate(tiles[i].comp, tiles[i].len, &placed[i].width,
+                             &placed[i].height, &offset, 
+                             &placed[i].little)) {
+            status = COMPRESS40_BAD_FORMAT;
+        } else if (!Comp_img_verify(tiles[i].comp, tiles[i].len, 
+                                    &trailer)) {
+            status = COMPRESS40_BAD_CHECKSUM;
+        } else if (tiles[i].x % 2 != 0 || tiles[i].y % 2 != 0) {
+            status = COMPRESS40_BAD_REGION;
+        } else {
+            placed[i].words = tiles[i].comp + offset;
+            sealed = sealed || trailer != 0;
+        }
+    }
+
+    if (status == COMPRESS40_OK) {
+        int gray = Arith40_index_of_chroma(0.0);
+        Codeword blank = { Codeword_quantize_luma(fill), 0, 0, 0, 
+                           gray, gray };
+
+        grow_buffer(buf, cap, Comp_img_serialized_size(width, height));
+        size_t header = Comp_img_serialize_header(width, height, *buf);
+        Comp_mosaic(*buf + header, width, height, placed, ntiles, 
+                    Codeword_pack(blank));
+        *outlen = Comp_img_seal(*buf, header + (size_t) (width / 2) * 
+                                               (height / 2) * 4);
+        seal_output(buf, cap, 0, outlen, sealed);
+    }
+
+    FREE(placed);
+    return status;
+}
+
+
+/* compress40_patch
+ * Purpose:     Re-encodes the blocks of a compressed image held in memory 
+ *                  that a ppm patch covers, in place
+ * Parameters:  uint8_t *comp, size_t len: the compressed image
+ *              const uint8_t *patch, size_t patch_len: the P6 ppm patch
+ *              unsigned x, y: where the patch's top left pixel goes
+ *              Compress40_rect *dirty: set to the pixels whose blocks were
+ *                  rewritten, grown out to the 2x2 block grid
+ * Returns:     COMPRESS40_OK, COMPRESS40_BAD_FORMAT, or 
+ *                  COMPRESS40_BAD_REGION if (x, y) is outside the image
+ * Note:        It is a CRE for dirty to be NULL
+ *              Only the block rows and columns under the patch are read or
+ *                  written, so the cost follows the patch's size and comp 
+ *                  may be a mapped file far larger than memory. Blocks the
+ *                  patch covers entirely encode exactly as compress40 would
+ *                  encode the same pixels
+ */
+extern Compress40_status compress40_patch(uint8_t *comp, size_t len,
+                                          const uint8_t *patch, 
+                                          size_t patch_len, unsigned x,
+                                          unsigned y, Compress40_rect *dirty)
+{
+    assert(dirty != NULL);
+
+    unsigned width, height;
+    size_t offset, trailer;
+    bool binary;
+    Ppm_header hdr;
+    if (!Comp_img_locate(comp, len, &width, &height, &offset, &binary) ||
+        !Ppm_parse_header(patch, patch_len, &hdr)) {
+        return COMPRESS40_BAD_FORMAT;
+    }
+    if (!Comp_img_verify(comp, len, &trailer)) {
+        return COMPRESS40_BAD_CHECKSUM;
+    }
+    if (x >= width || y >= height || hdr.width == 0 || hdr.height == 0) {
+        return COMPRESS40_BAD_REGION;
+    }
+    unsigned w = hdr.width < width - x ? hdr.width : width - x;
+    unsigned h = hdr.height < height - y ? hdr.height : height - y;
+
+    /* grow the patch out to whole blocks */
+    unsigned col = x & ~1u, row = y & ~1u;
+    unsigned blk_width = evenify(x + w + 1) - col;
+    unsigned blk_height = evenify(y + h + 1) - row;
+    size_t stride = (size_t) blk_width * 3;
+    uint8_t *raster = Img_arena_alloc(pipeline_arena(), 
+                                      stride * blk_height);
+
+    if (w != blk_width || h != blk_height) {
+        Comp_img old = Comp_img_parse_region_in(pipeline_arena(), comp, len,
+                                                col, row, blk_width, 
+                                                blk_height);
+        assert(old != NULL);
+        xyz_to_raster(xyz_decompress_in(pipeline_arena(), old), raster);
+    }
+    merge_patch(raster + (y - row) * stride + (x - col) * 3, stride, 
+                patch + hdr.raster_offset, &hdr, w, h);
+
+    XYZ_img xyz_img = raster_to_xyz_in(pipeline_arena(), raster, blk_width,
+                                       blk_height, 255);
+    Comp_img patched = xyz_compress_in(pipeline_arena(), xyz_img);
+    const uint32_t *words = Comp_img_words(patched);
+
+    for (unsigned r = 0; r < blk_height / 2; r++) {
+        uint8_t *out = comp + offset + 
+                       ((size_t) (row / 2 + r) * (width / 2) + col / 2) * 4;
+        for (unsigned c = 0; c < blk_width / 2; c++, words++, out += 4) {
+            Codeword_store(out, *words, binary);
+        }
+    }
+
+    *dirty = (Compress40_rect) { col, row, blk_width, blk_height };
+    Comp_img_reseal(comp, len);
+    Img_arena_reset(pipeline_arena());
+    return COMPRESS40_OK;
+}
+
+
+/* compress40_pack
+ * Purpose:     Entropy codes a compressed image held in memory
+ * Parameters:  const uint8_t *comp, size_t len: the compressed image
+ *              int nthreads: the number of threads, or < 1 for one per CPU
+ *              uint8_t **buf, size_t *cap: the output buffer and its size,
+ *                  grown with RESIZE when the output would not fit
+ *              size_t *outlen: set to the size of the entropy-coded image
+ * Returns:     COMPRESS40_OK or COMPRESS40_BAD_FORMAT
+ * Note:        It is a CRE for buf, cap or outlen to be NULL
+ */
+extern Compress40_status compress40_pack(const uint8_t *comp, size_t len,
+                                         int nthreads, uint8_t **buf,
+                                         size_t *cap, size_t *outlen)
+{
+    assert(buf != NULL && cap != NULL && outlen != NULL);
+
+    unsigned width, height;
+    size_t offset, trailer;
+    bool binary;
+    if (!Comp_img_locate(comp, len, &width, &height, &offset, &binary)) {
+        return COMPRESS40_BAD_FORMAT;
+    }
+    if (!Comp_img_verify(comp, len, &trailer)) {
+        return COMPRESS40_BAD_CHECKSUM;
+    }
+
+    grow_buffer(buf, cap, Comp_entropy_bound(width, height) + 
+                          COMPRESS40_TRAILER_SIZE);
+    *outlen = Comp_entropy_encode(comp + offset, binary, width, height, 
+                                  nthreads, *buf);
+    if (trailer != 0 || Comp_img_trailer_size() > 0) {
+        *outlen = Comp_entropy_seal(*buf, *outlen);
+    }
+    return COMPRESS40_OK;
+}
+
+
+/* compress40_unpack
+ * Purpose:     Decodes an entropy-coded image held in memory back into the
+ *                  plain compressed format
+ * Parameters:  const uint8_t *comp, size_t len: the entropy-coded image
+ *              int nthreads: the number of threads, or < 1 for one per CPU
+ *              uint8_t **buf, size_t *cap: the output buffer and its size,
+ *                  grown with RESIZE when the output would not fit
+ *              size_t *outlen: set to the size of the compressed image
+ * Returns:     COMPRESS40_OK or COMPRESS40_BAD_FORMAT
+ * Note:        It is a CRE for buf, cap or outlen to be NULL
+ */
+extern Compress40_status compress40_unpack(const uint8_t *comp, size_t len,
+                                           int nthreads, uint8_t **buf,
+                                           size_t *cap, size_t *outlen)
+{
+    assert(buf != NULL && cap != NULL && outlen != NULL);
+
+    Comp_img img = Comp_entropy_decode_in(pipeline_arena(), comp, len,
+                                          nthreads);
+    if (img == NULL) {
+        Img_arena_reset(pipeline_arena());
+        return parse_failure(comp, len);
+    }
+
+    *outlen = Comp_img_serialized_size(Comp_img_width(img),
+                                       Comp_img_height(img));
+    grow_buffer(buf, cap, *outlen);
+    *outlen = Comp_img_serialize(img, *buf);
+    seal_output(buf, cap, 0, outlen, input_sealed(comp, len));
+
+    Img_arena_reset(pipeline_arena());
+    return COMPRESS40_OK;
+}
+
+
+/* compress40_convert
+ * Purpose:     Rewrites a compressed image held in memory in format 2 
+ *                  (text header, big-endian words) or format 3 (binary 
+ *                  header, aligned little-endian words)
+ * Parameters:  const uint8_t *comp, size_t len: the compressed image, in 
+ *                  any format decompress40 reads
+ *              unsigned format: 2 or 3
+ *              uint8_t **buf, size_t *cap: the output buffer and its size,
+ *                  grown with RESIZE when the output would not fit
+ *              size_t *outlen: set to the size of the converted image
+ * Returns:     COMPRESS40_OK or COMPRESS40_BAD_FORMAT
+ * Note:        It is a CRE for buf, cap or outlen to be NULL, or for 
+ *                  format to be neither 2 nor 3
+ *              Format 2 goes to format 3 a word at a time with no Comp_img,
+ *                  so converting costs one pass over the words
+ */
+extern Compress40_status compress40_convert(const uint8_t *comp, size_t len,
+                                            unsigned format, uint8_t **buf,
+                                            size_t *cap, size_t *outlen)
+{
+    assert(buf != NULL && cap != NULL && outlen != NULL);
+    assert(format == 2 || format == 3);
+
+    unsigned width, height;
+    size_t offset, trailer;
+    if (format == 3 && 
+        Comp_img_parse_header(comp, len, &width, &height, &offset) &&
+        Comp_img_verify(comp, len, &trailer)) {
+        size_t nwords = (size_t) (width / 2) * (height / 2);
+        grow_buffer(buf, cap, Comp_img_binary_size(width, height) + 
+                              COMPRESS40_TRAILER_SIZE);
+        size_t header = Comp_img_serialize_binary_header(width, height, 
+                                                         *buf);
+        swap_words(comp + offset, nwords, *buf + header);
+        *outlen = Comp_img_seal_if(*buf, header + nwords * 4, trailer != 0);
+        return COMPRESS40_OK;
+    }
+
+    Comp_img img = parse_compressed(comp, len);
+    if (img == NULL) {
+        Img_arena_reset(pipeline_arena());
+        return parse_failure(comp, len);
+    }
+
+    width = Comp_img_width(img);
+    height = Comp_img_height(img);
+    if (format == 3) {
+        grow_buffer(buf, cap, Comp_img_binary_size(width, height));
+        *outlen = Comp_img_serialize_binary(img, *buf);
+    } else {
+        grow_buffer(buf, cap, Comp_img_serialized_size(width, height));
+        *outlen = Comp_img_serialize(img, *buf);
+    }
+    seal_output(buf, cap, 0, outlen, input_sealed(comp, len));
+
+    Img_arena_reset(pipeline_arena());
+    return COMPRESS40_OK;
+}
+
+
+/* compress40_set_checksums
+ * Purpose:     Turns CRC-32C trailers on or off for every compressed image 
+ *                  written from now on
+ */
+extern void compress40_set_checksums(bool on)
+{
+    Comp_img_set_checksums(on);
+}
+
+
+/* compress40_set_profile
+ * Purpose:     Chooses the quantization profile every image compressed from
+ *                  now on is coded with
+ * Parameters:  const char *name: the profile's name; "standard" selects
+ *                  format 2
+ * Returns:     bool: false, leaving the profile alone, if there is no 
+ *                  profile called name
+ */
+extern bool compress40_set_profile(const char *name)
+{
+    const Comp_profile *named = Comp_profile_named(name);
+    if (named == NULL) {
+        return false;
+    }
+
+    profile = strcmp(name, "standard") == 0 ? NULL : named;
+    return true;
+}
+
+
+/* compress40_verify
+ * Purpose:     Checks a compressed image held in memory against its 
+ *                  checksum trailer without decoding it
+ * Parameters:  const uint8_t *comp, size_t len: the compressed image, in 
+ *                  format 2 or 3
+ *              size_t *trailer: set to the offset of its trailer, or 0 if 
+ *                  it has none
+ * Returns:     COMPRESS40_OK, COMPRESS40_BAD_FORMAT, or 
+ *                  COMPRESS40_BAD_CHECKSUM if the trailer does not match
+ * Note:        It is a CRE for trailer to be NULL
+ */
+extern Compress40_status compress40_verify(const uint8_t *comp, size_t len,
+                                           size_t *trailer)
+{
+    assert(trailer != NULL);
+
+    unsigned width, height;
+    *trailer = 0;
+    if (Comp_entropy_is(comp, len)) {
+        return Comp_entropy_verify(comp, len, trailer) ? COMPRESS40_OK :
+               *trailer != 0 ? COMPRESS40_BAD_CHECKSUM 
+                             : COMPRESS40_BAD_FORMAT;
+    }
+    if (Comp_gray_is(comp, len)) {
+        return Comp_gray_verify(comp, len, trailer) ? COMPRESS40_OK :
+               *trailer != 0 ? COMPRESS40_BAD_CHECKSUM 
+                             : COMPRESS40_BAD_FORMAT;
+    }
+    if (Comp_profile_is(comp, len)) {
+        return Comp_profile_verify(comp, len, trailer) ? COMPRESS40_OK :
+               *trailer != 0 ? COMPRESS40_BAD_CHECKSUM 
+                             : COMPRESS40_BAD_FORMAT;
+    }
+    if (compress40_size(comp, len, &width, &height) != COMPRESS40_OK) {
+        return COMPRESS40_BAD_FORMAT;
+    }
+    return Comp_img_verify(comp, len, trailer) ? COMPRESS40_OK 
+                                                : COMPRESS40_BAD_CHECKSUM;
+}
+
+
+/* compress40_delta
+ * Purpose:     Codes a compressed image as a delta frame against a 
+ *                  reference image of the same size
+ * Parameters:  const uint8_t *ref, size_t ref_len: the reference image
+ *              const uint8_t *comp, size_t len: the image to code
+ *              uint8_t **buf, size_t *cap: the output buffer and its size,
+ *                  grown with RESIZE when the output would not fit
+ *              size_t *outlen: set to the size of the delta frame
+ * Returns:     COMPRESS40_OK, COMPRESS40_BAD_FORMAT, COMPRESS40_BAD_CHECKSUM,
+ *                  or COMPRESS40_BAD_REGION if the images' sizes differ
+ * Note:        It is a CRE for buf, cap or outlen to be NULL
+ */
+extern Compress40_status compress40_delta(const uint8_t *ref, size_t ref_len,
+                                          const uint8_t *comp, size_t len,
+                                          uint8_t **buf, size_t *cap,
+                                          size_t *outlen)
+{
+    assert(buf != NULL && cap != NULL && outlen != NULL);
+
+    Comp_img ref_img = parse_compressed(ref, ref_len);
+    Comp_img img = ref_img != NULL ? parse_compressed(comp, len) : NULL;
+    if (img == NULL) {
+        Img_arena_reset(pipeline_arena());
+        return ref_img == NULL ? parse_failure(ref, ref_len) 
+                               : parse_failure(comp, len);
+    }
+
+    unsigned width = Comp_img_width(img);
+    unsigned height = Comp_img_height(img);
+    if (width != Comp_img_width(ref_img) || 
+        height != Comp_img_height(ref_img)) {
+        Img_arena_reset(pipeline_arena());
+        return COMPRESS40_BAD_REGION;
+    }
+
+    size_t changed;
+    grow_buffer(buf, cap, Comp_delta_bound(width, height));
+    *outlen = Comp_delta_encode(Comp_img_words(ref_img), Comp_img_words(img),
+                                width, height, *buf, &changed);
+
+    Img_arena_reset(pipeline_arena());
+    return COMPRESS40_OK;
+}
+
+
+/* compress40_delta_size
+ * Purpose:     Reads the size of a delta frame held in memory
+ * Parameters:  const uint8_t *delta, size_t len: the delta frame
+ *              unsigned *width, *height: set to its size in pixels
+ * Returns:     COMPRESS40_OK or COMPRESS40_BAD_FORMAT
+ * Note:        It is a CRE for width or height to be NULL
+ */
+extern Compress40_status compress40_delta_size(const uint8_t *delta, 
+                                               size_t len, unsigned *width,
+                                               unsigned *height)
+{
+    return Comp_delta_parse_header(delta, len, width, height) ? 
+           COMPRESS40_OK : COMPRESS40_BAD_FORMAT;
+}
+
+
+/* compress40_apply_delta
+ * Purpose:     Turns a delta frame's reference into the frame, in place
+ * Parameters:  uint8_t *comp, size_t len: the reference image
+ *              const uint8_t *delta, size_t delta_len: the delta frame
+ * Returns:     COMPRESS40_OK, COMPRESS40_BAD_CHECKSUM, or 
+ *                  COMPRESS40_BAD_FORMAT if comp is not a format 2 image or
+ *                  delta is not a delta frame of its size
+ * Note:        Only the changed words are written, so applying a frame 
+ *                  costs little more than reading its skip bitmap
+ */
+extern Compress40_status compress40_apply_delta(uint8_t *comp, size_t len,
+                                                const uint8_t *delta,
+                                                size_t delta_len)
+{
+    unsigned width, height;
+    size_t offset, trailer;
+    if (!Comp_img_parse_header(comp, len, &width, &height, &offset)) {
+        return COMPRESS40_BAD_FORMAT;
+    }
+    if (!Comp_img_verify(comp, len, &trailer)) {
+        return COMPRESS40_BAD_CHECKSUM;
+    }
+    if (!Comp_delta_apply(delta, delta_len, comp + offset, width, height)) {
+        return COMPRESS40_BAD_FORMAT;
+    }
+
+    Comp_img_reseal(comp, len);
+    return COMPRESS40_OK;
+}
+
+
+/* compress40_free
+ * Purpose:     frees a buffer returned by compress40_mem or decompress40_mem
+ */
+extern void compress40_free(uint8_t *buf)
+{
+    if (buf != NULL) {
+        FREE(buf);
+    }
+}
+
+
+/* compress40_release
+ * Purpose:     unmaps the calling thread's pipeline arena, if it has one
+ */
+extern void compress40_release(void)
+{
+    if (arena != NULL) {
+        Img_arena_free(&arena);
+    }
+}
+
+
+/* decompressed_size
+ * Purpose:     returns the size in bytes of the P6 ppm that decompressing 
+ *                  an image of the provided dimensions produces
+ */
+size_t decompressed_size(unsigned width, unsigned height)
+{
+    return Ppm_write_header(NULL, width, height, 255) + 
+           (size_t) width * height * 3;
+}
+
+
+/* grow_buffer
+ * Purpose:     makes sure *buf, whose size is *cap, can hold len bytes
+ */
+void grow_buffer(uint8_t **buf, size_t *cap, size_t len)
+{
+    if (*cap >= len) {
+        return;
+    }
+    if (*buf == NULL) {
+        *buf = ALLOC(len);
+    } else {
+        RESIZE(*buf, len);
+    }
+    *cap = len;
+}
+
+
+/* pipeline_arena
+ * Purpose:     Returns the calling thread's arena that owns all per-image 
+ *                  pipeline state, creating it on first use. The arena is 
+ *                  reset (not freed) after each image so its memory is 
+ *                  reused by the next one.
+ */
+Img_arena pipeline_arena(void)
+{
+    if (arena == NULL) {
+        arena = Img_arena_new(PIPELINE_CHUNK_SIZE, true);
+    }
+    return arena;
+}
+
+
+/* merge_patch
+ * Purpose:     Copies the top left width x height pixels of a ppm's raster
+ *                  into an 8-bit raster, rescaling samples to maxval 255 
+ *                  if the ppm has another maxval
+ * Parameters:  uint8_t *raster, size_t stride: the first pixel written and
+ *                  the distance in bytes between rows
+ *              const uint8_t *patch: the ppm's raster
+ *              const Ppm_header *hdr: the ppm's header
+ *              unsigned width, height: the size of the area copied
+ */
+void merge_patch(uint8_t *raster, size_t stride, const uint8_t *patch, 
+                 const Ppm_header *hdr, unsigned width, unsigned height)
+{
+    unsigned bytes = hdr->maxval < 256 ? 1 : 2;
+    size_t patch_stride = (size_t) hdr->width * 3 * bytes;
+
+    for (unsigned r = 0; r < height; r++) {
+        const uint8_t *in = patch + r * patch_stride;
+        uint8_t *out = raster + r * stride;
+
+        if (hdr->maxval == 255) {
+            memcpy(out, in, (size_t) width * 3);
+            continue;
+        }
+        for (unsigned i = 0; i < width * 3; i++) {
+            unsigned v = bytes == 1 ? in[i] 
+                                    : (unsigned) in[2 * i] << 8 | in[2 * i + 1];
+            v = v < hdr->maxval ? v : hdr->maxval;
+            out[i] = (v * 255u + hdr->maxval / 2) / hdr->maxval;
+        }
+    }
+}
+
+
+/* parse_compressed
+ * Purpose:     Parses a compressed image held in memory, in format 2, 
+ *                  format 3 or the entropy-coded format, into a Comp_img 
+ *                  owned by the pipeline arena
+ * Returns:     Comp_img: the image, or NULL if comp holds none of them
+ * Note:        Entropy-coded stripes are decoded on the calling thread, 
+ *                  since callers may already be running one image per 
+ *                  thread; compress40_unpack decodes them in parallel
+ *              A format 3 image's words are used where they lie when they
+ *                  can be (see Comp_img_view_in), so comp must outlive the
+ *                  image and its words must not be written
+ */
+Comp_img parse_compressed(const uint8_t *comp, size_t len)
+{
+    if (Comp_entropy_is(comp, len)) {
+        return Comp_entropy_decode_in(pipeline_arena(), comp, len, 1);
+    }
+    return Comp_img_view_in(pipeline_arena(), comp, len);
+}
+
+
+/* parse_failure
+ * Purpose:     Returns why parse_compressed found no image in comp: 
+ *                  COMPRESS40_BAD_CHECKSUM if comp has a well-formed header
+ *                  but fails its checksum, else COMPRESS40_BAD_FORMAT
+ */
+Compress40_status parse_failure(const uint8_t *comp, size_t len)
+{
+    size_t trailer;
+    return compress40_verify(comp, len, &trailer) == COMPRESS40_BAD_CHECKSUM
+           ? COMPRESS40_BAD_CHECKSUM : COMPRESS40_BAD_FORMAT;
+}
+
+
+/* swap_words
+ * Purpose:     Copies n big-endian words from in to out little-endian
+ */
+void swap_words(const uint8_t *in, size_t n, uint8_t *out)
+{
+    for (size_t i = 0; i < n; i++, in += 4, out += 4) {
+        out[0] = in[3];
+        out[1] = in[2];
+        out[2] = in[1];
+        out[3] = in[0];
+    }
+}
+
+
+/* input_sealed
+ * Purpose:     Returns true if the compressed image in comp[0..len), in any
+ *                  format parse_compressed reads, ends in a checksum 
+ *                  trailer, so the images made from it should too
+ */
+bool input_sealed(const uint8_t *comp, size_t len)
+{
+    size_t trailer;
+    if (Comp_entropy_is(comp, len)) {
+        return Comp_entropy_verify(comp, len, &trailer) && trailer != 0;
+    }
+    return Comp_img_trailer_offset(comp, len) != 0;
+}
+
+
+/* seal_output
+ * Purpose:     Ends the compressed image just written at (*buf)[start..
+ *                  *outlen) with a checksum trailer if sealed is true and 
+ *                  it does not end in one already, growing the buffer
+ */
+void seal_output(uint8_t **buf, size_t *cap, size_t start, size_t *outlen,
+                 bool sealed)
+{
+    if (!sealed) {
+        return;
+    }
+    grow_buffer(buf, cap, *outlen + COMPRESS40_TRAILER_SIZE);
+    *outlen = start + Comp_img_seal_if(*buf + start, *outlen - start, true);
+}
+
+
+/* read_stream
+ * Purpose:     Reads all of a stream into a new buffer, to be freed with 
+ *                  FREE, and sets *lenp to its length
+ */
+uint8_t *read_stream(FILE *input, size_t *lenp)
+{
+    size_t len = 0, cap = 1 << 16, n;
+    uint8_t *buf = ALLOC(cap);
+
+    while ((n = fread(buf + len, 1, cap - len, input)) > 0) {
+        len += n;
+        if (len == cap) {
+            cap *= 2;
+            RESIZE(buf, cap);
+        }
+    }
+
+    *lenp = len;
+    return buf;
+}
+
+
+/* write_mem
+ * Purpose:     Codes in[0..len) with compress40_mem or decompress40_mem 
+ *                  and writes the result to stdout, for the stream API
+ * Note:        It is a CRE for the input not to be codable
+ */
+void write_mem(Compress40_status (*code)(const uint8_t *, size_t, 
+                                         uint8_t **, size_t *), 
+               const uint8_t *in, size_t len)
+{
+    uint8_t *out = NULL;
+    size_t outlen;
+    Compress40_status status = code(in, len, &out, &outlen);
+    assert(status == COMPRESS40_OK);
+
+    Fault_stats_begin("write");
+    fwrite(out, 1, outlen, stdout);
+    Fault_stats_end();
+    FREE(out);
 }
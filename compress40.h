@@ -0,0 +1,384 @@
+/* compress40.h
+ * Interface provided by COMP 40 Spring 2021, extended by Marshall Wilson 
+ *  (wwilso02) and Eliza Encherman (eenche01) with an in-memory API
+ *
+ *  Declares the top-level functions of the 40image codec. compress40 and 
+ *      decompress40 read from the provided stream and write their result to
+ *      stdout. The *_mem functions work entirely on buffers so the codec can
+ *      be linked into other programs (see lib40image.a / lib40image.so).
+ */
+
+#ifndef COMPRESS40_H
+#define COMPRESS40_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* reads a PPM (or a P5 PGM, coded in the grayscale format) from input and
+    writes the compressed image to stdout. Input that is not a complete 
+    image of at least 2x2 pixels is reported on stderr and ends the program
+    with EXIT_FAILURE */
+extern void compress40  (FILE *input);
+
+/* reads a compressed image from input and writes the PPM (or, for a
+    grayscale image, the PGM) to stdout */
+extern void decompress40(FILE *input);
+
+
+/* results of the in-memory functions */
+typedef enum Compress40_status {
+    COMPRESS40_OK = 0,
+    COMPRESS40_BAD_FORMAT,      /* input is not a P6 ppm/compressed image */
+    COMPRESS40_TOO_SMALL,       /* the provided output buffer is too small */
+    COMPRESS40_BAD_REGION,      /* the region misses the image, or the
+                                   image is too small for the operation */
+    COMPRESS40_BAD_CHECKSUM     /* the image's checksum trailer does not 
+                                   match its contents */
+} Compress40_status;
+
+/* a rectangle of pixels: top left corner (x, y), width w and height h */
+typedef struct Compress40_rect {
+    unsigned x, y, w, h;
+} Compress40_rect;
+
+/* lossless compressed-domain transforms */
+typedef enum Compress40_transform {
+    COMPRESS40_ROT90,           /* rotate 90 degrees clockwise */
+    COMPRESS40_ROT180,
+    COMPRESS40_ROT270,
+    COMPRESS40_FLIP_H,          /* mirror left to right */
+    COMPRESS40_FLIP_V,          /* mirror top to bottom */
+    COMPRESS40_TRANSPOSE
+} Compress40_transform;
+
+/* a tonal adjustment: Y' = contrast * (Y - 1/2) + 1/2 + brightness, and
+    Pb' and Pr' are Pb and Pr times saturation (0 for grayscale) */
+typedef struct Compress40_adjustment {
+    float brightness;
+    float contrast;
+    float saturation;
+} Compress40_adjustment;
+
+/* layouts of raw YUV 4:2:0 input: a full size Y plane, then quarter size
+    chroma in separate Cb and Cr planes (I420) or in one plane of 
+    interleaved Cb, Cr pairs (NV12) */
+typedef enum Compress40_yuv_layout {
+    COMPRESS40_I420,
+    COMPRESS40_NV12
+} Compress40_yuv_layout;
+
+/* a compressed image comp[0..len) placed on a mosaic with its top left 
+    pixel at (x, y) */
+typedef struct Compress40_tile {
+    const uint8_t *comp;
+    size_t len;
+    unsigned x, y;
+} Compress40_tile;
+
+/* compresses the P6 ppm in ppm[0..len) into a new buffer, returned in *out
+    with its length in *outlen. Free *out with compress40_free */
+extern Compress40_status compress40_mem(const uint8_t *ppm, size_t len,
+                                        uint8_t **out, size_t *outlen);
+
+/* decompresses the compressed image in comp[0..len) into a new P6 ppm 
+    buffer, returned in *out with its length in *outlen. Free *out with 
+    compress40_free */
+extern Compress40_status decompress40_mem(const uint8_t *comp, size_t len,
+                                          uint8_t **out, size_t *outlen);
+
+/* compresses the P6 ppm in ppm[0..len) into out[0..cap) and sets *outlen to
+    the compressed size. If out is NULL or cap is too small, nothing is
+    compressed; *outlen still receives the size needed. A P5 pgm is coded
+    in the grayscale format instead: 3 bytes a block, luma only, sealed 
+    with a checksum trailer like format 2 when checksums are on. Grayscale
+    images can only be decompressed and verified; the other operations 
+    below return COMPRESS40_BAD_FORMAT for them */
+extern Compress40_status compress40_into(const uint8_t *ppm, size_t len,
+                                         uint8_t *out, size_t cap,
+                                         size_t *outlen);
+
+/* decompresses the compressed image in comp[0..len) into out[0..cap) and 
+    sets *outlen to the ppm's size. If out is NULL or cap is too small,
+    nothing is decompressed; *outlen still receives the size needed, read
+    from the header alone, so a corrupt image is only reported by the call
+    that decodes it. A grayscale image decompresses to a P5 pgm with 
+    maxval 255 */
+extern Compress40_status decompress40_into(const uint8_t *comp, size_t len,
+                                           uint8_t *out, size_t cap,
+                                           size_t *outlen);
+
+/* compresses (or decompresses, if compress is false) in[0..len) into *buf,
+    first growing *buf with RESIZE if *cap is too small (*buf may start as
+    NULL with *cap 0). Meant for callers that reuse one output buffer for 
+    many images. Free *buf with compress40_free */
+extern Compress40_status compress40_buffered(bool compress, 
+                                             const uint8_t *in, size_t len,
+                                             uint8_t **buf, size_t *cap,
+                                             size_t *outlen);
+
+/* sets *width and *height to the size in pixels of the compressed image in
+    comp[0..len), in format 2 or 3 
+    Note: it is a CRE for width or height to be NULL */
+extern Compress40_status compress40_size(const uint8_t *comp, size_t len,
+                                         unsigned *width, unsigned *height);
+
+/* sets *offset to the byte offset in comp[0..len), in format 2 or 3, of
+    the word for the block holding pixel (col, row). Returns 
+    COMPRESS40_BAD_REGION if the pixel is outside the image
+    Note: it is a CRE for offset to be NULL */
+extern Compress40_status compress40_word_offset(const uint8_t *comp, 
+                                                size_t len, unsigned col,
+                                                unsigned row, size_t *offset);
+
+/* decodes just the pixels of the compressed image in comp[0..len) inside 
+    rect (clipped to the image) into a P6 ppm, or, if keep_compressed is 
+    true, copies the blocks covering rect into a new compressed image with 
+    no decoding at all; that sub-image is rect grown out to the 2x2 block
+    grid. Only the words of the block rows and columns under rect are read,
+    so comp may be a mapped file far larger than memory. The output goes 
+    into *buf as in compress40_buffered */
+extern Compress40_status decompress40_crop(const uint8_t *comp, size_t len,
+                                           Compress40_rect rect, 
+                                           bool keep_compressed,
+                                           uint8_t **buf, size_t *cap,
+                                           size_t *outlen);
+
+/* decodes a 1/shrink scale preview (shrink 2 for --half, 4 for --quarter) 
+    of the compressed image in comp[0..len) into a P6 ppm, one pixel per 
+    block or per group of blocks, straight from the codewords. The output 
+    goes into *buf as in compress40_buffered
+    Note: it is a CRE for shrink to be odd or < 2 */
+extern Compress40_status decompress40_preview(const uint8_t *comp, 
+                                              size_t len, unsigned shrink,
+                                              uint8_t **buf, size_t *cap,
+                                              size_t *outlen);
+
+/* compresses the raw 8-bit width x height YUV 4:2:0 image in 
+    yuv[0..len), in the provided layout and in BT.601 limited range or, 
+    with full_range, full range, with no RGB or Pnm_ppm in between: luma 
+    goes straight into the Haar transform and the chroma samples over each
+    block are averaged. The output goes into *buf as in compress40_buffered.
+    Returns COMPRESS40_BAD_FORMAT if yuv is too short for the size or the
+    size is under 2x2 */
+extern Compress40_status compress40_yuv(const uint8_t *yuv, size_t len,
+                                        Compress40_yuv_layout layout,
+                                        unsigned width, unsigned height,
+                                        bool full_range, uint8_t **buf,
+                                        size_t *cap, size_t *outlen);
+
+/* like compress40_yuv, for the first frame of the Y4M stream in 
+    y4m[0..len), whose header gives its size, chroma subsampling (4:2:0,
+    4:2:2, 4:4:4 or mono) and range */
+extern Compress40_status compress40_y4m(const uint8_t *y4m, size_t len,
+                                        uint8_t **buf, size_t *cap,
+                                        size_t *outlen);
+
+/* decodes the compressed image in comp[0..len) to raw 8-bit I420: the 
+    width x height Y plane, then the (width / 2) x (height / 2) Cb and Cr
+    planes, in BT.601 limited range or, with full_range, full range. Each
+    block's four Y samples come straight from its inverse Haar transform
+    and its Cb and Cr from its chroma indices, with no RGB in between. The
+    output goes into *buf as in compress40_buffered */
+extern Compress40_status decompress40_yuv420(const uint8_t *comp, 
+                                             size_t len, bool full_range,
+                                             uint8_t **buf, size_t *cap,
+                                             size_t *outlen);
+
+/* decompresses the compressed image in comp[0..len) into a P6 ppm with 
+    maxval 65535 (two big-endian bytes per sample), for 16-bit sources 
+    that should not be cut down to 8 bits on the way out. The output goes 
+    into *buf as in compress40_buffered */
+extern Compress40_status decompress40_16bit(const uint8_t *comp, size_t len,
+                                            uint8_t **buf, size_t *cap,
+                                            size_t *outlen);
+
+/* rotates, flips or transposes the compressed image in comp[0..len) into a
+    new compressed image, working on its codewords only, so there is no 
+    generation loss. The output goes into *buf as in compress40_buffered */
+extern Compress40_status compress40_transform(const uint8_t *comp, 
+                                              size_t len,
+                                              Compress40_transform transform,
+                                              uint8_t **buf, size_t *cap,
+                                              size_t *outlen);
+
+/* halves the compressed image in comp[0..len) levels times (or, if levels
+    is 0, until it is too small to halve again) without decoding it, and 
+    writes every level, largest first, into *buf as one compressed image 
+    after another. Returns COMPRESS40_BAD_REGION if the image is too small
+    to halve even once. The output goes into *buf as in 
+    compress40_buffered */
+extern Compress40_status compress40_downscale(const uint8_t *comp, 
+                                              size_t len, unsigned levels,
+                                              uint8_t **buf, size_t *cap,
+                                              size_t *outlen);
+
+/* applies adj in place to the codewords of the compressed image in 
+    comp[0..len), which may be a writable mapping of its file, without 
+    decoding it. *saturated receives the number of coefficients that had 
+    to be clamped to their quantizer limits
+    Note: it is a CRE for saturated to be NULL */
+extern Compress40_status compress40_adjust(uint8_t *comp, size_t len,
+                                           Compress40_adjustment adj,
+                                           size_t *saturated);
+
+/* writes a JSON object of statistics about the compressed image in 
+    comp[0..len) (luma histogram, mean and spread of the luma, mean color, 
+    and whether the image is mostly dark or blank) into *buf as in 
+    compress40_buffered. Only the a, Pb and Pr fields of the words are 
+    read, with nthreads threads (one per CPU if < 1) */
+extern Compress40_status compress40_stats(const uint8_t *comp, size_t len,
+                                          int nthreads, uint8_t **buf, 
+                                          size_t *cap, size_t *outlen);
+
+/* sets *hash to the 64-bit perceptual hash of the compressed image in 
+    comp[0..len), computed from the a fields of its words alone. Images that
+    look alike have hashes that differ in few bits
+    Note: it is a CRE for hash to be NULL */
+extern Compress40_status compress40_hash(const uint8_t *comp, size_t len,
+                                         uint64_t *hash);
+
+/* blends the compressed image overlay[0..overlay_len) into the compressed
+    image base[0..base_len) with weight alpha (0 keeps base, 1 replaces it),
+    the overlay's top left pixel going at (x, y) of base, and writes the 
+    result into *buf as in compress40_buffered. Parts of the overlay off 
+    base are ignored. Only the words are blended; nothing is decoded, with 
+    nthreads threads (one per CPU if < 1). Returns COMPRESS40_BAD_REGION if
+    x or y is odd or the overlay misses base entirely, and 
+    COMPRESS40_BAD_CHECKSUM if either image fails its checksum trailer; the
+    result is sealed if either image was
+    Note: it is a CRE for alpha to be outside [0, 1] */
+extern Compress40_status compress40_blend(const uint8_t *base, 
+                                          size_t base_len,
+                                          const uint8_t *overlay, 
+                                          size_t overlay_len,
+                                          unsigned x, unsigned y, 
+                                          float alpha, int nthreads,
+                                          uint8_t **buf, size_t *cap,
+                                          size_t *outlen);
+
+/* lays the ntiles compressed images in tiles out on a new width x height 
+    compressed canvas (both rounded down to even), later tiles covering 
+    earlier ones and the rest of the canvas filled with the gray level fill
+    (0 black, 1 white), and writes it into *buf as in compress40_buffered.
+    Tiles are copied a row of codewords at a time with no decoding. 
+    Returns COMPRESS40_BAD_REGION if a tile's x or y is odd or the canvas 
+    is empty, and COMPRESS40_BAD_CHECKSUM if a tile fails its checksum 
+    trailer; the canvas is sealed if any tile was */
+extern Compress40_status compress40_mosaic(const Compress40_tile *tiles,
+                                           unsigned ntiles, unsigned width,
+                                           unsigned height, float fill,
+                                           uint8_t **buf, size_t *cap,
+                                           size_t *outlen);
+
+/* re-encodes, in place, just the blocks of the compressed image in 
+    comp[0..len) under the P6 ppm patch[0..patch_len) placed with its top 
+    left pixel at (x, y); the rest of the patch is off the image and 
+    ignored. Where the patch only partly covers a block, the block's other
+    pixels are decoded from comp and encoded again with it. *dirty receives
+    the block-aligned rectangle of pixels whose words were rewritten, so a
+    caller working on a private copy of a file can write just those words 
+    back (see compress40_word_offset). Returns COMPRESS40_BAD_REGION if 
+    (x, y) is outside the image
+    Note: it is a CRE for dirty to be NULL */
+extern Compress40_status compress40_patch(uint8_t *comp, size_t len,
+                                          const uint8_t *patch, 
+                                          size_t patch_len, unsigned x,
+                                          unsigned y, Compress40_rect *dirty);
+
+/* entropy codes the compressed image in comp[0..len) into the smaller 
+    entropy-coded format, whose stripes can be decoded independently, and 
+    writes it into *buf as in compress40_buffered, coding stripes on 
+    nthreads threads (one per CPU if < 1). decompress40 and the other 
+    functions that decode an image whole read either format */
+extern Compress40_status compress40_pack(const uint8_t *comp, size_t len,
+                                         int nthreads, uint8_t **buf,
+                                         size_t *cap, size_t *outlen);
+
+/* decodes the entropy-coded image in comp[0..len) back into the plain 
+    compressed format, with nthreads threads (one per CPU if < 1), into 
+    *buf as in compress40_buffered */
+extern Compress40_status compress40_unpack(const uint8_t *comp, size_t len,
+                                           int nthreads, uint8_t **buf,
+                                           size_t *cap, size_t *outlen);
+
+/* rewrites the compressed image in comp[0..len) (in any format decompress40
+    reads) in format 2, the text header and big-endian words compress40 
+    writes, or in format 3: a fixed binary header with the words 
+    little-endian from a 64-byte aligned offset, so that on little-endian 
+    hosts a mapped format 3 file is decoded with no copy of its words. The 
+    output goes into *buf as in compress40_buffered. The functions that 
+    work on the stored words directly (adjust, stats, hash, blend, mosaic, 
+    patch, pack) take either format; those that rewrite words in place keep
+    the input's format, and mosaic always writes format 2
+    Note: it is a CRE for format to be neither 2 nor 3 */
+extern Compress40_status compress40_convert(const uint8_t *comp, size_t len,
+                                            unsigned format, uint8_t **buf,
+                                            size_t *cap, size_t *outlen);
+
+/* turns CRC-32C checksum trailers on or off for every compressed image 
+    written from now on, by any thread. A trailer (8 bytes after the last
+    word) covers the header and words; images that have one are checked 
+    whenever they are decoded whole, and adjust and patch rewrite it. 
+    Transform, downscale, pack, unpack and convert seal their output 
+    whenever their input was sealed, even with checksums off */
+extern void compress40_set_checksums(bool on);
+
+/* chooses the quantization profile every image compressed from now on, by
+    any thread, is coded with: "tiny" (16 bits a block), "small" (24), 
+    "standard" (32, format 2, the default), "high" (48) or "max" (64). 
+    Images coded with a profile other than standard go into the profile 
+    format, whose header names the profile, sealed with a checksum 
+    trailer when checksums are on; like grayscale images, they can only be
+    decompressed and verified. Returns false, changing nothing, for any 
+    other name */
+extern bool compress40_set_profile(const char *name);
+
+/* the size of a checksum trailer */
+#define COMPRESS40_TRAILER_SIZE 8
+
+/* checks the compressed image in comp[0..len), in any format decompress40
+    reads, against its checksum trailer, reading it once without decoding 
+    it, and sets *trailer to the trailer's offset (0 if the image has none,
+    which is not an error). Returns COMPRESS40_BAD_CHECKSUM if the trailer 
+    does not match or a format 3 header promises one that is missing
+    Note: it is a CRE for trailer to be NULL */
+extern Compress40_status compress40_verify(const uint8_t *comp, size_t len,
+                                           size_t *trailer);
+
+/* codes the compressed image in comp[0..len) as a delta frame against 
+    the compressed image in ref[0..ref_len): a bitmap of the blocks whose 
+    words differ from ref's and just those words, so that frames of a 
+    still scene take little more than the bitmap. The frame goes into *buf
+    as in compress40_buffered. Returns COMPRESS40_BAD_REGION if the images
+    are not the same size */
+extern Compress40_status compress40_delta(const uint8_t *ref, size_t ref_len,
+                                          const uint8_t *comp, size_t len,
+                                          uint8_t **buf, size_t *cap,
+                                          size_t *outlen);
+
+/* sets *width and *height to the size of the delta frame in 
+    delta[0..len), or returns COMPRESS40_BAD_FORMAT if it is not one
+    Note: it is a CRE for width or height to be NULL */
+extern Compress40_status compress40_delta_size(const uint8_t *delta, 
+                                               size_t len, unsigned *width,
+                                               unsigned *height);
+
+/* rewrites the compressed image in comp[0..len), in format 2, in place 
+    into the frame the delta frame in delta[0..delta_len) makes of it, 
+    writing only the changed words, and rewrites its checksum trailer if it
+    has one. Returns COMPRESS40_BAD_FORMAT if delta is not a delta frame of
+    comp's size */
+extern Compress40_status compress40_apply_delta(uint8_t *comp, size_t len,
+                                                const uint8_t *delta,
+                                                size_t delta_len);
+
+/* frees a buffer returned by compress40_mem or decompress40_mem */
+extern void compress40_free(uint8_t *buf);
+
+/* releases the calling thread's pipeline memory. Threads that use the 
+    codec should call this before they exit */
+extern void compress40_release(void);
+
+#endif
@@ -0,0 +1,140 @@
+/* crc32c.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/2/2021
+ *
+ * Contains the implementation of CRC-32C. On x86-64 CPUs with SSE4.2 the
+ *  crc32 instruction checksums 8 bytes at a time; everywhere else a
+ *  slice-by-8 table lookup does. Both give the same result, and the choice
+ *  is made once, the first time a checksum is computed.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include "assert.h"
+#include "crc32c.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define CRC32C_HW 1
+#else
+#define CRC32C_HW 0
+#endif
+
+
+/* the CRC-32C polynomial, bit-reversed */
+#define POLY 0x82f63b78u
+
+/* slice[k][b] is the CRC of byte b followed by k zero bytes */
+static uint32_t slice[8][256];
+
+/* true if the CPU has the SSE4.2 crc32 instruction */
+static bool hardware = false;
+
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+
+/* helper function declarations */
+void crc32c_init(void);
+uint32_t crc32c_sw(uint32_t crc, const uint8_t *p, size_t len);
+#if CRC32C_HW
+uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t len);
+#endif
+
+
+/* Crc32c_update
+ * Purpose:     Continues a CRC-32C over another buffer
+ * Parameters:  uint32_t crc: the CRC-32C of everything before buf, or 0
+ *              const void *buf, size_t len: the bytes to add
+ * Returns:     uint32_t: the CRC-32C of everything up to buf + len
+ * Note:        It is a CRE for buf to be NULL while len > 0
+ */
+uint32_t Crc32c_update(uint32_t crc, const void *buf, size_t len)
+{
+    assert(buf != NULL || len == 0);
+    pthread_once(&once, crc32c_init);
+
+#if CRC32C_HW
+    if (hardware) {
+        return ~crc32c_hw(~crc, buf, len);
+    }
+#endif
+    return ~crc32c_sw(~crc, buf, len);
+}
+
+
+/* crc32c_init
+ * Purpose:     Builds the slice-by-8 tables and checks for SSE4.2
+ */
+void crc32c_init(void)
+{
+    for (unsigned b = 0; b < 256; b++) {
+        uint32_t crc = b;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (crc & 1 ? POLY : 0);
+        }
+        slice[0][b] = crc;
+    }
+    for (unsigned b = 0; b < 256; b++) {
+        for (int k = 1; k < 8; k++) {
+            uint32_t prev = slice[k - 1][b];
+            slice[k][b] = (prev >> 8) ^ slice[0][prev & 0xff];
+        }
+    }
+
+#if CRC32C_HW
+    __builtin_cpu_init();
+    hardware = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+
+/* crc32c_sw
+ * Purpose:     Updates a raw (uncomplemented) CRC-32C with len bytes at p,
+ *                  8 at a time through the slice-by-8 tables
+ */
+uint32_t crc32c_sw(uint32_t crc, const uint8_t *p, size_t len)
+{
+    for (; len >= 8; len -= 8, p += 8) {
+        crc ^= (uint32_t) p[0] | ((uint32_t) p[1] << 8) |
+               ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+        crc = slice[7][crc & 0xff] ^ slice[6][(crc >> 8) & 0xff] ^
+              slice[5][(crc >> 16) & 0xff] ^ slice[4][crc >> 24] ^
+              slice[3][p[4]] ^ slice[2][p[5]] ^ slice[1][p[6]] ^
+              slice[0][p[7]];
+    }
+    while (len-- > 0) {
+        crc = (crc >> 8) ^ slice[0][(crc ^ *p++) & 0xff];
+    }
+    return crc;
+}
+
+
+#if CRC32C_HW
+/* crc32c_hw
+ * Purpose:     Updates a raw (uncomplemented) CRC-32C with len bytes at p
+ *                  with the SSE4.2 crc32 instruction, a byte at a time up to
+ *                  an 8-byte boundary and 8 bytes at a time after it
+ * Note:        Only called once crc32c_init has found SSE4.2
+ */
+__attribute__((target("sse4.2")))
+uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+    for (; len > 0 && (uintptr_t) p % 8 != 0; len--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+
+    uint64_t crc64 = crc;
+    for (; len >= 8; len -= 8, p += 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        crc64 = _mm_crc32_u64(crc64, v);
+    }
+    crc = crc64;
+
+    while (len-- > 0) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+#endif
@@ -0,0 +1,21 @@
+/* crc32c.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/2/2021
+ *
+ * Contains the interface for computing CRC-32C (Castagnoli) checksums,
+ *  which guard compressed images against silent corruption
+ */
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/* returns the CRC-32C of buf[0..len) continued from crc, the CRC-32C of
+    the bytes before it (0 for none), so a buffer can be checked in pieces
+    Note: it is a CRE for buf to be NULL while len > 0 */
+uint32_t Crc32c_update(uint32_t crc, const void *buf, size_t len);
+
+#endif
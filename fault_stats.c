@@ -0,0 +1,79 @@
+/* fault_stats.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 4/14/2021
+ *
+ * Contains the implementation of per-stage page fault counting, based on
+ *  the fault counters getrusage keeps for the calling thread
+ */
+
+#define _GNU_SOURCE     /* for RUSAGE_THREAD */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "assert.h"
+#include "fault_stats.h"
+
+/* count faults of the calling thread where the OS supports it */
+#ifdef RUSAGE_THREAD
+#define FAULT_STATS_WHO RUSAGE_THREAD
+#else
+#define FAULT_STATS_WHO RUSAGE_SELF
+#endif
+
+
+/* where reports go, or NULL if reporting is off */
+static FILE *report_fp = NULL;
+
+/* the stage being counted by this thread and its starting counters */
+static __thread const char *curr_stage = NULL;
+static __thread long start_minflt, start_majflt;
+
+
+/* Fault_stats_report_to
+ * Purpose:     turns per-stage fault reporting on or off
+ * Parameters:  FILE *out: where to print reports, or NULL to turn them off
+ */
+void Fault_stats_report_to(FILE *out)
+{
+    report_fp = out;
+}
+
+
+/* Fault_stats_begin
+ * Purpose:     snapshots the calling thread's fault counters at the start 
+ *                  of a pipeline stage
+ * Parameters:  const char *stage: the name of the stage, printed in reports
+ * Note:        It is a CRE for stage to be NULL
+ */
+void Fault_stats_begin(const char *stage)
+{
+    assert(stage != NULL);
+    if (report_fp == NULL) {
+        return;
+    }
+
+    struct rusage usage;
+    getrusage(FAULT_STATS_WHO, &usage);
+    curr_stage = stage;
+    start_minflt = usage.ru_minflt;
+    start_majflt = usage.ru_majflt;
+}
+
+
+/* Fault_stats_end
+ * Purpose:     prints the faults taken since the matching Fault_stats_begin
+ */
+void Fault_stats_end(void)
+{
+    if (report_fp == NULL || curr_stage == NULL) {
+        return;
+    }
+
+    struct rusage usage;
+    getrusage(FAULT_STATS_WHO, &usage);
+    fprintf(report_fp, "%-12s %10ld minor faults %10ld major faults\n", 
+                       curr_stage, usage.ru_minflt - start_minflt, 
+                       usage.ru_majflt - start_majflt);
+    curr_stage = NULL;
+}
@@ -0,0 +1,26 @@
+/* fault_stats.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 4/14/2021
+ *
+ * Contains the interface for counting the page faults taken by each stage
+ *  of the compression pipeline, so the effect of huge pages and prefaulting
+ *  on large images can be measured.
+ */
+
+#ifndef FAULT_STATS_H
+#define FAULT_STATS_H
+
+#include <stdio.h>
+
+/* turns reporting on (out != NULL) or off (out == NULL). When on, every
+    stage's minor and major fault counts are printed to out as it ends */
+void Fault_stats_report_to(FILE *out);
+
+/* starts counting faults for the named stage of the calling thread. 
+    Does nothing if reporting is off */
+void Fault_stats_begin(const char *stage);
+
+/* stops counting faults for the current stage and reports them */
+void Fault_stats_end(void);
+
+#endif
@@ -0,0 +1,564 @@
+/* frame_seq.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the implementation of frame sequences. A sequence file is laid
+ *  out so that it can be mapped and read in place:
+ *
+ *      "C40SEQ01"                  magic
+ *      uint64_t reserved           0
+ *      the frames                  each a whole compressed image, starting
+ *                                      on a FRAME_ALIGN boundary (so format
+ *                                      3 words stay aligned when mapped)
+ *      struct Seq_entry index[count]   each frame's offset and size, from
+ *                                      an 8-byte boundary
+ *      uint64_t index_offset, count
+ *      "C40SEQIX"                  footer magic
+ *
+ *  all in the host's byte order. Appending a frame writes it over the old
+ *  index and writes the index, one entry longer, and the footer after it,
+ *  so the frames already in the file are never rewritten.
+ *
+ *  A frame is either a keyframe, a compressed image on its own, or a delta
+ *  frame (see compress40_delta) coded against the frame before it. A run
+ *  of frames from a keyframe up to the next is a group: decoding frame k
+ *  rebuilds it from its group's keyframe, and --extract decodes each group
+ *  as one job, applying the deltas in turn to a single format 2 image.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "assert.h"
+#include "mem.h"
+#include "thread_pool.h"
+#include "frame_seq.h"
+
+
+#define SEQ_MAGIC "C40SEQ01"
+#define SEQ_HEADER 16
+#define FOOTER_MAGIC "C40SEQIX"
+#define SEQ_FOOTER 24
+#define FRAME_ALIGN 64
+
+/* rounds n up to a multiple of align, a power of 2 */
+#define ROUND_UP(n, align) (((n) + (align) - 1) & ~(uint64_t) ((align) - 1))
+
+
+/* struct Seq_entry
+ * Members:     offset, size: where a frame lies in the file
+ */
+struct Seq_entry {
+    uint64_t offset;
+    uint64_t size;
+};
+
+/* struct Frame_seq
+ * Members:     map, size:      the mapped sequence file
+ *              count:          the number of frames
+ *              index:          the frames' entries
+ *              index_offset:   where the index starts
+ */
+struct Frame_seq {
+    void *map;
+    size_t size;
+    size_t count;
+    const struct Seq_entry *index;
+    uint64_t index_offset;
+};
+
+/* struct Extract_job
+ * Members:     seq:            the sequence
+ *              first, count:   the group of frames to decode
+ *              outdir:         the directory to write them into
+ *              failures:       set to the number of frames that failed
+ */
+struct Extract_job {
+    Frame_seq seq;
+    size_t first;
+    size_t count;
+    const char *outdir;
+    int failures;
+};
+
+
+/* helper function declarations */
+bool seq_is_delta(Frame_seq seq, size_t k);
+size_t seq_keyframe(Frame_seq seq, size_t k);
+Compress40_status seq_rebuild(Frame_seq seq, size_t k, uint8_t **buf,
+                              size_t *cap, size_t *len);
+bool seq_encode_delta(Frame_seq seq, const uint8_t *frame, size_t len,
+                      unsigned interval, uint8_t **buf, size_t *cap,
+                      size_t *outlen);
+void extract_group(void *jobp);
+const char *extract_write(const char *outdir, size_t k, size_t len);
+void extract_worker_exit(void);
+int write_at(int fd, const void *buf, size_t len, uint64_t offset);
+
+
+/* the calling worker's output buffer and group reference image, reused
+   across frames */
+static __thread uint8_t *out_buf = NULL;
+static __thread size_t out_cap = 0;
+static __thread uint8_t *ref_buf = NULL;
+static __thread size_t ref_cap = 0;
+
+
+/* Frame_seq_open
+ * Purpose:     Maps a sequence file and checks that it is well formed
+ * Parameters:  const char *path: the sequence file
+ * Returns:     Frame_seq: the sequence, or NULL if it cannot be read
+ * Note:        It is a CRE for path to be NULL
+ */
+Frame_seq Frame_seq_open(const char *path)
+{
+    assert(path != NULL);
+
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 ||
+        (size_t) st.st_size < SEQ_HEADER + SEQ_FOOTER) {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    Frame_seq seq;
+    NEW(seq);
+    seq->map = map;
+    seq->size = st.st_size;
+
+    const char *footer = (const char *) map + seq->size - SEQ_FOOTER;
+    uint64_t count;
+    memcpy(&seq->index_offset, footer, sizeof(uint64_t));
+    memcpy(&count, footer + 8, sizeof(uint64_t));
+    seq->count = count;
+    seq->index = NULL;
+
+    bool ok = memcmp(map, SEQ_MAGIC, 8) == 0 &&
+              memcmp(footer + 16, FOOTER_MAGIC, 8) == 0 &&
+              seq->index_offset >= SEQ_HEADER &&
+              seq->index_offset % 8 == 0 &&
+              seq->index_offset <= seq->size - SEQ_FOOTER &&
+              count == (seq->size - SEQ_FOOTER - seq->index_offset) /
+                       sizeof(struct Seq_entry) &&
+              (seq->size - SEQ_FOOTER - seq->index_offset) %
+              sizeof(struct Seq_entry) == 0;
+
+    /* the index is only located once its offset is known to be inside */
+    if (ok) {
+        seq->index = (const struct Seq_entry *) ((char *) map +
+                                                 seq->index_offset);
+    }
+    for (size_t k = 0; ok && k < seq->count; k++) {
+        ok = seq->index[k].offset >= SEQ_HEADER &&
+             seq->index[k].offset <= seq->index_offset &&
+             seq->index[k].size <= seq->index_offset - seq->index[k].offset;
+    }
+    if (!ok) {
+        Frame_seq_free(&seq);
+        return NULL;
+    }
+
+    return seq;
+}
+
+
+/* Frame_seq_length
+ * Purpose:     returns the number of frames in the sequence
+ */
+size_t Frame_seq_length(Frame_seq seq)
+{
+    assert(seq != NULL);
+    return seq->count;
+}
+
+
+/* Frame_seq_frame
+ * Purpose:     returns frame k where it lies in the mapped file, and its
+ *                  length in *lenp
+ */
+const uint8_t *Frame_seq_frame(Frame_seq seq, size_t k, size_t *lenp)
+{
+    assert(seq != NULL && lenp != NULL && k < seq->count);
+    *lenp = seq->index[k].size;
+    return (const uint8_t *) seq->map + seq->index[k].offset;
+}
+
+
+/* Frame_seq_decode
+ * Purpose:     Decodes frame k of a sequence into a P6 ppm
+ * Parameters:  Frame_seq seq, size_t k: the frame
+ *              uint8_t **buf, size_t *cap: the output buffer and its size,
+ *                  grown with RESIZE when the output would not fit
+ *              size_t *outlen: set to the size of the ppm
+ * Returns:     Compress40_status: as decompress40_buffered
+ * Note:        It is a CRE for seq, buf, cap or outlen to be NULL or k to
+ *                  be out of range
+ *              A delta frame is rebuilt from its group's keyframe, so its
+ *                  cost grows with its distance from the keyframe
+ */
+Compress40_status Frame_seq_decode(Frame_seq seq, size_t k, uint8_t **buf,
+                                   size_t *cap, size_t *outlen)
+{
+    size_t len;
+    const uint8_t *frame = Frame_seq_frame(seq, k, &len);
+    if (!seq_is_delta(seq, k)) {
+        return compress40_buffered(false, frame, len, buf, cap, outlen);
+    }
+
+    uint8_t *ref = NULL;
+    size_t cap_ref = 0, ref_len;
+    Compress40_status status = seq_rebuild(seq, k, &ref, &cap_ref, &ref_len);
+    if (status == COMPRESS40_OK) {
+        status = compress40_buffered(false, ref, ref_len, buf, cap, outlen);
+    }
+    compress40_free(ref);
+    return status;
+}
+
+
+/* Frame_seq_extract
+ * Purpose:     Decodes every frame of a sequence into its own ppm file
+ * Parameters:  Frame_seq seq: the sequence
+ *              const char *outdir: the directory to write the frames into
+ *              int nthreads: the number of threads, or < 1 for one per CPU
+ * Returns:     int: the number of frames that failed
+ * Note:        It is a CRE for seq or outdir to be NULL
+ *              Groups are independent jobs on a Thread_pool, each decoded
+ *                  from the mapping into its worker's buffers
+ */
+int Frame_seq_extract(Frame_seq seq, const char *outdir, int nthreads)
+{
+    assert(seq != NULL && outdir != NULL);
+
+    struct Extract_job *jobs = CALLOC(seq->count > 0 ? seq->count : 1,
+                                      sizeof(*jobs));
+    size_t njobs = 0;
+    for (size_t k = 0; k < seq->count; k++) {
+        if (k == 0 || !seq_is_delta(seq, k)) {
+            jobs[njobs++] = (struct Extract_job) { seq, k, 0, outdir, 0 };
+        }
+        jobs[njobs - 1].count++;
+    }
+
+    Thread_pool pool = Thread_pool_new(nthreads, extract_worker_exit);
+    for (size_t j = 0; j < njobs; j++) {
+        Thread_pool_submit(pool, j % Thread_pool_size(pool), extract_group,
+                           &jobs[j]);
+    }
+    Thread_pool_free(&pool);
+
+    int failures = 0;
+    for (size_t j = 0; j < njobs; j++) {
+        failures += jobs[j].failures;
+    }
+    FREE(jobs);
+    return failures;
+}
+
+
+/* Frame_seq_free
+ * Purpose:     unmaps the sequence and frees its handle
+ */
+void Frame_seq_free(Frame_seq *seqp)
+{
+    assert(seqp != NULL && *seqp != NULL);
+    munmap((*seqp)->map, (*seqp)->size);
+    FREE(*seqp);
+}
+
+
+/* Frame_seq_append
+ * Purpose:     Adds a compressed frame to the end of a sequence file
+ * Parameters:  const char *path: the sequence file, created if missing
+ *              const uint8_t *frame, size_t len: the frame
+ *              unsigned interval: the most frames in a group; 0 or 1 makes
+ *                  every frame a keyframe
+ * Returns:     int: 0 on success, -1 (with errno set) otherwise
+ * Note:        It is a CRE for path or frame to be NULL
+ *              A file that exists but is not a sequence is not overwritten
+ *              The frame is written over the old index, then the new index
+ *                  and footer after it
+ */
+int Frame_seq_append(const char *path, const uint8_t *frame, size_t len,
+                     unsigned interval)
+{
+    assert(path != NULL && frame != NULL);
+
+    struct stat st;
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+
+    size_t count = 0;
+    uint64_t end = SEQ_HEADER;
+    struct Seq_entry *index;
+    uint8_t *delta = NULL;
+    size_t delta_cap = 0, delta_len;
+    if (st.st_size == 0) {
+        index = ALLOC(sizeof(*index));
+        char header[SEQ_HEADER] = SEQ_MAGIC;
+        if (write_at(fd, header, SEQ_HEADER, 0) != 0) {
+            FREE(index);
+            close(fd);
+            return -1;
+        }
+    } else {
+        Frame_seq old = Frame_seq_open(path);
+        if (old == NULL) {
+            close(fd);
+            errno = EINVAL;
+            return -1;
+        }
+        count = old->count;
+        end = old->index_offset;
+        index = ALLOC((count + 1) * sizeof(*index));
+        memcpy(index, old->index, count * sizeof(*index));
+        if (seq_encode_delta(old, frame, len, interval, &delta, &delta_cap,
+                             &delta_len)) {
+            frame = delta;
+            len = delta_len;
+        }
+        Frame_seq_free(&old);
+    }
+
+    static const uint8_t zeros[FRAME_ALIGN];
+    uint64_t offset = ROUND_UP(end, FRAME_ALIGN);
+    uint64_t index_offset = ROUND_UP(offset + len, 8);
+    uint64_t footer[2] = { index_offset, count + 1 };
+    index[count] = (struct Seq_entry) { offset, len };
+
+    int result = write_at(fd, zeros, offset - end, end);
+    if (result == 0) {
+        result = write_at(fd, frame, len, offset);
+    }
+    if (result == 0) {
+        result = write_at(fd, zeros, index_offset - offset - len,
+                          offset + len);
+    }
+    if (result == 0) {
+        result = write_at(fd, index, (count + 1) * sizeof(*index),
+                          index_offset);
+    }
+    uint64_t footer_offset = index_offset + (count + 1) * sizeof(*index);
+    if (result == 0) {
+        result = write_at(fd, footer, sizeof(footer), footer_offset);
+    }
+    if (result == 0) {
+        result = write_at(fd, FOOTER_MAGIC, 8,
+                          footer_offset + sizeof(footer));
+    }
+
+    FREE(index);
+    compress40_free(delta);
+    if (close(fd) != 0) {
+        result = -1;
+    }
+    return result;
+}
+
+
+/* seq_is_delta
+ * Purpose:     returns true if frame k of a sequence is a delta frame
+ */
+bool seq_is_delta(Frame_seq seq, size_t k)
+{
+    size_t len;
+    unsigned width, height;
+    const uint8_t *frame = Frame_seq_frame(seq, k, &len);
+    return compress40_delta_size(frame, len, &width, &height) ==
+           COMPRESS40_OK;
+}
+
+
+/* seq_keyframe
+ * Purpose:     returns the keyframe of frame k's group (0 if there is none,
+ *                  in which case frame 0 is a delta and cannot be decoded)
+ */
+size_t seq_keyframe(Frame_seq seq, size_t k)
+{
+    while (k > 0 && seq_is_delta(seq, k)) {
+        k--;
+    }
+    return k;
+}
+
+
+/* seq_rebuild
+ * Purpose:     Rebuilds frame k of a sequence as a format 2 compressed image
+ * Parameters:  Frame_seq seq, size_t k: the frame
+ *              uint8_t **buf, size_t *cap: the output buffer and its size,
+ *                  grown with RESIZE when the output would not fit
+ *              size_t *len: set to the size of the image
+ * Returns:     Compress40_status: COMPRESS40_OK, or why the keyframe or a
+ *                  delta could not be read
+ */
+Compress40_status seq_rebuild(Frame_seq seq, size_t k, uint8_t **buf,
+                              size_t *cap, size_t *len)
+{
+    size_t frame_len;
+    size_t key = seq_keyframe(seq, k);
+    const uint8_t *frame = Frame_seq_frame(seq, key, &frame_len);
+
+    Compress40_status status = compress40_convert(frame, frame_len, 2, buf,
+                                                  cap, len);
+    for (size_t j = key + 1; j <= k && status == COMPRESS40_OK; j++) {
+        frame = Frame_seq_frame(seq, j, &frame_len);
+        status = compress40_apply_delta(*buf, *len, frame, frame_len);
+    }
+    return status;
+}
+
+
+/* seq_encode_delta
+ * Purpose:     Codes a frame about to be appended to a sequence as a delta
+ *                  against the sequence's last frame, if it belongs in that
+ *                  frame's group
+ * Parameters:  Frame_seq seq: the sequence
+ *              const uint8_t *frame, size_t len: the new frame
+ *              unsigned interval: the most frames in a group
+ *              uint8_t **buf, size_t *cap: the output buffer and its size,
+ *                  grown with RESIZE when the output would not fit
+ *              size_t *outlen: set to the size of the delta frame
+ * Returns:     bool: true if the frame should be stored as the delta in
+ *                  *buf; false if it should start a new group, because the
+ *                  last group is full, the sizes differ or the delta would
+ *                  be no smaller than the frame
+ */
+bool seq_encode_delta(Frame_seq seq, const uint8_t *frame, size_t len,
+                      unsigned interval, uint8_t **buf, size_t *cap,
+                      size_t *outlen)
+{
+    if (interval <= 1 || seq->count == 0 ||
+        seq->count - seq_keyframe(seq, seq->count - 1) >= interval) {
+        return false;
+    }
+
+    uint8_t *ref = NULL;
+    size_t ref_cap = 0, ref_len;
+    bool ok = seq_rebuild(seq, seq->count - 1, &ref, &ref_cap,
+                          &ref_len) == COMPRESS40_OK &&
+              compress40_delta(ref, ref_len, frame, len, buf, cap,
+                               outlen) == COMPRESS40_OK &&
+              *outlen < len;
+    compress40_free(ref);
+    return ok;
+}
+
+
+/* extract_group
+ * Purpose:     Thread_pool job that decodes one group of frames, writing
+ *                  frame k to <outdir>/frameNNNNNN.ppm, and reports any
+ *                  failure on stderr
+ * Parameters:  void *jobp: the struct Extract_job to run
+ * Note:        The keyframe is converted to format 2 once, and each delta
+ *                  then rewrites only its changed words of it
+ */
+void extract_group(void *jobp)
+{
+    struct Extract_job *job = jobp;
+    size_t ref_len, outlen;
+    Compress40_status status = COMPRESS40_OK;
+
+    for (size_t k = job->first; k < job->first + job->count; k++) {
+        size_t len;
+        const uint8_t *frame = Frame_seq_frame(job->seq, k, &len);
+        if (status != COMPRESS40_OK) {
+            /* the group's image is lost; so are the rest of its frames */
+        } else if (k == job->first) {
+            status = seq_is_delta(job->seq, k) ? COMPRESS40_BAD_FORMAT :
+                     compress40_convert(frame, len, 2, &ref_buf, &ref_cap,
+                                        &ref_len);
+        } else {
+            status = compress40_apply_delta(ref_buf, ref_len, frame, len);
+        }
+        if (status == COMPRESS40_OK) {
+            status = compress40_buffered(false, ref_buf, ref_len, &out_buf,
+                                         &out_cap, &outlen);
+        }
+
+        const char *error = status == COMPRESS40_OK ?
+                            extract_write(job->outdir, k, outlen) :
+                            status == COMPRESS40_BAD_CHECKSUM ?
+                            "checksum mismatch" : "not a compressed image";
+        if (error != NULL) {
+            fprintf(stderr, "40image: frame %zu: %s\n", k, error);
+            job->failures++;
+        }
+    }
+}
+
+
+/* extract_write
+ * Purpose:     Writes the calling worker's decoded frame, out_buf[0..len),
+ *                  to <outdir>/frameNNNNNN.ppm
+ * Returns:     const char *: NULL on success, otherwise what went wrong
+ */
+const char *extract_write(const char *outdir, size_t k, size_t len)
+{
+    const char *error = NULL;
+    size_t size = strlen(outdir) + 32;
+    char *path = ALLOC(size);
+    snprintf(path, size, "%s/frame%06zu.ppm", outdir, k);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || write_at(fd, out_buf, len, 0) != 0) {
+        error = strerror(errno);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    FREE(path);
+    return error;
+}
+
+
+/* extract_worker_exit
+ * Purpose:     Releases a worker's reusable buffers when the pool shuts down
+ */
+void extract_worker_exit(void)
+{
+    compress40_free(out_buf);
+    compress40_free(ref_buf);
+    out_buf = ref_buf = NULL;
+    out_cap = ref_cap = 0;
+    compress40_release();
+}
+
+
+/* write_at
+ * Purpose:     Writes all of buf[0..len) to fd at offset
+ * Returns:     int: 0 on success, -1 (with errno set) otherwise
+ */
+int write_at(int fd, const void *buf, size_t len, uint64_t offset)
+{
+    size_t written = 0;
+    while (written < len) {
+        ssize_t n = pwrite(fd, (const char *) buf + written, len - written,
+                           offset + written);
+        if (n < 0 && errno != EINTR) {
+            return -1;
+        } else if (n > 0) {
+            written += n;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+/* frame_seq.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/4/2021
+ *
+ * Contains the interface for frame sequences: many compressed images (the
+ *  frames of a burst or timelapse, of any sizes) in one file, with an
+ *  index at its end so any frame is found with one lookup. Frames may be
+ *  coded as deltas against the frame before them (40image --append,
+ *  --keyframe, --frame and --extract)
+ */
+
+#ifndef FRAME_SEQ_H
+#define FRAME_SEQ_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "compress40.h"
+
+
+typedef struct Frame_seq *Frame_seq;
+
+
+/* maps the sequence file at path. Returns NULL if path does not exist or
+    is not a well-formed sequence
+    Note: it is a CRE for path to be NULL */
+Frame_seq Frame_seq_open(const char *path);
+
+/* returns the number of frames in the sequence
+   Note: it is a CRE for seq to be NULL */
+size_t Frame_seq_length(Frame_seq seq);
+
+/* returns frame k, a compressed image in any format decompress40 reads,
+    as it lies in the mapped file, and sets *lenp to its length
+    Note: it is a CRE for seq or lenp to be NULL or k to be out of range */
+const uint8_t *Frame_seq_frame(Frame_seq seq, size_t k, size_t *lenp);
+
+/* decodes frame k into a P6 ppm in *buf as in compress40_buffered
+    Note: it is a CRE for seq, buf, cap or outlen to be NULL or k to be out
+    of range */
+Compress40_status Frame_seq_decode(Frame_seq seq, size_t k, uint8_t **buf,
+                                   size_t *cap, size_t *outlen);
+
+/* decodes every frame into outdir/frameNNNNNN.ppm with nthreads threads
+    (one per CPU if < 1), each decoding whole groups of frames. A frame
+    that fails is reported on stderr and skipped. Returns the number of
+    such frames
+    Note: it is a CRE for seq or outdir to be NULL */
+int Frame_seq_extract(Frame_seq seq, const char *outdir, int nthreads);
+
+/* unmaps the sequence
+   Note: it is a CRE for seqp or *seqp to be NULL */
+void Frame_seq_free(Frame_seq *seqp);
+
+/* appends the compressed image frame[0..len) to the sequence at path,
+    creating it if need be. Only the new frame and the index are written.
+    With an interval above 1, a frame the same size as the last one is
+    stored as a delta frame against it (when that is smaller), until a
+    group of interval frames from a keyframe is full. Returns 0, or -1
+    (with errno set, or EINVAL if path exists but is not a sequence) if the
+    sequence could not be written
+    Note: it is a CRE for path or frame to be NULL */
+int Frame_seq_append(const char *path, const uint8_t *frame, size_t len,
+                     unsigned interval);
+
+#endif
@@ -0,0 +1,470 @@
+/* hash_index.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 4/30/2021
+ *
+ * Contains the implementation of the perceptual hash index. An index file
+ *  is laid out so that it can be mapped and queried in place:
+ *
+ *      "C40HASH1"              magic
+ *      uint64_t count          number of images
+ *      uint64_t hashes[count]  their hashes
+ *      uint64_t names[count]   offset of each name in the name table
+ *      char name table[]       NUL-terminated file names
+ *
+ *  all in the host's byte order. A query is one pass of XOR and popcount 
+ *  over the contiguous hash array, split across a Thread_pool for large 
+ *  indexes. Adding images rewrites the whole file (into a temporary that 
+ *  is renamed over the old one), sorted by name.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "assert.h"
+#include "mem.h"
+#include "compress40.h"
+#include "comp_hash.h"
+#include "thread_pool.h"
+#include "hash_index.h"
+
+
+#define INDEX_MAGIC "C40HASH1"
+#define INDEX_HEADER 16
+
+/* indexes with fewer entries than this are queried on the calling thread */
+#define QUERY_MIN_PARALLEL (1 << 16)
+
+
+/* struct Hash_index
+ * Members:     map, size:      the mapped index file
+ *              count:          the number of images
+ *              hashes, names:  the hash and name offset arrays
+ *              table, table_len: the name table
+ */
+struct Hash_index {
+    void *map;
+    size_t size;
+    size_t count;
+    const uint64_t *hashes;
+    const uint64_t *names;
+    const char *table;
+    size_t table_len;
+};
+
+/* struct Query_job
+ * Members:     hashes, first, n:  the slice of the hash array to scan
+ *              hash, max_distance: the query
+ *              matches, nmatches, cap: the matches found, in a growing array
+ */
+struct Query_job {
+    const uint64_t *hashes;
+    size_t first, n;
+    uint64_t hash;
+    unsigned max_distance;
+    Hash_match *matches;
+    size_t nmatches, cap;
+};
+
+/* struct Hash_job
+ * Members:     path:   the compressed image to hash
+ *              hash:   its hash
+ *              error:  NULL on success, otherwise what went wrong
+ */
+struct Hash_job {
+    const char *path;
+    uint64_t hash;
+    const char *error;
+};
+
+/* struct Hash_entry
+ * Members:     name, hash: an image in the index being written
+ *              order:      its position among old then new entries, so 
+ *                              that the newest entry for a name wins
+ */
+struct Hash_entry {
+    const char *name;
+    uint64_t hash;
+    size_t order;
+};
+
+
+/* helper function declarations */
+void query_range(void *jobp);
+void hash_file(void *jobp);
+int cmp_match(const void *a, const void *b);
+int cmp_entry(const void *a, const void *b);
+int write_index(const char *path, struct Hash_entry *entries, size_t n);
+
+
+/* Hash_index_open
+ * Purpose:     Maps an index file and checks that it is well formed
+ * Parameters:  const char *path: the index file
+ * Returns:     Hash_index: the index, or NULL if it cannot be read
+ * Note:        It is a CRE for path to be NULL
+ */
+Hash_index Hash_index_open(const char *path)
+{
+    assert(path != NULL);
+
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < INDEX_HEADER) {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    Hash_index index;
+    NEW(index);
+    index->map = map;
+    index->size = st.st_size;
+    memcpy(&index->count, (char *) map + 8, sizeof(uint64_t));
+    index->hashes = (const uint64_t *) ((char *) map + INDEX_HEADER);
+    index->names = index->hashes + index->count;
+    index->table = (const char *) (index->names + index->count);
+
+    bool ok = memcmp(map, INDEX_MAGIC, 8) == 0 && 
+              index->count <= (index->size - INDEX_HEADER) / 16;
+    if (ok) {
+        index->table_len = index->size - INDEX_HEADER - 16 * index->count;
+        ok = index->count == 0 || (index->table_len > 0 && 
+                                   index->table[index->table_len - 1] == 0);
+    }
+    for (size_t i = 0; ok && i < index->count; i++) {
+        ok = index->names[i] < index->table_len;
+    }
+    if (!ok) {
+        Hash_index_free(&index);
+        return NULL;
+    }
+
+    return index;
+}
+
+
+/* Hash_index_length
+ * Purpose:     returns the number of images in the index
+ */
+size_t Hash_index_length(Hash_index index)
+{
+    assert(index != NULL);
+    return index->count;
+}
+
+
+/* Hash_index_name
+ * Purpose:     returns the file name of the image at entry
+ */
+const char *Hash_index_name(Hash_index index, size_t entry)
+{
+    assert(index != NULL && entry < index->count);
+    return index->table + index->names[entry];
+}
+
+
+/* Hash_index_hash
+ * Purpose:     returns the hash of the image at entry
+ */
+uint64_t Hash_index_hash(Hash_index index, size_t entry)
+{
+    assert(index != NULL && entry < index->count);
+    return index->hashes[entry];
+}
+
+
+/* Hash_index_query
+ * Purpose:     Finds the entries whose hashes are near a query hash
+ * Parameters:  Hash_index index: the index to search
+ *              uint64_t hash: the query
+ *              unsigned max_distance: the most bits a match may differ in
+ *              int nthreads: the number of threads, or < 1 for one per CPU
+ *              Hash_match **matchesp: set to the new array of matches
+ * Returns:     size_t: the number of matches
+ * Note:        It is a CRE for index or matchesp to be NULL
+ *              Matches are sorted by distance, then by entry
+ */
+size_t Hash_index_query(Hash_index index, uint64_t hash, 
+                        unsigned max_distance, int nthreads, 
+                        Hash_match **matchesp)
+{
+    assert(index != NULL && matchesp != NULL);
+
+    struct Query_job whole = { index->hashes, 0, index->count, hash,
+                               max_distance, NULL, 0, 0 };
+
+    if (nthreads == 1 || index->count < QUERY_MIN_PARALLEL) {
+        query_range(&whole);
+    } else {
+        Thread_pool pool = Thread_pool_new(nthreads, NULL);
+        int njobs = Thread_pool_size(pool);
+        struct Query_job *jobs = CALLOC(njobs, sizeof(*jobs));
+
+        size_t per_job = (index->count + njobs - 1) / njobs;
+        for (int i = 0; i < njobs; i++) {
+            jobs[i] = whole;
+            jobs[i].first = per_job * i < index->count ? per_job * i 
+                                                       : index->count;
+            jobs[i].n = index->count - jobs[i].first < per_job ? 
+                        index->count - jobs[i].first : per_job;
+            Thread_pool_submit(pool, i, query_range, &jobs[i]);
+        }
+        Thread_pool_free(&pool);
+
+        for (int i = 0; i < njobs; i++) {
+            whole.nmatches += jobs[i].nmatches;
+        }
+        whole.matches = ALLOC((whole.nmatches > 0 ? whole.nmatches : 1) * 
+                              sizeof(Hash_match));
+        size_t n = 0;
+        for (int i = 0; i < njobs; i++) {
+            if (jobs[i].nmatches > 0) {
+                memcpy(whole.matches + n, jobs[i].matches, 
+                       jobs[i].nmatches * sizeof(Hash_match));
+                n += jobs[i].nmatches;
+            }
+            if (jobs[i].matches != NULL) {
+                FREE(jobs[i].matches);
+            }
+        }
+        FREE(jobs);
+    }
+
+    if (whole.matches == NULL) {
+        whole.matches = ALLOC(sizeof(Hash_match));
+    }
+    qsort(whole.matches, whole.nmatches, sizeof(Hash_match), cmp_match);
+    *matchesp = whole.matches;
+    return whole.nmatches;
+}
+
+
+/* Hash_index_free
+ * Purpose:     unmaps the index and frees its handle
+ */
+void Hash_index_free(Hash_index *indexp)
+{
+    assert(indexp != NULL && *indexp != NULL);
+    munmap((*indexp)->map, (*indexp)->size);
+    FREE(*indexp);
+}
+
+
+/* Hash_index_add
+ * Purpose:     Hashes compressed images and adds them to an index file
+ * Parameters:  const char *path: the index file, created if missing
+ *              char **files, int nfiles: the images to add
+ *              int nthreads: the number of threads, or < 1 for one per CPU
+ * Returns:     int: the number of files that could not be hashed, or -1 if
+ *                  the index could not be written
+ * Note:        It is a CRE for path or files to be NULL
+ *              A file that exists but is not an index is not overwritten
+ */
+int Hash_index_add(const char *path, char **files, int nfiles, int nthreads)
+{
+    assert(path != NULL && files != NULL);
+
+    Hash_index old = Hash_index_open(path);
+    if (old == NULL && access(path, F_OK) == 0) {
+        fprintf(stderr, "40image: %s: not a hash index\n", path);
+        return -1;
+    }
+
+    struct Hash_job *jobs = CALLOC(nfiles > 0 ? nfiles : 1, sizeof(*jobs));
+    Thread_pool pool = Thread_pool_new(nthreads, NULL);
+    for (int i = 0; i < nfiles; i++) {
+        jobs[i].path = files[i];
+        Thread_pool_submit(pool, -1, hash_file, &jobs[i]);
+    }
+    Thread_pool_free(&pool);
+
+    size_t nold = old != NULL ? old->count : 0;
+    struct Hash_entry *entries = ALLOC((nold + nfiles + 1) * 
+                                       sizeof(*entries));
+    size_t n = 0;
+    for (size_t i = 0; i < nold; i++, n++) {
+        entries[n] = (struct Hash_entry) { Hash_index_name(old, i), 
+                                           old->hashes[i], n };
+    }
+
+    int failures = 0;
+    for (int i = 0; i < nfiles; i++) {
+        if (jobs[i].error != NULL) {
+            fprintf(stderr, "40image: %s: %s\n", jobs[i].path, 
+                    jobs[i].error);
+            failures++;
+        } else {
+            entries[n] = (struct Hash_entry) { files[i], jobs[i].hash, n };
+            n++;
+        }
+    }
+
+    /* sort by name, newest first, and keep the first of each name */
+    qsort(entries, n, sizeof(*entries), cmp_entry);
+    size_t kept = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (kept == 0 || strcmp(entries[kept - 1].name, 
+                                entries[i].name) != 0) {
+            entries[kept++] = entries[i];
+        }
+    }
+
+    if (write_index(path, entries, kept) != 0) {
+        fprintf(stderr, "40image: %s: %s\n", path, strerror(errno));
+        failures = -1;
+    }
+
+    FREE(entries);
+    FREE(jobs);
+    if (old != NULL) {
+        Hash_index_free(&old);
+    }
+    return failures;
+}
+
+
+/* query_range
+ * Purpose:     Thread_pool job (also run directly) that collects the 
+ *                  matches in one slice of the hash array
+ * Parameters:  void *jobp: the struct Query_job to run
+ */
+void query_range(void *jobp)
+{
+    struct Query_job *job = jobp;
+    const uint64_t *hashes = job->hashes + job->first;
+
+    for (size_t i = 0; i < job->n; i++) {
+        unsigned distance = Comp_hash_distance(hashes[i], job->hash);
+        if (distance > job->max_distance) {
+            continue;
+        }
+        if (job->nmatches == job->cap) {
+            job->cap = job->cap > 0 ? job->cap * 2 : 64;
+            if (job->matches == NULL) {
+                job->matches = ALLOC(job->cap * sizeof(Hash_match));
+            } else {
+                RESIZE(job->matches, job->cap * sizeof(Hash_match));
+            }
+        }
+        job->matches[job->nmatches++] = 
+            (Hash_match) { job->first + i, distance };
+    }
+}
+
+
+/* hash_file
+ * Purpose:     Thread_pool job that maps one compressed image and hashes it
+ * Parameters:  void *jobp: the struct Hash_job to run
+ * Note:        Sets job->error instead of hashing if the file cannot be 
+ *                  read or is not a compressed image
+ */
+void hash_file(void *jobp)
+{
+    struct Hash_job *job = jobp;
+    struct stat st;
+
+    int fd = open(job->path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size <= 0) {
+        job->error = fd < 0 ? strerror(errno) : "empty or unreadable file";
+        if (fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+    void *in = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (in == MAP_FAILED) {
+        job->error = "cannot map file";
+        return;
+    }
+
+    if (compress40_hash(in, st.st_size, &job->hash) != COMPRESS40_OK) {
+        job->error = "not a compressed image";
+    }
+    munmap(in, st.st_size);
+}
+
+
+/* cmp_match
+ * Purpose:     qsort comparison ordering matches by distance, then entry
+ */
+int cmp_match(const void *a, const void *b)
+{
+    const Hash_match *x = a, *y = b;
+    if (x->distance != y->distance) {
+        return x->distance < y->distance ? -1 : 1;
+    }
+    return (x->entry > y->entry) - (x->entry < y->entry);
+}
+
+
+/* cmp_entry
+ * Purpose:     qsort comparison ordering entries by name, newest first
+ */
+int cmp_entry(const void *a, const void *b)
+{
+    const struct Hash_entry *x = a, *y = b;
+    int c = strcmp(x->name, y->name);
+    if (c != 0) {
+        return c;
+    }
+    return (x->order < y->order) - (x->order > y->order);
+}
+
+
+/* write_index
+ * Purpose:     Writes entries as an index file at path, replacing any old
+ *                  one only once the new one is complete
+ * Parameters:  const char *path: the index file
+ *              struct Hash_entry *entries, size_t n: the images
+ * Returns:     int: 0 on success, -1 (with errno set) otherwise
+ */
+int write_index(const char *path, struct Hash_entry *entries, size_t n)
+{
+    size_t path_len = strlen(path);
+    char *tmp = ALLOC(path_len + 5);
+    memcpy(tmp, path, path_len);
+    memcpy(tmp + path_len, ".tmp", 5);
+
+    FILE *fp = fopen(tmp, "wb");
+    if (fp == NULL) {
+        FREE(tmp);
+        return -1;
+    }
+
+    uint64_t count = n, offset = 0;
+    fwrite(INDEX_MAGIC, 1, 8, fp);
+    fwrite(&count, sizeof(count), 1, fp);
+    for (size_t i = 0; i < n; i++) {
+        fwrite(&entries[i].hash, sizeof(uint64_t), 1, fp);
+    }
+    for (size_t i = 0; i < n; i++) {
+        fwrite(&offset, sizeof(offset), 1, fp);
+        offset += strlen(entries[i].name) + 1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        fwrite(entries[i].name, 1, strlen(entries[i].name) + 1, fp);
+    }
+
+    int result = ferror(fp) ? -1 : 0;
+    if (fclose(fp) != 0 || result != 0 || rename(tmp, path) != 0) {
+        int saved = errno;
+        unlink(tmp);
+        errno = saved;
+        result = -1;
+    }
+    FREE(tmp);
+    return result;
+}
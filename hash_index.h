@@ -0,0 +1,65 @@
+/* hash_index.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 4/30/2021
+ *
+ * Contains the interface for an on-disk index of perceptual hashes of 
+ *  compressed images, and for finding the near duplicates of an image in it
+ *  (40image --hash-add and --near)
+ */
+
+#ifndef HASH_INDEX_H
+#define HASH_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+typedef struct Hash_index *Hash_index;
+
+/* an index entry within some Hamming distance of a query */
+typedef struct Hash_match {
+    size_t entry;
+    unsigned distance;
+} Hash_match;
+
+
+/* maps the index at path. Returns NULL if path does not exist or is not a
+    well-formed index
+    Note: it is a CRE for path to be NULL */
+Hash_index Hash_index_open(const char *path);
+
+/* returns the number of images in the index 
+   Note: it is a CRE for index to be NULL */
+size_t Hash_index_length(Hash_index index);
+
+/* returns the file name of the image at entry 
+   Note: it is a CRE for index to be NULL or entry to be out of range */
+const char *Hash_index_name(Hash_index index, size_t entry);
+
+/* returns the hash of the image at entry 
+   Note: it is a CRE for index to be NULL or entry to be out of range */
+uint64_t Hash_index_hash(Hash_index index, size_t entry);
+
+/* finds every entry whose hash is at most max_distance bits from hash, 
+    scanning with nthreads threads (one per CPU if < 1). *matchesp receives
+    a new array of them, nearest first, to be freed with FREE, and their 
+    number is returned
+    Note: it is a CRE for index or matchesp to be NULL */
+size_t Hash_index_query(Hash_index index, uint64_t hash, 
+                        unsigned max_distance, int nthreads, 
+                        Hash_match **matchesp);
+
+/* unmaps the index
+   Note: it is a CRE for indexp or *indexp to be NULL */
+void Hash_index_free(Hash_index *indexp);
+
+/* hashes the nfiles compressed images named in files using nthreads 
+    threads, and rewrites the index at path (creating it if need be) with 
+    them added; an image already in the index under the same name is 
+    replaced. Files that cannot be hashed are reported on stderr and 
+    skipped. Returns the number of such files, or -1 if the index could not
+    be written
+    Note: it is a CRE for path or files to be NULL */
+int Hash_index_add(const char *path, char **files, int nfiles, int nthreads);
+
+#endif
@@ -0,0 +1,240 @@
+/* img_arena.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 4/12/2021
+ *
+ * Contains the implementation of Img_arena, a chunked bump allocator. Chunks
+ *  are mapped straight from the OS and each one begins with its own header,
+ *  so the arena itself never touches Hanson's Mem.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "assert.h"
+#include "img_arena.h"
+#include "uarrayrep.h"
+#include "big_buf.h"
+
+
+/* every allocation is rounded up to a multiple of this many bytes */
+#define ARENA_ALIGN 16
+
+/* chunks are sized in multiples of a transparent huge page */
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+
+/* struct Chunk
+ * Members:     next:   the next chunk in the arena, or NULL
+ *              limit:  one past the last usable byte of the chunk
+ *              size:   the number of bytes mapped for the chunk
+ * Note:        the usable memory of a chunk starts right after its header
+ */
+struct Chunk {
+    struct Chunk *next;
+    char *limit;
+    size_t size;
+};
+
+/* struct Img_arena
+ * Members:     first:      the first chunk, which also holds this struct
+ *              curr:       the chunk currently being bumped through
+ *              avail:      the next free byte in curr
+ *              chunk_size: the minimum size of a newly mapped chunk
+ *              used:       bytes handed out since the last reset
+ *              huge_pages: whether chunks are advised to use huge pages
+ */
+struct Img_arena {
+    struct Chunk *first, *curr;
+    char *avail;
+    size_t chunk_size;
+    size_t used;
+    bool huge_pages;
+};
+
+
+/* helper function declarations */
+struct Chunk *arena_map_chunk(size_t min_size, bool huge_pages, 
+                              bool prefault);
+char *arena_chunk_base(struct Chunk *chunk);
+size_t arena_round_up(size_t n, size_t multiple);
+
+
+/* Img_arena_new
+ * Purpose:     Maps the first chunk of a new arena and places the arena's
+ *                  own bookkeeping at the start of it
+ * Parameters:  size_t chunk_size: the minimum size of each mapped chunk
+ *              bool huge_pages: true to back chunks with huge pages
+ * Returns:     Img_arena: the new, empty arena
+ */
+Img_arena Img_arena_new(size_t chunk_size, bool huge_pages)
+{
+    struct Chunk *first = arena_map_chunk(chunk_size, huge_pages, false);
+
+    Img_arena arena = (Img_arena) arena_chunk_base(first);
+    arena->first = first;
+    arena->curr = first;
+    arena->chunk_size = chunk_size;
+    arena->huge_pages = huge_pages;
+    Img_arena_reset(arena);
+
+    return arena;
+}
+
+
+/* Img_arena_alloc
+ * Purpose:     Bumps nbytes off the current chunk, moving on to the next
+ *                  chunk (or mapping a new one) when the current one is full
+ * Parameters:  Img_arena arena: the arena to allocate from
+ *              size_t nbytes: the number of bytes needed
+ * Returns:     void *: pointer to the uninitialized memory
+ * Note:        It is a CRE for arena to be NULL
+ */
+void *Img_arena_alloc(Img_arena arena, size_t nbytes)
+{
+    assert(arena != NULL);
+    nbytes = arena_round_up(nbytes > 0 ? nbytes : 1, ARENA_ALIGN);
+
+    while ((size_t) (arena->curr->limit - arena->avail) < nbytes) {
+        struct Chunk *next = arena->curr->next;
+
+        /* splice in a fresh chunk if the next one is missing or too small.
+           Chunks for big buffers are prefaulted if Big_buf is configured 
+           to do so; once faulted they stay that way across resets */
+        if (next == NULL ||
+            (size_t) (next->limit - arena_chunk_base(next)) < nbytes) {
+            size_t size = nbytes + sizeof(struct Chunk);
+            bool prefault = Big_buf_prefault() && 
+                            nbytes >= Big_buf_threshold();
+            next = arena_map_chunk(size > arena->chunk_size ?
+                                        size : arena->chunk_size,
+                                   arena->huge_pages, prefault);
+            next->next = arena->curr->next;
+            arena->curr->next = next;
+        }
+
+        arena->curr = next;
+        arena->avail = arena_chunk_base(next);
+    }
+
+    void *ptr = arena->avail;
+    arena->avail += nbytes;
+    arena->used += nbytes;
+
+    return ptr;
+}
+
+
+/* Img_arena_reset
+ * Purpose:     Releases every allocation at once by rewinding to the start
+ *                  of the first chunk. Later chunks stay mapped and are
+ *                  reused as the arena fills up again.
+ * Note:        It is a CRE for arena to be NULL
+ */
+void Img_arena_reset(Img_arena arena)
+{
+    assert(arena != NULL);
+    arena->curr = arena->first;
+    arena->avail = arena_chunk_base(arena->first) +
+                   arena_round_up(sizeof(struct Img_arena), ARENA_ALIGN);
+    arena->used = 0;
+}
+
+
+/* Img_arena_free
+ * Purpose:     Unmaps all of the arena's chunks, including the one holding
+ *                  the arena itself
+ * Note:        It is a CRE for arenap or *arenap to be NULL
+ */
+void Img_arena_free(Img_arena *arenap)
+{
+    assert(arenap != NULL);
+    assert(*arenap != NULL);
+
+    struct Chunk *chunk = (*arenap)->first;
+    while (chunk != NULL) {
+        struct Chunk *next = chunk->next;
+        munmap(chunk, chunk->size);
+        chunk = next;
+    }
+
+    *arenap = NULL;
+}
+
+
+/* Img_arena_used
+ * Purpose:     returns the number of bytes handed out since the last reset
+ * Note:        It is a CRE for arena to be NULL
+ */
+size_t Img_arena_used(Img_arena arena)
+{
+    assert(arena != NULL);
+    return arena->used;
+}
+
+
+/* UArray_new_in
+ * Purpose:     Creates a Hanson UArray whose descriptor and elements both
+ *                  live in the provided arena
+ * Parameters:  Img_arena arena: the arena that owns the UArray
+ *              int length: the number of elements
+ *              int size: the number of bytes in one element
+ * Returns:     UArray_T: the new UArray, with uninitialized elements
+ * Note:        It is a CRE for arena to be NULL
+ *              The UArray is released by resetting the arena, never by
+ *                  UArray_free
+ */
+UArray_T UArray_new_in(Img_arena arena, int length, int size)
+{
+    assert(arena != NULL);
+    assert(length >= 0 && size > 0);
+
+    UArray_T uarray = Img_arena_alloc(arena, sizeof(*uarray));
+    UArrayRep_init(uarray, length, size,
+                   Img_arena_alloc(arena, (size_t) length * size));
+
+    return uarray;
+}
+
+
+/* arena_map_chunk
+ * Purpose:     Maps a new chunk of at least min_size bytes from the OS
+ * Parameters:  size_t min_size: the minimum size of the chunk
+ *              bool huge_pages: true to advise the kernel to use huge pages
+ *              bool prefault: true to fault in every page of the chunk now
+ * Returns:     struct Chunk *: the new chunk with its header filled in
+ * Note:        Raises Mem_Failed if the mapping fails
+ */
+struct Chunk *arena_map_chunk(size_t min_size, bool huge_pages, 
+                              bool prefault)
+{
+    size_t size = arena_round_up(min_size + sizeof(struct Chunk) +
+                                 sizeof(struct Img_arena), HUGE_PAGE_SIZE);
+
+    void *mem = Big_buf_map(size, huge_pages, prefault);
+
+    struct Chunk *chunk = mem;
+    chunk->next = NULL;
+    chunk->limit = (char *) mem + size;
+    chunk->size = size;
+
+    return chunk;
+}
+
+
+/* arena_chunk_base
+ * Purpose:     returns the first usable byte of a chunk, just past its header
+ */
+char *arena_chunk_base(struct Chunk *chunk)
+{
+    return (char *) chunk + arena_round_up(sizeof(struct Chunk), ARENA_ALIGN);
+}
+
+
+/* arena_round_up
+ * Purpose:     returns n rounded up to the nearest multiple of multiple
+ */
+size_t arena_round_up(size_t n, size_t multiple)
+{
+    return ((n + multiple - 1) / multiple) * multiple;
+}
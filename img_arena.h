@@ -0,0 +1,49 @@
+/* img_arena.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 4/12/2021
+ *
+ * Contains the interface for Img_arena, a bump allocator that owns all of
+ *  the per-image state of the compression pipeline. Everything allocated
+ *  from an arena is released at once by Img_arena_reset, so one arena can
+ *  be reused for image after image without any piece-by-piece frees.
+ */
+
+#ifndef IMG_ARENA_H
+#define IMG_ARENA_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "uarray.h"
+
+
+typedef struct Img_arena *Img_arena;
+
+/* allocates a new, empty arena that grabs memory from the OS in chunks of
+    at least chunk_size bytes. If huge_pages is true, chunks are advised to
+    be backed by transparent huge pages */
+Img_arena Img_arena_new(size_t chunk_size, bool huge_pages);
+
+/* returns a pointer to nbytes of uninitialized memory owned by the arena
+    Note: it is a CRE for arena to be NULL
+          raises Mem_Failed if the OS refuses to map more memory */
+void *Img_arena_alloc(Img_arena arena, size_t nbytes);
+
+/* releases everything allocated from the arena in O(1), keeping its chunks
+    mapped for the next image
+    Note: it is a CRE for arena to be NULL */
+void Img_arena_reset(Img_arena arena);
+
+/* unmaps every chunk of the arena and sets *arenap to NULL
+    Note: it is a CRE for arenap or *arenap to be NULL */
+void Img_arena_free(Img_arena *arenap);
+
+/* returns the number of bytes currently handed out by the arena
+    Note: it is a CRE for arena to be NULL */
+size_t Img_arena_used(Img_arena arena);
+
+/* allocates a Hanson UArray whose descriptor and elements are owned by the
+    arena. It must never be passed to UArray_free
+    Note: it is a CRE for arena to be NULL */
+UArray_T UArray_new_in(Img_arena arena, int length, int size);
+
+#endif
@@ -0,0 +1,186 @@
+/* ppm_mem.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/7/2021
+ *
+ * Contains the implementation of in-memory P6 ppm and P5 pgm header 
+ * handling
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "ppm_mem.h"
+
+
+/* helper function declarations */
+bool pnm_parse_header(const uint8_t *buf, size_t len, char kind, 
+                      unsigned channels, Ppm_header *hdr);
+size_t pnm_write_header(uint8_t *buf, char kind, unsigned width, 
+                        unsigned height, unsigned maxval);
+bool ppm_skip_space(const uint8_t *buf, size_t len, size_t *pos);
+bool ppm_read_uint(const uint8_t *buf, size_t len, size_t *pos, 
+                   unsigned *n);
+
+
+/* Ppm_parse_header
+ * Purpose:     Parses and checks the header of an in-memory P6 ppm
+ * Parameters:  const uint8_t *buf: the bytes of the ppm
+ *              size_t len: the number of bytes in buf
+ *              Ppm_header *hdr: filled in with the parsed header
+ * Returns:     bool: true if buf holds a complete P6 ppm, false otherwise
+ * Note:        It is a CRE for buf or hdr to be NULL
+ */
+bool Ppm_parse_header(const uint8_t *buf, size_t len, Ppm_header *hdr)
+{
+    return pnm_parse_header(buf, len, '6', 3, hdr);
+}
+
+
+/* Ppm_write_header
+ * Purpose:     Writes a P6 header for an image of the provided size
+ * Parameters:  uint8_t *buf: where to write the header, or NULL to only 
+ *                  measure it
+ *              unsigned width, height, maxval: the image's header values
+ * Returns:     size_t: the length of the header in bytes
+ */
+size_t Ppm_write_header(uint8_t *buf, unsigned width, unsigned height,
+                        unsigned maxval)
+{
+    return pnm_write_header(buf, '6', width, height, maxval);
+}
+
+
+/* Pgm_parse_header
+ * Purpose:     Parses and checks the header of an in-memory P5 pgm
+ * Parameters:  const uint8_t *buf: the bytes of the pgm
+ *              size_t len: the number of bytes in buf
+ *              Ppm_header *hdr: filled in with the parsed header
+ * Returns:     bool: true if buf holds a complete P5 pgm, false otherwise
+ * Note:        It is a CRE for buf or hdr to be NULL
+ */
+bool Pgm_parse_header(const uint8_t *buf, size_t len, Ppm_header *hdr)
+{
+    return pnm_parse_header(buf, len, '5', 1, hdr);
+}
+
+
+/* Pgm_write_header
+ * Purpose:     Writes a P5 header for an image of the provided size
+ * Parameters:  uint8_t *buf: where to write the header, or NULL to only 
+ *                  measure it
+ *              unsigned width, height, maxval: the image's header values
+ * Returns:     size_t: the length of the header in bytes
+ */
+size_t Pgm_write_header(uint8_t *buf, unsigned width, unsigned height,
+                        unsigned maxval)
+{
+    return pnm_write_header(buf, '5', width, height, maxval);
+}
+
+
+/* pnm_parse_header
+ * Purpose:     Parses and checks the header of an in-memory raw pnm
+ * Parameters:  const uint8_t *buf, size_t len: the bytes of the pnm
+ *              char kind: the digit after the 'P' of its magic number
+ *              unsigned channels: the samples per pixel
+ *              Ppm_header *hdr: filled in with the parsed header
+ * Returns:     bool: true if buf holds a complete pnm of that kind
+ */
+bool pnm_parse_header(const uint8_t *buf, size_t len, char kind, 
+                      unsigned channels, Ppm_header *hdr)
+{
+    if (buf == NULL || hdr == NULL || len < 2 || 
+        buf[0] != 'P' || buf[1] != kind) {
+        return false;
+    }
+
+    size_t pos = 2;
+    if (!ppm_read_uint(buf, len, &pos, &hdr->width) ||
+        !ppm_read_uint(buf, len, &pos, &hdr->height) ||
+        !ppm_read_uint(buf, len, &pos, &hdr->maxval)) {
+        return false;
+    }
+
+    /* exactly one whitespace byte separates maxval from the raster */
+    if (pos >= len || !isspace(buf[pos]) || 
+        hdr->maxval == 0 || hdr->maxval > 65535) {
+        return false;
+    }
+    hdr->raster_offset = pos + 1;
+
+    /* a raster whose size does not fit in a size_t cannot be in buf */
+    size_t sample_bytes = hdr->maxval > 255 ? 2 : 1;
+    if (hdr->width == 0 || hdr->height == 0 ||
+        hdr->width > SIZE_MAX / hdr->height / channels / sample_bytes) {
+        return false;
+    }
+    hdr->raster_bytes = (size_t) hdr->width * hdr->height * channels * 
+                        sample_bytes;
+
+    return len - hdr->raster_offset >= hdr->raster_bytes;
+}
+
+
+/* pnm_write_header
+ * Purpose:     Writes a raw pnm header of the provided kind ('6' or '5')
+ * Returns:     size_t: the length of the header in bytes
+ */
+size_t pnm_write_header(uint8_t *buf, char kind, unsigned width, 
+                        unsigned height, unsigned maxval)
+{
+    char header[64];
+    int n = snprintf(header, sizeof(header), "P%c\n%u %u\n%u\n", 
+                     kind, width, height, maxval);
+
+    if (buf != NULL) {
+        memcpy(buf, header, n);
+    }
+    return n;
+}
+
+
+/* ppm_skip_space
+ * Purpose:     Advances pos past whitespace and '#' comments
+ * Returns:     bool: false if the end of the buffer was reached
+ */
+bool ppm_skip_space(const uint8_t *buf, size_t len, size_t *pos)
+{
+    while (*pos < len) {
+        if (buf[*pos] == '#') {
+            while (*pos < len && buf[*pos] != '\n') {
+                (*pos)++;
+            }
+        } else if (isspace(buf[*pos])) {
+            (*pos)++;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/* ppm_read_uint
+ * Purpose:     Reads one unsigned decimal header field starting at pos
+ * Returns:     bool: false if no number was found or it overflowed
+ */
+bool ppm_read_uint(const uint8_t *buf, size_t len, size_t *pos, 
+                   unsigned *n)
+{
+    if (!ppm_skip_space(buf, len, pos) || !isdigit(buf[*pos])) {
+        return false;
+    }
+
+    uint64_t value = 0;
+    while (*pos < len && isdigit(buf[*pos])) {
+        value = value * 10 + (buf[*pos] - '0');
+        if (value > 0xFFFFFFFFu) {
+            return false;
+        }
+        (*pos)++;
+    }
+
+    *n = (unsigned) value;
+    return true;
+}
@@ -0,0 +1,47 @@
+/* ppm_mem.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/7/2021
+ *
+ * Contains the interface for reading and writing the header of a raw (P6)
+ * ppm or (P5) pgm that lives in memory, so that its raster can be handed 
+ * straight to the pipeline without going through Pnm_ppmread.
+ */
+
+#ifndef PPM_MEM_H
+#define PPM_MEM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+/* Ppm_header
+ * Members:     width, height:  the dimensions of the image in pixels
+ *              maxval:         the denominator of the samples (1 to 65535)
+ *              raster_offset:  the byte offset of the raster in the buffer
+ *              raster_bytes:   the size of the raster in bytes
+ */
+typedef struct Ppm_header {
+    unsigned width, height, maxval;
+    size_t raster_offset;
+    size_t raster_bytes;
+} Ppm_header;
+
+
+/* parses the header of the P6 ppm at the start of buf into hdr. Returns
+    false if buf does not hold a complete P6 ppm */
+bool Ppm_parse_header(const uint8_t *buf, size_t len, Ppm_header *hdr);
+
+/* writes a P6 header for an image of the provided size into buf and returns
+    its length. If buf is NULL nothing is written */
+size_t Ppm_write_header(uint8_t *buf, unsigned width, unsigned height,
+                        unsigned maxval);
+
+/* like Ppm_parse_header, for a P5 pgm: one sample per pixel */
+bool Pgm_parse_header(const uint8_t *buf, size_t len, Ppm_header *hdr);
+
+/* like Ppm_write_header, for a P5 pgm */
+size_t Pgm_write_header(uint8_t *buf, unsigned width, unsigned height,
+                        unsigned maxval);
+
+#endif
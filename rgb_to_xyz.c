@@ -1,6 +1,6 @@
 /* rgb_to_xyz.c
  * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
- * last edited: 3/13/2021
+ * last edited: 5/7/2021
  * 
  * Purpose: contains the implementation of functions for converting between
  *              images in the RGB colorspace and images in the CIE XYZ 
@@ -19,14 +19,13 @@
 #include "mem.h"
 #include <math.h>
 #include "math_funs.h"
+#include "uarray2.h"
 
 
 
 /*********************** Helper function declarations ************************/
 XYZ_pix rgb_to_xyz(Pnm_rgb rgb_pix, int denom);
 
-struct Pnm_rgb xyz_to_rgb(XYZ_pix xyz_pix, int denom);
-
 void apply_rgb_to_xyz(int col, int row, A2Methods_UArray2 xyz_array, 
                                         A2Methods_Object *xyz_pix, 
                                         void *rgb_imgp);
@@ -35,6 +34,18 @@ void apply_xyz_to_rgb(int col, int row, A2Methods_UArray2 xyz_array,
                                         A2Methods_Object *xyz_pix, 
                                         void *rgb_imgp);
 
+void apply_raster_to_xyz(int col, int row, A2Methods_UArray2 xyz_array, 
+                                           A2Methods_Object *xyz_pix, 
+                                           void *raster_cl);
+
+void apply_raster16_to_xyz(int col, int row, A2Methods_UArray2 xyz_array, 
+                                             A2Methods_Object *xyz_pix, 
+                                             void *raster_cl);
+
+void apply_xyz_to_raster(int col, int row, A2Methods_UArray2 xyz_array, 
+                                           A2Methods_Object *xyz_pix, 
+                                           void *raster_cl);
+
 int xyz_val_to_rgb_val(XYZ_pix xyz_pix, const float Pb_mult, 
                                         const float Pr_mult, int denom);
 
@@ -77,6 +88,29 @@ const int DENOMINATOR = 255;
 
 
 
+/* struct Raster_cl
+ * Purpose:     closure for converting between XYZ_imgs and raw P6 rasters
+ * Members:     raster: the first byte of the raster
+ *              width:  the number of pixels in one row of the raster
+ *              maxval: the denominator of the raster's samples
+ *              col0, row0: the XYZ pixel that lands at the raster's top 
+ *                  left corner
+ *              height: the number of rows in the raster; XYZ pixels 
+ *                  outside the width x height window are skipped
+ *              to_xyz: the RGB to Y, Pb and Pr coefficients divided by 
+ *                  maxval, for reading 16-bit rasters without a division
+ */
+struct Raster_cl {
+    uint8_t *raster;
+    unsigned width;
+    unsigned maxval;
+    unsigned col0, row0;
+    unsigned height;
+    float to_xyz[3][3];
+};
+
+
+
 /******************************************************************************
 ******************************** Functions ************************************
 ******************************************************************************/
@@ -93,12 +127,28 @@ const int DENOMINATOR = 255;
  *          It is a CRE for rgb_img to be NULL
  */
 XYZ_img rgb_img_to_xyz(Pnm_ppm rgb_img)
+{
+    return rgb_img_to_xyz_in(NULL, rgb_img);
+}
+
+
+/* rgb_img_to_xyz_in
+ *  Purpose: Same as rgb_img_to_xyz, but the XYZ_img is allocated out of the
+ *           provided arena
+ *  Parameters: Img_arena arena: the arena to own the new image, or NULL to 
+ *                  allocate it on the heap
+ *              Pnm_ppm rgb_img: the image to be converted
+ *  Returns:    XYZ_img: the CIE XYZ version of the provided image
+ *  Note:   It is a CRE for rgb_img to have width or height < 2
+ *          It is a CRE for rgb_img to be NULL
+ */
+XYZ_img rgb_img_to_xyz_in(Img_arena arena, Pnm_ppm rgb_img)
 {
     assert(rgb_img != NULL);
     assert(rgb_img->width > 1 && rgb_img->height > 1);
 
-    XYZ_img xyz_img = XYZ_img_new(evenify(rgb_img->width), 
-                                  evenify(rgb_img->height));
+    XYZ_img xyz_img = XYZ_img_new_in(arena, evenify(rgb_img->width), 
+                                            evenify(rgb_img->height));
 
 
     XYZ_img_map(xyz_img, apply_rgb_to_xyz, &rgb_img);       
@@ -115,19 +165,48 @@ XYZ_img rgb_img_to_xyz(Pnm_ppm rgb_img)
  *              It is a CRE for xyz_img to have width or height < 2
  */
 Pnm_ppm xyz_img_to_rgb(XYZ_img xyz_img)
+{
+    return xyz_img_to_rgb_in(NULL, xyz_img);
+}
+
+
+/*xyz_img_to_rgb_in
+ * Purpose:     Same as xyz_img_to_rgb, but the Pnm_ppm and its pixels are 
+ *                  allocated out of the provided arena
+ * Parameters:  Img_arena arena: the arena to own the new image, or NULL to 
+ *                  allocate it on the heap
+ *              XYZ_img xyz_img: the CIE XYZ colorspace image to be converted
+ * Returns:     Pnm_ppm: An RGB version of the original image
+ * Notes:       It is a CRE for xyz_img to be NULL
+ *              It is a CRE for xyz_img to have width or height < 2
+ *              An arena-owned result must never be passed to Pnm_ppmfree
+ */
+Pnm_ppm xyz_img_to_rgb_in(Img_arena arena, XYZ_img xyz_img)
 {
     assert(xyz_img != NULL);
     assert(XYZ_img_height(xyz_img) > 1 && XYZ_img_width(xyz_img) > 1);
 
     /* initialize rgb image same size as xyz image */
-    Pnm_ppm rgb_img = ALLOC(sizeof(struct Pnm_ppm));
+    Pnm_ppm rgb_img;
+    if (arena == NULL) {
+        rgb_img = ALLOC(sizeof(struct Pnm_ppm));
+    } else {
+        rgb_img = Img_arena_alloc(arena, sizeof(struct Pnm_ppm));
+    }
     rgb_img->width = XYZ_img_width(xyz_img);
     rgb_img->height = XYZ_img_height(xyz_img);
     rgb_img->denominator = DENOMINATOR;
     rgb_img->methods = uarray2_methods_plain;
     assert(rgb_img->methods);
-    rgb_img->pixels = rgb_img->methods->new(rgb_img->width, rgb_img->height,
-                                            sizeof(struct Pnm_rgb));
+    if (arena == NULL) {
+        rgb_img->pixels = rgb_img->methods->new(rgb_img->width, 
+                                                rgb_img->height,
+                                                sizeof(struct Pnm_rgb));
+    } else {
+        rgb_img->pixels = UArray2_new_in(arena, rgb_img->width, 
+                                         rgb_img->height,
+                                         sizeof(struct Pnm_rgb));
+    }
 
     /* map through xyz pixels converting to rgb and adding to rgb_img */
     XYZ_img_map(xyz_img, apply_xyz_to_rgb, &rgb_img);
@@ -263,4 +342,216 @@ void apply_xyz_to_rgb(int col, int row, A2Methods_UArray2 xyz_array,
 
     *rgb_pix = xyz_to_rgb(*(XYZ_pix *)xyz_pix, rgb_img->denominator);
     (void) xyz_array;
-}
\ No newline at end of file
+}
+
+
+/* raster_to_xyz_in
+ *  Purpose: Converts a raw P6 raster straight into a CIE XYZ image, without
+ *           building a Pnm_ppm first
+ *  Parameters: Img_arena arena: the arena to own the new image, or NULL to 
+ *                  allocate it on the heap
+ *              const uint8_t *raster: the raster's first byte
+ *              unsigned width, height: the dimensions of the raster
+ *              unsigned maxval: the denominator of the raster's samples; 
+ *                  samples are two big-endian bytes if it is over 255
+ *  Returns:    XYZ_img: the CIE XYZ version of the raster
+ *  Note:   Odd dimensions are reduced to even numbers like rgb_img_to_xyz
+ *          It is a CRE for raster to be NULL
+ *          It is a CRE for width or height to be < 2
+ */
+XYZ_img raster_to_xyz_in(Img_arena arena, const uint8_t *raster, 
+                         unsigned width, unsigned height, unsigned maxval)
+{
+    assert(raster != NULL);
+    assert(width > 1 && height > 1);
+
+    XYZ_img xyz_img = XYZ_img_new_in(arena, evenify(width), evenify(height));
+
+    struct Raster_cl cl = { (uint8_t *) raster, width, maxval, 
+                            0, 0, height, {
+        { R_TO_Y / maxval, G_TO_Y / maxval, B_TO_Y / maxval },
+        { R_TO_PB / maxval, G_TO_PB / maxval, B_TO_PB / maxval },
+        { R_TO_PR / maxval, G_TO_PR / maxval, B_TO_PR / maxval }
+    } };
+    XYZ_img_map(xyz_img, maxval > 255 ? apply_raster16_to_xyz 
+                                      : apply_raster_to_xyz, &cl);
+
+    return xyz_img;
+}
+
+
+/* xyz_to_raster16
+ *  Purpose: Converts a CIE XYZ image straight into a raw P6 raster with 
+ *           maxval 65535, two big-endian bytes per sample
+ *  Parameters: XYZ_img xyz_img: the image to convert
+ *              uint8_t *raster: where to write the raster's 
+ *                  6 * width * height bytes
+ *  Returns:    None
+ *  Note:   It is a CRE for xyz_img or raster to be NULL
+ */
+void xyz_to_raster16(XYZ_img xyz_img, uint8_t *raster)
+{
+    assert(xyz_img != NULL);
+    assert(raster != NULL);
+
+    struct Raster_cl cl = { raster, XYZ_img_width(xyz_img), 65535, 0, 0, 
+                            XYZ_img_height(xyz_img), { { 0 } } };
+    XYZ_img_map(xyz_img, apply_xyz_to_raster, &cl);
+}
+
+
+/* xyz_to_raster
+ *  Purpose: Converts a CIE XYZ image straight into a raw P6 raster with 
+ *           maxval DENOMINATOR, without building a Pnm_ppm first
+ *  Parameters: XYZ_img xyz_img: the image to convert
+ *              uint8_t *raster: where to write the raster's 
+ *                  3 * width * height bytes
+ *  Returns:    None
+ *  Note:   It is a CRE for xyz_img or raster to be NULL
+ */
+void xyz_to_raster(XYZ_img xyz_img, uint8_t *raster)
+{
+    assert(xyz_img != NULL);
+    assert(raster != NULL);
+
+    xyz_to_raster_crop(xyz_img, raster, 0, 0, XYZ_img_width(xyz_img), 
+                       XYZ_img_height(xyz_img));
+}
+
+
+/* xyz_to_raster_crop
+ *  Purpose: Converts a rectangle of a CIE XYZ image straight into a raw P6
+ *           raster with maxval DENOMINATOR
+ *  Parameters: XYZ_img xyz_img: the image to convert
+ *              uint8_t *raster: where to write the raster's 
+ *                  3 * width * height bytes
+ *              unsigned col, row: the top left pixel of the rectangle
+ *              unsigned width, height: the size of the rectangle
+ *  Returns:    None
+ *  Note:   It is a CRE for xyz_img or raster to be NULL, or for the 
+ *              rectangle to reach outside the image
+ */
+void xyz_to_raster_crop(XYZ_img xyz_img, uint8_t *raster, unsigned col, 
+                        unsigned row, unsigned width, unsigned height)
+{
+    assert(xyz_img != NULL);
+    assert(raster != NULL);
+    assert(col + width <= XYZ_img_width(xyz_img));
+    assert(row + height <= XYZ_img_height(xyz_img));
+
+    struct Raster_cl cl = { raster, width, DENOMINATOR, col, row, height,
+                            { { 0 } } };
+    XYZ_img_map(xyz_img, apply_xyz_to_raster, &cl);
+}
+
+
+/* apply_raster_to_xyz
+ *  Purpose:    Reads the current pixel's samples out of a raw P6 raster and
+ *                  stores their CIE XYZ values in the pixel
+ *  Parameters: int col, row: The column and row index of the XYZ pixel
+ *              xyz_array: The 2D array holding the current XYZ pixel
+ *              xyz_pix:   pointer to the current XYZ pixel
+ *              raster_cl: pointer to a struct Raster_cl for the raster
+ *  Returns:    None
+ */
+void apply_raster_to_xyz(int col, int row, A2Methods_UArray2 xyz_array, 
+                                           A2Methods_Object *xyz_pix, 
+                                           void *raster_cl)
+{
+    struct Raster_cl *cl = raster_cl;
+    size_t pixel = (size_t) row * cl->width + col;
+    struct Pnm_rgb rgb;
+
+    if (cl->maxval > 255) {
+        const uint8_t *s = cl->raster + pixel * 6;
+        rgb.red   = (s[0] << 8) | s[1];
+        rgb.green = (s[2] << 8) | s[3];
+        rgb.blue  = (s[4] << 8) | s[5];
+    } else {
+        const uint8_t *s = cl->raster + pixel * 3;
+        rgb.red   = s[0];
+        rgb.green = s[1];
+        rgb.blue  = s[2];
+    }
+
+    *(XYZ_pix *)xyz_pix = rgb_to_xyz(&rgb, cl->maxval);
+    (void) xyz_array;
+}
+
+
+/* apply_raster16_to_xyz
+ *  Purpose:    Like apply_raster_to_xyz, for a raster of big-endian 16-bit
+ *                  samples: each channel is one multiply-add by a 
+ *                  coefficient that already holds 1 / maxval, in place of
+ *                  rgb_val_to_xyz_val's division per channel
+ *  Parameters: int col, row: The column and row index of the XYZ pixel
+ *              xyz_array: The 2D array holding the current XYZ pixel
+ *              xyz_pix:   pointer to the current XYZ pixel
+ *              raster_cl: pointer to a struct Raster_cl for the raster
+ *  Returns:    None
+ */
+void apply_raster16_to_xyz(int col, int row, A2Methods_UArray2 xyz_array, 
+                                             A2Methods_Object *xyz_pix, 
+                                             void *raster_cl)
+{
+    struct Raster_cl *cl = raster_cl;
+    const uint8_t *s = cl->raster + ((size_t) row * cl->width + col) * 6;
+    float rgb[3] = {
+        (s[0] << 8) | s[1], (s[2] << 8) | s[3], (s[4] << 8) | s[5]
+    };
+
+    float v[3];
+    for (int i = 0; i < 3; i++) {
+        v[i] = cl->to_xyz[i][0] * rgb[0] + cl->to_xyz[i][1] * rgb[1] + 
+               cl->to_xyz[i][2] * rgb[2];
+    }
+
+    XYZ_pix *pix = xyz_pix;
+    pix->Y = constrain(v[0], Y_LOW, Y_HI);
+    pix->Pb = constrain(v[1], PBPR_LOW, PBPR_HI);
+    pix->Pr = constrain(v[2], PBPR_LOW, PBPR_HI);
+    (void) xyz_array;
+}
+
+
+/* apply_xyz_to_raster
+ *  Purpose:    Converts the current pixel of an XYZ_img to RGB and writes its
+ *                  samples into a raw P6 raster, 8-bit or, if its maxval is
+ *                  over 255, big-endian 16-bit
+ *  Parameters: int col, row: The column and row index of the XYZ pixel
+ *              xyz_array: The 2D array holding the current XYZ pixel
+ *              xyz_pix:   pointer to the current XYZ pixel
+ *              raster_cl: pointer to a struct Raster_cl for the raster
+ *  Returns:    None
+ */
+void apply_xyz_to_raster(int col, int row, A2Methods_UArray2 xyz_array, 
+                                           A2Methods_Object *xyz_pix, 
+                                           void *raster_cl)
+{
+    struct Raster_cl *cl = raster_cl;
+
+    /* unsigned wraparound also skips pixels above or left of the window */
+    unsigned x = col - cl->col0, y = row - cl->row0;
+    if (x >= cl->width || y >= cl->height) {
+        return;
+    }
+    size_t pixel = (size_t) y * cl->width + x;
+
+    struct Pnm_rgb rgb = xyz_to_rgb(*(XYZ_pix *)xyz_pix, cl->maxval);
+    if (cl->maxval > 255) {
+        uint8_t *d = cl->raster + pixel * 6;
+        d[0] = rgb.red >> 8;
+        d[1] = rgb.red;
+        d[2] = rgb.green >> 8;
+        d[3] = rgb.green;
+        d[4] = rgb.blue >> 8;
+        d[5] = rgb.blue;
+    } else {
+        uint8_t *d = cl->raster + pixel * 3;
+        d[0] = rgb.red;
+        d[1] = rgb.green;
+        d[2] = rgb.blue;
+    }
+
+    (void) xyz_array;
+}
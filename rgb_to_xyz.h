@@ -10,6 +10,7 @@
 #ifndef RGB_TO_XYZ_H
 #define RGB_TO_XYZ_H
 
+#include <stdint.h>
 #include "xyz_img.h"
 #include "pnm.h"
 
@@ -19,9 +20,44 @@
           it is a CRE for rgb_img to have width or height < 2 */
 XYZ_img rgb_img_to_xyz(Pnm_ppm rgb_img);
 
+/* like rgb_img_to_xyz, but the returned image is owned by the provided arena
+    (or the heap if arena is NULL) */
+XYZ_img rgb_img_to_xyz_in(Img_arena arena, Pnm_ppm rgb_img);
+
 /* returns the provided image converted from CIE XYZ to RGB format 
     Note: it is a CRE for xyz_img to be NULL
           it is a CRE for xyz_img to have width or height < 2 */
 Pnm_ppm xyz_img_to_rgb(XYZ_img xyz_img);
 
+/* like xyz_img_to_rgb, but the returned image is owned by the provided arena
+    (or the heap if arena is NULL). An arena-owned Pnm_ppm must never be 
+    passed to Pnm_ppmfree */
+Pnm_ppm xyz_img_to_rgb_in(Img_arena arena, XYZ_img xyz_img);
+
+/* returns the RGB pixel, with samples out of denom, for a CIE XYZ pixel */
+struct Pnm_rgb xyz_to_rgb(XYZ_pix xyz_pix, int denom);
+
+/* returns the raw P6 raster (8-bit samples if maxval < 256, big-endian 
+    16-bit samples otherwise) of a width x height image converted to CIE XYZ,
+    owned by the provided arena (or the heap if arena is NULL)
+    Note: it is a CRE for raster to be NULL
+          it is a CRE for width or height to be < 2 */
+XYZ_img raster_to_xyz_in(Img_arena arena, const uint8_t *raster, 
+                         unsigned width, unsigned height, unsigned maxval);
+
+/* writes the provided image as a raw P6 raster with maxval 255 into raster,
+    which must hold 3 * width * height bytes
+    Note: it is a CRE for xyz_img or raster to be NULL */
+void xyz_to_raster(XYZ_img xyz_img, uint8_t *raster);
+
+/* like xyz_to_raster, but with maxval 65535: two big-endian bytes per 
+    sample, so raster must hold 6 * width * height bytes */
+void xyz_to_raster16(XYZ_img xyz_img, uint8_t *raster);
+
+/* like xyz_to_raster, but writes only the width x height rectangle of the 
+    image whose top left pixel is (col, row)
+    Note: it is a CRE for the rectangle to reach outside the image */
+void xyz_to_raster_crop(XYZ_img xyz_img, uint8_t *raster, unsigned col, 
+                        unsigned row, unsigned width, unsigned height);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,555 @@
+/* serve40.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the implementation of the 40image codec daemon and its client
+ *  side. The daemon's main thread watches the listening socket and every
+ *  idle connection with epoll, accepts new connections, and hands a
+ *  connection to a Thread_pool worker only once a request has arrived on
+ *  it; after the response the connection goes back into the watch set, so
+ *  idle clients never hold a worker. Workers keep their input and output
+ *  buffers (and, inside compress40.c, their pipeline arenas) warm from one
+ *  request to the next.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "assert.h"
+#include "mem.h"
+#include "thread_pool.h"
+#include "serve40.h"
+
+
+/* helper function declarations */
+void serve_connection(void *connp);
+bool serve_watch(int conn, int *connp, int op);
+void serve_worker_exit(void);
+void stop_serving(int signum);
+int serve_one(int conn);
+uint32_t serve_code(bool compress, const uint8_t *in, size_t len, 
+                    size_t *outlen);
+bool serve_recv_header(int sock, Serve40_header *hdr, int *fd);
+bool serve_send_header(int sock, Serve40_header *hdr, int fd);
+bool serve_read_full(int fd, void *buf, size_t len);
+bool serve_write_full(int fd, const void *buf, size_t len);
+bool serve_skip(int fd, uint64_t len);
+bool serve_grow(uint8_t **buf, size_t *cap, size_t len);
+bool serve_address(const char *sock_path, struct sockaddr_un *addr);
+
+
+/* the calling worker's request and response buffers */
+static __thread uint8_t *in_buf = NULL;
+static __thread size_t in_cap = 0;
+static __thread uint8_t *out_buf = NULL;
+static __thread size_t out_cap = 0;
+
+/* the daemon's workers, which readable connections are submitted to */
+static Thread_pool serve_pool = NULL;
+
+/* the epoll instance watching the listener and the idle connections */
+static int serve_epoll = -1;
+
+/* the most readiness events taken from epoll_wait at once */
+#define SERVE_EVENTS 64
+
+/* the largest input or output of one request */
+static size_t serve_limit = SERVE40_DEFAULT_LIMIT;
+
+/* set by SIGINT/SIGTERM to stop accepting connections */
+static volatile sig_atomic_t stopping = 0;
+
+
+/* serve40
+ * Purpose:     Runs the codec daemon on a Unix domain socket
+ * Parameters:  const char *sock_path: where to create the socket; an old 
+ *                  socket file at that path is replaced
+ *              int nthreads: the number of workers, or < 1 for one per CPU
+ *              size_t max_bytes: the largest input or output a request may
+ *                  have, or 0 for SERVE40_DEFAULT_LIMIT
+ * Returns:     EXIT_SUCCESS after a signal, EXIT_FAILURE if the socket 
+ *                  could not be set up
+ * Note:        It is a CRE for sock_path to be NULL
+ *              A connection occupies a worker only from the moment its 
+ *                  next request is readable until the response is sent,
+ *                  so any number of idle clients may stay connected and
+ *                  more clients than workers are served in turn
+ */
+int serve40(const char *sock_path, int nthreads, size_t max_bytes)
+{
+    assert(sock_path != NULL);
+    serve_limit = max_bytes > 0 ? max_bytes : SERVE40_DEFAULT_LIMIT;
+
+    struct sockaddr_un addr;
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || !serve_address(sock_path, &addr)) {
+        fprintf(stderr, "40image: %s: cannot create socket\n", sock_path);
+        return EXIT_FAILURE;
+    }
+
+    unlink(sock_path);
+    if (bind(listener, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+        listen(listener, SOMAXCONN) != 0) {
+        fprintf(stderr, "40image: %s: %s\n", sock_path, strerror(errno));
+        close(listener);
+        return EXIT_FAILURE;
+    }
+
+    /* no SA_RESTART, so a signal interrupts epoll_wait */
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stop_serving;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    /* the listener's event carries NULL; a connection's carries its connp */
+    serve_epoll = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    if (serve_epoll < 0 || 
+        epoll_ctl(serve_epoll, EPOLL_CTL_ADD, listener, &ev) != 0) {
+        fprintf(stderr, "40image: %s: %s\n", sock_path, strerror(errno));
+        close(listener);
+        return EXIT_FAILURE;
+    }
+
+    serve_pool = Thread_pool_new(nthreads, serve_worker_exit);
+
+    struct epoll_event events[SERVE_EVENTS];
+    while (!stopping) {
+        int n = epoll_wait(serve_epoll, events, SERVE_EVENTS, -1);
+        for (int i = 0; i < n; i++) {
+            int *connp = events[i].data.ptr;
+            if (connp != NULL) {
+                /* EPOLLONESHOT has disarmed it until the worker is done */
+                Thread_pool_submit(serve_pool, -1, serve_connection, connp);
+                continue;
+            }
+
+            int conn = accept(listener, NULL, NULL);
+            if (conn < 0) {
+                continue;
+            }
+            NEW(connp);
+            *connp = conn;
+            if (!serve_watch(conn, connp, EPOLL_CTL_ADD)) {
+                close(conn);
+                FREE(connp);
+            }
+        }
+    }
+
+    /* open connections are abandoned; the process is about to exit */
+    close(serve_epoll);
+    close(listener);
+    unlink(sock_path);
+    return EXIT_SUCCESS;
+}
+
+
+/* serve40_connect
+ * Purpose:     Connects to a running daemon
+ * Parameters:  const char *sock_path: the daemon's socket
+ * Returns:     int: the connected socket, or -1 on failure
+ */
+int serve40_connect(const char *sock_path)
+{
+    struct sockaddr_un addr;
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (sock >= 0 && (!serve_address(sock_path, &addr) || 
+        connect(sock, (struct sockaddr *) &addr, sizeof(addr)) != 0)) {
+        close(sock);
+        sock = -1;
+    }
+    return sock;
+}
+
+
+/* serve40_request
+ * Purpose:     Sends one request to the daemon and receives its response
+ * Parameters:  int sock: a socket from serve40_connect
+ *              bool compress: true to compress, false to decompress
+ *              const uint8_t *in, size_t len: the input, or NULL to pass fd
+ *              int fd: an open input file, used only when in is NULL
+ *              uint8_t **buf, size_t *cap: a growable output buffer
+ *              size_t *outlen: set to the size of the output
+ * Returns:     int: the response status (a Compress40_status), or 
+ *                  SERVE40_IO_ERROR if the connection failed
+ */
+int serve40_request(int sock, bool compress, const uint8_t *in, size_t len,
+                    int fd, uint8_t **buf, size_t *cap, size_t *outlen)
+{
+    assert(buf != NULL && cap != NULL && outlen != NULL);
+
+    Serve40_header hdr;
+    hdr.op = compress ? SERVE40_COMPRESS : SERVE40_DECOMPRESS;
+    hdr.status = 0;
+    hdr.len = in == NULL ? 0 : len;
+    if (in == NULL) {
+        hdr.op |= SERVE40_PASS_FD;
+    }
+
+    if (!serve_send_header(sock, &hdr, in == NULL ? fd : -1) ||
+        (in != NULL && !serve_write_full(sock, in, len)) ||
+        !serve_recv_header(sock, &hdr, NULL)) {
+        return SERVE40_IO_ERROR;
+    }
+
+    *outlen = hdr.len;
+    if (!serve_grow(buf, cap, hdr.len) || 
+        !serve_read_full(sock, *buf, hdr.len)) {
+        return SERVE40_IO_ERROR;
+    }
+    return hdr.status;
+}
+
+
+/* serve_connection
+ * Purpose:     Thread_pool job that serves the request waiting on one 
+ *                  connection, then hands the connection back to the main
+ *                  thread's watch set, or closes it once the client hangs
+ *                  up or breaks the protocol
+ * Parameters:  void *connp: heap-allocated int holding the connection
+ */
+void serve_connection(void *connp)
+{
+    int conn = *(int *) connp;
+
+    if (serve_one(conn) != 0 || 
+        !serve_watch(conn, connp, EPOLL_CTL_MOD)) {
+        close(conn);
+        FREE(connp);
+    }
+}
+
+
+/* serve_watch
+ * Purpose:     Arms the watch set to report the next request on a 
+ *                  connection, once
+ * Parameters:  int conn: the connection
+ *              int *connp: the heap-allocated int holding it, which the 
+ *                  event carries
+ *              int op: EPOLL_CTL_ADD for a new connection, EPOLL_CTL_MOD 
+ *                  to rearm one already in the set
+ * Returns:     bool: false if epoll refused the connection
+ */
+bool serve_watch(int conn, int *connp, int op)
+{
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT,
+                              .data.ptr = connp };
+    return epoll_ctl(serve_epoll, op, conn, &ev) == 0;
+}
+
+
+/* serve_one
+ * Purpose:     Reads one request, codes it, and writes the response
+ * Returns:     int: 0 if the connection can carry another request, -1 if 
+ *                  it should be closed
+ */
+int serve_one(int conn)
+{
+    Serve40_header hdr;
+    int fd = -1;
+    if (!serve_recv_header(conn, &hdr, &fd)) {
+        return -1;
+    }
+
+    const uint8_t *in = NULL;
+    size_t len = 0;
+    void *mapped = MAP_FAILED;
+    uint32_t status = COMPRESS40_OK;
+
+    if (hdr.op & SERVE40_PASS_FD) {
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+            if ((uint64_t) st.st_size > serve_limit) {
+                status = SERVE40_TOO_LARGE;
+            } else {
+                len = st.st_size;
+                mapped = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+            }
+        }
+        if (mapped == MAP_FAILED && status == COMPRESS40_OK) {
+            status = SERVE40_IO_ERROR;
+        }
+        in = mapped;
+    } else if (hdr.len > serve_limit) {
+        /* the payload is dropped so that the client still gets its answer */
+        if (!serve_skip(conn, hdr.len)) {
+            return -1;
+        }
+        status = SERVE40_TOO_LARGE;
+    } else {
+        len = hdr.len;
+        if (!serve_grow(&in_buf, &in_cap, len) || 
+            !serve_read_full(conn, in_buf, len)) {
+            return -1;
+        }
+        in = in_buf;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    size_t outlen = 0;
+    uint32_t op = hdr.op & ~SERVE40_PASS_FD;
+    if (status == COMPRESS40_OK && 
+        op != SERVE40_COMPRESS && op != SERVE40_DECOMPRESS) {
+        status = SERVE40_IO_ERROR;
+    }
+    if (status == COMPRESS40_OK) {
+        status = serve_code(op == SERVE40_COMPRESS, in, len, &outlen);
+    }
+    if (mapped != MAP_FAILED) {
+        munmap(mapped, len);
+    }
+
+    hdr.status = status;
+    hdr.len = status == COMPRESS40_OK ? outlen : 0;
+    if (!serve_send_header(conn, &hdr, -1) || 
+        !serve_write_full(conn, out_buf, hdr.len)) {
+        return -1;
+    }
+    return 0;
+}
+
+
+/* serve_code
+ * Purpose:     Codes one request's input into the worker's output buffer,
+ *                  unless the output would be larger than the limit
+ * Parameters:  bool compress: true to compress, false to decompress
+ *              const uint8_t *in, size_t len: the request's input
+ *              size_t *outlen: set to the size of the output
+ * Returns:     uint32_t: a Compress40_status, or SERVE40_TOO_LARGE
+ * Note:        The size query reads only the input's header, and the 
+ *                  pipeline's working memory grows with the image, so 
+ *                  capping both ends keeps a request from exhausting memory
+ */
+uint32_t serve_code(bool compress, const uint8_t *in, size_t len, 
+                    size_t *outlen)
+{
+    Compress40_status status = compress ? 
+                               compress40_into(in, len, NULL, 0, outlen) :
+                               decompress40_into(in, len, NULL, 0, outlen);
+    if (status != COMPRESS40_TOO_SMALL) {
+        return status;
+    }
+    if (*outlen > serve_limit) {
+        return SERVE40_TOO_LARGE;
+    }
+    return compress40_buffered(compress, in, len, &out_buf, &out_cap, 
+                               outlen);
+}
+
+
+/* serve_recv_header
+ * Purpose:     Reads a Serve40_header, collecting a passed file descriptor
+ *                  into *fd if fd is not NULL
+ * Returns:     bool: false on EOF or error
+ */
+bool serve_recv_header(int sock, Serve40_header *hdr, int *fd)
+{
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct iovec iov = { hdr, sizeof(*hdr) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    ssize_t n;
+    do {
+        n = recvmsg(sock, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        return false;
+    }
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && 
+        cmsg->cmsg_type == SCM_RIGHTS) {
+        int passed;
+        memcpy(&passed, CMSG_DATA(cmsg), sizeof(int));
+        if (fd != NULL) {
+            *fd = passed;
+        } else {
+            close(passed);
+        }
+    }
+
+    return serve_read_full(sock, (char *) hdr + n, sizeof(*hdr) - n);
+}
+
+
+/* serve_send_header
+ * Purpose:     Writes a Serve40_header, passing fd along with it if fd is 
+ *                  not -1
+ * Returns:     bool: false on error
+ */
+bool serve_send_header(int sock, Serve40_header *hdr, int fd)
+{
+    if (fd < 0) {
+        return serve_write_full(sock, hdr, sizeof(*hdr));
+    }
+
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct iovec iov = { hdr, sizeof(*hdr) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    memset(&control, 0, sizeof(control));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    ssize_t n;
+    do {
+        n = sendmsg(sock, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        return false;
+    }
+    return serve_write_full(sock, (char *) hdr + n, sizeof(*hdr) - n);
+}
+
+
+/* serve_read_full
+ * Purpose:     reads exactly len bytes from fd into buf
+ * Returns:     bool: false on EOF or error
+ */
+bool serve_read_full(int fd, void *buf, size_t len)
+{
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = read(fd, (char *) buf + done, len - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+
+/* serve_skip
+ * Purpose:     reads and discards exactly len bytes from fd
+ * Returns:     bool: false on EOF or error
+ */
+bool serve_skip(int fd, uint64_t len)
+{
+    char scratch[4096];
+    while (len > 0) {
+        size_t n = len < sizeof(scratch) ? len : sizeof(scratch);
+        if (!serve_read_full(fd, scratch, n)) {
+            return false;
+        }
+        len -= n;
+    }
+    return true;
+}
+
+
+/* serve_write_full
+ * Purpose:     writes exactly len bytes from buf to fd
+ * Returns:     bool: false on error
+ */
+bool serve_write_full(int fd, const void *buf, size_t len)
+{
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write(fd, (const char *) buf + done, len - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+
+/* serve_grow
+ * Purpose:     makes sure *buf can hold len bytes, growing it with RESIZE
+ * Returns:     bool: false if len is unreasonably large for one request
+ */
+bool serve_grow(uint8_t **buf, size_t *cap, size_t len)
+{
+    if (len > ((size_t) 1 << 40)) {
+        return false;
+    }
+    if (len > *cap) {
+        if (*buf == NULL) {
+            *buf = ALLOC(len);
+        } else {
+            RESIZE(*buf, len);
+        }
+        *cap = len;
+    }
+    return true;
+}
+
+
+/* serve_address
+ * Purpose:     fills in a Unix domain socket address for sock_path
+ * Returns:     bool: false if the path is too long for a socket address
+ */
+bool serve_address(const char *sock_path, struct sockaddr_un *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(sock_path) >= sizeof(addr->sun_path)) {
+        return false;
+    }
+    strcpy(addr->sun_path, sock_path);
+    return true;
+}
+
+
+/* serve_worker_exit
+ * Purpose:     releases a worker's warm buffers when the pool shuts down
+ */
+void serve_worker_exit(void)
+{
+    compress40_free(in_buf);
+    compress40_free(out_buf);
+    in_buf = out_buf = NULL;
+    in_cap = out_cap = 0;
+    compress40_release();
+}
+
+
+/* stop_serving
+ * Purpose:     signal handler that stops the accept loop
+ */
+void stop_serving(int signum)
+{
+    (void) signum;
+    stopping = 1;
+}
@@ -0,0 +1,74 @@
+/* serve40.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 5/9/2021
+ *
+ * Contains the interface for the 40image codec daemon (40image --serve) 
+ *  and its client side. Clients talk to the daemon over a Unix domain 
+ *  socket. Each request is a Serve40_header followed by len payload bytes,
+ *  or by no payload if the input file's descriptor is passed along with 
+ *  the header. Each response is a Serve40_header whose status is a 
+ *  Compress40_status (or SERVE40_IO_ERROR or SERVE40_TOO_LARGE), followed
+ *  by len bytes of output.
+ *  A connection may carry any number of requests.
+ */
+
+#ifndef SERVE40_H
+#define SERVE40_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "compress40.h"
+
+
+/* request operations */
+#define SERVE40_COMPRESS   1
+#define SERVE40_DECOMPRESS 2
+
+/* request flag: the input is a file descriptor passed with the header */
+#define SERVE40_PASS_FD    0x100
+
+/* response status for failures outside the codec itself */
+#define SERVE40_IO_ERROR   100
+
+/* response status for a request whose input or output is larger than the
+   daemon's per-request limit */
+#define SERVE40_TOO_LARGE  101
+
+/* the per-request limit used when serve40 is given none */
+#define SERVE40_DEFAULT_LIMIT ((size_t) 1 << 30)
+
+
+/* Serve40_header
+ * Members:     op:     a request's operation and flags, unused in responses
+ *              status: a response's status, unused in requests
+ *              len:    the number of payload bytes that follow
+ */
+typedef struct Serve40_header {
+    uint32_t op;
+    uint32_t status;
+    uint64_t len;
+} Serve40_header;
+
+
+/* listens on the Unix socket at sock_path and serves requests with 
+    nthreads warm workers (one per CPU if < 1) until SIGINT or SIGTERM. 
+    A request whose input or output exceeds max_bytes (or 
+    SERVE40_DEFAULT_LIMIT if 0) is answered with SERVE40_TOO_LARGE. 
+    Returns EXIT_SUCCESS, or EXIT_FAILURE if the socket cannot be set up
+    Note: it is a CRE for sock_path to be NULL */
+int serve40(const char *sock_path, int nthreads, size_t max_bytes);
+
+/* connects to the daemon at sock_path; returns the socket or -1 */
+int serve40_connect(const char *sock_path);
+
+/* sends one request over sock carrying in[0..len) (or, if in is NULL, the
+    open file descriptor fd) and waits for the response. On COMPRESS40_OK 
+    the output is stored in *buf, which is grown with RESIZE as needed and
+    whose size is tracked in *cap, and its length in *outlen. Returns the 
+    response's status, or SERVE40_IO_ERROR if the connection failed
+    Note: it is a CRE for buf, cap or outlen to be NULL */
+int serve40_request(int sock, bool compress, const uint8_t *in, size_t len,
+                    int fd, uint8_t **buf, size_t *cap, size_t *outlen);
+
+#endif
@@ -0,0 +1,344 @@
+/* thread_pool.c
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 4/22/2021
+ *
+ * Contains the implementation of Thread_pool. Every worker owns a deque of
+ *  jobs protected by its own lock; a single pool-wide lock and condition 
+ *  variable are only used to sleep when there is no work anywhere.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "assert.h"
+#include "mem.h"
+#include "thread_pool.h"
+
+
+/* struct Job
+ * Members:     run, arg: the job's function and its argument
+ */
+struct Job {
+    Thread_pool_run *run;
+    void *arg;
+};
+
+/* struct Deque
+ * Purpose:     a growable ring buffer of jobs, one per worker
+ * Members:     jobs:   the ring's storage
+ *              cap:    the number of slots in jobs
+ *              head:   index of the front job
+ *              length: the number of queued jobs
+ *              lock:   protects all of the above
+ */
+struct Deque {
+    struct Job *jobs;
+    int cap, head, length;
+    pthread_mutex_t lock;
+};
+
+/* struct Worker
+ * Members:     pool:   the pool the worker belongs to
+ *              index:  the worker's position in pool->workers
+ *              thread: the worker's thread
+ *              deque:  the worker's own jobs
+ */
+struct Worker {
+    Thread_pool pool;
+    int index;
+    pthread_t thread;
+    struct Deque deque;
+};
+
+/* struct Thread_pool
+ * Members:     workers, nthreads:  the pool's workers
+ *              next_worker:        round-robin target for submit(-1)
+ *              queued:             jobs waiting in any deque
+ *              pending:            jobs submitted but not yet finished
+ *              shutdown:           true once the workers should exit
+ *              worker_exit:        optional hook run by exiting workers
+ *              lock, work_ready, all_done: sleep/wake for the above counts
+ */
+struct Thread_pool {
+    struct Worker *workers;
+    int nthreads;
+    int next_worker;
+    int queued;
+    int pending;
+    bool shutdown;
+    void (*worker_exit)(void);
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t all_done;
+};
+
+
+/* helper function declarations */
+void *pool_worker_main(void *workerp);
+bool pool_find_job(struct Worker *self, struct Job *job);
+bool deque_pop_front(struct Deque *deque, struct Job *job);
+bool deque_pop_back(struct Deque *deque, struct Job *job);
+void deque_push_back(struct Deque *deque, struct Job job);
+
+
+/* Thread_pool_new
+ * Purpose:     Creates a pool and starts its workers
+ * Parameters:  int nthreads: the number of workers, or < 1 for one per CPU
+ *              void worker_exit(void): hook each worker runs before it 
+ *                  exits, or NULL
+ * Returns:     Thread_pool: the running pool
+ */
+Thread_pool Thread_pool_new(int nthreads, void worker_exit(void))
+{
+    if (nthreads < 1) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = cpus > 0 ? cpus : 1;
+    }
+
+    Thread_pool pool;
+    NEW(pool);
+    pool->nthreads = nthreads;
+    pool->next_worker = 0;
+    pool->queued = 0;
+    pool->pending = 0;
+    pool->shutdown = false;
+    pool->worker_exit = worker_exit;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->all_done, NULL);
+
+    pool->workers = CALLOC(nthreads, sizeof(struct Worker));
+    for (int i = 0; i < nthreads; i++) {
+        struct Worker *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i;
+        worker->deque.cap = 16;
+        worker->deque.jobs = ALLOC(worker->deque.cap * sizeof(struct Job));
+        worker->deque.head = 0;
+        worker->deque.length = 0;
+        pthread_mutex_init(&worker->deque.lock, NULL);
+    }
+    for (int i = 0; i < nthreads; i++) {
+        int err = pthread_create(&pool->workers[i].thread, NULL, 
+                                 pool_worker_main, &pool->workers[i]);
+        assert(err == 0);
+    }
+
+    return pool;
+}
+
+
+/* Thread_pool_size
+ * Purpose:     returns the number of workers in the pool
+ */
+int Thread_pool_size(Thread_pool pool)
+{
+    assert(pool != NULL);
+    return pool->nthreads;
+}
+
+
+/* Thread_pool_submit
+ * Purpose:     Queues a job on a worker's deque and wakes a sleeping worker
+ * Parameters:  Thread_pool pool: the pool to run the job
+ *              int worker: the worker whose deque gets the job, or < 0 to 
+ *                  spread jobs round-robin
+ *              Thread_pool_run run, void *arg: the job
+ */
+void Thread_pool_submit(Thread_pool pool, int worker, Thread_pool_run run, 
+                        void *arg)
+{
+    assert(pool != NULL);
+    assert(run != NULL);
+
+    pthread_mutex_lock(&pool->lock);
+    if (worker < 0) {
+        worker = pool->next_worker;
+        pool->next_worker = (pool->next_worker + 1) % pool->nthreads;
+    }
+    worker %= pool->nthreads;
+    pool->pending++;
+    pool->queued++;
+    pthread_mutex_unlock(&pool->lock);
+
+    struct Job job = { run, arg };
+    deque_push_back(&pool->workers[worker].deque, job);
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+
+/* Thread_pool_wait
+ * Purpose:     Blocks until no submitted job is queued or running
+ */
+void Thread_pool_wait(Thread_pool pool)
+{
+    assert(pool != NULL);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->all_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+
+/* Thread_pool_free
+ * Purpose:     Finishes all jobs, joins every worker and frees the pool
+ */
+void Thread_pool_free(Thread_pool *poolp)
+{
+    assert(poolp != NULL);
+    assert(*poolp != NULL);
+    Thread_pool pool = *poolp;
+
+    Thread_pool_wait(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->nthreads; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+        pthread_mutex_destroy(&pool->workers[i].deque.lock);
+        FREE(pool->workers[i].deque.jobs);
+    }
+
+    pthread_cond_destroy(&pool->all_done);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_mutex_destroy(&pool->lock);
+    FREE(pool->workers);
+    FREE(*poolp);
+}
+
+
+/* pool_worker_main
+ * Purpose:     The loop each worker thread runs: find a job (own deque 
+ *                  first, then steal), run it, and sleep when there is 
+ *                  nothing to do
+ * Parameters:  void *workerp: the worker's struct Worker
+ */
+void *pool_worker_main(void *workerp)
+{
+    struct Worker *self = workerp;
+    Thread_pool pool = self->pool;
+
+    for (;;) {
+        struct Job job;
+
+        if (pool_find_job(self, &job)) {
+            job.run(job.arg);
+
+            pthread_mutex_lock(&pool->lock);
+            if (--pool->pending == 0) {
+                pthread_cond_broadcast(&pool->all_done);
+            }
+            pthread_mutex_unlock(&pool->lock);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->queued == 0 && !pool->shutdown) {
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+        bool done = pool->queued == 0 && pool->shutdown;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (done) {
+            break;
+        }
+    }
+
+    if (pool->worker_exit != NULL) {
+        pool->worker_exit();
+    }
+    return NULL;
+}
+
+
+/* pool_find_job
+ * Purpose:     Takes the front job of the worker's own deque or, failing 
+ *                  that, steals the back job of the next non-empty deque
+ * Parameters:  struct Worker *self: the worker looking for work
+ *              struct Job *job: set to the job found
+ * Returns:     bool: true if a job was found
+ */
+bool pool_find_job(struct Worker *self, struct Job *job)
+{
+    Thread_pool pool = self->pool;
+    bool found = deque_pop_front(&self->deque, job);
+
+    for (int i = 1; !found && i < pool->nthreads; i++) {
+        int victim = (self->index + i) % pool->nthreads;
+        found = deque_pop_back(&pool->workers[victim].deque, job);
+    }
+
+    if (found) {
+        pthread_mutex_lock(&pool->lock);
+        pool->queued--;
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return found;
+}
+
+
+/* deque_pop_front
+ * Purpose:     removes the front job of a deque into *job
+ * Returns:     bool: false if the deque was empty
+ */
+bool deque_pop_front(struct Deque *deque, struct Job *job)
+{
+    pthread_mutex_lock(&deque->lock);
+    bool found = deque->length > 0;
+    if (found) {
+        *job = deque->jobs[deque->head];
+        deque->head = (deque->head + 1) % deque->cap;
+        deque->length--;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+
+/* deque_pop_back
+ * Purpose:     removes the back job of a deque into *job
+ * Returns:     bool: false if the deque was empty
+ */
+bool deque_pop_back(struct Deque *deque, struct Job *job)
+{
+    pthread_mutex_lock(&deque->lock);
+    bool found = deque->length > 0;
+    if (found) {
+        deque->length--;
+        *job = deque->jobs[(deque->head + deque->length) % deque->cap];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+
+/* deque_push_back
+ * Purpose:     appends a job to a deque, doubling its storage when full
+ */
+void deque_push_back(struct Deque *deque, struct Job job)
+{
+    pthread_mutex_lock(&deque->lock);
+    if (deque->length == deque->cap) {
+        struct Job *jobs = ALLOC(2 * deque->cap * sizeof(struct Job));
+        for (int i = 0; i < deque->length; i++) {
+            jobs[i] = deque->jobs[(deque->head + i) % deque->cap];
+        }
+        FREE(deque->jobs);
+        deque->jobs = jobs;
+        deque->head = 0;
+        deque->cap *= 2;
+    }
+    deque->jobs[(deque->head + deque->length) % deque->cap] = job;
+    deque->length++;
+    pthread_mutex_unlock(&deque->lock);
+}
@@ -0,0 +1,43 @@
+/* thread_pool.h
+ * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
+ * last edited: 4/22/2021
+ *
+ * Contains the interface for Thread_pool, a fixed set of worker threads 
+ *  that run submitted jobs. Each worker has its own deque of jobs: it takes
+ *  work from the front of its own deque and, when that is empty, steals 
+ *  from the back of another worker's deque.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+
+typedef struct Thread_pool *Thread_pool;
+
+/* a job: run(arg) is called on some worker thread */
+typedef void Thread_pool_run(void *arg);
+
+/* starts nthreads workers (or one per online CPU if nthreads < 1). If
+    worker_exit is not NULL, each worker calls it just before it exits so it
+    can release its thread-local state */
+Thread_pool Thread_pool_new(int nthreads, void worker_exit(void));
+
+/* returns the number of workers in the pool
+    Note: it is a CRE for pool to be NULL */
+int Thread_pool_size(Thread_pool pool);
+
+/* queues a job at the back of the given worker's deque (any worker if 
+    worker < 0)
+    Note: it is a CRE for pool or run to be NULL */
+void Thread_pool_submit(Thread_pool pool, int worker, Thread_pool_run run, 
+                        void *arg);
+
+/* blocks until every job submitted so far has finished
+    Note: it is a CRE for pool to be NULL */
+void Thread_pool_wait(Thread_pool pool);
+
+/* waits for all jobs, stops the workers, and frees the pool
+    Note: it is a CRE for poolp or *poolp to be NULL */
+void Thread_pool_free(Thread_pool *poolp);
+
+#endif
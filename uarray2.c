@@ -37,6 +37,30 @@ T UArray2_new(int width, int height, int size)
 }
 
 
+/*
+* UArray2_new_in: allocates a new 2-D UArray exactly like UArray2_new, but
+*              with the descriptor and all of the elements owned by the
+*              provided arena. The array is released by resetting the arena.
+* Notes:       it is a CRE for arena to be NULL. The array must never be
+*              passed to UArray2_free.
+*/
+T UArray2_new_in(Img_arena arena, int width, int height, int size)
+{
+    assert(arena != NULL);
+    assert(width >= 0 && height >= 0);
+    assert(size > 0);
+
+    T uarray2 = Img_arena_alloc(arena, sizeof(*uarray2));
+    uarray2->width = width;
+    uarray2->height = height;
+    uarray2->count = width * height;
+    uarray2->size = size;
+    uarray2->arr = UArray_new_in(arena, uarray2->count, size);
+
+    return uarray2;
+}
+
+
 /*
  * UArray2Rep_init: initializes the UArray2Rep_T struct with the provided 
  *                      data
@@ -0,0 +1,43 @@
+/*
+* uarray2.h
+* Written By: Megan Gelement (mgelem01) and Marshall Wilson (wwilso02)
+* Date:       February 19, 2021
+* Summary:    uarray2.h is the interface for a 2-dimensional version of
+*               Hanson's UArray.
+*/
+
+#ifndef UARRAY2_INCLUDED
+#define UARRAY2_INCLUDED
+
+#include "img_arena.h"
+
+#define T UArray2_T
+typedef struct T *T;
+
+typedef void UArray2_applyfun(int col, int row, T uarray2, void *elemp,
+                              void *cl);
+
+/* allocates a new width x height 2D array of elements of size bytes */
+extern T UArray2_new(int width, int height, int size);
+
+/* allocates a new 2D array whose memory is owned by the provided arena.
+   Note: it is a CRE for arena to be NULL, and the array must never be
+         passed to UArray2_free */
+extern T UArray2_new_in(Img_arena arena, int width, int height, int size);
+
+extern void UArray2_free(T *uarray2);
+
+extern int UArray2_width(T uarray2);
+extern int UArray2_height(T uarray2);
+extern int UArray2_count(T uarray2);
+extern int UArray2_size(T uarray2);
+
+extern void *UArray2_at(T uarray2, int col, int row);
+
+extern void UArray2_map_row_major(T uarray2, UArray2_applyfun apply,
+                                  void *cl);
+extern void UArray2_map_col_major(T uarray2, UArray2_applyfun apply,
+                                  void *cl);
+
+#undef T
+#endif
@@ -7,11 +7,12 @@
  */
 
 
-#include <uarray2b.h>
+#include "uarray2b.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include <uarray2.h>
+#include "uarray2.h"
 #include <uarray.h>
+#include <uarrayrep.h>
 #include <assert.h>
 #include <mem.h>
 #include <math.h>
@@ -22,6 +23,8 @@
 /* helper function declarations */
 void add_a_block(int col, int row, UArray2_T uarray2, void *elemp, void *cl);
 void free_a_block(int col, int row, UArray2_T uarray2, void *elemp, void *cl);
+void add_an_arena_block(int col, int row, UArray2_T uarray2, void *elemp,
+                        void *cl);
 void map_a_block(int col, int row, UArray2_T uarray2, void *elemp, void *cl);
 bool in_range(T array2b, int column, int row);
 
@@ -101,6 +104,84 @@ void free_a_block(int col, int row, UArray2_T uarray2, void *elemp, void *cl)
 }
 
 
+/* struct arena_block_cl
+ * closure for add_an_arena_block: the blocked array being built, the
+ * arena-owned block descriptors, and the shared element buffer they index
+ */
+struct arena_block_cl {
+    T array2b;
+    struct UArray_T *blocks;
+    char *elems;
+    int next_block;
+};
+
+
+/*
+ * new blocked 2d array owned by the provided arena
+ *
+ * Every block's descriptor and elements are bumped off the arena, with the
+ * elements of all blocks packed into one contiguous buffer in block-major
+ * order. Nothing here may be passed to UArray2b_free; resetting the arena
+ * releases it all at once.
+ */
+extern T UArray2b_new_in(Img_arena arena, int width, int height, int size,
+                         int blocksize)
+{
+    assert(arena != NULL);
+    assert(blocksize > 0 && size > 0);
+    assert(width >= blocksize && height >= blocksize);
+
+    T new_array = Img_arena_alloc(arena, sizeof(*new_array));
+    new_array->width = width;
+    new_array->height = height;
+    new_array->size = size;
+    new_array->blocksize = blocksize;
+
+    new_array->block_arr = UArray2_new_in(arena,
+                                          ceil((double) width / blocksize),
+                                          ceil((double) height / blocksize),
+                                          sizeof(UArray_T));
+
+    int num_blocks = UArray2_count(new_array->block_arr);
+    int block_bytes = blocksize * blocksize * size;
+
+    struct arena_block_cl cl;
+    cl.array2b = new_array;
+    cl.blocks = Img_arena_alloc(arena, num_blocks * sizeof(struct UArray_T));
+    cl.elems = Img_arena_alloc(arena, (size_t) num_blocks * block_bytes);
+    cl.next_block = 0;
+
+    UArray2_map_row_major(new_array->block_arr, add_an_arena_block, &cl);
+
+    return new_array;
+}
+
+
+/* add_an_arena_block
+ *
+ * apply function for UArray2. Points the cell at the next unused block
+ * descriptor from the closure and aims that descriptor at its slice of the
+ * shared element buffer.
+ */
+void add_an_arena_block(int col, int row, UArray2_T uarray2, void *elemp,
+                        void *cl)
+{
+    struct arena_block_cl *abc = cl;
+    int cells = abc->array2b->blocksize * abc->array2b->blocksize;
+    UArray_T block = &abc->blocks[abc->next_block];
+
+    UArrayRep_init(block, cells, abc->array2b->size,
+                   abc->elems + (size_t) abc->next_block * cells *
+                                abc->array2b->size);
+    *(UArray_T *)elemp = block;
+    abc->next_block++;
+
+    (void) col;
+    (void) row;
+    (void) uarray2;
+}
+
+
 /* new blocked 2d array: blocksize as large as possible provided
  * block occupies at most 64KB (if possible)
  */
@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include "xyz_img.h"
 #include "a2blocked.h"
+#include "uarray2b.h"
 #include "assert.h"
 #include "mem.h"
 
@@ -20,12 +21,15 @@
  *                                  XYZ_pix and blocksize 2
  *              methods:        methods to operate on pixels 
  *                                  (always uarray2_methods_blocked)
+ *              arena:          the arena owning the image, or NULL if the
+ *                                  image is heap-allocated
  */
 struct XYZ_img {
 
     unsigned width, height;
     A2Methods_UArray2 pixels;
     A2Methods_T methods;
+    Img_arena arena;
 };
 
 
@@ -41,6 +45,26 @@ XYZ_img XYZ_img_new(unsigned width, unsigned height)
                                                             height, 
                                                             sizeof(XYZ_pix), 
                                                             2);
+    new_img->arena = NULL;
+    return new_img;
+}
+
+
+/* allocates a new XYZ_img with the provided width and height out of the 
+    provided arena, falling back to XYZ_img_new when arena is NULL */
+XYZ_img XYZ_img_new_in(Img_arena arena, unsigned width, unsigned height)
+{
+    if (arena == NULL) {
+        return XYZ_img_new(width, height);
+    }
+
+    XYZ_img new_img = Img_arena_alloc(arena, sizeof(*new_img));
+    new_img->width = width;
+    new_img->height = height;
+    new_img->methods = uarray2_methods_blocked;
+    new_img->pixels = UArray2b_new_in(arena, width, height, 
+                                      sizeof(XYZ_pix), 2);
+    new_img->arena = arena;
     return new_img;
 }
 
@@ -50,6 +74,13 @@ void XYZ_img_free(XYZ_img *imgp)
 {
     assert(imgp != NULL);
     assert(*imgp != NULL);
+
+    /* arena-owned images are released by resetting their arena */
+    if ((*imgp)->arena != NULL) {
+        *imgp = NULL;
+        return;
+    }
+
     (*imgp)->methods->free(&(*imgp)->pixels);
     FREE(*imgp);
 }
@@ -10,6 +10,7 @@
 
 #include "a2methods.h"
 #include "pnm.h"
+#include "img_arena.h"
 
 
 /* CIE XYZ colorspace pixel values */
@@ -24,7 +25,12 @@ typedef struct XYZ_img *XYZ_img;
 /* allocates a new XYZ_img width the provided width and height*/
 XYZ_img XYZ_img_new(unsigned width, unsigned height);
 
-/* frees all heap-allocated memory associated with a XYZ_img 
+/* allocates a new XYZ_img whose memory is owned by the provided arena, or 
+    on the heap like XYZ_img_new if arena is NULL */
+XYZ_img XYZ_img_new_in(Img_arena arena, unsigned width, unsigned height);
+
+/* frees all heap-allocated memory associated with a XYZ_img. Arena-owned
+    images are only forgotten; their memory goes back with the arena 
     Note: it is a CRE for imgp or *imgp to be NULL*/
 void XYZ_img_free(XYZ_img *imgp);
 
@@ -1,6 +1,6 @@
 /* xyz_to_abcd.c
  * by Marshall Wilson (wwilso02) and Eliza Encherman (eenche01)
- * last edited: 3/22/2021
+ * last edited: 5/7/2021
  * 
  * Purpose: contains the implementation of functions compressing and 
  *              decompressing images in the XYZ CIE colorspace
@@ -17,13 +17,15 @@
 #include "rgb_to_xyz.h"
 
 typedef struct Curr_blk Curr_blk;
+typedef struct Blk_map Blk_map;
 
 /* helper function declarations */
 void apply_compress_blocks(A2Methods_Object *pixelp, void *curr_blk_cl);
 void apply_decomp_blocks(A2Methods_Object *pixelp, void *curr_blk_cl);
-float *do_compression_math(float *xyz_val);
-float *do_decomp_math(float *abc_val);
-Curr_blk new_curr_blk(Comp_img *comp_img);
+void apply_read_blocks(A2Methods_Object *pixelp, void *blk_map_cl);
+void apply_write_blocks(A2Methods_Object *pixelp, void *blk_map_cl);
+void do_compression_math(float *xyz_val, float *abc_val);
+void do_decomp_math(float *abc_val, float *xyz_val);
 
 
 
@@ -36,19 +38,38 @@ Curr_blk new_curr_blk(Comp_img *comp_img);
  *                                   2 | 3 
  *              xyz_val: array containing the XYZ values of the 4 pixels
  *                  [Y1, Y2, Y3, Y4, Pb1, Pb2, Pb3, Pb4, Pr1, Pr2, Pr3, Pr4]
- *              word: a pointer to a 64-bit word that will hold a full block's
- *                      data.
+ *              abc_val: scratch array for the block's 
+ *                  [a, b, c, d, Pb_avg, Pr_avg] values
+ *              word: a 64-bit word that will hold a full block's data.
  *              compressed: a comp_img struct that will hold the compressed
  *                              image's data as 32 bit words
  */
 struct Curr_blk {
     int count;     
-    float *xyz_val;   
-    uint64_t *word;        
+    float xyz_val[12];   
+    float abc_val[6];
+    uint64_t word;        
     Comp_img *comp_img;   
 };
 
 
+/* Blk_map struct
+ * Purpose:     closure for xyz_map_blocks and xyz_from_blocks_in, which hand
+ *              each block's [a, b, c, d, Pb_avg, Pr_avg] to or take it from
+ *              a caller's function instead of a 32-bit word
+ * Members:     count, xyz_val, abc_val: as in Curr_blk
+ *              apply: the caller's function, called once per block
+ *              cl: the caller's closure
+ */
+struct Blk_map {
+    int count;
+    float xyz_val[12];
+    float abc_val[6];
+    void (*apply)(float *abc_val, void *cl);
+    void *cl;
+};
+
+
 /* xyz_compress
  * Purpose: Given an XYZ_img, returns a Comp_img struct with the blocks 
  *          compressed into 32-bit words
@@ -57,19 +78,31 @@ struct Curr_blk {
  * Note: It is a CRE to pass this function a null XYZ_img
  */
 Comp_img xyz_compress(XYZ_img xyz_img)
+{
+    return xyz_compress_in(NULL, xyz_img);
+}
+
+
+/* xyz_compress_in
+ * Purpose: Given an XYZ_img, returns a Comp_img struct owned by the provided
+ *          arena with the blocks compressed into 32-bit words
+ * Parameters: The arena to own the Comp_img (or NULL for the heap) and the 
+ *             XYZ_img to compress
+ * Return:  The Comp_img with the compressed blocks
+ * Note: It is a CRE to pass this function a null XYZ_img
+ */
+Comp_img xyz_compress_in(Img_arena arena, XYZ_img xyz_img)
 {
     assert(xyz_img != NULL);
 
     /* Create Comp_img to hold the words to print out */
-    Comp_img comp_img = Comp_img_new(XYZ_img_width(xyz_img), 
-                                     XYZ_img_height(xyz_img));
+    Comp_img comp_img = Comp_img_new_in(arena, XYZ_img_width(xyz_img), 
+                                               XYZ_img_height(xyz_img));
 
     /* Create Curr_blk closure struct for mapping */
     Curr_blk blk;
     blk.count = 0;
     blk.comp_img = &comp_img;
-    float xyz_vals[12];
-    blk.xyz_val = xyz_vals;
 
     /* compress the xyz image into the Comp_img format */
     XYZ_img_small_map(xyz_img, apply_compress_blocks, &blk);
@@ -86,18 +119,31 @@ Comp_img xyz_compress(XYZ_img xyz_img)
  * Note: It is a CRE to pass this function a null Comp_img struct
  */
 XYZ_img xyz_decompress(Comp_img comp_img)
+{
+    return xyz_decompress_in(NULL, comp_img);
+}
+
+
+/* xyz_decompress_in
+ *
+ * Purpose: Given a Comp_img, returns it as an XYZ_img with Y/Pb/Pr values 
+ *          owned by the provided arena
+ * Parameters: The arena to own the XYZ_img (or NULL for the heap) and the 
+ *             Comp_img to decompress
+ * Return:  The decompressed XYZ_img
+ * Note: It is a CRE to pass this function a null Comp_img struct
+ */
+XYZ_img xyz_decompress_in(Img_arena arena, Comp_img comp_img)
 {
     assert(comp_img != NULL);
     /* create new xyz_img with correct dimensions */
-    XYZ_img xyz_img = XYZ_img_new(Comp_img_width(comp_img), 
-                                  Comp_img_height(comp_img));
+    XYZ_img xyz_img = XYZ_img_new_in(arena, Comp_img_width(comp_img), 
+                                            Comp_img_height(comp_img));
 
     /* Create Curr_blk closure struct for mapping */
     Curr_blk blk;
     blk.count = 0;
     blk.comp_img = &comp_img;
-    float xyz_vals[12];
-    blk.xyz_val = xyz_vals;
 
     /* map over xyz_img to decompress each block from comp_img */
     XYZ_img_small_map(xyz_img, apply_decomp_blocks, &blk);
@@ -106,6 +152,46 @@ XYZ_img xyz_decompress(Comp_img comp_img)
 }
 
 
+/* xyz_map_blocks
+ * Purpose: Calls apply with the [a, b, c, d, Pb_avg, Pr_avg] values of each
+ *          2x2 block of an XYZ_img, in the order xyz_compress packs words
+ * Parameters: The XYZ_img, the function to call and its closure
+ * Return:  None
+ * Note: It is a CRE to pass this function a null XYZ_img or apply
+ */
+void xyz_map_blocks(XYZ_img xyz_img, void apply(float *abc_val, void *cl),
+                    void *cl)
+{
+    assert(xyz_img != NULL && apply != NULL);
+
+    Blk_map blk = { .count = 0, .apply = apply, .cl = cl };
+    XYZ_img_small_map(xyz_img, apply_read_blocks, &blk);
+}
+
+
+/* xyz_from_blocks_in
+ * Purpose: Builds an XYZ_img owned by the provided arena from the 
+ *          [a, b, c, d, Pb_avg, Pr_avg] values apply fills in for each
+ *          block, in the order xyz_decompress reads words
+ * Parameters: The arena to own the XYZ_img (or NULL for the heap), the 
+ *             image's size, and the function to call and its closure
+ * Return:  The decompressed XYZ_img
+ * Note: It is a CRE to pass this function a null apply, or a width or 
+ *       height that is < 2
+ */
+XYZ_img xyz_from_blocks_in(Img_arena arena, unsigned width, unsigned height,
+                           void apply(float *abc_val, void *cl), void *cl)
+{
+    assert(apply != NULL);
+    XYZ_img xyz_img = XYZ_img_new_in(arena, width, height);
+
+    Blk_map blk = { .count = 0, .apply = apply, .cl = cl };
+    XYZ_img_small_map(xyz_img, apply_write_blocks, &blk);
+
+    return xyz_img;
+}
+
+
 /* apply_compress_blocks
  * Purpose: collects the data for each 2x2 block of XYZ pixels, compresses them
  *              into a, b, c, d, Pb_avg, Pr_avg format, and packs them into
@@ -120,9 +206,9 @@ void apply_compress_blocks(A2Methods_Object *pixelp, void *curr_blk_cl)
     Curr_blk *blk = (Curr_blk *)curr_blk_cl;
     XYZ_pix pix = *(XYZ_pix *)pixelp;
 
-    /* allocate new word pointer at beginning of new block*/
+    /* clear the word at beginning of new block*/
     if (blk->count == 0) {
-        blk->word = ALLOC(sizeof(uint64_t));
+        blk->word = 0;
     }
 
     /* retrieve XYZ values for pixel */
@@ -134,13 +220,11 @@ void apply_compress_blocks(A2Methods_Object *pixelp, void *curr_blk_cl)
     if (blk->count == 3) {
 
         /* get compressed values */
-        float *abc_val = do_compression_math(blk->xyz_val);
-        abcd_to_word(abc_val, blk->word);
-        RESIZE(blk->word, sizeof(uint32_t));
-        Comp_img_add_word(*blk->comp_img, (uint32_t *)blk->word);
+        do_compression_math(blk->xyz_val, blk->abc_val);
+        abcd_to_word(blk->abc_val, &blk->word);
+        Comp_img_add_word(*blk->comp_img, (uint32_t) blk->word);
     
         blk->count = 0;
-        FREE(abc_val);
 
     } else {
         blk->count++;
@@ -166,22 +250,19 @@ void apply_decomp_blocks(A2Methods_Object *pixelp, void *curr_blk_cl)
     /*if start of block and word, grab new word. */
     if (blk->count == 0) {
         
-        blk->word = (uint64_t *) Comp_img_get_next_word(*blk->comp_img);
+        blk->word = Comp_img_get_next_word(*blk->comp_img);
         
         /* Unpack 1 block from word, decompress into array of pixel values */
-        float *abc_val = ALLOC(sizeof(float) * 6);
-        word_to_abcd(abc_val, blk->word);
-        blk->xyz_val = do_decomp_math(abc_val);
+        word_to_abcd(blk->abc_val, &blk->word);
+        do_decomp_math(blk->abc_val, blk->xyz_val);
     }
 
     pix->Y = blk->xyz_val[blk->count];
     pix->Pb = blk->xyz_val[blk->count + 4];
     pix->Pr = blk->xyz_val[blk->count + 8];
 
-    /* If last pixel in block, reset pixel count, free the word.*/
+    /* If last pixel in block, reset pixel count */
     if (blk->count == 3) {
-        FREE(blk->word);
-        FREE(blk->xyz_val);
         blk->count = 0;
         
     } else {
@@ -192,20 +273,68 @@ void apply_decomp_blocks(A2Methods_Object *pixelp, void *curr_blk_cl)
 }
 
 
+/* apply_read_blocks
+ * Purpose: like apply_compress_blocks, but hands each block's values to the
+ *              Blk_map's function instead of packing them
+ * Parameters:  A2Methods_Object *pixelp: pointer to an XYZ pixel value struct
+ *              void *blk_map_cl: pointer to a Blk_map
+ */
+void apply_read_blocks(A2Methods_Object *pixelp, void *blk_map_cl)
+{
+    Blk_map *blk = blk_map_cl;
+    XYZ_pix pix = *(XYZ_pix *)pixelp;
+
+    blk->xyz_val[blk->count] = pix.Y;
+    blk->xyz_val[blk->count + 4] = pix.Pb;
+    blk->xyz_val[blk->count + 8] = pix.Pr;
+
+    if (blk->count == 3) {
+        do_compression_math(blk->xyz_val, blk->abc_val);
+        blk->apply(blk->abc_val, blk->cl);
+        blk->count = 0;
+    } else {
+        blk->count++;
+    }
+}
+
+
+/* apply_write_blocks
+ * Purpose: like apply_decomp_blocks, but takes each block's values from the
+ *              Blk_map's function instead of unpacking a word
+ * Parameters:  A2Methods_Object *pixelp: pointer to an XYZ pixel value struct
+ *              void *blk_map_cl: pointer to a Blk_map
+ */
+void apply_write_blocks(A2Methods_Object *pixelp, void *blk_map_cl)
+{
+    Blk_map *blk = blk_map_cl;
+    XYZ_pix *pix = (XYZ_pix *)pixelp;
+
+    if (blk->count == 0) {
+        blk->apply(blk->abc_val, blk->cl);
+        do_decomp_math(blk->abc_val, blk->xyz_val);
+    }
+
+    pix->Y = blk->xyz_val[blk->count];
+    pix->Pb = blk->xyz_val[blk->count + 4];
+    pix->Pr = blk->xyz_val[blk->count + 8];
+
+    blk->count = blk->count == 3 ? 0 : blk->count + 1;
+}
+
+
 /*do_compression_math
- * Purpose: Given an array with one block's worth of XYZ values, calculates, 
- *          allocates and returns a pointer to an array with the a, b, c, d 
- *          and average Pb and Pr values
+ * Purpose: Given an array with one block's worth of XYZ values, calculates 
+ *          the a, b, c, d and average Pb and Pr values into abc_val
  * Parameters:  an array of floats with the XYZ values of the 4 pixels
  *                  [Y1, Y2, Y3, Y4, Pb1, Pb2, Pb3, Pb4, Pr1, Pr2, Pr3, Pr4]
- * Returns:     a pointer to an array of floats [a, b, c, d, Pb_avg, Pr_avg]
- * Note:        It is a CRE for xyz_val to be NULL
+ *              an array of 6 floats to hold [a, b, c, d, Pb_avg, Pr_avg]
+ * Returns:     None
+ * Note:        It is a CRE for xyz_val or abc_val to be NULL
  */
-float *do_compression_math(float *xyz_val)
+void do_compression_math(float *xyz_val, float *abc_val)
 {
     assert(xyz_val != NULL);
-
-    float *abc_val = ALLOC(6 * sizeof(float));
+    assert(abc_val != NULL);
     
     /* calculate a, b, c, d. Store at indices 0-3, respectively */
     abc_val[0] = (xyz_val[3] + xyz_val[2] + xyz_val[1] + xyz_val[0]) / 4.0;
@@ -222,25 +351,23 @@ float *do_compression_math(float *xyz_val)
     }
     abc_val[4] = pb_sum / 4.0;
     abc_val[5] = pr_sum / 4.0;
-
-    return abc_val;
 }
 
 
 /*do_decomp_math
  * Purpose: Given an array with one block's worth of  a, b, c, d and average 
- *          Pb and Pr values, calculates, allocates and returns a pointer to a
- *          float array with the trasformed XYZ (aka Y/Pb/Pr) values
+ *          Pb and Pr values, calculates the trasformed XYZ (aka Y/Pb/Pr) 
+ *          values into xyz_val
  * Parameters: a pointer to float array abc_val [a, b, c, d, Pb_avg, Pr_avg]
- * Returns: xyz_val, an array of floats with the XYZ values of the 4 pixels
- *          [Y1, Y2, Y3, Y4, Pb1, Pb2, Pb3, Pb4, Pr1, Pr2, Pr3, Pr4]
- * Note:    it is a CRE for abc_val to be NULL
+ *             xyz_val, an array of 12 floats to hold the XYZ values of the 
+ *             4 pixels [Y1, Y2, Y3, Y4, Pb1, Pb2, Pb3, Pb4, Pr1, Pr2, Pr3, Pr4]
+ * Returns: None
+ * Note:    it is a CRE for abc_val or xyz_val to be NULL
  */
-float *do_decomp_math(float *abc_val)
+void do_decomp_math(float *abc_val, float *xyz_val)
 {
     assert(abc_val != NULL);
-
-    float *xyz_val = ALLOC(sizeof(float) * 12);
+    assert(xyz_val != NULL);
     
     /* calculate Y values for each pixel */
     xyz_val[0] = abc_val[0] - abc_val[1] - abc_val[2] + abc_val[3];
@@ -253,8 +380,5 @@ float *do_decomp_math(float *abc_val)
         xyz_val[i] = abc_val[4];
         xyz_val[i + 4] = abc_val[5];   
     }
-
-    FREE(abc_val);
-    return xyz_val;
 }
 
@@ -20,11 +20,41 @@
  */
 Comp_img xyz_compress(XYZ_img img);
 
+/* Purpose: Like xyz_compress, but the returned Comp_img is owned by the 
+ *              provided arena (or the heap if arena is NULL)
+ * Note: It is a CRE to pass this function a null XYZ_img
+ */
+Comp_img xyz_compress_in(Img_arena arena, XYZ_img img);
+
 /* Purpose: Given a Comp_img struct with a compressed image, returns it as a 
  *               XYZ_img with CIE XYZ colorspace pixels
  * Note: It is a CRE to pass this function a null Comp_img struct
  */
 XYZ_img xyz_decompress(Comp_img img);
 
+/* Purpose: Like xyz_decompress, but the returned XYZ_img is owned by the 
+ *              provided arena (or the heap if arena is NULL)
+ * Note: It is a CRE to pass this function a null Comp_img struct
+ */
+XYZ_img xyz_decompress_in(Img_arena arena, Comp_img img);
+
+/* Purpose: Calls apply with each 2x2 block's [a, b, c, d, Pb_avg, Pr_avg],
+ *              in the order xyz_compress packs words, for coders that 
+ *              quantize blocks some other way
+ * Note: It is a CRE to pass this function a null XYZ_img or apply
+ */
+void xyz_map_blocks(XYZ_img img, void apply(float *abc_val, void *cl),
+                    void *cl);
+
+/* Purpose: Builds a width x height XYZ_img owned by the provided arena (or
+ *              the heap if arena is NULL) from the [a, b, c, d, Pb_avg, 
+ *              Pr_avg] apply fills in for each block, in the order 
+ *              xyz_decompress reads words
+ * Note: It is a CRE to pass this function a null apply, or a width or 
+ *       height that is < 2
+ */
+XYZ_img xyz_from_blocks_in(Img_arena arena, unsigned width, unsigned height,
+                           void apply(float *abc_val, void *cl), void *cl);
+
 
 #endif
\ No newline at end of file